@@ -1,6 +1,7 @@
 #include "mir-bitmap.h"
 
-int main (void) {
+/* Bit I of SPARSE_MASK defines sparse representation for bitmap I + 1: */
+static int test (int sparse_mask) {
   int status;
   bitmap_t b1, b2, b3, b4;
 
@@ -8,6 +9,10 @@ int main (void) {
   b2 = bitmap_create ();
   b3 = bitmap_create ();
   b4 = bitmap_create ();
+  bitmap_make_sparse (b1, (sparse_mask & 1) != 0);
+  bitmap_make_sparse (b2, (sparse_mask & 2) != 0);
+  bitmap_make_sparse (b3, (sparse_mask & 4) != 0);
+  bitmap_make_sparse (b4, (sparse_mask & 8) != 0);
   status = bitmap_empty_p (b1);
   status &= bitmap_bit_count (b1) == 0;
 
@@ -112,10 +117,59 @@ int main (void) {
   status &= n == 362;
   status &= nmin == 30 && nmax == 391;
 
-  fprintf (stderr, status ? "BITMAP OK\n" : "BITMAP FAILURE!\n");
+  bitmap_clear (b2);
+  status &= bitmap_set_bit_p (b2, 100000);
+  status &= bitmap_set_bit_p (b2, 5);
+  status &= bitmap_set_bit_p (b2, 500);
+  bitmap_copy (b4, b2);
+  status &= bitmap_equal_p (b4, b2);
+  status &= bitmap_bit_count (b4) == 3;
+  n = 0;
+  FOREACH_BITMAP_BIT (iter, b4, nb) {
+    status &= nb == (n == 0 ? 5 : n == 1 ? 500 : 100000);
+    n++;
+  }
+  status &= n == 3;
+  status &= bitmap_find_next_bit_p (b4, 0, &nb) && nb == 5;
+  status &= bitmap_find_next_bit_p (b4, 5, &nb) && nb == 5;
+  status &= bitmap_find_next_bit_p (b4, 6, &nb) && nb == 500;
+  status &= bitmap_find_next_bit_p (b4, 501, &nb) && nb == 100000;
+  status &= !bitmap_find_next_bit_p (b4, 100001, &nb);
+  status &= bitmap_ior (b4, b4, b1);
+  status &= !bitmap_ior (b4, b4, b1);
+  status &= bitmap_bit_count (b4) == 365;
+  status &= bitmap_and_compl (b4, b4, b1);
+  status &= bitmap_equal_p (b4, b2);
+  status &= bitmap_clear_bit_p (b4, 100000);
+  status &= !bitmap_equal_p (b4, b2);
+  status &= bitmap_intersect_p (b4, b2);
+  status &= !bitmap_intersect_p (b1, b2);
+
+  /* Removing a word before the current one during the iteration: */
+  bitmap_clear (b4);
+  status &= bitmap_set_bit_p (b4, 5);
+  status &= bitmap_set_bit_p (b4, 200);
+  status &= bitmap_set_bit_p (b4, 201);
+  status &= bitmap_set_bit_p (b4, 300);
+  n = 0;
+  FOREACH_BITMAP_BIT (iter, b4, nb) {
+    status &= nb == (n == 0 ? 5 : n == 1 ? 200 : n == 2 ? 201 : 300);
+    if (nb == 200) status &= bitmap_clear_bit_p (b4, 5);
+    n++;
+  }
+  status &= n == 4;
+
   bitmap_destroy (b1);
   bitmap_destroy (b2);
   bitmap_destroy (b3);
   bitmap_destroy (b4);
+  return status;
+}
+
+int main (void) {
+  int status = TRUE;
+
+  for (int sparse_mask = 0; sparse_mask < 16; sparse_mask++) status &= test (sparse_mask);
+  fprintf (stderr, status ? "BITMAP OK\n" : "BITMAP FAILURE!\n");
   return !status;
 }
@@ -9818,8 +9818,6 @@ struct gen_ctx {
     VARR (MIR_var_t) * arg_vars;
   } proto_info;
   VARR (init_el_t) * init_els;
-  MIR_item_t memset_proto, memset_item;
-  MIR_item_t memcpy_proto, memcpy_item;
   VARR (MIR_op_t) * call_ops, *ret_ops, *switch_ops;
   VARR (case_t) * switch_cases;
   int curr_mir_proto_num;
@@ -9837,10 +9835,6 @@ struct gen_ctx {
 #define top_gen_last_op gen_ctx->top_gen_last_op
 #define proto_info gen_ctx->proto_info
 #define init_els gen_ctx->init_els
-#define memset_proto gen_ctx->memset_proto
-#define memset_item gen_ctx->memset_item
-#define memcpy_proto gen_ctx->memcpy_proto
-#define memcpy_item gen_ctx->memcpy_item
 #define call_ops gen_ctx->call_ops
 #define ret_ops gen_ctx->ret_ops
 #define switch_ops gen_ctx->switch_ops
@@ -10567,57 +10561,16 @@ static void top_gen (c2m_ctx_t c2m_ctx, node_t r, MIR_label_t true_label, MIR_la
   top_gen_last_op = gen (c2m_ctx, r, true_label, false_label, FALSE, NULL);
 }
 
-static op_t modify_for_block_move (c2m_ctx_t c2m_ctx, op_t mem, op_t index) {
-  MIR_context_t ctx = c2m_ctx->ctx;
-  op_t base;
-
-  assert (mem.mir_op.u.mem.base != 0 && mem.mir_op.mode == MIR_OP_MEM
-          && index.mir_op.mode == MIR_OP_REG);
-  if (mem.mir_op.u.mem.index == 0) {
-    mem.mir_op.u.mem.index = index.mir_op.u.reg;
-    mem.mir_op.u.mem.scale = 1;
-  } else {
-    base = get_new_temp (c2m_ctx, MIR_T_I64);
-    if (mem.mir_op.u.mem.scale != 1)
-      emit3 (c2m_ctx, MIR_MUL, base.mir_op, MIR_new_reg_op (ctx, mem.mir_op.u.mem.index),
-             MIR_new_int_op (ctx, mem.mir_op.u.mem.scale));
-    else
-      emit2 (c2m_ctx, MIR_MOV, base.mir_op, MIR_new_reg_op (ctx, mem.mir_op.u.mem.index));
-    emit3 (c2m_ctx, MIR_ADD, base.mir_op, base.mir_op, MIR_new_reg_op (ctx, mem.mir_op.u.mem.base));
-    mem.mir_op.u.mem.base = base.mir_op.u.reg;
-    mem.mir_op.u.mem.index = index.mir_op.u.reg;
-    mem.mir_op.u.mem.scale = 1;
-  }
-  return mem;
-}
-
 static void gen_memcpy (c2m_ctx_t c2m_ctx, MIR_disp_t disp, MIR_reg_t base, op_t val,
                         mir_size_t len);
 
 static void block_move (c2m_ctx_t c2m_ctx, op_t var, op_t val, mir_size_t size) {
-  gen_ctx_t gen_ctx = c2m_ctx->gen_ctx;
   MIR_context_t ctx = c2m_ctx->ctx;
-  MIR_label_t repeat_label;
-  op_t index;
 
   if (MIR_op_eq_p (ctx, var.mir_op, val.mir_op) || size == 0) return;
-  if (size > 5) {
-    var = mem_to_address (c2m_ctx, var, TRUE);
-    assert (var.mir_op.mode == MIR_OP_REG);
-    gen_memcpy (c2m_ctx, 0, var.mir_op.u.reg, val, size);
-  } else {
-    repeat_label = MIR_new_label (ctx);
-    index = get_new_temp (c2m_ctx, MIR_T_I64);
-    emit2 (c2m_ctx, MIR_MOV, index.mir_op, MIR_new_int_op (ctx, size));
-    val = modify_for_block_move (c2m_ctx, val, index);
-    var = modify_for_block_move (c2m_ctx, var, index);
-    emit_label_insn_opt (c2m_ctx, repeat_label);
-    emit3 (c2m_ctx, MIR_SUB, index.mir_op, index.mir_op, one_op.mir_op);
-    assert (var.mir_op.mode == MIR_OP_MEM && val.mir_op.mode == MIR_OP_MEM);
-    val.mir_op.u.mem.type = var.mir_op.u.mem.type = MIR_T_I8;
-    emit2 (c2m_ctx, MIR_MOV, var.mir_op, val.mir_op);
-    emit3 (c2m_ctx, MIR_BGT, MIR_new_label_op (ctx, repeat_label), index.mir_op, zero_op.mir_op);
-  }
+  var = mem_to_address (c2m_ctx, var, TRUE);
+  assert (var.mir_op.mode == MIR_OP_REG);
+  gen_memcpy (c2m_ctx, 0, var.mir_op.u.reg, val, size);
 }
 
 static const char *get_reg_var_name (c2m_ctx_t c2m_ctx, MIR_type_t promoted_type,
@@ -11180,82 +11133,35 @@ static void move_item_forward (c2m_ctx_t c2m_ctx, MIR_item_t item) {
   DLIST_INSERT_BEFORE (MIR_item_t, curr_func->module->items, curr_func, item);
 }
 
+static MIR_op_t get_block_addr_op (c2m_ctx_t c2m_ctx, MIR_disp_t disp, MIR_reg_t base) {
+  MIR_context_t ctx = c2m_ctx->ctx;
+  MIR_op_t treg_op;
+
+  if (disp == 0) return MIR_new_reg_op (ctx, base);
+  treg_op = get_new_temp (c2m_ctx, get_int_mir_type (sizeof (mir_size_t))).mir_op;
+  emit3 (c2m_ctx, MIR_ADD, treg_op, MIR_new_reg_op (ctx, base), MIR_new_int_op (ctx, disp));
+  return treg_op;
+}
+
 static void gen_memset (c2m_ctx_t c2m_ctx, MIR_disp_t disp, MIR_reg_t base, mir_size_t len) {
   gen_ctx_t gen_ctx = c2m_ctx->gen_ctx;
   MIR_context_t ctx = c2m_ctx->ctx;
-  MIR_type_t ret_type;
-  MIR_var_t vars[3];
-  MIR_op_t treg_op, args[6];
-  MIR_module_t module;
-
-  if (memset_item == NULL) {
-    ret_type = get_int_mir_type (sizeof (mir_size_t));
-    vars[0].name = "s";
-    vars[0].type = get_int_mir_type (sizeof (mir_size_t));
-    vars[1].name = "c";
-    vars[1].type = get_int_mir_type (sizeof (mir_int));
-    vars[2].name = "n";
-    vars[2].type = get_int_mir_type (sizeof (mir_size_t));
-    module = curr_func->module;
-    memset_proto = MIR_new_proto_arr (ctx, "memset_p", 1, &ret_type, 3, vars);
-    memset_item = MIR_new_import (ctx, "memset");
-    move_item_to_module_start (module, memset_proto);
-    move_item_to_module_start (module, memset_item);
-  }
-  args[0] = MIR_new_ref_op (ctx, memset_proto);
-  args[1] = MIR_new_ref_op (ctx, memset_item);
-  args[2] = get_new_temp (c2m_ctx, get_int_mir_type (sizeof (mir_size_t))).mir_op;
-  if (disp == 0) {
-    treg_op = MIR_new_reg_op (ctx, base);
-  } else {
-    treg_op = get_new_temp (c2m_ctx, get_int_mir_type (sizeof (mir_size_t))).mir_op;
-    emit3 (c2m_ctx, MIR_ADD, treg_op, MIR_new_reg_op (ctx, base), MIR_new_int_op (ctx, disp));
-  }
-  args[3] = treg_op;
-  args[4] = MIR_new_int_op (ctx, 0);
-  args[5] = MIR_new_uint_op (ctx, len);
-  emit_insn (c2m_ctx, MIR_new_insn_arr (ctx, MIR_CALL, 6 /* args + proto + func + res */, args));
+
+  emit3 (c2m_ctx, MIR_MEMSET, get_block_addr_op (c2m_ctx, disp, base), zero_op.mir_op,
+         MIR_new_uint_op (ctx, len));
 }
 
 static void gen_memcpy (c2m_ctx_t c2m_ctx, MIR_disp_t disp, MIR_reg_t base, op_t val,
                         mir_size_t len) {
-  gen_ctx_t gen_ctx = c2m_ctx->gen_ctx;
   MIR_context_t ctx = c2m_ctx->ctx;
-  MIR_type_t ret_type;
-  MIR_var_t vars[3];
-  MIR_op_t treg_op, args[6];
-  MIR_module_t module;
+  MIR_op_t treg_op;
 
   if (val.mir_op.mode == MIR_OP_MEM && val.mir_op.u.mem.index == 0 && val.mir_op.u.mem.disp == disp
       && val.mir_op.u.mem.base == base)
     return;
-  if (memcpy_item == NULL) {
-    ret_type = get_int_mir_type (sizeof (mir_size_t));
-    vars[0].name = "dest";
-    vars[0].type = get_int_mir_type (sizeof (mir_size_t));
-    vars[1].name = "src";
-    vars[1].type = get_int_mir_type (sizeof (mir_size_t));
-    vars[2].name = "n";
-    vars[2].type = get_int_mir_type (sizeof (mir_size_t));
-    module = curr_func->module;
-    memcpy_proto = MIR_new_proto_arr (ctx, "memcpy_p", 1, &ret_type, 3, vars);
-    memcpy_item = MIR_new_import (ctx, "memcpy");
-    move_item_to_module_start (module, memcpy_proto);
-    move_item_to_module_start (module, memcpy_item);
-  }
-  args[0] = MIR_new_ref_op (ctx, memcpy_proto);
-  args[1] = MIR_new_ref_op (ctx, memcpy_item);
-  args[2] = get_new_temp (c2m_ctx, get_int_mir_type (sizeof (mir_size_t))).mir_op;
-  if (disp == 0) {
-    treg_op = MIR_new_reg_op (ctx, base);
-  } else {
-    treg_op = get_new_temp (c2m_ctx, get_int_mir_type (sizeof (mir_size_t))).mir_op;
-    emit3 (c2m_ctx, MIR_ADD, treg_op, MIR_new_reg_op (ctx, base), MIR_new_int_op (ctx, disp));
-  }
-  args[3] = treg_op;
-  args[4] = mem_to_address (c2m_ctx, val, FALSE).mir_op;
-  args[5] = MIR_new_uint_op (ctx, len);
-  emit_insn (c2m_ctx, MIR_new_insn_arr (ctx, MIR_CALL, 6 /* args + proto + func + res */, args));
+  treg_op = get_block_addr_op (c2m_ctx, disp, base);
+  emit3 (c2m_ctx, MIR_MEMCPY, treg_op, mem_to_address (c2m_ctx, val, FALSE).mir_op,
+         MIR_new_uint_op (ctx, len));
 }
 
 static void emit_scalar_assign (c2m_ctx_t c2m_ctx, op_t var, op_t *val, MIR_type_t t,
@@ -12899,7 +12805,6 @@ static void gen_mir (c2m_ctx_t c2m_ctx, node_t r) {
   VARR_CREATE (MIR_op_t, switch_ops, 128);
   VARR_CREATE (case_t, switch_cases, 64);
   VARR_CREATE (init_el_t, init_els, 128);
-  memset_proto = memset_item = memcpy_proto = memcpy_item = NULL;
   top_gen (c2m_ctx, r, NULL, NULL);
   gen_finish (c2m_ctx);
 }
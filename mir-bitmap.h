@@ -40,36 +40,111 @@ typedef uint64_t bitmap_el_t;
 
 DEF_VARR (bitmap_el_t);
 
-typedef VARR (bitmap_el_t) * bitmap_t;
-typedef const VARR (bitmap_el_t) * const_bitmap_t;
+/* A bitmap can be dense or sparse.  Words of a dense bitmap are stored in ELS one by one.  A
+   sparse bitmap contains only non-zero words, ELS is a sequence of pairs <word index, word>
+   ordered by the index.  SPARE is used to build results of operations on sparse bitmaps.  Any
+   operation can work on bitmaps of different representations, the representation of the
+   result bitmap is always kept.  */
+struct bitmap {
+  int sparse_p;
+  VARR (bitmap_el_t) * els, *spare;
+};
+
+typedef struct bitmap *bitmap_t;
+typedef const struct bitmap *const_bitmap_t;
 
 static inline bitmap_t bitmap_create2 (size_t init_bits_num) {
-  bitmap_t bm;
+  bitmap_t bm = malloc (sizeof (struct bitmap));
 
-  VARR_CREATE (bitmap_el_t, bm, (init_bits_num + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS);
+  if (bm == NULL) mir_varr_error ("no memory");
+  bm->sparse_p = FALSE;
+  bm->spare = NULL;
+  VARR_CREATE (bitmap_el_t, bm->els, (init_bits_num + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS);
   return bm;
 }
 
 static inline bitmap_t bitmap_create (void) { return bitmap_create2 (0); }
 
-static inline void bitmap_destroy (bitmap_t bm) { VARR_DESTROY (bitmap_el_t, bm); }
+static inline void bitmap_destroy (bitmap_t bm) {
+  VARR_DESTROY (bitmap_el_t, bm->els);
+  if (bm->spare != NULL) VARR_DESTROY (bitmap_el_t, bm->spare);
+  free (bm);
+}
+
+static inline void bitmap_clear (bitmap_t bm) { VARR_TRUNC (bitmap_el_t, bm->els, 0); }
 
-static inline void bitmap_clear (bitmap_t bm) { VARR_TRUNC (bitmap_el_t, bm, 0); }
+/* Make BM empty and change its representation to sparse one if SPARSE_P or to dense one
+   otherwise.  Sparse bitmaps are profitable when a few bits of a big range are set.  */
+static inline void bitmap_make_sparse (bitmap_t bm, int sparse_p) {
+  bitmap_clear (bm);
+  bm->sparse_p = sparse_p;
+  if (sparse_p && bm->spare == NULL) VARR_CREATE (bitmap_el_t, bm->spare, 0);
+}
+
+static inline int bitmap_sparse_p (const_bitmap_t bm) { return bm->sparse_p; }
 
 static inline void bitmap_expand (bitmap_t bm, size_t nb) {
-  size_t i, len = VARR_LENGTH (bitmap_el_t, bm);
+  size_t i, len = VARR_LENGTH (bitmap_el_t, bm->els);
   size_t new_len = (nb + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
 
-  for (i = len; i < new_len; i++) VARR_PUSH (bitmap_el_t, bm, (bitmap_el_t) 0);
+  BITMAP_ASSERT (!bm->sparse_p, expand);
+  for (i = len; i < new_len; i++) VARR_PUSH (bitmap_el_t, bm->els, (bitmap_el_t) 0);
+}
+
+/* Return the position of the first pair in sparse BM whose word index is >= NW: */
+static inline size_t bitmap_sparse_find (const_bitmap_t bm, size_t nw) {
+  size_t l = 0, r = VARR_LENGTH (bitmap_el_t, bm->els) / 2, m;
+  bitmap_el_t *addr = VARR_ADDR (bitmap_el_t, bm->els);
+
+  while (l < r) {
+    m = (l + r) / 2;
+    if (addr[2 * m] < nw)
+      l = m + 1;
+    else
+      r = m;
+  }
+  return l;
+}
+
+/* Return address of word NW in sparse BM.  If there is no such word, return NULL or add a zero
+   word if ADD_P. */
+static inline bitmap_el_t *bitmap_sparse_word (bitmap_t bm, size_t nw, int add_p) {
+  size_t len, pos = bitmap_sparse_find (bm, nw);
+  bitmap_el_t *addr = VARR_ADDR (bitmap_el_t, bm->els);
+
+  len = VARR_LENGTH (bitmap_el_t, bm->els);
+  if (2 * pos < len && addr[2 * pos] == nw) return &addr[2 * pos + 1];
+  if (!add_p) return NULL;
+  VARR_PUSH (bitmap_el_t, bm->els, 0);
+  VARR_PUSH (bitmap_el_t, bm->els, 0);
+  addr = VARR_ADDR (bitmap_el_t, bm->els);
+  memmove (&addr[2 * pos + 2], &addr[2 * pos], (len - 2 * pos) * sizeof (bitmap_el_t));
+  addr[2 * pos] = nw;
+  addr[2 * pos + 1] = 0;
+  return &addr[2 * pos + 1];
+}
+
+/* Remove zero word with address WORD_ADDR from sparse BM: */
+static inline void bitmap_sparse_remove_word (bitmap_t bm, bitmap_el_t *word_addr) {
+  bitmap_el_t *addr = VARR_ADDR (bitmap_el_t, bm->els);
+  size_t len = VARR_LENGTH (bitmap_el_t, bm->els), pos = word_addr - addr - 1;
+
+  memmove (&addr[pos], &addr[pos + 2], (len - pos - 2) * sizeof (bitmap_el_t));
+  VARR_TRUNC (bitmap_el_t, bm->els, len - 2);
 }
 
 static inline int bitmap_bit_p (const_bitmap_t bm, size_t nb) {
-  size_t nw, sh, len = VARR_LENGTH (bitmap_el_t, bm);
-  bitmap_el_t *addr = VARR_ADDR (bitmap_el_t, bm);
+  size_t nw, sh, len = VARR_LENGTH (bitmap_el_t, bm->els);
+  bitmap_el_t *addr = VARR_ADDR (bitmap_el_t, bm->els);
 
-  if (nb >= BITMAP_WORD_BITS * len) return 0;
   nw = nb / BITMAP_WORD_BITS;
   sh = nb % BITMAP_WORD_BITS;
+  if (bm->sparse_p) {
+    size_t pos = bitmap_sparse_find (bm, nw);
+
+    return 2 * pos < len && addr[2 * pos] == nw && ((addr[2 * pos + 1] >> sh) & 1);
+  }
+  if (nb >= BITMAP_WORD_BITS * len) return 0;
   return (addr[nw] >> sh) & 1;
 }
 
@@ -78,25 +153,35 @@ static inline int bitmap_set_bit_p (bitmap_t bm, size_t nb) {
   bitmap_el_t *addr;
   int res;
 
-  bitmap_expand (bm, nb + 1);
-  addr = VARR_ADDR (bitmap_el_t, bm);
   nw = nb / BITMAP_WORD_BITS;
   sh = nb % BITMAP_WORD_BITS;
-  res = ((addr[nw] >> sh) & 1) == 0;
-  addr[nw] |= (bitmap_el_t) 1 << sh;
+  if (bm->sparse_p) {
+    addr = bitmap_sparse_word (bm, nw, TRUE);
+  } else {
+    bitmap_expand (bm, nb + 1);
+    addr = &VARR_ADDR (bitmap_el_t, bm->els)[nw];
+  }
+  res = ((*addr >> sh) & 1) == 0;
+  *addr |= (bitmap_el_t) 1 << sh;
   return res;
 }
 
 static inline int bitmap_clear_bit_p (bitmap_t bm, size_t nb) {
-  size_t nw, sh, len = VARR_LENGTH (bitmap_el_t, bm);
-  bitmap_el_t *addr = VARR_ADDR (bitmap_el_t, bm);
+  size_t nw, sh, len = VARR_LENGTH (bitmap_el_t, bm->els);
+  bitmap_el_t *addr;
   int res;
 
-  if (nb >= BITMAP_WORD_BITS * len) return 0;
   nw = nb / BITMAP_WORD_BITS;
   sh = nb % BITMAP_WORD_BITS;
-  res = (addr[nw] >> sh) & 1;
-  addr[nw] &= ~((bitmap_el_t) 1 << sh);
+  if (bm->sparse_p) {
+    if ((addr = bitmap_sparse_word (bm, nw, FALSE)) == NULL) return 0;
+  } else {
+    if (nb >= BITMAP_WORD_BITS * len) return 0;
+    addr = &VARR_ADDR (bitmap_el_t, bm->els)[nw];
+  }
+  res = (*addr >> sh) & 1;
+  *addr &= ~((bitmap_el_t) 1 << sh);
+  if (bm->sparse_p && *addr == 0) bitmap_sparse_remove_word (bm, addr);
   return res;
 }
 
@@ -105,19 +190,23 @@ static inline int bitmap_set_or_clear_bit_range_p (bitmap_t bm, size_t nb, size_
   bitmap_el_t mask, *addr;
   int res = 0;
 
-  bitmap_expand (bm, nb + len);
-  addr = VARR_ADDR (bitmap_el_t, bm);
+  if (!bm->sparse_p) bitmap_expand (bm, nb + len);
   while (len > 0) {
     nw = nb / BITMAP_WORD_BITS;
     lsh = nb % BITMAP_WORD_BITS;
     rsh = len >= BITMAP_WORD_BITS - lsh ? 0 : BITMAP_WORD_BITS - (nb + len) % BITMAP_WORD_BITS;
     mask = ((~(bitmap_el_t) 0) >> (rsh + lsh)) << lsh;
+    if (!bm->sparse_p)
+      addr = &VARR_ADDR (bitmap_el_t, bm->els)[nw];
+    else
+      addr = bitmap_sparse_word (bm, nw, set_p);
     if (set_p) {
-      res |= (~addr[nw] & mask) != 0;
-      addr[nw] |= mask;
-    } else {
-      res |= (addr[nw] & mask) != 0;
-      addr[nw] &= ~mask;
+      res |= (~*addr & mask) != 0;
+      *addr |= mask;
+    } else if (addr != NULL) {
+      res |= (*addr & mask) != 0;
+      *addr &= ~mask;
+      if (bm->sparse_p && *addr == 0) bitmap_sparse_remove_word (bm, addr);
     }
     range_len = BITMAP_WORD_BITS - rsh - lsh;
     len -= range_len;
@@ -134,24 +223,100 @@ static inline int bitmap_clear_bit_range_p (bitmap_t bm, size_t nb, size_t len)
   return bitmap_set_or_clear_bit_range_p (bm, nb, len, FALSE);
 }
 
-static inline void bitmap_copy (bitmap_t dst, const_bitmap_t src) {
-  size_t dst_len = VARR_LENGTH (bitmap_el_t, dst);
-  size_t src_len = VARR_LENGTH (bitmap_el_t, src);
+/* Cursor to get words of a bitmap in increasing order of their indexes: */
+typedef struct {
+  const bitmap_el_t *addr;
+  size_t len, pos; /* number of words (pairs for sparse bitmap) and the next word (pair) */
+  int sparse_p;
+} bitmap_cursor_t;
+
+static inline void bitmap_cursor_init (bitmap_cursor_t *c, const_bitmap_t bm) {
+  c->addr = VARR_ADDR (bitmap_el_t, bm->els);
+  c->sparse_p = bm->sparse_p;
+  c->len = VARR_LENGTH (bitmap_el_t, bm->els) / (bm->sparse_p ? 2 : 1);
+  c->pos = 0;
+}
+
+/* Return index of the next word of the cursor or SIZE_MAX if there are no more words: */
+static inline size_t bitmap_cursor_index (const bitmap_cursor_t *c) {
+  if (c->pos >= c->len) return SIZE_MAX;
+  return c->sparse_p ? (size_t) c->addr[2 * c->pos] : c->pos;
+}
 
-  if (dst_len >= src_len)
-    VARR_TRUNC (bitmap_el_t, dst, src_len);
-  else
-    bitmap_expand (dst, src_len * BITMAP_WORD_BITS);
-  memcpy (VARR_ADDR (bitmap_el_t, dst), VARR_ADDR (bitmap_el_t, src),
-          src_len * sizeof (bitmap_el_t));
+/* Return 1 + the biggest index of the cursor words: */
+static inline size_t bitmap_cursor_bound (const bitmap_cursor_t *c) {
+  if (!c->sparse_p || c->len == 0) return c->len;
+  return (size_t) c->addr[2 * c->len - 2] + 1;
+}
+
+/* Return word NW of the cursor bitmap.  NW should be not less than the previously requested
+   one. */
+static inline bitmap_el_t bitmap_cursor_word (bitmap_cursor_t *c, size_t nw) {
+  if (!c->sparse_p) {
+    c->pos = nw + 1;
+    return nw < c->len ? c->addr[nw] : 0;
+  }
+  while (c->pos < c->len && c->addr[2 * c->pos] < nw) c->pos++;
+  if (c->pos >= c->len || c->addr[2 * c->pos] != nw) return 0;
+  return c->addr[2 * c->pos++ + 1];
+}
+
+static inline void bitmap_copy (bitmap_t dst, const_bitmap_t src) {
+  size_t dst_len = VARR_LENGTH (bitmap_el_t, dst->els);
+  size_t src_len = VARR_LENGTH (bitmap_el_t, src->els);
+
+  if (dst == src) return;
+  if (dst->sparse_p == src->sparse_p) {
+    if (dst_len >= src_len)
+      VARR_TRUNC (bitmap_el_t, dst->els, src_len);
+    else
+      while (dst_len++ < src_len) VARR_PUSH (bitmap_el_t, dst->els, 0);
+    memcpy (VARR_ADDR (bitmap_el_t, dst->els), VARR_ADDR (bitmap_el_t, src->els),
+            src_len * sizeof (bitmap_el_t));
+  } else {
+    bitmap_cursor_t c;
+    size_t nw;
+    bitmap_el_t el;
+
+    bitmap_clear (dst);
+    bitmap_cursor_init (&c, src);
+    while ((nw = bitmap_cursor_index (&c)) != SIZE_MAX) {
+      if ((el = bitmap_cursor_word (&c, nw)) == 0) continue;
+      if (dst->sparse_p) {
+        VARR_PUSH (bitmap_el_t, dst->els, nw);
+      } else {
+        bitmap_expand (dst, nw * BITMAP_WORD_BITS);
+      }
+      VARR_PUSH (bitmap_el_t, dst->els, el);
+    }
+  }
 }
 
 static inline int bitmap_equal_p (const_bitmap_t bm1, const_bitmap_t bm2) {
   const_bitmap_t temp_bm;
-  size_t i, temp_len, bm1_len = VARR_LENGTH (bitmap_el_t, bm1);
-  size_t bm2_len = VARR_LENGTH (bitmap_el_t, bm2);
+  size_t i, temp_len, bm1_len = VARR_LENGTH (bitmap_el_t, bm1->els);
+  size_t bm2_len = VARR_LENGTH (bitmap_el_t, bm2->els);
   bitmap_el_t *addr1, *addr2;
 
+  if (bm1->sparse_p != bm2->sparse_p) {
+    bitmap_cursor_t c1, c2;
+    size_t nw1, nw2;
+
+    bitmap_cursor_init (&c1, bm1);
+    bitmap_cursor_init (&c2, bm2);
+    for (;;) {
+      nw1 = bitmap_cursor_index (&c1);
+      nw2 = bitmap_cursor_index (&c2);
+      if (nw1 == SIZE_MAX && nw2 == SIZE_MAX) return TRUE;
+      if (nw1 > nw2) nw1 = nw2;
+      if (bitmap_cursor_word (&c1, nw1) != bitmap_cursor_word (&c2, nw1)) return FALSE;
+    }
+  }
+  if (bm1->sparse_p)
+    return (bm1_len == bm2_len
+            && memcmp (VARR_ADDR (bitmap_el_t, bm1->els), VARR_ADDR (bitmap_el_t, bm2->els),
+                       bm1_len * sizeof (bitmap_el_t))
+                 == 0);
   if (bm1_len > bm2_len) {
     temp_bm = bm1;
     bm1 = bm2;
@@ -160,8 +325,8 @@ static inline int bitmap_equal_p (const_bitmap_t bm1, const_bitmap_t bm2) {
     bm1_len = bm2_len;
     bm2_len = temp_len;
   }
-  addr1 = VARR_ADDR (bitmap_el_t, bm1);
-  addr2 = VARR_ADDR (bitmap_el_t, bm2);
+  addr1 = VARR_ADDR (bitmap_el_t, bm1->els);
+  addr2 = VARR_ADDR (bitmap_el_t, bm2->els);
   if (memcmp (addr1, addr2, bm1_len * sizeof (bitmap_el_t)) != 0) return FALSE;
   for (i = bm1_len; i < bm2_len; i++)
     if (addr2[i] != 0) return FALSE;
@@ -169,11 +334,26 @@ static inline int bitmap_equal_p (const_bitmap_t bm1, const_bitmap_t bm2) {
 }
 
 static inline int bitmap_intersect_p (const_bitmap_t bm1, const_bitmap_t bm2) {
-  size_t i, min_len, bm1_len = VARR_LENGTH (bitmap_el_t, bm1);
-  size_t bm2_len = VARR_LENGTH (bitmap_el_t, bm2);
-  bitmap_el_t *addr1 = VARR_ADDR (bitmap_el_t, bm1);
-  bitmap_el_t *addr2 = VARR_ADDR (bitmap_el_t, bm2);
-
+  size_t i, min_len, bm1_len = VARR_LENGTH (bitmap_el_t, bm1->els);
+  size_t bm2_len = VARR_LENGTH (bitmap_el_t, bm2->els);
+  bitmap_el_t *addr1 = VARR_ADDR (bitmap_el_t, bm1->els);
+  bitmap_el_t *addr2 = VARR_ADDR (bitmap_el_t, bm2->els);
+
+  if (bm1->sparse_p || bm2->sparse_p) {
+    bitmap_cursor_t c1, c2;
+    size_t nw;
+
+    if (!bm1->sparse_p) { /* iterate on the sparse bitmap */
+      const_bitmap_t temp_bm = bm1;
+      bm1 = bm2;
+      bm2 = temp_bm;
+    }
+    bitmap_cursor_init (&c1, bm1);
+    bitmap_cursor_init (&c2, bm2);
+    while ((nw = bitmap_cursor_index (&c1)) != SIZE_MAX)
+      if ((bitmap_cursor_word (&c1, nw) & bitmap_cursor_word (&c2, nw)) != 0) return TRUE;
+    return FALSE;
+  }
   min_len = bm1_len <= bm2_len ? bm1_len : bm2_len;
   for (i = 0; i < min_len; i++)
     if ((addr1[i] & addr2[i]) != 0) return TRUE;
@@ -181,9 +361,10 @@ static inline int bitmap_intersect_p (const_bitmap_t bm1, const_bitmap_t bm2) {
 }
 
 static inline int bitmap_empty_p (const_bitmap_t bm) {
-  size_t i, len = VARR_LENGTH (bitmap_el_t, bm);
-  bitmap_el_t *addr = VARR_ADDR (bitmap_el_t, bm);
+  size_t i, len = VARR_LENGTH (bitmap_el_t, bm->els);
+  bitmap_el_t *addr = VARR_ADDR (bitmap_el_t, bm->els);
 
+  if (bm->sparse_p) return len == 0; /* there are no zero words in sparse bitmap */
   for (i = 0; i < len; i++)
     if (addr[i] != 0) return FALSE;
   return TRUE;
@@ -198,127 +379,271 @@ static inline bitmap_el_t bitmap_el_max3 (bitmap_el_t el1, bitmap_el_t el2, bitm
   return el1 < el3 ? el3 : el1;
 }
 
+/* Return the number of bits set in EL.  Use the population count insn when the target surely has
+   it, otherwise count bits in parallel (this version is vectorized well in loops).  */
+static inline size_t bitmap_el_bit_count (bitmap_el_t el) {
+#if defined(__GNUC__) && (defined(__POPCNT__) || defined(__aarch64__))
+  return __builtin_popcountll (el);
+#else
+  el = el - ((el >> 1) & (bitmap_el_t) 0x5555555555555555ULL);
+  el = ((el & (bitmap_el_t) 0x3333333333333333ULL)
+        + ((el >> 2) & (bitmap_el_t) 0x3333333333333333ULL));
+  el = (el + (el >> 4)) & (bitmap_el_t) 0x0f0f0f0f0f0f0f0fULL;
+  return (el * (bitmap_el_t) 0x0101010101010101ULL) >> 56;
+#endif
+}
+
 /* Return the number of bits set in BM.  */
 static inline size_t bitmap_bit_count (const_bitmap_t bm) {
-  size_t i, len = VARR_LENGTH (bitmap_el_t, bm);
-  bitmap_el_t el, *addr = VARR_ADDR (bitmap_el_t, bm);
+  size_t i, len = VARR_LENGTH (bitmap_el_t, bm->els);
+  bitmap_el_t *addr = VARR_ADDR (bitmap_el_t, bm->els);
   size_t count = 0;
 
-  for (i = 0; i < len; i++) {
-    if ((el = addr[i]) != 0) {
-      for (; el != 0; el >>= 1)
-        if (el & 1) count++;
-    }
+  if (!bm->sparse_p) {
+    for (i = 0; i < len; i++) count += bitmap_el_bit_count (addr[i]);
+  } else {
+    for (i = 1; i < len; i += 2) count += bitmap_el_bit_count (addr[i]);
   }
   return count;
 }
 
-static inline int bitmap_op2 (bitmap_t dst, const_bitmap_t src1, const_bitmap_t src2,
-                              bitmap_el_t (*op) (bitmap_el_t, bitmap_el_t)) {
-  size_t i, len, bound, src1_len, src2_len;
-  bitmap_el_t old, *dst_addr, *src1_addr, *src2_addr;
-  int change_p = FALSE;
-
-  src1_len = VARR_LENGTH (bitmap_el_t, src1);
-  src2_len = VARR_LENGTH (bitmap_el_t, src2);
-  len = bitmap_el_max2 (src1_len, src2_len);
-  bitmap_expand (dst, len * BITMAP_WORD_BITS);
-  dst_addr = VARR_ADDR (bitmap_el_t, dst);
-  src1_addr = VARR_ADDR (bitmap_el_t, src1);
-  src2_addr = VARR_ADDR (bitmap_el_t, src2);
-  for (bound = i = 0; i < len; i++) {
-    old = dst_addr[i];
-    if ((dst_addr[i] = op (i >= src1_len ? 0 : src1_addr[i], i >= src2_len ? 0 : src2_addr[i]))
-        != 0)
-      bound = i + 1;
-    if (old != dst_addr[i]) change_p = TRUE;
+/* Return TRUE and set up *RES to the number of the first set bit of BM which is >= NB.  Return
+   FALSE if there is no such bit.  */
+static inline int bitmap_find_next_bit_p (const_bitmap_t bm, size_t nb, size_t *res) {
+  size_t pos, nw = nb / BITMAP_WORD_BITS, len = VARR_LENGTH (bitmap_el_t, bm->els);
+  bitmap_el_t el, *addr = VARR_ADDR (bitmap_el_t, bm->els);
+
+  if (!bm->sparse_p) {
+    if (nw >= len) return FALSE;
+    el = addr[nw] & (~(bitmap_el_t) 0 << nb % BITMAP_WORD_BITS);
+    while (el == 0) {
+      if (++nw >= len) return FALSE;
+      el = addr[nw];
+    }
+  } else {
+    if (2 * (pos = bitmap_sparse_find (bm, nw)) >= len) return FALSE;
+    el = addr[2 * pos + 1];
+    if (addr[2 * pos] == nw && (el &= ~(bitmap_el_t) 0 << nb % BITMAP_WORD_BITS) == 0) {
+      if (2 * ++pos >= len) return FALSE;
+      el = addr[2 * pos + 1];
+    }
+    nw = addr[2 * pos];
   }
-  VARR_TRUNC (bitmap_el_t, dst, bound);
-  return change_p;
+  *res = nw * BITMAP_WORD_BITS + bitmap_el_bit_count ((el & (~el + 1)) - 1);
+  return TRUE;
 }
 
-static inline bitmap_el_t bitmap_el_and (bitmap_el_t el1, bitmap_el_t el2) { return el1 & el2; }
-
-static inline int bitmap_and (bitmap_t dst, bitmap_t src1, bitmap_t src2) {
-  return bitmap_op2 (dst, src1, src2, bitmap_el_and);
+/* Finish building the result of an operation on sparse DST in DST->SPARE.  Return TRUE if DST
+   changed.  */
+static inline int bitmap_sparse_finish_op (bitmap_t dst) {
+  VARR (bitmap_el_t) *temp = dst->els;
+  size_t len = VARR_LENGTH (bitmap_el_t, temp);
+  int change_p;
+
+  change_p = (len != VARR_LENGTH (bitmap_el_t, dst->spare)
+              || memcmp (VARR_ADDR (bitmap_el_t, temp), VARR_ADDR (bitmap_el_t, dst->spare),
+                         len * sizeof (bitmap_el_t))
+                   != 0);
+  dst->els = dst->spare;
+  dst->spare = temp;
+  return change_p;
 }
 
-static inline bitmap_el_t bitmap_el_and_compl (bitmap_el_t el1, bitmap_el_t el2) {
-  return el1 & ~el2;
-}
+/* Generic version of bitmap_op2 and bitmap_op3 for operands with different representations or
+   sparse operands.  SRC3 and OP3 are NULL for bitmap_op2.  */
+static inline int bitmap_op_generic (bitmap_t dst, const_bitmap_t src1, const_bitmap_t src2,
+                                     const_bitmap_t src3,
+                                     bitmap_el_t (*op2) (bitmap_el_t, bitmap_el_t),
+                                     bitmap_el_t (*op3) (bitmap_el_t, bitmap_el_t,
+                                                         bitmap_el_t)) {
+  bitmap_cursor_t c1, c2, c3;
+  size_t i, nw, nw2, len, bound;
+  bitmap_el_t el, old, *dst_addr;
+  int change_p = FALSE;
 
-static inline int bitmap_and_compl (bitmap_t dst, bitmap_t src1, bitmap_t src2) {
-  return bitmap_op2 (dst, src1, src2, bitmap_el_and_compl);
+  if (!dst->sparse_p) { /* process all words in place: */
+    bitmap_cursor_init (&c1, src1);
+    bitmap_cursor_init (&c2, src2);
+    len = bitmap_el_max2 (bitmap_cursor_bound (&c1), bitmap_cursor_bound (&c2));
+    if (src3 != NULL) {
+      bitmap_cursor_init (&c3, src3);
+      len = bitmap_el_max2 (len, bitmap_cursor_bound (&c3));
+    }
+    bitmap_expand (dst, len * BITMAP_WORD_BITS);
+    /* Reinitialize as dst can be a source and its words can be reallocated: */
+    bitmap_cursor_init (&c1, src1);
+    bitmap_cursor_init (&c2, src2);
+    if (src3 != NULL) bitmap_cursor_init (&c3, src3);
+    dst_addr = VARR_ADDR (bitmap_el_t, dst->els);
+    for (bound = i = 0; i < len; i++) {
+      old = dst_addr[i];
+      el = (src3 == NULL ? op2 (bitmap_cursor_word (&c1, i), bitmap_cursor_word (&c2, i))
+                         : op3 (bitmap_cursor_word (&c1, i), bitmap_cursor_word (&c2, i),
+                                bitmap_cursor_word (&c3, i)));
+      if ((dst_addr[i] = el) != 0) bound = i + 1;
+      if (old != el) change_p = TRUE;
+    }
+    VARR_TRUNC (bitmap_el_t, dst->els, bound);
+    return change_p;
+  }
+  VARR_TRUNC (bitmap_el_t, dst->spare, 0);
+  bitmap_cursor_init (&c1, src1);
+  bitmap_cursor_init (&c2, src2);
+  if (src3 != NULL) bitmap_cursor_init (&c3, src3);
+  for (;;) {
+    nw = bitmap_cursor_index (&c1);
+    if ((nw2 = bitmap_cursor_index (&c2)) < nw) nw = nw2;
+    if (src3 != NULL && (nw2 = bitmap_cursor_index (&c3)) < nw) nw = nw2;
+    if (nw == SIZE_MAX) break;
+    el = (src3 == NULL ? op2 (bitmap_cursor_word (&c1, nw), bitmap_cursor_word (&c2, nw))
+                       : op3 (bitmap_cursor_word (&c1, nw), bitmap_cursor_word (&c2, nw),
+                              bitmap_cursor_word (&c3, nw)));
+    if (el == 0) continue;
+    VARR_PUSH (bitmap_el_t, dst->spare, nw);
+    VARR_PUSH (bitmap_el_t, dst->spare, el);
+  }
+  return bitmap_sparse_finish_op (dst);
 }
 
-static inline bitmap_el_t bitmap_el_ior (bitmap_el_t el1, bitmap_el_t el2) { return el1 | el2; }
+/* Finish a dense operation whose result occupies the first LEN words of DST.  CHANGE_P is true
+   if these words changed.  Return TRUE if DST changed.  */
+static inline int bitmap_dense_finish_op (bitmap_t dst, size_t len, int change_p) {
+  size_t i, dst_len = VARR_LENGTH (bitmap_el_t, dst->els);
+  bitmap_el_t *addr = VARR_ADDR (bitmap_el_t, dst->els);
 
-static inline int bitmap_ior (bitmap_t dst, bitmap_t src1, bitmap_t src2) {
-  return bitmap_op2 (dst, src1, src2, bitmap_el_ior);
+  for (i = len; i < dst_len && !change_p; i++)
+    if (addr[i] != 0) change_p = TRUE;
+  while (len > 0 && addr[len - 1] == 0) len--;
+  VARR_TRUNC (bitmap_el_t, dst->els, len);
+  return change_p;
 }
 
-static inline int bitmap_op3 (bitmap_t dst, const_bitmap_t src1, const_bitmap_t src2,
-                              const_bitmap_t src3,
-                              bitmap_el_t (*op) (bitmap_el_t, bitmap_el_t, bitmap_el_t)) {
-  size_t i, len, bound, src1_len, src2_len, src3_len;
-  bitmap_el_t old, *dst_addr, *src1_addr, *src2_addr, *src3_addr;
-  int change_p = FALSE;
+/* Process words [START, END) of dense DST_ADDR: DST_ADDR[I] = EXPR where EXPR uses EL1, EL2, and
+   EL3 defined as E1, E2, and E3.  Accumulate the difference between the old and new words in
+   DIFF.  There are no calls and no data dependent branches in the loop, so the compiler can
+   vectorize it.  */
+#define BITMAP_DENSE_LOOP(START, END, E1, E2, E3, EXPR) \
+  for (i = (START); i < (END); i++) {                   \
+    bitmap_el_t el1 = (E1), el2 = (E2), el3 = (E3), el; \
+    el = (EXPR);                                        \
+    (void) el3;                                         \
+    diff |= dst_addr[i] ^ el;                           \
+    dst_addr[i] = el;                                   \
+  }
 
-  src1_len = VARR_LENGTH (bitmap_el_t, src1);
-  src2_len = VARR_LENGTH (bitmap_el_t, src2);
-  src3_len = VARR_LENGTH (bitmap_el_t, src3);
-  len = bitmap_el_max3 (src1_len, src2_len, src3_len);
-  bitmap_expand (dst, len * BITMAP_WORD_BITS);
-  dst_addr = VARR_ADDR (bitmap_el_t, dst);
-  src1_addr = VARR_ADDR (bitmap_el_t, src1);
-  src2_addr = VARR_ADDR (bitmap_el_t, src2);
-  src3_addr = VARR_ADDR (bitmap_el_t, src3);
-  for (bound = i = 0; i < len; i++) {
-    old = dst_addr[i];
-    if ((dst_addr[i] = op (i >= src1_len ? 0 : src1_addr[i], i >= src2_len ? 0 : src2_addr[i],
-                           i >= src3_len ? 0 : src3_addr[i]))
-        != 0)
-      bound = i + 1;
-    if (old != dst_addr[i]) change_p = TRUE;
+/* Define bitmap_<NAME> (dst, src1, src2) calculating DST = EXPR for words EL1 and EL2 of SRC1
+   and SRC2 and returning TRUE if DST changed.  The usual case of DST == SRC1 is processed by a
+   separate loop to help the compiler vectorize it.  */
+#define BITMAP_DEF_OP2(NAME, EXPR)                                                            \
+  static inline bitmap_el_t bitmap_el_##NAME (bitmap_el_t el1, bitmap_el_t el2) {            \
+    return EXPR;                                                                              \
+  }                                                                                           \
+  static inline int bitmap_##NAME (bitmap_t dst, const_bitmap_t src1, const_bitmap_t src2) { \
+    size_t i, len, min_len, src1_len, src2_len;                                               \
+    bitmap_el_t diff = 0, *dst_addr, *src1_addr, *src2_addr;                                  \
+                                                                                              \
+    if (dst->sparse_p || src1->sparse_p || src2->sparse_p)                                    \
+      return bitmap_op_generic (dst, src1, src2, NULL, bitmap_el_##NAME, NULL);               \
+    src1_len = VARR_LENGTH (bitmap_el_t, src1->els);                                          \
+    src2_len = VARR_LENGTH (bitmap_el_t, src2->els);                                          \
+    len = bitmap_el_max2 (src1_len, src2_len);                                                \
+    min_len = src1_len < src2_len ? src1_len : src2_len;                                      \
+    bitmap_expand (dst, len * BITMAP_WORD_BITS);                                              \
+    dst_addr = VARR_ADDR (bitmap_el_t, dst->els);                                             \
+    src1_addr = VARR_ADDR (bitmap_el_t, src1->els);                                           \
+    src2_addr = VARR_ADDR (bitmap_el_t, src2->els);                                           \
+    if (dst == src1) {                                                                        \
+      BITMAP_DENSE_LOOP (0, min_len, dst_addr[i], src2_addr[i], 0, EXPR);                     \
+    } else {                                                                                  \
+      BITMAP_DENSE_LOOP (0, min_len, src1_addr[i], src2_addr[i], 0, EXPR);                    \
+    }                                                                                         \
+    BITMAP_DENSE_LOOP (min_len, src1_len, src1_addr[i], 0, 0, EXPR);                          \
+    BITMAP_DENSE_LOOP (min_len, src2_len, 0, src2_addr[i], 0, EXPR);                          \
+    return bitmap_dense_finish_op (dst, len, diff != 0);                                      \
   }
-  VARR_TRUNC (bitmap_el_t, dst, bound);
-  return change_p;
-}
 
-static inline bitmap_el_t bitmap_el_ior_and (bitmap_el_t el1, bitmap_el_t el2, bitmap_el_t el3) {
-  return el1 | (el2 & el3);
-}
+/* Define bitmap_<NAME> (dst, src1, src2, src3) calculating DST = EXPR for words EL1, EL2, and EL3
+   of SRC1, SRC2, and SRC3 and returning TRUE if DST changed.  */
+#define BITMAP_DEF_OP3(NAME, EXPR)                                                                \
+  static inline bitmap_el_t bitmap_el_##NAME (bitmap_el_t el1, bitmap_el_t el2,                  \
+                                              bitmap_el_t el3) {                                  \
+    return EXPR;                                                                                  \
+  }                                                                                               \
+  static inline int bitmap_##NAME (bitmap_t dst, const_bitmap_t src1, const_bitmap_t src2,       \
+                                   const_bitmap_t src3) {                                         \
+    size_t i, len, min_len, src1_len, src2_len, src3_len;                                         \
+    bitmap_el_t diff = 0, *dst_addr, *src1_addr, *src2_addr, *src3_addr;                          \
+                                                                                                  \
+    if (dst->sparse_p || src1->sparse_p || src2->sparse_p || src3->sparse_p)                      \
+      return bitmap_op_generic (dst, src1, src2, src3, NULL, bitmap_el_##NAME);                   \
+    src1_len = VARR_LENGTH (bitmap_el_t, src1->els);                                              \
+    src2_len = VARR_LENGTH (bitmap_el_t, src2->els);                                              \
+    src3_len = VARR_LENGTH (bitmap_el_t, src3->els);                                              \
+    len = bitmap_el_max3 (src1_len, src2_len, src3_len);                                          \
+    min_len = src1_len < src2_len ? src1_len : src2_len;                                          \
+    if (src3_len < min_len) min_len = src3_len;                                                   \
+    bitmap_expand (dst, len * BITMAP_WORD_BITS);                                                  \
+    dst_addr = VARR_ADDR (bitmap_el_t, dst->els);                                                 \
+    src1_addr = VARR_ADDR (bitmap_el_t, src1->els);                                               \
+    src2_addr = VARR_ADDR (bitmap_el_t, src2->els);                                               \
+    src3_addr = VARR_ADDR (bitmap_el_t, src3->els);                                               \
+    BITMAP_DENSE_LOOP (0, min_len, src1_addr[i], src2_addr[i], src3_addr[i], EXPR);               \
+    BITMAP_DENSE_LOOP (min_len, len, i < src1_len ? src1_addr[i] : 0,                             \
+                       i < src2_len ? src2_addr[i] : 0, i < src3_len ? src3_addr[i] : 0, EXPR);   \
+    return bitmap_dense_finish_op (dst, len, diff != 0);                                          \
+  }
 
-/* DST = SRC1 | (SRC2 & SRC3).  Return true if DST changed.  */
-static inline int bitmap_ior_and (bitmap_t dst, bitmap_t src1, bitmap_t src2, bitmap_t src3) {
-  return bitmap_op3 (dst, src1, src2, src3, bitmap_el_ior_and);
-}
+/* DST = SRC1 & SRC2.  Return true if DST changed.  */
+BITMAP_DEF_OP2 (and, el1 & el2)
 
-static inline bitmap_el_t bitmap_el_ior_and_compl (bitmap_el_t el1, bitmap_el_t el2,
-                                                   bitmap_el_t el3) {
-  return el1 | (el2 & ~el3);
-}
+/* DST = SRC1 & ~SRC2.  Return true if DST changed.  */
+BITMAP_DEF_OP2 (and_compl, el1 & ~el2)
+
+/* DST = SRC1 | SRC2.  Return true if DST changed.  */
+BITMAP_DEF_OP2 (ior, el1 | el2)
+
+/* DST = SRC1 | (SRC2 & SRC3).  Return true if DST changed.  */
+BITMAP_DEF_OP3 (ior_and, el1 | (el2 & el3))
 
 /* DST = SRC1 | (SRC2 & ~SRC3).  Return true if DST changed.  */
-static inline int bitmap_ior_and_compl (bitmap_t dst, bitmap_t src1, bitmap_t src2, bitmap_t src3) {
-  return bitmap_op3 (dst, src1, src2, src3, bitmap_el_ior_and_compl);
-}
+BITMAP_DEF_OP3 (ior_and_compl, el1 | (el2 & ~el3))
 
 typedef struct {
   bitmap_t bitmap;
   size_t nbit;
+  size_t pos; /* the current pair for sparse bitmap */
 } bitmap_iterator_t;
 
 static inline void bitmap_iterator_init (bitmap_iterator_t *iter, bitmap_t bitmap) {
   iter->bitmap = bitmap;
   iter->nbit = 0;
+  iter->pos = 0;
 }
 
 static inline int bitmap_iterator_next (bitmap_iterator_t *iter, size_t *nbit) {
   const size_t el_bits_num = sizeof (bitmap_el_t) * CHAR_BIT;
-  size_t curr_nel = iter->nbit / el_bits_num, len = VARR_LENGTH (bitmap_el_t, iter->bitmap);
-  bitmap_el_t el, *addr = VARR_ADDR (bitmap_el_t, iter->bitmap);
-
+  size_t curr_nel = iter->nbit / el_bits_num, len = VARR_LENGTH (bitmap_el_t, iter->bitmap->els);
+  bitmap_el_t el, *addr = VARR_ADDR (bitmap_el_t, iter->bitmap->els);
+
+  if (iter->bitmap->sparse_p) {
+    /* Words can be added or removed during the iteration, shifting the pairs: */
+    if (2 * iter->pos >= len || addr[2 * iter->pos] != curr_nel)
+      iter->pos = bitmap_sparse_find (iter->bitmap, curr_nel);
+    for (; 2 * iter->pos < len; iter->pos++) {
+      if (addr[2 * iter->pos] > curr_nel) {
+        curr_nel = addr[2 * iter->pos];
+        iter->nbit = curr_nel * el_bits_num;
+      }
+      for (el = addr[2 * iter->pos + 1] >> iter->nbit % el_bits_num; el != 0;
+           el >>= 1, iter->nbit++)
+        if (el & 1) {
+          *nbit = iter->nbit++;
+          return TRUE;
+        }
+      iter->nbit = ++curr_nel * el_bits_num;
+    }
+    return FALSE;
+  }
   for (; curr_nel < len; curr_nel++, iter->nbit = curr_nel * el_bits_num)
     if ((el = addr[curr_nel]) != 0)
       for (el >>= iter->nbit % el_bits_num; el != 0; el >>= 1, iter->nbit++)
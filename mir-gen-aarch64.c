@@ -105,6 +105,8 @@ static const int int_reg_save_area_size = 8 * 8;
 static const int reg_save_area_size = 8 * 8 + 8 * 16;
 #endif
 
+#define TARGET_OVERFLOW_INSNS
+
 static const MIR_insn_code_t target_io_dup_op_insn_codes[] = {MIR_INSN_BOUND};
 
 static MIR_insn_code_t get_ext_code (MIR_type_t type) {
@@ -1406,6 +1408,34 @@ static const struct pattern patterns[] = {
   /* udiv r8,Wn,Wm;msub Wd,r8,Wm,Wn: */
   {MIR_UMODS, "r r r", "1ac00800:ffe0fc00 hd8 rn1 rm2;1b008000:ffe08000 rd0 hm8 rn2 ra1"},
 
+  /* Overflow insns set up V flag on overflow: */
+  {MIR_ADDO, "r r r", "ab000000:ff200000 rd0 rn1 rm2"},  /* adds Rd,Rn,Rm*/
+  {MIR_ADDO, "r r I", "b1000000:ff000000 rd0 rn1 I"},    /* adds Rd,Rn,I,shift */
+  {MIR_ADDOS, "r r r", "2b000000:ff200000 rd0 rn1 rm2"}, /* adds Wd,Wn,Wm*/
+  {MIR_ADDOS, "r r I", "31000000:ff000000 rd0 rn1 I"},   /* adds Wd,Wn,I,shift */
+  {MIR_SUBO, "r r r", "eb000000:ff200000 rd0 rn1 rm2"},  /* subs Rd,Rn,Rm*/
+  {MIR_SUBO, "r r I", "f1000000:ff000000 rd0 rn1 I"},    /* subs Rd,Rn,I,shift */
+  {MIR_SUBOS, "r r r", "6b000000:ff200000 rd0 rn1 rm2"}, /* subs Wd,Wn,Wm*/
+  {MIR_SUBOS, "r r I", "71000000:ff000000 rd0 rn1 I"},   /* subs Wd,Wn,I,shift */
+
+#define CCMP_OV "fa5f03e1:ffffffff" /* ccmp xzr,xzr,#1,eq -- set V if ne */
+  /* smulh r8,Rn,Rm;mul Rd,Rn,Rm;cmp r8,Rd,asr 63;ccmp xzr,xzr,#1,eq: */
+  {MIR_MULO, "r r r",
+   "9b407c00:ffe0fc00 hd8 rn1 rm2;9b007c00:ffe0fc00 rd0 rn1 rm2;"
+   "eb80fc1f:ffe0fc1f hn8 rm0;" CCMP_OV},
+  /* smull r8,Wn,Wm;cmp r8,w8,sxtw;ccmp xzr,xzr,#1,eq;mov Wd,w8: */
+  {MIR_MULOS, "r r r",
+   "9b207c00:ffe0fc00 hd8 rn1 rm2;eb20c01f:ffe0fc1f hn8 hm8;" CCMP_OV
+   ";2a0003e0:ffe0ffe0 rd0 hm8"},
+  /* umulh r8,Rn,Rm;mul Rd,Rn,Rm;cmp r8,0;ccmp xzr,xzr,#1,eq: */
+  {MIR_UMULO, "r r r",
+   "9bc07c00:ffe0fc00 hd8 rn1 rm2;9b007c00:ffe0fc00 rd0 rn1 rm2;"
+   "f100001f:fffffc1f hn8;" CCMP_OV},
+  /* umull r8,Wn,Wm;cmp r8,w8,uxtw;ccmp xzr,xzr,#1,eq;mov Wd,w8: */
+  {MIR_UMULOS, "r r r",
+   "9ba07c00:ffe0fc00 hd8 rn1 rm2;eb20401f:ffe0fc1f hn8 hm8;" CCMP_OV
+   ";2a0003e0:ffe0ffe0 rd0 hm8"},
+
 #define CMPR "eb00001f:ff20001f rn1 rm2"
 #define CMPI "f100001f:ff00001f rn1 I"
 #define SCMPR "6b00001f:ff20001f rn1 rm2"
@@ -1578,6 +1608,11 @@ static const struct pattern patterns[] = {
   {MIR_BF, "l r", "b4000000:ff000000 rd1 l"},  /* cbz rd,l */
   {MIR_BFS, "l r", "34000000:ff000000 rd1 l"}, /* cbz wd,l */
 
+  {MIR_BO, "l", "54000006:ff00001f l"},   /* b.vs l */
+  {MIR_UBO, "l", "54000006:ff00001f l"},  /* b.vs l */
+  {MIR_BNO, "l", "54000007:ff00001f l"},  /* b.vc l */
+  {MIR_UBNO, "l", "54000007:ff00001f l"}, /* b.vc l */
+
 #define BEQ "54000000:ff00001f l"
   // ??? add extended reg cmp insns:
   // all ld insn are changed to builtins and bt/bts
@@ -1778,7 +1813,8 @@ static const struct pattern patterns[] = {
 static void target_get_early_clobbered_hard_regs (MIR_insn_t insn, MIR_reg_t *hr1, MIR_reg_t *hr2) {
   *hr1 = *hr2 = MIR_NON_HARD_REG;
   if (insn->code == MIR_MOD || insn->code == MIR_MODS || insn->code == MIR_UMOD
-      || insn->code == MIR_UMODS)
+      || insn->code == MIR_UMODS || insn->code == MIR_MULO || insn->code == MIR_MULOS
+      || insn->code == MIR_UMULO || insn->code == MIR_UMULOS)
     *hr1 = R8_HARD_REG;
 }
 
@@ -108,6 +108,8 @@ static MIR_disp_t target_get_stack_slot_offset (gen_ctx_t gen_ctx, MIR_type_t ty
            + (curr_func_item->u.func->vararg_p ? reg_save_area_size : 0));
 }
 
+#define TARGET_OVERFLOW_INSNS
+
 static const MIR_insn_code_t target_io_dup_op_insn_codes[] = {
   /* see possible patterns */
   MIR_FADD,  MIR_DADD,  MIR_LDADD, MIR_SUB,  MIR_SUBS,  MIR_FSUB,       MIR_DSUB,
@@ -115,7 +117,8 @@ static const MIR_insn_code_t target_io_dup_op_insn_codes[] = {
   MIR_DIVS,  MIR_UDIV,  MIR_FDIV,  MIR_DDIV, MIR_LDDIV, MIR_MOD,        MIR_MODS,
   MIR_UMOD,  MIR_UMODS, MIR_AND,   MIR_ANDS, MIR_OR,    MIR_ORS,        MIR_XOR,
   MIR_XORS,  MIR_LSH,   MIR_LSHS,  MIR_RSH,  MIR_RSHS,  MIR_URSH,       MIR_URSHS,
-  MIR_NEG,   MIR_NEGS,  MIR_FNEG,  MIR_DNEG, MIR_LDNEG, MIR_INSN_BOUND,
+  MIR_NEG,   MIR_NEGS,  MIR_FNEG,  MIR_DNEG, MIR_LDNEG, MIR_ADDO,       MIR_ADDOS,
+  MIR_SUBO,  MIR_SUBOS, MIR_MULO,  MIR_MULOS, MIR_INSN_BOUND,
 };
 
 static MIR_insn_code_t get_ext_code (MIR_type_t type) {
@@ -1006,8 +1009,10 @@ static void target_machinize (gen_ctx_t gen_ctx) {
     case MIR_DIV:
     case MIR_UDIV:
     case MIR_DIVS:
-    case MIR_UDIVS: {
-      /* Divide uses ax/dx as operands: */
+    case MIR_UDIVS:
+    case MIR_UMULO:
+    case MIR_UMULOS: {
+      /* Divide and unsigned multiply use ax/dx as operands: */
       MIR_op_t areg_op = _MIR_new_hard_reg_op (ctx, AX_HARD_REG);
 
       new_insn = MIR_new_insn (ctx, MIR_MOV, areg_op, insn->ops[1]);
@@ -1320,6 +1325,7 @@ struct pattern {
      t - ax, cx, dx, or bx register
      h[0-31] - hard register with given number
      z - operand is zero
+     Z - operand is zero and the flags are set by the previous insn result in place of operand 1
      i[0-3] - immediate of size 8,16,32,64-bits
      p[0-3] - reference
      s - immediate 1, 2, 4, or 8 (scale)
@@ -1605,6 +1611,10 @@ static const struct pattern patterns[] = {
 
   IOP (MIR_SUB, "2B", "29", "83 /5", "81 /5") /* x86_64 int subtractions */
 
+  /* overflow insns: no lea as it does not set flags */
+  IOP (MIR_ADDO, "03", "01", "83 /0", "81 /0") /* x86_64 int additions with overflow */
+  IOP (MIR_SUBO, "2B", "29", "83 /5", "81 /5") /* x86_64 int subtractions with overflow */
+
   {MIR_MUL, "r 0 r", "X 0F AF r0 R2"},    /* imul r0,r1*/
   {MIR_MUL, "r 0 m3", "X 0F AF r0 m2"},   /* imul r0,m1*/
   {MIR_MUL, "r r i2", "X 69 r0 R1 I2"},   /* imul r0,r1,i32*/
@@ -1616,6 +1626,19 @@ static const struct pattern patterns[] = {
   {MIR_MULS, "r m2 i2", "Y 69 r0 m1 I2"}, /* imul r0,m1,i32*/
   {MIR_MULS, "r r s", "Y 8D r0 ap"},      /* lea r0,(,r1,s2)*/
 
+  {MIR_MULO, "r 0 r", "X 0F AF r0 R2"},    /* imul r0,r1*/
+  {MIR_MULO, "r 0 m3", "X 0F AF r0 m2"},   /* imul r0,m1*/
+  {MIR_MULO, "r r i2", "X 69 r0 R1 I2"},   /* imul r0,r1,i32*/
+  {MIR_MULO, "r m3 i2", "X 69 r0 m1 I2"},  /* imul r0,m1,i32*/
+  {MIR_MULOS, "r 0 r", "Y 0F AF r0 R2"},   /* imul r0,r1*/
+  {MIR_MULOS, "r 0 m2", "Y 0F AF r0 m2"},  /* imul r0,m1*/
+  {MIR_MULOS, "r r i2", "Y 69 r0 R1 I2"},  /* imul r0,r1,i32*/
+  {MIR_MULOS, "r m2 i2", "Y 69 r0 m1 I2"}, /* imul r0,m1,i32*/
+  {MIR_UMULO, "h0 h0 r", "X F7 /4 R2"},    /* mul r2*/
+  {MIR_UMULO, "h0 h0 m3", "X F7 /4 m2"},   /* mul m2*/
+  {MIR_UMULOS, "h0 h0 r", "Y F7 /4 R2"},   /* mul r2*/
+  {MIR_UMULOS, "h0 h0 m2", "Y F7 /4 m2"},  /* mul m2*/
+
   {MIR_DIV, "h0 h0 r", "X 99; X F7 /7 R2"},  /* cqo; idiv r2*/
   {MIR_DIV, "h0 h0 m3", "X 99; X F7 /7 m2"}, /* cqo; idiv m2*/
   {MIR_DIVS, "h0 h0 r", "99; Y F7 /7 R2"},   /* cdq; idiv r2*/
@@ -1670,6 +1693,20 @@ static const struct pattern patterns[] = {
 
   BR (MIR_BT, "0F 85") BR (MIR_BF, "0F 84") /* branches */
 
+  {MIR_BO, "l", "0F 80 l0"},   /* jo rel32 */
+  {MIR_UBO, "l", "0F 82 l0"},  /* jc rel32 */
+  {MIR_BNO, "l", "0F 81 l0"},  /* jno rel32 */
+  {MIR_UBNO, "l", "0F 83 l0"}, /* jnc rel32 */
+
+  {MIR_BEQ, "l r Z", "0F 84 l0"},  /* je rel32 */
+  {MIR_BEQ, "l m3 Z", "0F 84 l0"}, /* je rel32 */
+  {MIR_BNE, "l r Z", "0F 85 l0"},  /* jne rel32 */
+  {MIR_BNE, "l m3 Z", "0F 85 l0"}, /* jne rel32 */
+  {MIR_BLT, "l r Z", "0F 88 l0"},  /* js rel32 */
+  {MIR_BLT, "l m3 Z", "0F 88 l0"}, /* js rel32 */
+  {MIR_BGE, "l r Z", "0F 89 l0"},  /* jns rel32 */
+  {MIR_BGE, "l m3 Z", "0F 89 l0"}, /* jns rel32 */
+
   BCMP (MIR_BEQ, "0F 84") BCMP (MIR_BNE, "0F 85")  /* 1. int compare and branch */
   BCMP (MIR_BLT, "0F 8C") BCMP (MIR_UBLT, "0F 82") /* 2. int compare and branch */
   BCMP (MIR_BLE, "0F 8E") BCMP (MIR_UBLE, "0F 86") /* 3. int compare and branch */
@@ -1706,7 +1743,8 @@ static void target_get_early_clobbered_hard_regs (MIR_insn_t insn, MIR_reg_t *hr
 
   *hr1 = *hr2 = MIR_NON_HARD_REG;
   if (code == MIR_DIV || code == MIR_UDIV || code == MIR_DIVS || code == MIR_UDIVS
-      || code == MIR_MOD || code == MIR_UMOD || code == MIR_MODS || code == MIR_UMODS) {
+      || code == MIR_MOD || code == MIR_UMOD || code == MIR_MODS || code == MIR_UMODS
+      || code == MIR_UMULO || code == MIR_UMULOS) {
     *hr1 = DX_HARD_REG;
   } else if (code == MIR_FEQ || code == MIR_FNE || code == MIR_DEQ || code == MIR_DNE
              || code == MIR_LDEQ || code == MIR_LDNE) {
@@ -1775,6 +1813,29 @@ static void patterns_init (gen_ctx_t gen_ctx) {
   info_addr[prev_code].num = n - info_addr[prev_code].start;
 }
 
+/* Return TRUE if the flags set by an overflow insn before INSN are used by an overflow branch
+   after INSN.  Only moves added by the generator can be between them.  */
+static int overflow_flags_live_p (MIR_insn_t insn) {
+  MIR_insn_code_t code;
+
+  for (insn = DLIST_NEXT (MIR_insn_t, insn); insn != NULL; insn = DLIST_NEXT (MIR_insn_t, insn)) {
+    if ((code = insn->code) == MIR_BO || code == MIR_UBO || code == MIR_BNO || code == MIR_UBNO)
+      return TRUE;
+    if (code != MIR_MOV && code != MIR_FMOV && code != MIR_DMOV && code != MIR_LDMOV) return FALSE;
+  }
+  return FALSE;
+}
+
+/* Return TRUE if the previous insn is an int addition or subtraction in place of INSN operand 1.
+   Such insn is always add or sub which sets the flags by the result.  */
+static int op1_flags_set_p (MIR_context_t ctx, MIR_insn_t insn) {
+  MIR_insn_t prev_insn = DLIST_PREV (MIR_insn_t, insn);
+
+  return (prev_insn != NULL && (prev_insn->code == MIR_ADD || prev_insn->code == MIR_SUB)
+          && MIR_op_eq_p (ctx, prev_insn->ops[0], insn->ops[1])
+          && MIR_op_eq_p (ctx, prev_insn->ops[0], prev_insn->ops[1]));
+}
+
 static int pattern_match_p (gen_ctx_t gen_ctx, const struct pattern *pat, MIR_insn_t insn) {
   MIR_context_t ctx = gen_ctx->ctx;
   int nop, n;
@@ -1813,8 +1874,15 @@ static int pattern_match_p (gen_ctx_t gen_ctx, const struct pattern *pat, MIR_in
         --p;
       if (op.u.hard_reg != hr) return FALSE;
       break;
-    case 'z':
-      if ((op.mode != MIR_OP_INT && op.mode != MIR_OP_UINT) || op.u.i != 0) return FALSE;
+    case 'z': /* xor changes the flags */
+      if ((op.mode != MIR_OP_INT && op.mode != MIR_OP_UINT) || op.u.i != 0
+          || overflow_flags_live_p (insn))
+        return FALSE;
+      break;
+    case 'Z': /* zero compared with the result of the previous insn */
+      if ((op.mode != MIR_OP_INT && op.mode != MIR_OP_UINT) || op.u.i != 0
+          || !op1_flags_set_p (ctx, insn))
+        return FALSE;
       break;
     case 'i':
       if (op.mode != MIR_OP_INT && op.mode != MIR_OP_UINT) return FALSE;
@@ -30,8 +30,8 @@
                      extension insns
    Global Value Numbering: Removing redundant insns through GVN. Only for -O2 and above.
    Dead code elimination: Removing insns with unused outputs.  Only for -O2 and above.
-   Sparse Conditional Constant Propagation: Constant propagation and removing death paths of CFG.
-                                            Only for -O2 and above.
+   Sparse Conditional Constant Propagation: Constant and value range propagation and removing
+                                            death paths of CFG.  Only for -O2 and above.
    Out of SSA: Removing phi nodes and SSA edges (we keep conventional SSA all the time)
    Machinize: Machine-dependent code (e.g. in mir-gen-x86_64.c)
               transforming MIR for calls ABI, 2-op insns, etc.  Always.
@@ -40,7 +40,8 @@
    Building Live Info: Calculating live in and live out for the basic blocks.
    Build Live Ranges: Calculating program point ranges for registers.  Only for -O1 and above.
    Assign: Fast RA for -O0 or Priority-based linear scan RA for -O1 and above.
-   Rewrite: Transform MIR according to the assign using reserved hard regs.
+   Rewrite: Transform MIR according to the assign using reserved hard regs.  Pseudos with
+            constants, references, or frame addresses are rematerialized instead of spilled.
    Combine (code selection): Merging data-depended insns into one.  Only for -O1 and above.
    Dead code elimination: Removing insns with unused outputs.  Only for -O1 and above.
    Generate machine insns: Machine-dependent code (e.g. in
@@ -113,6 +114,7 @@ struct data_flow_ctx;
 struct ssa_ctx;
 struct gvn_ctx;
 struct ccp_ctx;
+struct ext_ctx;
 struct lr_ctx;
 struct ra_ctx;
 struct selection_ctx;
@@ -135,6 +137,8 @@ struct all_gen_ctx;
 typedef struct bb_insn *bb_insn_t;
 DEF_VARR (bb_insn_t);
 
+typedef struct gen_arena_page *gen_arena_page_t;
+
 struct gen_ctx {
   struct all_gen_ctx *all_gen_ctx;
   int gen_num; /* always 1 for non-parallel generation */
@@ -144,6 +148,10 @@ struct gen_ctx {
 #endif
   MIR_context_t ctx;
   unsigned optimize_level; /* 0:fast gen; 1:RA+combiner; 2: +GVN/CCP (default); >=3: everything  */
+  MIR_gen_budget_t budget;
+  MIR_gen_stats_t stats;
+  unsigned budget_flags;  /* MIR_GEN_*_BUDGET flags of the current function */
+  double func_start_time; /* in usec */
   MIR_item_t curr_func_item;
 #if !MIR_NO_GEN_DEBUG
   FILE *debug_file;
@@ -154,11 +162,13 @@ struct gen_ctx {
   func_cfg_t curr_cfg;
   uint32_t curr_bb_index, curr_loop_node_index;
   DLIST (dead_var_t) free_dead_vars;
+  gen_arena_page_t arena_pages, curr_arena_page; /* arena for the current function data */
   struct target_ctx *target_ctx;
   struct data_flow_ctx *data_flow_ctx;
   struct ssa_ctx *ssa_ctx;
   struct gvn_ctx *gvn_ctx;
   struct ccp_ctx *ccp_ctx;
+  struct ext_ctx *ext_ctx;
   struct lr_ctx *lr_ctx;
   struct ra_ctx *ra_ctx;
   struct selection_ctx *selection_ctx;
@@ -183,6 +193,8 @@ struct gen_ctx {
 #define curr_bb_index gen_ctx->curr_bb_index
 #define curr_loop_node_index gen_ctx->curr_loop_node_index
 #define free_dead_vars gen_ctx->free_dead_vars
+#define arena_pages gen_ctx->arena_pages
+#define curr_arena_page gen_ctx->curr_arena_page
 #define dead_bb_insns gen_ctx->dead_bb_insns
 #define loop_nodes gen_ctx->loop_nodes
 #define queue_nodes gen_ctx->queue_nodes
@@ -247,8 +259,374 @@ static void *gen_malloc (gen_ctx_t gen_ctx, size_t size) {
   return res;
 }
 
+/* Arena for data living only during generation of one function: CFG, bb insns, edges, SSA
+   edges, exprs, live ranges etc.  They are not freed individually.  The whole arena is reset
+   at the end of MIR_gen but its pages are kept for the next functions.  */
+
+#define GEN_ARENA_PAGE_SIZE (64 * 1024)
+#define GEN_ARENA_ALIGN (2 * sizeof (void *))
+
+struct gen_arena_page {
+  gen_arena_page_t next;
+  size_t size, used; /* of the data after the page header */
+};
+
+#define GEN_ARENA_HEADER_SIZE \
+  ((sizeof (struct gen_arena_page) + GEN_ARENA_ALIGN - 1) / GEN_ARENA_ALIGN * GEN_ARENA_ALIGN)
+
+static gen_arena_page_t new_arena_page (gen_ctx_t gen_ctx, size_t size) {
+  gen_arena_page_t page = gen_malloc (gen_ctx, GEN_ARENA_HEADER_SIZE + size);
+
+  page->next = NULL;
+  page->size = size;
+  page->used = 0;
+  return page;
+}
+
+static void *gen_arena_alloc (gen_ctx_t gen_ctx, size_t size) {
+  gen_arena_page_t page = curr_arena_page;
+  void *res;
+
+  size = (size + GEN_ARENA_ALIGN - 1) / GEN_ARENA_ALIGN * GEN_ARENA_ALIGN;
+  while (page->used + size > page->size) {
+    if (page->next == NULL)
+      page->next
+        = new_arena_page (gen_ctx, size > GEN_ARENA_PAGE_SIZE ? size : GEN_ARENA_PAGE_SIZE);
+    page = page->next;
+    page->used = 0; /* the page is not used since the last arena reset */
+  }
+  curr_arena_page = page;
+  res = (char *) page + GEN_ARENA_HEADER_SIZE + page->used;
+  page->used += size;
+  return res;
+}
+
+static void init_arena (gen_ctx_t gen_ctx) {
+  curr_arena_page = arena_pages = new_arena_page (gen_ctx, GEN_ARENA_PAGE_SIZE);
+}
+
+static void reset_arena (gen_ctx_t gen_ctx) {
+  curr_arena_page = arena_pages;
+  arena_pages->used = 0;
+  DLIST_INIT (dead_var_t, free_dead_vars); /* dead vars are allocated in the arena */
+}
+
+static void finish_arena (gen_ctx_t gen_ctx) {
+  gen_arena_page_t page, next_page;
+
+  for (page = arena_pages; page != NULL; page = next_page) {
+    next_page = page->next;
+    free (page);
+  }
+  arena_pages = curr_arena_page = NULL;
+}
+
 #define DEFAULT_INIT_BITMAP_BITS_NUM 256
 
+static int overflow_branch_code_p (MIR_insn_code_t code) {
+  return code == MIR_BO || code == MIR_UBO || code == MIR_BNO || code == MIR_UBNO;
+}
+
+/* Expand overflow insns and branches on overflow for targets without
+   their native support.  The overflow flag is kept in a temp reg.  It
+   is done before building CFG as the expansion can contain branches.
+   As the code is already simplified, all immediates are put into regs.
+
+   Targets with native support use the machine flags but only for
+   functions whose overflow branches immediately follow overflow insns.
+   Other insns between them (including ones added by the generator, e.g.
+   a zero move implemented by xor) can change the machine flags.  */
+#ifdef TARGET_OVERFLOW_INSNS
+static int overflow_flags_usable_p (gen_ctx_t gen_ctx) {
+  MIR_insn_t insn, prev_insn;
+
+  for (insn = DLIST_HEAD (MIR_insn_t, curr_func_item->u.func->insns); insn != NULL;
+       insn = DLIST_NEXT (MIR_insn_t, insn))
+    if (overflow_branch_code_p (insn->code)
+        && ((prev_insn = DLIST_PREV (MIR_insn_t, insn)) == NULL
+            || !MIR_overflow_code_p (prev_insn->code)))
+      return FALSE;
+  return TRUE;
+}
+#endif
+
+static MIR_op_t new_overflow_temp_op (gen_ctx_t gen_ctx) { /* CFG is not built yet */
+  MIR_context_t ctx = gen_ctx->ctx;
+
+  return MIR_new_reg_op (ctx, _MIR_new_temp_reg (ctx, MIR_T_I64, curr_func_item->u.func));
+}
+
+static void expand_overflow_insns (gen_ctx_t gen_ctx) {
+  MIR_context_t ctx = gen_ctx->ctx;
+  MIR_insn_t insn, next_insn, new_insns[16];
+  MIR_insn_code_t code;
+  MIR_op_t flag, res, t1, t2, a, b, imm;
+  MIR_label_t check_label, end_label;
+  size_t n;
+
+  gen_assert (curr_func_item->item_type == MIR_func_item);
+  flag = MIR_new_int_op (ctx, 0); /* To remove unitilized warning */
+  for (insn = DLIST_HEAD (MIR_insn_t, curr_func_item->u.func->insns); insn != NULL;
+       insn = next_insn) {
+    next_insn = DLIST_NEXT (MIR_insn_t, insn);
+    code = insn->code;
+    if (!MIR_overflow_code_p (code) && !overflow_branch_code_p (code)) continue;
+    if (flag.mode != MIR_OP_REG) flag = new_overflow_temp_op (gen_ctx);
+    if (!MIR_overflow_code_p (code)) {
+      new_insns[0] = MIR_new_insn (ctx, code == MIR_BO || code == MIR_UBO ? MIR_BT : MIR_BF,
+                                   insn->ops[0], flag);
+      MIR_insert_insn_before (ctx, curr_func_item, insn, new_insns[0]);
+      MIR_remove_insn (ctx, curr_func_item, insn);
+      continue;
+    }
+    res = new_overflow_temp_op (gen_ctx);
+    t1 = new_overflow_temp_op (gen_ctx);
+    t2 = new_overflow_temp_op (gen_ctx);
+    imm = new_overflow_temp_op (gen_ctx);
+    a = insn->ops[1];
+    b = insn->ops[2];
+    n = 0;
+    switch (code) {
+    case MIR_ADDO:
+    case MIR_ADDOS: /* res = a + b; flag = ((res ^ a) & (res ^ b)) < 0: */
+      new_insns[n++] = MIR_new_insn (ctx, code == MIR_ADDO ? MIR_ADD : MIR_ADDS, res, a, b);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_XOR, t1, res, a);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_XOR, t2, res, b);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_AND, t1, t1, t2);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_MOV, imm, MIR_new_int_op (ctx, 0));
+      new_insns[n++] = MIR_new_insn (ctx, code == MIR_ADDO ? MIR_LT : MIR_LTS, flag, t1, imm);
+      break;
+    case MIR_SUBO:
+    case MIR_SUBOS: /* res = a - b; flag = ((a ^ b) & (a ^ res)) < 0: */
+      new_insns[n++] = MIR_new_insn (ctx, code == MIR_SUBO ? MIR_SUB : MIR_SUBS, res, a, b);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_XOR, t1, a, b);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_XOR, t2, a, res);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_AND, t1, t1, t2);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_MOV, imm, MIR_new_int_op (ctx, 0));
+      new_insns[n++] = MIR_new_insn (ctx, code == MIR_SUBO ? MIR_LT : MIR_LTS, flag, t1, imm);
+      break;
+    case MIR_MULOS:
+    case MIR_UMULOS: /* res = ext (a) * ext (b); flag = res != ext (res): */
+      code = code == MIR_MULOS ? MIR_EXT32 : MIR_UEXT32;
+      new_insns[n++] = MIR_new_insn (ctx, code, t1, a);
+      new_insns[n++] = MIR_new_insn (ctx, code, t2, b);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_MUL, res, t1, t2);
+      new_insns[n++] = MIR_new_insn (ctx, code, t1, res);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_NE, flag, res, t1);
+      break;
+    case MIR_MULO:
+    case MIR_UMULO:
+      /* res = a * b; flag = 0; if (a == 0) goto end;
+         [if (a != -1) goto check; flag = b == INT64_MIN; goto end;]
+         check: t1 = res / a; flag = t1 != b; end: */
+      end_label = MIR_new_label (ctx);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_MUL, res, a, b);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_MOV, imm, MIR_new_int_op (ctx, 0));
+      new_insns[n++] = MIR_new_insn (ctx, MIR_MOV, flag, imm);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_BEQ, MIR_new_label_op (ctx, end_label), a, imm);
+      if (code == MIR_MULO) {
+        check_label = MIR_new_label (ctx);
+        new_insns[n++] = MIR_new_insn (ctx, MIR_MOV, imm, MIR_new_int_op (ctx, -1));
+        new_insns[n++]
+          = MIR_new_insn (ctx, MIR_BNE, MIR_new_label_op (ctx, check_label), a, imm);
+        new_insns[n++] = MIR_new_insn (ctx, MIR_MOV, imm, MIR_new_int_op (ctx, INT64_MIN));
+        new_insns[n++] = MIR_new_insn (ctx, MIR_EQ, flag, b, imm);
+        new_insns[n++] = MIR_new_insn (ctx, MIR_JMP, MIR_new_label_op (ctx, end_label));
+        new_insns[n++] = check_label;
+      }
+      new_insns[n++] = MIR_new_insn (ctx, code == MIR_MULO ? MIR_DIV : MIR_UDIV, t1, res, a);
+      new_insns[n++] = MIR_new_insn (ctx, MIR_NE, flag, t1, b);
+      new_insns[n++] = end_label;
+      break;
+    default: gen_assert (FALSE);
+    }
+    new_insns[n++] = MIR_new_insn (ctx, MIR_MOV, insn->ops[0], res);
+    gen_assert (n <= sizeof (new_insns) / sizeof (MIR_insn_t));
+    for (size_t i = 0; i < n; i++) MIR_insert_insn_before (ctx, curr_func_item, insn, new_insns[i]);
+    MIR_remove_insn (ctx, curr_func_item, insn);
+  }
+}
+
+/* Expand block copy and fill insns.  Blocks of small constant size are
+   copied/filled by a sequence of moves of the widest possible chunks,
+   other blocks are processed by calls of memcpy/memset.  It is done
+   before building CFG as we don't need to update it for new calls. */
+#define MAX_INLINE_BLOCK_SIZE 64
+
+static MIR_op_t new_block_temp_op (gen_ctx_t gen_ctx) { /* CFG is not built yet */
+  MIR_context_t ctx = gen_ctx->ctx;
+
+  return MIR_new_reg_op (ctx, _MIR_new_temp_reg (ctx, MIR_T_I64, curr_func_item->u.func));
+}
+
+static void expand_block_insns (gen_ctx_t gen_ctx) {
+  MIR_context_t ctx = gen_ctx->ctx;
+  MIR_module_t module = curr_func_item->module;
+  MIR_insn_t insn, next_insn, new_insn;
+  MIR_item_t proto_item, func_import_item;
+  MIR_op_t dest, src, size_op, temp, ops[5];
+  MIR_type_t type;
+  int64_t disp, chunk, size;
+
+  gen_assert (curr_func_item->item_type == MIR_func_item);
+  for (insn = DLIST_HEAD (MIR_insn_t, curr_func_item->u.func->insns); insn != NULL;
+       insn = next_insn) {
+    next_insn = DLIST_NEXT (MIR_insn_t, insn);
+    if (insn->code != MIR_MEMCPY && insn->code != MIR_MEMSET) continue;
+    dest = insn->ops[0];
+    src = insn->ops[1];
+    size_op = insn->ops[2];
+    gen_assert (dest.mode == MIR_OP_REG && src.mode == MIR_OP_REG);
+    if ((size_op.mode == MIR_OP_INT || size_op.mode == MIR_OP_UINT)
+        && size_op.u.u <= MAX_INLINE_BLOCK_SIZE) {
+      size = size_op.u.i;
+      if (insn->code == MIR_MEMSET && size != 0) { /* spread the byte value: */
+        temp = new_block_temp_op (gen_ctx);
+        new_insn = MIR_new_insn (ctx, MIR_UEXT8, temp, src);
+        MIR_insert_insn_before (ctx, curr_func_item, insn, new_insn);
+        if (size > 1) {
+          src = new_block_temp_op (gen_ctx);
+          new_insn = MIR_new_insn (ctx, MIR_MOV, src, MIR_new_uint_op (ctx, 0x0101010101010101));
+          MIR_insert_insn_before (ctx, curr_func_item, insn, new_insn);
+          new_insn = MIR_new_insn (ctx, MIR_MUL, temp, temp, src);
+          MIR_insert_insn_before (ctx, curr_func_item, insn, new_insn);
+        }
+        src = temp;
+      }
+      for (disp = 0; disp < size; disp += chunk) {
+        for (chunk = 8; chunk > size - disp; chunk /= 2)
+          ;
+        type = (chunk == 8   ? MIR_T_I64
+                : chunk == 4 ? MIR_T_U32
+                : chunk == 2 ? MIR_T_U16
+                             : MIR_T_U8);
+        if (insn->code == MIR_MEMSET) {
+          temp = src;
+        } else {
+          temp = new_block_temp_op (gen_ctx);
+          new_insn = MIR_new_insn (ctx, MIR_MOV, temp,
+                                   MIR_new_mem_op (ctx, type, disp, src.u.reg, 0, 1));
+          MIR_insert_insn_before (ctx, curr_func_item, insn, new_insn);
+        }
+        new_insn
+          = MIR_new_insn (ctx, MIR_MOV, MIR_new_mem_op (ctx, type, disp, dest.u.reg, 0, 1), temp);
+        MIR_insert_insn_before (ctx, curr_func_item, insn, new_insn);
+      }
+    } else {
+      if (insn->code == MIR_MEMCPY) {
+        proto_item = _MIR_builtin_proto (ctx, module, "mir.memcpy.p", 0, NULL, 3, MIR_T_I64,
+                                         "dest", MIR_T_I64, "src", MIR_T_I64, "n");
+        func_import_item = _MIR_builtin_func (ctx, module, "mir.memcpy", memcpy);
+      } else {
+        proto_item = _MIR_builtin_proto (ctx, module, "mir.memset.p", 0, NULL, 3, MIR_T_I64,
+                                         "dest", MIR_T_I64, "c", MIR_T_I64, "n");
+        func_import_item = _MIR_builtin_func (ctx, module, "mir.memset", memset);
+      }
+      ops[0] = MIR_new_ref_op (ctx, proto_item);
+      ops[1] = new_block_temp_op (gen_ctx);
+      new_insn = MIR_new_insn (ctx, MIR_MOV, ops[1], MIR_new_ref_op (ctx, func_import_item));
+      MIR_insert_insn_before (ctx, curr_func_item, insn, new_insn);
+      ops[2] = dest;
+      ops[3] = src;
+      if (size_op.mode == MIR_OP_REG) {
+        ops[4] = size_op;
+      } else {
+        ops[4] = new_block_temp_op (gen_ctx);
+        new_insn = MIR_new_insn (ctx, MIR_MOV, ops[4], size_op);
+        MIR_insert_insn_before (ctx, curr_func_item, insn, new_insn);
+      }
+      new_insn = MIR_new_insn_arr (ctx, MIR_CALL, 5, ops);
+      MIR_insert_insn_before (ctx, curr_func_item, insn, new_insn);
+    }
+    MIR_remove_insn (ctx, curr_func_item, insn);
+  }
+}
+
+/* Insert fuel checks at the function start and after loop labels (see
+   _MIR_mark_loop_labels) when the fuel metering is on.  The fuel address is loaded once at the
+   function start and each check is
+     mov t, i64:(a); sub t, t, 1; blt C, t, 0; mov i64:(a), t; L:
+   The branch directly follows the subtraction, so the target can use its flags.  The cold code
+   for the exhausted fuel is put before the last insn (RET which should stay the last one for
+   the epilogue):
+     jmp R; C: mov i64:(a), t; mov f, mir.fuel_exhausted; mov c, ctx;
+     call mir.fuel_exhausted.p, f, c; jmp L; ...; R: ret ...
+   It is done before building CFG as the check contains a branch and a call.  */
+static MIR_op_t new_fuel_temp_op (gen_ctx_t gen_ctx) { /* CFG is not built yet */
+  MIR_context_t ctx = gen_ctx->ctx;
+
+  return MIR_new_reg_op (ctx, _MIR_new_temp_reg (ctx, MIR_T_I64, curr_func_item->u.func));
+}
+
+static MIR_insn_t insert_fuel_check (gen_ctx_t gen_ctx, MIR_insn_t after, MIR_insn_t cold_anchor,
+                                     MIR_op_t addr, MIR_item_t proto_item,
+                                     MIR_item_t func_import_item) {
+  MIR_context_t ctx = gen_ctx->ctx;
+  MIR_label_t cold_label = MIR_new_label (ctx), resume_label = MIR_new_label (ctx);
+  MIR_op_t fuel = MIR_new_mem_op (ctx, MIR_T_I64, 0, addr.u.reg, 0, 1);
+  MIR_op_t temp = new_fuel_temp_op (gen_ctx), ops[3];
+  MIR_insn_t new_insns[6];
+  size_t i, n = 0;
+
+  new_insns[n++] = MIR_new_insn (ctx, MIR_MOV, temp, fuel);
+  new_insns[n++] = MIR_new_insn (ctx, MIR_SUB, temp, temp, MIR_new_int_op (ctx, 1));
+  new_insns[n++] = MIR_new_insn (ctx, MIR_BLT, MIR_new_label_op (ctx, cold_label), temp,
+                                 MIR_new_int_op (ctx, 0));
+  new_insns[n++] = MIR_new_insn (ctx, MIR_MOV, fuel, temp);
+  new_insns[n++] = resume_label;
+  for (i = 0; i < n; i++) {
+    MIR_insert_insn_after (ctx, curr_func_item, after, new_insns[i]);
+    after = new_insns[i];
+  }
+  ops[0] = MIR_new_ref_op (ctx, proto_item);
+  ops[1] = new_fuel_temp_op (gen_ctx);
+  ops[2] = new_fuel_temp_op (gen_ctx);
+  n = 0;
+  new_insns[n++] = cold_label;
+  new_insns[n++] = MIR_new_insn (ctx, MIR_MOV, fuel, temp);
+  new_insns[n++] = MIR_new_insn (ctx, MIR_MOV, ops[1], MIR_new_ref_op (ctx, func_import_item));
+  new_insns[n++] = MIR_new_insn (ctx, MIR_MOV, ops[2], MIR_new_uint_op (ctx, (uintptr_t) ctx));
+  new_insns[n++] = MIR_new_insn_arr (ctx, MIR_CALL, 3, ops);
+  new_insns[n++] = MIR_new_insn (ctx, MIR_JMP, MIR_new_label_op (ctx, resume_label));
+  gen_assert (n <= sizeof (new_insns) / sizeof (MIR_insn_t));
+  for (i = 0; i < n; i++) MIR_insert_insn_before (ctx, curr_func_item, cold_anchor, new_insns[i]);
+  return resume_label;
+}
+
+static void insert_fuel_checks (gen_ctx_t gen_ctx) {
+  MIR_context_t ctx = gen_ctx->ctx;
+  MIR_module_t module = curr_func_item->module;
+  MIR_insn_t insn, next_insn, tail_insn, start_insn, cold_start_insn;
+  MIR_label_t ret_label;
+  MIR_item_t proto_item, func_import_item;
+  MIR_op_t addr;
+  int64_t *fuel_addr = _MIR_get_fuel_addr (ctx);
+
+  if (fuel_addr == NULL) return;
+  proto_item = _MIR_builtin_proto (ctx, module, "mir.fuel_exhausted.p", 0, NULL, 1, MIR_T_I64,
+                                   "ctx");
+  func_import_item = _MIR_builtin_func (ctx, module, "mir.fuel_exhausted", _MIR_fuel_exhausted);
+  tail_insn = DLIST_TAIL (MIR_insn_t, curr_func_item->u.func->insns);
+  gen_assert (tail_insn != NULL && tail_insn->code == MIR_RET);
+  _MIR_mark_loop_labels (ctx, curr_func_item);
+  ret_label = MIR_new_label (ctx);
+  cold_start_insn = MIR_new_insn (ctx, MIR_JMP, MIR_new_label_op (ctx, ret_label));
+  MIR_insert_insn_before (ctx, curr_func_item, tail_insn, cold_start_insn);
+  MIR_insert_insn_before (ctx, curr_func_item, tail_insn, ret_label);
+  addr = new_fuel_temp_op (gen_ctx);
+  start_insn = MIR_new_insn (ctx, MIR_MOV, addr, MIR_new_uint_op (ctx, (uintptr_t) fuel_addr));
+  MIR_prepend_insn (ctx, curr_func_item, start_insn);
+  insert_fuel_check (gen_ctx, start_insn, ret_label, addr, proto_item, func_import_item);
+  for (insn = DLIST_HEAD (MIR_insn_t, curr_func_item->u.func->insns); insn != cold_start_insn;
+       insn = next_insn) {
+    next_insn = DLIST_NEXT (MIR_insn_t, insn);
+    if (insn->code != MIR_LABEL || insn->data == NULL) continue;
+    insn->data = NULL;
+    next_insn = DLIST_NEXT (MIR_insn_t, insert_fuel_check (gen_ctx, insn, ret_label, addr,
+                                                           proto_item, func_import_item));
+  }
+}
+
 static void make_io_dup_op_insns (gen_ctx_t gen_ctx) {
   MIR_context_t ctx = gen_ctx->ctx;
   MIR_func_t func;
@@ -351,8 +729,8 @@ struct bb_insn {
 DEF_DLIST (bb_insn_t, bb_insn_link);
 
 struct bb {
-  size_t index, pre, rpost, bfs; /* preorder, reverse post order, breadth first order */
-  unsigned int flag;             /* used for CCP */
+  size_t index, pre, rpost, order; /* preorder, reverse post order, position in bb_order */
+  unsigned int flag;               /* used for CCP */
   DLIST_LINK (bb_t) bb_link;
   DLIST (in_edge_t) in_edges;
   /* The out edges order: optional fall through bb, optional label bb,
@@ -361,7 +739,9 @@ struct bb {
   DLIST (bb_insn_t) bb_insns;
   size_t freq;
   bitmap_t in, out, gen, kill; /* var bitmaps for different data flow problems */
-  bitmap_t dom_in, dom_out;    /* additional var bitmaps */
+  bb_t idom;                   /* immediate dominator, NULL for entry and unreachable bbs */
+  bb_t dom_child, dom_sibling; /* used to build the dominator tree */
+  uint32_t dom_pre, dom_post;  /* the dominator tree preorder and postorder numbers */
   loop_node_t loop_node;
   int max_int_pressure, max_fp_pressure;
 };
@@ -458,20 +838,11 @@ static dead_var_t get_dead_var (gen_ctx_t gen_ctx) {
   dead_var_t dv;
 
   if ((dv = DLIST_HEAD (dead_var_t, free_dead_vars)) == NULL)
-    return gen_malloc (gen_ctx, sizeof (struct dead_var));
+    return gen_arena_alloc (gen_ctx, sizeof (struct dead_var));
   DLIST_REMOVE (dead_var_t, free_dead_vars, dv);
   return dv;
 }
 
-static void finish_dead_vars (gen_ctx_t gen_ctx) {
-  dead_var_t dv;
-
-  while ((dv = DLIST_HEAD (dead_var_t, free_dead_vars)) != NULL) {
-    DLIST_REMOVE (dead_var_t, free_dead_vars, dv);
-    free (dv);
-  }
-}
-
 static void add_bb_insn_dead_var (gen_ctx_t gen_ctx, bb_insn_t bb_insn, MIR_reg_t var) {
   dead_var_t dv;
 
@@ -533,7 +904,7 @@ static void setup_insn_data (gen_ctx_t gen_ctx, MIR_insn_t insn, bb_t bb) {
     insn->data = bb;
     return;
   }
-  insn_data = insn->data = gen_malloc (gen_ctx, sizeof (struct insn_data));
+  insn_data = insn->data = gen_arena_alloc (gen_ctx, sizeof (struct insn_data));
   insn_data->bb = bb;
   insn_data->u.call_hard_reg_args = NULL;
 }
@@ -548,11 +919,10 @@ static void delete_insn_data (MIR_insn_t insn) {
   if (insn_data == NULL || !insn_data_p (insn)) return;
   if (MIR_call_code_p (insn->code) && insn_data->u.call_hard_reg_args != NULL)
     bitmap_destroy (insn_data->u.call_hard_reg_args);
-  free (insn_data);
 }
 
 static bb_insn_t create_bb_insn (gen_ctx_t gen_ctx, MIR_insn_t insn, bb_t bb) {
-  bb_insn_t bb_insn = gen_malloc (gen_ctx, sizeof (struct bb_insn));
+  bb_insn_t bb_insn = gen_arena_alloc (gen_ctx, sizeof (struct bb_insn));
 
   insn->data = bb_insn;
   bb_insn->bb = bb;
@@ -579,7 +949,6 @@ static void delete_bb_insn (gen_ctx_t gen_ctx, bb_insn_t bb_insn) {
   bb_insn->insn->data = NULL;
   clear_bb_insn_dead_vars (gen_ctx, bb_insn);
   if (bb_insn->call_hard_reg_args != NULL) bitmap_destroy (bb_insn->call_hard_reg_args);
-  free (bb_insn);
 }
 
 static bb_t get_insn_bb (gen_ctx_t gen_ctx, MIR_insn_t insn) {
@@ -704,9 +1073,9 @@ static MIR_reg_t get_temp_hard_reg (MIR_type_t type, int first_p) {
 }
 
 static bb_t create_bb (gen_ctx_t gen_ctx, MIR_insn_t insn) {
-  bb_t bb = gen_malloc (gen_ctx, sizeof (struct bb));
+  bb_t bb = gen_arena_alloc (gen_ctx, sizeof (struct bb));
 
-  bb->pre = bb->rpost = bb->bfs = 0;
+  bb->pre = bb->rpost = bb->order = 0;
   bb->flag = FALSE;
   bb->loop_node = NULL;
   DLIST_INIT (bb_insn_t, bb->bb_insns);
@@ -716,8 +1085,8 @@ static bb_t create_bb (gen_ctx_t gen_ctx, MIR_insn_t insn) {
   bb->out = bitmap_create2 (DEFAULT_INIT_BITMAP_BITS_NUM);
   bb->gen = bitmap_create2 (DEFAULT_INIT_BITMAP_BITS_NUM);
   bb->kill = bitmap_create2 (DEFAULT_INIT_BITMAP_BITS_NUM);
-  bb->dom_in = bitmap_create2 (DEFAULT_INIT_BITMAP_BITS_NUM);
-  bb->dom_out = bitmap_create2 (DEFAULT_INIT_BITMAP_BITS_NUM);
+  bb->idom = bb->dom_child = bb->dom_sibling = NULL;
+  bb->dom_pre = bb->dom_post = 0;
   bb->max_int_pressure = bb->max_fp_pressure = 0;
   if (insn != NULL) {
     if (optimize_level == 0)
@@ -734,7 +1103,7 @@ static void add_bb (gen_ctx_t gen_ctx, bb_t bb) {
 }
 
 static edge_t create_edge (gen_ctx_t gen_ctx, bb_t src, bb_t dst, int append_p) {
-  edge_t e = gen_malloc (gen_ctx, sizeof (struct edge));
+  edge_t e = gen_arena_alloc (gen_ctx, sizeof (struct edge));
 
   e->src = src;
   e->dst = dst;
@@ -752,7 +1121,6 @@ static edge_t create_edge (gen_ctx_t gen_ctx, bb_t src, bb_t dst, int append_p)
 static void delete_edge (edge_t e) {
   DLIST_REMOVE (out_edge_t, e->src->out_edges, e);
   DLIST_REMOVE (in_edge_t, e->dst->in_edges, e);
-  free (e);
 }
 
 static void delete_bb (gen_ctx_t gen_ctx, bb_t bb) {
@@ -771,9 +1139,6 @@ static void delete_bb (gen_ctx_t gen_ctx, bb_t bb) {
   bitmap_destroy (bb->out);
   bitmap_destroy (bb->gen);
   bitmap_destroy (bb->kill);
-  bitmap_destroy (bb->dom_in);
-  bitmap_destroy (bb->dom_out);
-  free (bb);
 }
 
 static void DFS (bb_t bb, size_t *pre, size_t *rpost) {
@@ -804,7 +1169,7 @@ static loop_node_t top_loop_node (bb_t bb) {
 }
 
 static loop_node_t create_loop_node (gen_ctx_t gen_ctx, bb_t bb) {
-  loop_node_t loop_node = gen_malloc (gen_ctx, sizeof (struct loop_node));
+  loop_node_t loop_node = gen_arena_alloc (gen_ctx, sizeof (struct loop_node));
 
   loop_node->index = curr_loop_node_index++;
   loop_node->bb = bb;
@@ -920,7 +1285,6 @@ static void destroy_loop_tree (gen_ctx_t gen_ctx, loop_node_t root) {
       destroy_loop_tree (gen_ctx, node);
     }
   }
-  free (root);
 }
 
 static void update_min_max_reg (gen_ctx_t gen_ctx, MIR_reg_t reg) {
@@ -1246,7 +1610,7 @@ static mv_t get_free_move (gen_ctx_t gen_ctx) {
   if ((mv = DLIST_HEAD (mv_t, curr_cfg->free_moves)) != NULL)
     DLIST_REMOVE (mv_t, curr_cfg->free_moves, mv);
   else
-    mv = gen_malloc (gen_ctx, sizeof (struct mv));
+    mv = gen_arena_alloc (gen_ctx, sizeof (struct mv));
   DLIST_APPEND (mv_t, curr_cfg->used_moves, mv);
   return mv;
 }
@@ -1339,7 +1703,6 @@ static void destroy_func_cfg (gen_ctx_t gen_ctx) {
   MIR_insn_t insn;
   bb_insn_t bb_insn;
   bb_t bb, next_bb;
-  mv_t mv, next_mv;
 
   gen_assert (curr_func_item->item_type == MIR_func_item && curr_func_item->data != NULL);
   for (insn = DLIST_HEAD (MIR_insn_t, curr_func_item->u.func->insns); insn != NULL;
@@ -1356,99 +1719,117 @@ static void destroy_func_cfg (gen_ctx_t gen_ctx) {
     next_bb = DLIST_NEXT (bb_t, bb);
     delete_bb (gen_ctx, bb);
   }
-  for (mv = DLIST_HEAD (mv_t, curr_cfg->used_moves); mv != NULL; mv = next_mv) {
-    next_mv = DLIST_NEXT (mv_t, mv);
-    free (mv);
-  }
-  for (mv = DLIST_HEAD (mv_t, curr_cfg->free_moves); mv != NULL; mv = next_mv) {
-    next_mv = DLIST_NEXT (mv_t, mv);
-    free (mv);
-  }
   VARR_DESTROY (reg_info_t, curr_cfg->breg_info);
   bitmap_destroy (curr_cfg->call_crossed_bregs);
-  free (curr_func_item->data);
   curr_func_item->data = NULL;
 }
 
-static int rpost_cmp (const void *a1, const void *a2) {
-  return (*(const struct bb **) a1)->rpost - (*(const struct bb **) a2)->rpost;
-}
-
-static int post_cmp (const void *a1, const void *a2) { return -rpost_cmp (a1, a2); }
-
 DEF_VARR (bb_t);
 
 struct data_flow_ctx {
-  VARR (bb_t) * worklist, *pending;
-  bitmap_t bb_to_consider;
+  VARR (bb_t) * worklist, *bb_order;
+  bitmap_t bbs_to_process;
 };
 
 #define worklist gen_ctx->data_flow_ctx->worklist
-#define pending gen_ctx->data_flow_ctx->pending
-#define bb_to_consider gen_ctx->data_flow_ctx->bb_to_consider
+#define bb_order gen_ctx->data_flow_ctx->bb_order
+#define bbs_to_process gen_ctx->data_flow_ctx->bbs_to_process
+
+/* Put BBs into bb_order in reverse post order (if FORWARD_P) or in post order.  Unreachable BBs
+   go last.  Set up BB order field to the BB position in bb_order.  Make bbs_to_process empty.  */
+static void order_bbs (gen_ctx_t gen_ctx, int forward_p) {
+  size_t n = DLIST_LENGTH (bb_t, curr_cfg->bbs), reachable_n = 0, unreachable_pos;
+  bb_t bb;
+
+  enumerate_bbs (gen_ctx);
+  VARR_TRUNC (bb_t, bb_order, 0);
+  for (bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb)) {
+    VARR_PUSH (bb_t, bb_order, NULL);
+    if (bb->rpost != 0) reachable_n++;
+  }
+  /* Reachable BBs have rpost numbers in [n - reachable_n + 1, n], unreachable ones have zero: */
+  unreachable_pos = reachable_n;
+  for (bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb)) {
+    if (bb->rpost == 0)
+      bb->order = unreachable_pos++;
+    else
+      bb->order = forward_p ? bb->rpost - (n - reachable_n + 1) : n - bb->rpost;
+    VARR_SET (bb_t, bb_order, bb->order, bb);
+  }
+  bitmap_clear (bbs_to_process);
+}
+
+/* Add BB to the BBs to process.  Return FALSE if it is already there.  */
+static int add_bb_to_process_p (gen_ctx_t gen_ctx, bb_t bb) {
+  return bitmap_set_bit_p (bbs_to_process, bb->order);
+}
+
+/* Remove and return the first BB to process whose position in bb_order is >= *POS.  If there is
+   no such BB, start from the beginning of bb_order and increase *PASS.  Set up *POS to the
+   position after the returned BB.  Return NULL if there are no BBs to process.  */
+static bb_t extract_bb_to_process (gen_ctx_t gen_ctx, size_t *pos, size_t *pass) {
+  size_t nb;
+
+  if (!bitmap_find_next_bit_p (bbs_to_process, *pos, &nb)) {
+    if (*pos == 0 || !bitmap_find_next_bit_p (bbs_to_process, 0, &nb)) return NULL;
+    (*pass)++;
+  }
+  bitmap_clear_bit_p (bbs_to_process, nb);
+  *pos = nb + 1;
+  return VARR_GET (bb_t, bb_order, nb);
+}
 
+/* Solve a data flow problem.  BBs are processed in passes over bb_order.  A BB is processed
+   again only when its predecessor (successor for backward problem) has changed.  A pass
+   processes BBs in order and includes changed BBs which are after the current one, so the
+   problem usually converges in a few passes.  */
 static void solve_dataflow (gen_ctx_t gen_ctx, int forward_p, void (*con_func_0) (bb_t),
                             int (*con_func_n) (gen_ctx_t, bb_t),
                             int (*trans_func) (gen_ctx_t, bb_t)) {
-  size_t i, iter;
-  bb_t bb, *addr;
-  VARR (bb_t) * t;
+  size_t pos, pass;
+  bb_t bb;
+  edge_t e;
 
-  VARR_TRUNC (bb_t, worklist, 0);
-  for (bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb))
-    VARR_PUSH (bb_t, worklist, bb);
-  VARR_TRUNC (bb_t, pending, 0);
-  iter = 0;
-  while (VARR_LENGTH (bb_t, worklist) != 0) {
-    VARR_TRUNC (bb_t, pending, 0);
-    addr = VARR_ADDR (bb_t, worklist);
-    qsort (addr, VARR_LENGTH (bb_t, worklist), sizeof (bb), forward_p ? rpost_cmp : post_cmp);
-    bitmap_clear (bb_to_consider);
-    for (i = 0; i < VARR_LENGTH (bb_t, worklist); i++) {
-      int changed_p = iter == 0;
-      edge_t e;
+  order_bbs (gen_ctx, forward_p);
+  bitmap_set_bit_range_p (bbs_to_process, 0, VARR_LENGTH (bb_t, bb_order));
+  pos = pass = 0;
+  while ((bb = extract_bb_to_process (gen_ctx, &pos, &pass)) != NULL) {
+    int changed_p = pass == 0;
 
-      bb = addr[i];
+    if (forward_p) {
+      if (DLIST_HEAD (in_edge_t, bb->in_edges) == NULL)
+        con_func_0 (bb);
+      else
+        changed_p |= con_func_n (gen_ctx, bb);
+    } else {
+      if (DLIST_HEAD (out_edge_t, bb->out_edges) == NULL)
+        con_func_0 (bb);
+      else
+        changed_p |= con_func_n (gen_ctx, bb);
+    }
+    if (changed_p && trans_func (gen_ctx, bb)) {
       if (forward_p) {
-        if (DLIST_HEAD (in_edge_t, bb->in_edges) == NULL)
-          con_func_0 (bb);
-        else
-          changed_p |= con_func_n (gen_ctx, bb);
+        for (e = DLIST_HEAD (out_edge_t, bb->out_edges); e != NULL; e = DLIST_NEXT (out_edge_t, e))
+          add_bb_to_process_p (gen_ctx, e->dst);
       } else {
-        if (DLIST_HEAD (out_edge_t, bb->out_edges) == NULL)
-          con_func_0 (bb);
-        else
-          changed_p |= con_func_n (gen_ctx, bb);
-      }
-      if (changed_p && trans_func (gen_ctx, bb)) {
-        if (forward_p) {
-          for (e = DLIST_HEAD (out_edge_t, bb->out_edges); e != NULL;
-               e = DLIST_NEXT (out_edge_t, e))
-            if (bitmap_set_bit_p (bb_to_consider, e->dst->index)) VARR_PUSH (bb_t, pending, e->dst);
-        } else {
-          for (e = DLIST_HEAD (in_edge_t, bb->in_edges); e != NULL; e = DLIST_NEXT (in_edge_t, e))
-            if (bitmap_set_bit_p (bb_to_consider, e->src->index)) VARR_PUSH (bb_t, pending, e->src);
-        }
+        for (e = DLIST_HEAD (in_edge_t, bb->in_edges); e != NULL; e = DLIST_NEXT (in_edge_t, e))
+          add_bb_to_process_p (gen_ctx, e->src);
       }
     }
-    iter++;
-    t = worklist;
-    worklist = pending;
-    pending = t;
   }
 }
 
 static void init_data_flow (gen_ctx_t gen_ctx) {
   gen_ctx->data_flow_ctx = gen_malloc (gen_ctx, sizeof (struct data_flow_ctx));
   VARR_CREATE (bb_t, worklist, 0);
-  VARR_CREATE (bb_t, pending, 0);
-  bb_to_consider = bitmap_create2 (512);
+  VARR_CREATE (bb_t, bb_order, 0);
+  bbs_to_process = bitmap_create2 (512);
 }
 
 static void finish_data_flow (gen_ctx_t gen_ctx) {
   VARR_DESTROY (bb_t, worklist);
-  VARR_DESTROY (bb_t, pending);
-  bitmap_destroy (bb_to_consider);
+  VARR_DESTROY (bb_t, bb_order);
+  bitmap_destroy (bbs_to_process);
   free (gen_ctx->data_flow_ctx);
   gen_ctx->data_flow_ctx = NULL;
 }
@@ -1499,8 +1880,20 @@ typedef struct def_tab_el {
 } def_tab_el_t;
 DEF_HTAB (def_tab_el_t);
 
+/* Info about regs found by a cheap pass before SSA building.  Regs never used before their def
+   in the same bb (block-local regs) bypass the def table and phi creation.  Regs with one def and
+   without additional phi or start insn defs are not processed for renaming.  */
+typedef struct ssa_reg_info {
+  bb_t def_bb;  /* bb of the last processed def of the reg */
+  bb_insn_t def; /* the last processed def */
+  uint32_t defs_num;
+  char global_p;     /* reg is used before its def in some bb */
+  char extra_defs_p; /* phi or start insn was created for the reg */
+} ssa_reg_info_t;
+
 DEF_VARR (MIR_op_t);
 DEF_VARR (ssa_edge_t);
+DEF_VARR (ssa_reg_info_t);
 DEF_VARR (char);
 DEF_VARR (size_t);
 
@@ -1511,6 +1904,7 @@ struct ssa_ctx {
   VARR (bb_insn_t) * phis, *deleted_phis;
   VARR (MIR_op_t) * temp_ops;
   HTAB (def_tab_el_t) * def_tab; /* reg,bb -> insn defining reg  */
+  VARR (ssa_reg_info_t) * ssa_reg_infos;
   /* used for renaming: */
   VARR (ssa_edge_t) * ssa_edges_to_process;
   VARR (size_t) * curr_reg_indexes;
@@ -1524,6 +1918,7 @@ struct ssa_ctx {
 #define deleted_phis gen_ctx->ssa_ctx->deleted_phis
 #define temp_ops gen_ctx->ssa_ctx->temp_ops
 #define def_tab gen_ctx->ssa_ctx->def_tab
+#define ssa_reg_infos gen_ctx->ssa_ctx->ssa_reg_infos
 #define ssa_edges_to_process gen_ctx->ssa_ctx->ssa_edges_to_process
 #define curr_reg_indexes gen_ctx->ssa_ctx->curr_reg_indexes
 #define reg_name gen_ctx->ssa_ctx->reg_name
@@ -1616,12 +2011,15 @@ static bb_insn_t get_def (gen_ctx_t gen_ctx, MIR_reg_t reg, bb_t bb) {
   el.bb = bb;
   el.reg = reg;
   if (HTAB_DO (def_tab_el_t, def_tab, el, HTAB_FIND, tab_el)) return tab_el.def;
+  gen_assert (VARR_GET (ssa_reg_info_t, ssa_reg_infos, reg).global_p);
   if (DLIST_LENGTH (in_edge_t, bb->in_edges) == 1) {
     if ((src = DLIST_HEAD (in_edge_t, bb->in_edges)->src)->index == 0) { /* start bb: args */
+      VARR_ADDR (ssa_reg_info_t, ssa_reg_infos)[reg].extra_defs_p = TRUE;
       return get_start_insn (gen_ctx, arg_bb_insns, reg);
     }
     return get_def (gen_ctx, reg, DLIST_HEAD (in_edge_t, bb->in_edges)->src);
   }
+  VARR_ADDR (ssa_reg_info_t, ssa_reg_infos)[reg].extra_defs_p = TRUE;
   op = MIR_new_reg_op (ctx, reg);
   el.def = def = create_phi (gen_ctx, bb, op);
   HTAB_DO (def_tab_el_t, def_tab, el, HTAB_INSERT, tab_el);
@@ -1700,7 +2098,7 @@ static void minimize_ssa (gen_ctx_t gen_ctx, size_t insns_num) {
 static void add_ssa_edge (gen_ctx_t gen_ctx, bb_insn_t def, int def_op_num, bb_insn_t use,
                           int use_op_num) {
   MIR_op_t *op_ref;
-  ssa_edge_t ssa_edge = gen_malloc (gen_ctx, sizeof (struct ssa_edge));
+  ssa_edge_t ssa_edge = gen_arena_alloc (gen_ctx, sizeof (struct ssa_edge));
 
   gen_assert (use_op_num >= 0 && def_op_num >= 0 && def_op_num < (1 << 16));
   ssa_edge->flag = FALSE;
@@ -1728,7 +2126,6 @@ static void remove_ssa_edge (gen_ctx_t gen_ctx, ssa_edge_t ssa_edge) {
   if (ssa_edge->next_use != NULL) ssa_edge->next_use->prev_use = ssa_edge->prev_use;
   gen_assert (ssa_edge->use->insn->ops[ssa_edge->use_op_num].data == ssa_edge);
   ssa_edge->use->insn->ops[ssa_edge->use_op_num].data = NULL;
-  free (ssa_edge);
 }
 
 static void change_ssa_edge_list_def (ssa_edge_t list, bb_insn_t new_bb_insn,
@@ -1859,6 +2256,11 @@ static void rename_bb_insn (gen_ctx_t gen_ctx, bb_insn_t bb_insn) {
       print_bb_insn (gen_ctx, bb_insn, FALSE);
     });
     reg = var2reg (gen_ctx, var);
+    if (reg < VARR_LENGTH (ssa_reg_info_t, ssa_reg_infos)) {
+      ssa_reg_info_t *info = &VARR_ADDR (ssa_reg_info_t, ssa_reg_infos)[reg];
+
+      if (info->defs_num == 1 && !info->extra_defs_p) continue; /* the only def: keep the reg */
+    }
     while (VARR_LENGTH (size_t, curr_reg_indexes) <= reg) VARR_PUSH (size_t, curr_reg_indexes, 0);
     reg_index = VARR_GET (size_t, curr_reg_indexes, reg);
     VARR_SET (size_t, curr_reg_indexes, reg, reg_index + 1);
@@ -1911,6 +2313,47 @@ static void rename_regs (gen_ctx_t gen_ctx) {
       rename_bb_insn (gen_ctx, bb_insn);
 }
 
+static void classify_ssa_regs (gen_ctx_t gen_ctx) {
+  bb_t bb;
+  bb_insn_t bb_insn;
+  int op_num, out_p, mem_p;
+  size_t passed_mem_num, global_num = 0, regs_num = 0;
+  MIR_reg_t var;
+  ssa_reg_info_t *info, zero_info = {NULL, NULL, 0, FALSE, FALSE};
+  insn_var_iterator_t iter;
+
+  VARR_TRUNC (ssa_reg_info_t, ssa_reg_infos, 0);
+  while (VARR_LENGTH (ssa_reg_info_t, ssa_reg_infos) <= curr_cfg->max_reg)
+    VARR_PUSH (ssa_reg_info_t, ssa_reg_infos, zero_info);
+  for (bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb))
+    for (bb_insn = DLIST_HEAD (bb_insn_t, bb->bb_insns); bb_insn != NULL;
+         bb_insn = DLIST_NEXT (bb_insn_t, bb_insn)) {
+      if (bb_insn->insn->code == MIR_PHI) continue;
+      FOREACH_INSN_VAR (gen_ctx, iter, bb_insn->insn, var, op_num, out_p, mem_p, passed_mem_num) {
+        if (out_p) continue;
+        info = &VARR_ADDR (ssa_reg_info_t, ssa_reg_infos)[var - MAX_HARD_REG];
+        if (info->def_bb != bb) info->global_p = TRUE;
+      }
+      FOREACH_INSN_VAR (gen_ctx, iter, bb_insn->insn, var, op_num, out_p, mem_p, passed_mem_num) {
+        if (!out_p) continue;
+        info = &VARR_ADDR (ssa_reg_info_t, ssa_reg_infos)[var - MAX_HARD_REG];
+        info->def_bb = bb;
+        if (info->defs_num < 2) info->defs_num++;
+      }
+    }
+  for (size_t i = 0; i < VARR_LENGTH (ssa_reg_info_t, ssa_reg_infos); i++) {
+    info = &VARR_ADDR (ssa_reg_info_t, ssa_reg_infos)[i];
+    info->def_bb = NULL;
+    if (info->defs_num == 0 && !info->global_p) continue;
+    regs_num++;
+    if (info->global_p) global_num++;
+  }
+  DEBUG (2, {
+    fprintf (debug_file, "SSA regs: %lu block-local, %lu global\n",
+             (unsigned long) (regs_num - global_num), (unsigned long) global_num);
+  });
+}
+
 static void build_ssa (gen_ctx_t gen_ctx) {
   bb_t bb;
   bb_insn_t def, bb_insn, phi;
@@ -1918,32 +2361,37 @@ static void build_ssa (gen_ctx_t gen_ctx) {
   size_t passed_mem_num, insns_num, i;
   MIR_reg_t var;
   def_tab_el_t el;
+  ssa_reg_info_t *info;
   insn_var_iterator_t iter;
 
   gen_assert (VARR_LENGTH (bb_insn_t, arg_bb_insns) == 0
               && VARR_LENGTH (bb_insn_t, undef_insns) == 0);
   def_use_repr_p = FALSE;
   HTAB_CLEAR (def_tab_el_t, def_tab);
-  VARR_TRUNC (bb_t, worklist, 0);
-  for (bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb))
-    VARR_PUSH (bb_t, worklist, bb);
-  qsort (VARR_ADDR (bb_t, worklist), VARR_LENGTH (bb_t, worklist), sizeof (bb_t), rpost_cmp);
+  classify_ssa_regs (gen_ctx);
+  order_bbs (gen_ctx, TRUE);
   VARR_TRUNC (bb_insn_t, phis, 0);
   insns_num = 0;
-  for (i = 0; i < VARR_LENGTH (bb_t, worklist); i++) {
-    bb = VARR_GET (bb_t, worklist, i);
+  for (i = 0; i < VARR_LENGTH (bb_t, bb_order); i++) {
+    bb = VARR_GET (bb_t, bb_order, i);
     for (bb_insn = DLIST_HEAD (bb_insn_t, bb->bb_insns); bb_insn != NULL;
          bb_insn = DLIST_NEXT (bb_insn_t, bb_insn)) {
       if (bb_insn->insn->code != MIR_PHI) {
         FOREACH_INSN_VAR (gen_ctx, iter, bb_insn->insn, var, op_num, out_p, mem_p, passed_mem_num) {
           gen_assert (var > MAX_HARD_REG);
           if (out_p) continue;
-          def = get_def (gen_ctx, var - MAX_HARD_REG, bb);
+          info = &VARR_ADDR (ssa_reg_info_t, ssa_reg_infos)[var - MAX_HARD_REG];
+          /* a def in the same bb does not need the def table lookup: */
+          def = info->def_bb == bb ? info->def : get_def (gen_ctx, var - MAX_HARD_REG, bb);
           bb_insn->insn->ops[op_num].data = def;
         }
         insns_num++;
         FOREACH_INSN_VAR (gen_ctx, iter, bb_insn->insn, var, op_num, out_p, mem_p, passed_mem_num) {
           if (!out_p) continue;
+          info = &VARR_ADDR (ssa_reg_info_t, ssa_reg_infos)[var - MAX_HARD_REG];
+          info->def_bb = bb;
+          info->def = bb_insn;
+          if (!info->global_p) continue; /* block-local reg: never looked up in other bbs */
           el.bb = bb;
           el.reg = var - MAX_HARD_REG;
           el.def = bb_insn;
@@ -1990,15 +2438,11 @@ static void undo_build_ssa (gen_ctx_t gen_ctx) {
       if (bb_insn->insn->code == MIR_PHI) gen_delete_insn (gen_ctx, bb_insn->insn);
     }
   while (VARR_LENGTH (bb_insn_t, arg_bb_insns) != 0)
-    if ((bb_insn = VARR_POP (bb_insn_t, arg_bb_insns)) != NULL) {  // ??? specialized free funcs
+    if ((bb_insn = VARR_POP (bb_insn_t, arg_bb_insns)) != NULL)  // ??? specialized free funcs
       free (bb_insn->insn);
-      free (bb_insn);
-    }
   while (VARR_LENGTH (bb_insn_t, undef_insns) != 0)
-    if ((bb_insn = VARR_POP (bb_insn_t, undef_insns)) != NULL) {  // ??? specialized free funcs
+    if ((bb_insn = VARR_POP (bb_insn_t, undef_insns)) != NULL)  // ??? specialized free funcs
       free (bb_insn->insn);
-      free (bb_insn);
-    }
 }
 
 static void init_ssa (gen_ctx_t gen_ctx) {
@@ -2009,6 +2453,7 @@ static void init_ssa (gen_ctx_t gen_ctx) {
   VARR_CREATE (bb_insn_t, deleted_phis, 0);
   VARR_CREATE (MIR_op_t, temp_ops, 16);
   HTAB_CREATE (def_tab_el_t, def_tab, 1024, def_tab_el_hash, def_tab_el_eq, gen_ctx);
+  VARR_CREATE (ssa_reg_info_t, ssa_reg_infos, 0);
   VARR_CREATE (ssa_edge_t, ssa_edges_to_process, 512);
   VARR_CREATE (size_t, curr_reg_indexes, 4096);
   VARR_CREATE (char, reg_name, 20);
@@ -2021,6 +2466,7 @@ static void finish_ssa (gen_ctx_t gen_ctx) {
   VARR_DESTROY (bb_insn_t, deleted_phis);
   VARR_DESTROY (MIR_op_t, temp_ops);
   HTAB_DESTROY (def_tab_el_t, def_tab);
+  VARR_DESTROY (ssa_reg_info_t, ssa_reg_infos);
   VARR_DESTROY (ssa_edge_t, ssa_edges_to_process);
   VARR_DESTROY (size_t, curr_reg_indexes);
   VARR_DESTROY (char, reg_name);
@@ -2139,33 +2585,76 @@ struct gvn_ctx {
 #define exprs gen_ctx->gvn_ctx->exprs
 #define expr_tab gen_ctx->gvn_ctx->expr_tab
 
-static void dom_con_func_0 (bb_t bb) { bitmap_clear (bb->dom_in); }
+/* Calculate immediate dominators by the iterative algorithm of Cooper, Harvey, and Kennedy
+   ("A Simple, Fast Dominance Algorithm") using the data flow solver processing BBs in reverse
+   post order.  After that, number the dominator tree nodes to answer dominance queries in
+   constant time.  */
+static bb_t dom_intersect (bb_t bb1, bb_t bb2) {
+  while (bb1 != bb2) {
+    while (bb1->rpost > bb2->rpost) bb1 = bb1->idom;
+    while (bb2->rpost > bb1->rpost) bb2 = bb2->idom;
+  }
+  return bb1;
+}
+
+static void dom_con_func_0 (bb_t bb) {}
 
 static int dom_con_func_n (gen_ctx_t gen_ctx, bb_t bb) {
-  edge_t e, head;
-  bitmap_t prev_dom_in = temp_bitmap;
-
-  bitmap_copy (prev_dom_in, bb->dom_in);
-  head = DLIST_HEAD (in_edge_t, bb->in_edges);
-  bitmap_copy (bb->dom_in, head->src->dom_out);
-  for (e = DLIST_NEXT (in_edge_t, head); e != NULL; e = DLIST_NEXT (in_edge_t, e))
-    bitmap_and (bb->dom_in, bb->dom_in, e->src->dom_out); /* dom_in &= dom_out */
-  return !bitmap_equal_p (bb->dom_in, prev_dom_in);
+  bb_t new_idom = NULL;
+
+  if (bb->idom == bb) return FALSE; /* entry */
+  for (edge_t e = DLIST_HEAD (in_edge_t, bb->in_edges); e != NULL; e = DLIST_NEXT (in_edge_t, e))
+    if (e->src->idom != NULL) /* processed pred */
+      new_idom = new_idom == NULL ? e->src : dom_intersect (e->src, new_idom);
+  if (bb->idom == new_idom) return FALSE;
+  bb->idom = new_idom;
+  return TRUE;
 }
 
-static int dom_trans_func (gen_ctx_t gen_ctx, bb_t bb) {
-  bitmap_clear (temp_bitmap);
-  bitmap_set_bit_p (temp_bitmap, bb->index);
-  return bitmap_ior (bb->dom_out, bb->dom_in, temp_bitmap);
-}
+static int dom_trans_func (gen_ctx_t gen_ctx, bb_t bb) { return bb->idom != NULL; }
 
 static void calculate_dominators (gen_ctx_t gen_ctx) {
-  bb_t entry_bb = DLIST_HEAD (bb_t, curr_cfg->bbs);
+  bb_t bb, child, entry_bb = DLIST_HEAD (bb_t, curr_cfg->bbs);
+  size_t i;
+  uint32_t num;
 
-  bitmap_clear (entry_bb->dom_out);
-  for (bb_t bb = DLIST_NEXT (bb_t, entry_bb); bb != NULL; bb = DLIST_NEXT (bb_t, bb))
-    bitmap_set_bit_range_p (bb->dom_out, 0, curr_bb_index);
+  for (bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb)) {
+    bb->idom = bb->dom_child = bb->dom_sibling = NULL;
+    bb->dom_pre = bb->dom_post = 0;
+  }
+  entry_bb->idom = entry_bb;
   solve_dataflow (gen_ctx, TRUE, dom_con_func_0, dom_con_func_n, dom_trans_func);
+  entry_bb->idom = NULL;
+  /* Build the tree with children in reverse post order: */
+  for (i = VARR_LENGTH (bb_t, bb_order); i > 0; i--) {
+    bb = VARR_GET (bb_t, bb_order, i - 1);
+    if (bb->idom == NULL) continue;
+    bb->dom_sibling = bb->idom->dom_child;
+    bb->idom->dom_child = bb;
+  }
+  /* Number the tree nodes (starting with 1 as unreachable BBs have zero numbers): */
+  VARR_TRUNC (bb_t, worklist, 0);
+  VARR_PUSH (bb_t, worklist, entry_bb);
+  num = 1;
+  entry_bb->dom_pre = num++;
+  while (VARR_LENGTH (bb_t, worklist) != 0) {
+    bb = VARR_LAST (bb_t, worklist);
+    if ((child = bb->dom_child) != NULL) {
+      bb->dom_child = child->dom_sibling;
+      child->dom_pre = num++;
+      VARR_PUSH (bb_t, worklist, child);
+    } else {
+      bb->dom_post = num++;
+      VARR_POP (bb_t, worklist);
+    }
+  }
+}
+
+/* Return TRUE if BB1 dominates BB2.  It is valid only after calculate_dominators.  */
+static int dominates_p (bb_t bb1, bb_t bb2) {
+  return bb1 == bb2
+         || (bb1->dom_pre != 0 && bb1->dom_pre <= bb2->dom_pre
+             && bb2->dom_post <= bb1->dom_post);
 }
 
 static int op_eq (gen_ctx_t gen_ctx, MIR_op_t op1, MIR_op_t op2) {
@@ -2240,7 +2729,7 @@ static void insert_expr (gen_ctx_t gen_ctx, expr_t e) {
 }
 
 static expr_t add_expr (gen_ctx_t gen_ctx, MIR_insn_t insn) {
-  expr_t e = gen_malloc (gen_ctx, sizeof (struct expr));
+  expr_t e = gen_arena_alloc (gen_ctx, sizeof (struct expr));
 
   gen_assert (!MIR_call_code_p (insn->code) && insn->code != MIR_RET);
   e->insn = insn;
@@ -2272,7 +2761,7 @@ static int gvn_insn_p (MIR_insn_t insn) {
           && insn->code != MIR_LABEL && !MIR_call_code_p (insn->code) && insn->code != MIR_ALLOCA
           && insn->code != MIR_BSTART && insn->code != MIR_BEND && insn->code != MIR_VA_START
           && insn->code != MIR_VA_ARG && insn->code != MIR_VA_END
-          && insn->code != MIR_PHI
+          && insn->code != MIR_PHI && !MIR_overflow_code_p (insn->code)
           /* After simplification we have only mem insn in form: mem = reg or reg = mem. */
           && (!move_code_p (insn->code)
               || (insn->ops[0].mode != MIR_OP_MEM && insn->ops[0].mode != MIR_OP_HARD_REG_MEM
@@ -2308,8 +2797,8 @@ static void gvn_modify (gen_ctx_t gen_ctx) {
   MIR_reg_t temp_reg;
   long gvn_insns_num = 0;
 
-  for (size_t i = 0; i < VARR_LENGTH (bb_t, worklist); i++) {
-    bb = VARR_GET (bb_t, worklist, i);
+  for (size_t i = 0; i < VARR_LENGTH (bb_t, bb_order); i++) {
+    bb = VARR_GET (bb_t, bb_order, i);
     for (bb_insn = DLIST_HEAD (bb_insn_t, bb->bb_insns); bb_insn != NULL; bb_insn = next_bb_insn) {
       expr_t e, new_e;
       MIR_op_t op;
@@ -2339,9 +2828,7 @@ static void gvn_modify (gen_ctx_t gen_ctx) {
         continue;
       if (phi_use_p (e->insn)) continue; /* keep conventional SSA */
       expr_bb_insn = e->insn->data;
-      if (bb->index != expr_bb_insn->bb->index
-          && !bitmap_bit_p (bb->dom_in, expr_bb_insn->bb->index))
-        continue;
+      if (!dominates_p (expr_bb_insn->bb, bb)) continue;
       add_def_p = e->temp_reg == 0;
       temp_reg = get_expr_temp_reg (gen_ctx, e);
       op = MIR_new_reg_op (ctx, temp_reg);
@@ -2394,16 +2881,13 @@ static void gvn_modify (gen_ctx_t gen_ctx) {
 }
 
 static void gvn (gen_ctx_t gen_ctx) {
-  calculate_dominators (gen_ctx);
-  for (bb_t bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb))
-    VARR_PUSH (bb_t, worklist, bb);
-  qsort (VARR_ADDR (bb_t, worklist), VARR_LENGTH (bb_t, worklist), sizeof (bb_t), rpost_cmp);
+  calculate_dominators (gen_ctx); /* it also puts BBs into bb_order in reverse post order */
   gvn_modify (gen_ctx);
 }
 
 static void gvn_clear (gen_ctx_t gen_ctx) {
   HTAB_CLEAR (expr_t, expr_tab);
-  while (VARR_LENGTH (expr_t, exprs) != 0) free (VARR_POP (expr_t, exprs));
+  VARR_TRUNC (expr_t, exprs, 0);
 }
 
 static void init_gvn (gen_ctx_t gen_ctx) {
@@ -2421,18 +2905,32 @@ static void finish_gvn (gen_ctx_t gen_ctx) {
 
 /* New Page */
 
-/* Sparse Conditional Constant Propagation.  Live info should exist.  */
+/* Sparse Conditional Constant Propagation.  Live info should exist.  Besides constants, integer
+   value ranges with known zero bits are propagated.  Operand ranges are refined by conditions of
+   branches on the path to the operand use when the branches compare the operand with a constant.
+   The ranges are used to fold compares and branches and to remove redundant extensions.  */
 
 #define live_in in
 #define live_out out
 
-enum ccp_val_kind { CCP_CONST = 0, CCP_VARYING, CCP_UNKNOWN };
+enum ccp_val_kind { CCP_CONST = 0, CCP_VARYING, CCP_UNKNOWN, CCP_RANGE };
+
+/* Values of the range are in [min, max] and their zero_bits are zero.  If low32_p, the range
+   describes the sign extended lower 32-bit part of the value, the higher part being undefined (a
+   result of 32-bit insn).  */
+typedef struct {
+  int64_t min, max;
+  uint64_t zero_bits;
+  char low32_p;
+} ccp_range_t;
 
 struct ccp_val {
   enum ccp_val_kind val_kind : 8;
   unsigned int flag : 8;
+  uint32_t range_changes; /* used for range widening */
   size_t ccp_run;
   const_t val;
+  ccp_range_t range; /* for CCP_CONST and CCP_RANGE */
 };
 
 typedef struct ccp_val *ccp_val_t;
@@ -2441,14 +2939,12 @@ DEF_VARR (ccp_val_t);
 struct ccp_ctx {
   size_t curr_ccp_run;
   bitmap_t bb_visited;
-  VARR (bb_t) * ccp_bbs;
   VARR (bb_insn_t) * ccp_insns;
   VARR (ccp_val_t) * ccp_vals;
 };
 
 #define curr_ccp_run gen_ctx->ccp_ctx->curr_ccp_run
 #define bb_visited gen_ctx->ccp_ctx->bb_visited
-#define ccp_bbs gen_ctx->ccp_ctx->ccp_bbs
 #define ccp_insns gen_ctx->ccp_ctx->ccp_insns
 #define ccp_vals gen_ctx->ccp_ctx->ccp_vals
 
@@ -2464,6 +2960,7 @@ static ccp_val_t get_ccp_val (gen_ctx_t gen_ctx, bb_insn_t bb_insn) {
   if (ccp_val->ccp_run != curr_ccp_run) {
     ccp_val->val_kind = bb_insn->bb == DLIST_HEAD (bb_t, curr_cfg->bbs) ? CCP_VARYING : CCP_UNKNOWN;
     ccp_val->flag = FALSE;
+    ccp_val->range_changes = 0;
     ccp_val->ccp_run = curr_ccp_run;
   }
   return ccp_val;
@@ -2488,10 +2985,10 @@ static void initiate_ccp_info (gen_ctx_t gen_ctx) {
   }
   bitmap_clear (bb_visited);
   VARR_TRUNC (bb_insn_t, ccp_insns, 0);
-  VARR_TRUNC (bb_t, ccp_bbs, 0);
   while (VARR_LENGTH (ccp_val_t, ccp_vals) != 0)
     if ((ccp_val = VARR_POP (ccp_val_t, ccp_vals)) != NULL) free (ccp_val);
-  VARR_PUSH (bb_t, ccp_bbs, DLIST_HEAD (bb_t, curr_cfg->bbs)); /* entry bb */
+  order_bbs (gen_ctx, TRUE);
+  add_bb_to_process_p (gen_ctx, DLIST_HEAD (bb_t, curr_cfg->bbs)); /* entry bb */
 }
 
 static int var_op_p (MIR_op_t op) { return op.mode == MIR_OP_HARD_REG || op.mode == MIR_OP_REG; }
@@ -2532,7 +3029,8 @@ static enum ccp_val_kind get_3ops (gen_ctx_t gen_ctx, MIR_insn_t insn, const_t *
   if (out_p && !var_insn_op_p (insn, 0)) return CCP_UNKNOWN;
   if ((res1 = get_op (gen_ctx, insn, 1, val1)) == CCP_VARYING) return CCP_VARYING;
   if ((res2 = get_op (gen_ctx, insn, 2, val2)) == CCP_VARYING) return CCP_VARYING;
-  return res1 == CCP_UNKNOWN || res2 == CCP_UNKNOWN ? CCP_UNKNOWN : CCP_CONST;
+  if (res1 == CCP_UNKNOWN || res2 == CCP_UNKNOWN) return CCP_UNKNOWN;
+  return res1 == CCP_RANGE || res2 == CCP_RANGE ? CCP_RANGE : CCP_CONST;
 }
 
 static enum ccp_val_kind get_2iops (gen_ctx_t gen_ctx, MIR_insn_t insn, int64_t *p, int out_p) {
@@ -2607,74 +3105,768 @@ static enum ccp_val_kind get_3usops (gen_ctx_t gen_ctx, MIR_insn_t insn, uint32_
   return CCP_CONST;
 }
 
-#define EXT(tp)                                                                       \
-  do {                                                                                \
-    int64_t p;                                                                        \
-    if ((ccp_res = get_2iops (gen_ctx, insn, &p, TRUE)) != CCP_CONST) goto non_const; \
-    val.uns_p = FALSE;                                                                \
-    val.u.i = (tp) p;                                                                 \
-  } while (0)
+/* Value ranges: */
 
-#define IOP2(op)                                                                      \
-  do {                                                                                \
-    int64_t p;                                                                        \
-    if ((ccp_res = get_2iops (gen_ctx, insn, &p, TRUE)) != CCP_CONST) goto non_const; \
-    val.uns_p = FALSE;                                                                \
-    val.u.i = op p;                                                                   \
-  } while (0)
+#define CCP_RANGE_WIDENING_THRESHOLD 4 /* range changes of a value before widening its range */
+#define CCP_RANGE_REFINE_DEPTH 8       /* max number of branches checked for a range refinement */
 
-#define IOP2S(op)                                                                      \
-  do {                                                                                 \
-    int32_t p;                                                                         \
-    if ((ccp_res = get_2isops (gen_ctx, insn, &p, TRUE)) != CCP_CONST) goto non_const; \
-    val.uns_p = FALSE;                                                                 \
-    val.u.i = op p;                                                                    \
-  } while (0)
+static int64_t range_lo (int low32_p) { return low32_p ? INT32_MIN : INT64_MIN; }
+static int64_t range_hi (int low32_p) { return low32_p ? INT32_MAX : INT64_MAX; }
 
-#define UOP2S(op)                                                                      \
-  do {                                                                                 \
-    uint32_t p;                                                                        \
-    if ((ccp_res = get_2usops (gen_ctx, insn, &p, TRUE)) != CCP_CONST) goto non_const; \
-    val.uns_p = FALSE;                                                                 \
-    val.u.u = op p;                                                                    \
-  } while (0)
+static void set_full_range (ccp_range_t *r, int low32_p) {
+  r->min = range_lo (low32_p);
+  r->max = range_hi (low32_p);
+  r->zero_bits = 0;
+  r->low32_p = low32_p;
+}
 
-#define IOP3(op)                                                                            \
-  do {                                                                                      \
-    int64_t p1, p2;                                                                         \
-    if ((ccp_res = get_3iops (gen_ctx, insn, &p1, &p2, TRUE)) != CCP_CONST) goto non_const; \
-    val.uns_p = FALSE;                                                                      \
-    val.u.i = p1 op p2;                                                                     \
-  } while (0)
+static void set_range (ccp_range_t *r, int64_t min, int64_t max, int low32_p) {
+  r->min = min;
+  r->max = max;
+  r->zero_bits = 0;
+  r->low32_p = low32_p;
+}
 
-#define IOP3S(op)                                                                            \
-  do {                                                                                       \
-    int32_t p1, p2;                                                                          \
-    if ((ccp_res = get_3isops (gen_ctx, insn, &p1, &p2, TRUE)) != CCP_CONST) goto non_const; \
-    val.uns_p = FALSE;                                                                       \
-    val.u.i = p1 op p2;                                                                      \
-  } while (0)
+static void set_const_range (ccp_range_t *r, int64_t v) {
+  r->min = r->max = v;
+  r->zero_bits = ~(uint64_t) v;
+  r->low32_p = FALSE;
+}
 
-#define UOP3(op)                                                                            \
-  do {                                                                                      \
-    uint64_t p1, p2;                                                                        \
-    if ((ccp_res = get_3uops (gen_ctx, insn, &p1, &p2, TRUE)) != CCP_CONST) goto non_const; \
-    val.uns_p = TRUE;                                                                       \
-    val.u.u = p1 op p2;                                                                     \
-  } while (0)
+static int full_range_p (ccp_range_t *r) {
+  return r->min == range_lo (r->low32_p) && r->max == range_hi (r->low32_p) && r->zero_bits == 0;
+}
 
-#define UOP3S(op)                                                                            \
-  do {                                                                                       \
-    uint32_t p1, p2;                                                                         \
-    if ((ccp_res = get_3usops (gen_ctx, insn, &p1, &p2, TRUE)) != CCP_CONST) goto non_const; \
-    val.uns_p = TRUE;                                                                        \
-    val.u.u = p1 op p2;                                                                      \
-  } while (0)
+static int equal_ranges_p (ccp_range_t *r1, ccp_range_t *r2) {
+  return (r1->min == r2->min && r1->max == r2->max && r1->zero_bits == r2->zero_bits
+          && r1->low32_p == r2->low32_p);
+}
 
-#define IOP30(op)                                                                                  \
-  do {                                                                                             \
-    if ((ccp_res = get_op (gen_ctx, insn, 2, &val)) != CCP_CONST || val.u.i == 0) goto non_const0; \
-    IOP3 (op);                                                                                     \
+/* Make range bounds and known zero bits consistent.  */
+static void normalize_range (ccp_range_t *r) {
+  uint64_t m;
+  int64_t bits_max;
+
+  if ((r->zero_bits >> 63) != 0 && r->max >= 0) { /* sign bit is zero */
+    if (r->min < 0) r->min = 0;
+    bits_max = (int64_t) ~r->zero_bits;
+    if (bits_max >= r->min && r->max > bits_max) r->max = bits_max;
+  }
+  if (r->min >= 0) { /* bits higher than the max value highest bit are zero */
+    m = (uint64_t) r->max;
+    m |= m >> 1;
+    m |= m >> 2;
+    m |= m >> 4;
+    m |= m >> 8;
+    m |= m >> 16;
+    m |= m >> 32;
+    r->zero_bits |= ~m;
+  }
+}
+
+/* Transform range R into the range of the sign extended lower 32-bit part.  */
+static void to_low32_range (ccp_range_t *r) {
+  if (r->low32_p) return;
+  r->low32_p = TRUE;
+  if (r->min >= INT32_MIN && r->max <= INT32_MAX) return;
+  r->min = INT32_MIN;
+  r->max = INT32_MAX;
+  if (r->zero_bits & ((uint64_t) 1 << 31))
+    r->zero_bits |= ~(uint64_t) 0xffffffff;
+  else
+    r->zero_bits &= 0x7fffffff;
+  normalize_range (r);
+}
+
+static void to_full_range (ccp_range_t *r) {
+  if (r->low32_p) set_full_range (r, FALSE);
+}
+
+static void join_ranges (ccp_range_t *r, ccp_range_t *r2) {
+  ccp_range_t t = *r2;
+
+  if (r->low32_p != t.low32_p) {
+    to_low32_range (r);
+    to_low32_range (&t);
+  }
+  if (r->min > t.min) r->min = t.min;
+  if (r->max < t.max) r->max = t.max;
+  r->zero_bits &= t.zero_bits;
+}
+
+/* Narrow range R by a constraint range C.  */
+static void intersect_ranges (ccp_range_t *r, ccp_range_t *c) {
+  ccp_range_t t = *c;
+
+  if (r->low32_p != t.low32_p) {
+    if (r->low32_p)
+      to_low32_range (&t);
+    else if (r->min >= INT32_MIN && r->max <= INT32_MAX) /* the value is its lower part */
+      t.low32_p = FALSE;
+    else
+      return;
+  }
+  if (t.min > r->max || t.max < r->min) return; /* contradiction: the path is never executed */
+  if (r->min < t.min) r->min = t.min;
+  if (r->max > t.max) r->max = t.max;
+  r->zero_bits |= t.zero_bits;
+  normalize_range (r);
+}
+
+enum ccp_cmp { CCP_CMP_EQ, CCP_CMP_NE, CCP_CMP_LT, CCP_CMP_LE, CCP_CMP_GT, CCP_CMP_GE };
+
+static int get_cmp_params (MIR_insn_code_t code, enum ccp_cmp *rel, int *s_p, int *uns_p) {
+  *s_p = *uns_p = FALSE;
+  switch (code) {
+  case MIR_EQS:
+  case MIR_BEQS: *s_p = TRUE; /* fall through */
+  case MIR_EQ:
+  case MIR_BEQ: *rel = CCP_CMP_EQ; return TRUE;
+  case MIR_NES:
+  case MIR_BNES: *s_p = TRUE; /* fall through */
+  case MIR_NE:
+  case MIR_BNE: *rel = CCP_CMP_NE; return TRUE;
+  case MIR_LTS:
+  case MIR_BLTS: *s_p = TRUE; /* fall through */
+  case MIR_LT:
+  case MIR_BLT: *rel = CCP_CMP_LT; return TRUE;
+  case MIR_LES:
+  case MIR_BLES: *s_p = TRUE; /* fall through */
+  case MIR_LE:
+  case MIR_BLE: *rel = CCP_CMP_LE; return TRUE;
+  case MIR_GTS:
+  case MIR_BGTS: *s_p = TRUE; /* fall through */
+  case MIR_GT:
+  case MIR_BGT: *rel = CCP_CMP_GT; return TRUE;
+  case MIR_GES:
+  case MIR_BGES: *s_p = TRUE; /* fall through */
+  case MIR_GE:
+  case MIR_BGE: *rel = CCP_CMP_GE; return TRUE;
+  case MIR_ULTS:
+  case MIR_UBLTS: *s_p = TRUE; /* fall through */
+  case MIR_ULT:
+  case MIR_UBLT: *uns_p = TRUE; *rel = CCP_CMP_LT; return TRUE;
+  case MIR_ULES:
+  case MIR_UBLES: *s_p = TRUE; /* fall through */
+  case MIR_ULE:
+  case MIR_UBLE: *uns_p = TRUE; *rel = CCP_CMP_LE; return TRUE;
+  case MIR_UGTS:
+  case MIR_UBGTS: *s_p = TRUE; /* fall through */
+  case MIR_UGT:
+  case MIR_UBGT: *uns_p = TRUE; *rel = CCP_CMP_GT; return TRUE;
+  case MIR_UGES:
+  case MIR_UBGES: *s_p = TRUE; /* fall through */
+  case MIR_UGE:
+  case MIR_UBGE: *uns_p = TRUE; *rel = CCP_CMP_GE; return TRUE;
+  default: return FALSE;
+  }
+}
+
+static enum ccp_cmp swap_cmp (enum ccp_cmp rel) {
+  return (rel == CCP_CMP_LT   ? CCP_CMP_GT
+          : rel == CCP_CMP_LE ? CCP_CMP_GE
+          : rel == CCP_CMP_GT ? CCP_CMP_LT
+          : rel == CCP_CMP_GE ? CCP_CMP_LE
+                              : rel);
+}
+
+static enum ccp_cmp reverse_cmp (enum ccp_cmp rel) {
+  return (rel == CCP_CMP_EQ   ? CCP_CMP_NE
+          : rel == CCP_CMP_NE ? CCP_CMP_EQ
+          : rel == CCP_CMP_LT ? CCP_CMP_GE
+          : rel == CCP_CMP_LE ? CCP_CMP_GT
+          : rel == CCP_CMP_GT ? CCP_CMP_LE
+                              : CCP_CMP_LT);
+}
+
+/* Return 1 (0) if relation REL is true (false) for all values from ranges R1 and R2 which are
+   already in the same form.  Return -1 otherwise.  */
+static int range_cmp (enum ccp_cmp rel, int uns_p, ccp_range_t *r1, ccp_range_t *r2) {
+  uint64_t min1, max1, min2, max2, sign = (uint64_t) 1 << 63;
+
+  gen_assert (r1->low32_p == r2->low32_p);
+  if (!uns_p) { /* map signed values to unsigned ones keeping the order */
+    min1 = (uint64_t) r1->min ^ sign;
+    max1 = (uint64_t) r1->max ^ sign;
+    min2 = (uint64_t) r2->min ^ sign;
+    max2 = (uint64_t) r2->max ^ sign;
+  } else if ((r1->min < 0 && r1->max >= 0) || (r2->min < 0 && r2->max >= 0)) {
+    return -1;
+  } else if (r1->low32_p) {
+    min1 = (uint32_t) r1->min;
+    max1 = (uint32_t) r1->max;
+    min2 = (uint32_t) r2->min;
+    max2 = (uint32_t) r2->max;
+  } else {
+    min1 = (uint64_t) r1->min;
+    max1 = (uint64_t) r1->max;
+    min2 = (uint64_t) r2->min;
+    max2 = (uint64_t) r2->max;
+  }
+  switch (rel) {
+  case CCP_CMP_EQ:
+  case CCP_CMP_NE:
+    if (min1 == max1 && min2 == max2 && min1 == min2) return rel == CCP_CMP_EQ;
+    if (max1 < min2 || max2 < min1
+        || (r2->min == r2->max && (r1->zero_bits & (uint64_t) r2->min) != 0)
+        || (r1->min == r1->max && (r2->zero_bits & (uint64_t) r1->min) != 0))
+      return rel == CCP_CMP_NE;
+    return -1;
+  case CCP_CMP_LT: return max1 < min2 ? 1 : min1 >= max2 ? 0 : -1;
+  case CCP_CMP_LE: return max1 <= min2 ? 1 : min1 > max2 ? 0 : -1;
+  case CCP_CMP_GT: return min1 > max2 ? 1 : max1 <= min2 ? 0 : -1;
+  case CCP_CMP_GE: return min1 >= max2 ? 1 : max1 < min2 ? 0 : -1;
+  default: gen_assert (FALSE); return -1;
+  }
+}
+
+static int op_def_p (MIR_insn_t insn, size_t nop, bb_insn_t def) {
+  return var_insn_op_p (insn, nop) && ((ssa_edge_t) insn->ops[nop].data)->def == def;
+}
+
+static int int_op_p (MIR_op_t op, int64_t *c) {
+  if (op.mode != MIR_OP_INT && op.mode != MIR_OP_UINT) return FALSE;
+  *c = op.u.i;
+  return TRUE;
+}
+
+/* Return TRUE if operand NOP of INSN is an integer constant or a var set up only by moving an
+   integer constant (the usual form after simplification).  */
+static int int_const_op_p (MIR_insn_t insn, size_t nop, int64_t *c) {
+  MIR_insn_t def_insn;
+
+  if (!var_insn_op_p (insn, nop)) return int_op_p (insn->ops[nop], c);
+  def_insn = ((ssa_edge_t) insn->ops[nop].data)->def->insn;
+  return def_insn->code == MIR_MOV && int_op_p (def_insn->ops[1], c);
+}
+
+/* Narrow range R of DEF by condition of branch INSN whose jump is taken or not (TAKEN_P).  */
+static void refine_range_by_branch (MIR_insn_t insn, bb_insn_t def, int taken_p, ccp_range_t *r) {
+  enum ccp_cmp rel;
+  int s_p, uns_p;
+  int64_t c, sc;
+  uint64_t uc;
+  ccp_range_t t;
+
+  if (insn->code == MIR_BT || insn->code == MIR_BTS || insn->code == MIR_BF
+      || insn->code == MIR_BFS) {
+    if (!op_def_p (insn, 1, def)) return;
+    s_p = insn->code == MIR_BTS || insn->code == MIR_BFS;
+    uns_p = FALSE;
+    c = 0;
+    rel = (insn->code == MIR_BT || insn->code == MIR_BTS) == taken_p ? CCP_CMP_NE : CCP_CMP_EQ;
+  } else if (!get_cmp_params (insn->code, &rel, &s_p, &uns_p)) {
+    return;
+  } else {
+    if (op_def_p (insn, 1, def) && int_const_op_p (insn, 2, &c)) {
+    } else if (op_def_p (insn, 2, def) && int_const_op_p (insn, 1, &c)) {
+      rel = swap_cmp (rel);
+    } else {
+      return;
+    }
+    if (!taken_p) rel = reverse_cmp (rel);
+  }
+  sc = s_p ? (int32_t) c : c;
+  uc = s_p ? (uint32_t) c : (uint64_t) c;
+  if (rel == CCP_CMP_NE) { /* exclude range end equal to the constant */
+    if (r->low32_p != s_p && (!s_p || r->min < INT32_MIN || r->max > INT32_MAX)) return;
+    if (r->min == sc && r->min < r->max)
+      r->min++;
+    else if (r->max == sc && r->min < r->max)
+      r->max--;
+    normalize_range (r);
+    return;
+  }
+  if (rel == CCP_CMP_EQ) {
+    set_range (&t, sc, sc, s_p);
+  } else if (uns_p) { /* only x < c and x <= c give a range of signed values */
+    if (rel == CCP_CMP_LT && uc != 0 && uc - 1 <= (uint64_t) range_hi (s_p))
+      set_range (&t, 0, uc - 1, s_p);
+    else if (rel == CCP_CMP_LE && uc <= (uint64_t) range_hi (s_p))
+      set_range (&t, 0, uc, s_p);
+    else
+      return;
+  } else if (rel == CCP_CMP_LT) {
+    if (sc == range_lo (s_p)) return;
+    set_range (&t, range_lo (s_p), sc - 1, s_p);
+  } else if (rel == CCP_CMP_LE) {
+    set_range (&t, range_lo (s_p), sc, s_p);
+  } else if (rel == CCP_CMP_GT) {
+    if (sc == range_hi (s_p)) return;
+    set_range (&t, sc + 1, range_hi (s_p), s_p);
+  } else {
+    set_range (&t, sc, range_hi (s_p), s_p);
+  }
+  normalize_range (&t);
+  intersect_ranges (r, &t);
+}
+
+static edge_t single_in_edge (bb_t bb) {
+  edge_t e = DLIST_HEAD (in_edge_t, bb->in_edges);
+
+  return e != NULL && DLIST_NEXT (in_edge_t, e) == NULL ? e : NULL;
+}
+
+/* Narrow range R of DEF value coming through edge E by conditions of branches executed right
+   before E on any path to E.  */
+static void refine_range (bb_insn_t def, edge_t e, ccp_range_t *r) {
+  bb_t src;
+  bb_insn_t tail;
+  edge_t e1, e2;
+
+  for (int n = 0; n < CCP_RANGE_REFINE_DEPTH; n++) {
+    src = e->src;
+    if ((tail = DLIST_TAIL (bb_insn_t, src->bb_insns)) != NULL
+        && (e1 = DLIST_HEAD (out_edge_t, src->out_edges)) != NULL
+        && (e2 = DLIST_NEXT (out_edge_t, e1)) != NULL && DLIST_NEXT (out_edge_t, e2) == NULL
+        && e1->dst != e2->dst)
+      refine_range_by_branch (tail->insn, def, e == e2, r); /* 2nd edge is for the jump */
+    if (src == def->bb || (e = single_in_edge (src)) == NULL) break;
+  }
+}
+
+/* Get range R of operand NOP of INSN.  Return CCP_UNKNOWN if it is not known yet.  */
+static enum ccp_val_kind get_op_range (gen_ctx_t gen_ctx, MIR_insn_t insn, size_t nop,
+                                       ccp_range_t *r) {
+  bb_t bb;
+  bb_insn_t def;
+  edge_t e;
+  ccp_val_t ccp_val;
+  int64_t c;
+
+  if (!var_insn_op_p (insn, nop)) {
+    if (!int_op_p (insn->ops[nop], &c)) {
+      set_full_range (r, FALSE);
+      return CCP_VARYING;
+    }
+    set_const_range (r, c);
+    return CCP_CONST;
+  }
+  def = ((ssa_edge_t) insn->ops[nop].data)->def;
+  ccp_val = get_ccp_val (gen_ctx, def);
+  if (ccp_val->val_kind == CCP_UNKNOWN) return CCP_UNKNOWN;
+  if (ccp_val->val_kind == CCP_VARYING)
+    set_full_range (r, FALSE);
+  else
+    *r = ccp_val->range;
+  bb = ((bb_insn_t) insn->data)->bb;
+  if (def->bb != bb && (e = single_in_edge (bb)) != NULL) refine_range (def, e, r);
+  return CCP_RANGE;
+}
+
+/* Merge value of kind KIND (CCP_CONST with VAL, CCP_RANGE with R, or CCP_VARYING) into CCP_VAL.
+   Widen the range of a frequently changed value if WIDEN_P.  It is enough to do this only for phis
+   as any dependence cycle goes through a phi.  Return TRUE if CCP_VAL was changed.  */
+static int update_ccp_val (ccp_val_t ccp_val, enum ccp_val_kind kind, const_t *val,
+                           ccp_range_t *r, int widen_p) {
+  ccp_range_t new_r, old_r;
+
+  gen_assert (kind != CCP_UNKNOWN);
+  if (ccp_val->val_kind == CCP_VARYING) return FALSE;
+  if (kind == CCP_VARYING) {
+    ccp_val->val_kind = CCP_VARYING;
+    return TRUE;
+  }
+  if (kind == CCP_CONST) {
+    if (ccp_val->val_kind == CCP_UNKNOWN) {
+      ccp_val->val_kind = CCP_CONST;
+      ccp_val->range_changes = 0;
+      ccp_val->val = *val;
+      set_const_range (&ccp_val->range, val->u.i);
+      return TRUE;
+    }
+    set_const_range (&new_r, val->u.i);
+  } else {
+    new_r = *r;
+  }
+  if (ccp_val->val_kind == CCP_UNKNOWN) {
+    ccp_val->range_changes = 0;
+  } else {
+    old_r = ccp_val->range;
+    join_ranges (&new_r, &old_r);
+    if (new_r.low32_p) to_low32_range (&old_r);
+    normalize_range (&new_r);
+    if (equal_ranges_p (&new_r, &old_r)) return FALSE;
+    if (widen_p && ccp_val->val_kind == CCP_RANGE
+        && ++ccp_val->range_changes > CCP_RANGE_WIDENING_THRESHOLD) { /* widen the range */
+      uint64_t lost_zero_bits = old_r.zero_bits & ~new_r.zero_bits;
+
+      if (new_r.min < old_r.min) new_r.min = range_lo (new_r.low32_p);
+      if (new_r.max > old_r.max) new_r.max = range_hi (new_r.low32_p);
+      /* Otherwise the known zero bits would still limit the range one bit per change: */
+      if (lost_zero_bits != 0) new_r.zero_bits &= (lost_zero_bits & -lost_zero_bits) - 1;
+    }
+  }
+  normalize_range (&new_r);
+  if (full_range_p (&new_r)) {
+    ccp_val->val_kind = CCP_VARYING;
+  } else if (new_r.min == new_r.max) {
+    /* The higher part of lower32 value is undefined and can be the constant one: */
+    ccp_val->val_kind = CCP_CONST;
+    ccp_val->val.uns_p = FALSE;
+    ccp_val->val.u.i = new_r.min;
+    set_const_range (&ccp_val->range, new_r.min);
+  } else {
+    ccp_val->val_kind = CCP_RANGE;
+    ccp_val->range = new_r;
+  }
+  return TRUE;
+}
+
+static int s_code_p (MIR_insn_code_t code) {
+  switch (code) {
+  case MIR_NEGS:
+  case MIR_ADDS:
+  case MIR_SUBS:
+  case MIR_MULS:
+  case MIR_DIVS:
+  case MIR_UDIVS:
+  case MIR_MODS:
+  case MIR_UMODS:
+  case MIR_ANDS:
+  case MIR_ORS:
+  case MIR_XORS:
+  case MIR_LSHS:
+  case MIR_RSHS:
+  case MIR_URSHS: return TRUE;
+  default: return FALSE;
+  }
+}
+
+static int add_overflow_p (int64_t a, int64_t b, int low32_p) {
+  return b > 0 ? a > range_hi (low32_p) - b : a < range_lo (low32_p) - b;
+}
+
+static int sub_overflow_p (int64_t a, int64_t b, int low32_p) {
+  return b < 0 ? a > range_hi (low32_p) + b : a < range_lo (low32_p) + b;
+}
+
+/* Return constant C if range R contains only one value.  */
+static int const_range_p (ccp_range_t *r, int64_t *c) {
+  if (r->min != r->max) return FALSE;
+  *c = r->min;
+  return TRUE;
+}
+
+/* Calculate range RES of the result of INSN which is not a constant.  */
+static enum ccp_val_kind get_range_res (gen_ctx_t gen_ctx, MIR_insn_t insn, ccp_range_t *res) {
+  MIR_insn_code_t code = insn->code;
+  ccp_range_t r1, r2;
+  enum ccp_cmp rel;
+  int w, sign_p, s_p, uns_p, v;
+  int64_t lo, hi, c, p[4];
+  uint64_t uc, mask;
+
+  if (code == MIR_MOV || (w = get_ext_params (code, &sign_p)) != 0) {
+    if (get_op_range (gen_ctx, insn, 1, &r1) == CCP_UNKNOWN) return CCP_UNKNOWN;
+    if (code == MIR_MOV) {
+      *res = r1;
+    } else {
+      to_low32_range (&r1);
+      mask = w == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << w) - 1;
+      lo = sign_p ? -((int64_t) 1 << (w - 1)) : 0;
+      hi = sign_p ? ((int64_t) 1 << (w - 1)) - 1 : (int64_t) mask;
+      *res = r1;
+      if (r1.min < lo || r1.max > hi) {
+        set_range (res, lo, hi, FALSE);
+        if (!sign_p || (r1.zero_bits & ((uint64_t) 1 << (w - 1))))
+          res->zero_bits = (r1.zero_bits & mask) | ~mask;
+        else
+          res->zero_bits = r1.zero_bits & mask;
+      }
+      res->low32_p = FALSE;
+    }
+  } else if (get_cmp_params (code, &rel, &s_p, &uns_p)) {
+    if (get_op_range (gen_ctx, insn, 1, &r1) == CCP_UNKNOWN
+        || get_op_range (gen_ctx, insn, 2, &r2) == CCP_UNKNOWN)
+      return CCP_UNKNOWN;
+    if (s_p) {
+      to_low32_range (&r1);
+      to_low32_range (&r2);
+    } else {
+      to_full_range (&r1);
+      to_full_range (&r2);
+    }
+    if ((v = range_cmp (rel, uns_p, &r1, &r2)) >= 0)
+      set_const_range (res, v);
+    else
+      set_range (res, 0, 1, s_p);
+  } else {
+    s_p = s_code_p (code);
+    switch (code) {
+    case MIR_NEG:
+    case MIR_NEGS:
+      if (get_op_range (gen_ctx, insn, 1, &r1) == CCP_UNKNOWN) return CCP_UNKNOWN;
+      r2 = r1;
+      set_const_range (&r1, 0);
+      break;
+    case MIR_ADD:
+    case MIR_ADDS:
+    case MIR_SUB:
+    case MIR_SUBS:
+    case MIR_MUL:
+    case MIR_MULS:
+    case MIR_DIV:
+    case MIR_DIVS:
+    case MIR_UDIV:
+    case MIR_UDIVS:
+    case MIR_MOD:
+    case MIR_MODS:
+    case MIR_UMOD:
+    case MIR_UMODS:
+    case MIR_AND:
+    case MIR_ANDS:
+    case MIR_OR:
+    case MIR_ORS:
+    case MIR_XOR:
+    case MIR_XORS:
+    case MIR_LSH:
+    case MIR_LSHS:
+    case MIR_RSH:
+    case MIR_RSHS:
+    case MIR_URSH:
+    case MIR_URSHS:
+      if (get_op_range (gen_ctx, insn, 1, &r1) == CCP_UNKNOWN
+          || get_op_range (gen_ctx, insn, 2, &r2) == CCP_UNKNOWN)
+        return CCP_UNKNOWN;
+      break;
+    default: return CCP_VARYING;
+    }
+    if (s_p) {
+      to_low32_range (&r1);
+      to_low32_range (&r2);
+    } else {
+      to_full_range (&r1);
+      to_full_range (&r2);
+    }
+    lo = range_lo (s_p);
+    hi = range_hi (s_p);
+    set_full_range (res, s_p);
+    switch (code) {
+    case MIR_NEG:
+    case MIR_NEGS:
+    case MIR_SUB:
+    case MIR_SUBS:
+      if (sub_overflow_p (r1.min, r2.max, s_p) || sub_overflow_p (r1.max, r2.min, s_p))
+        return CCP_VARYING;
+      set_range (res, r1.min - r2.max, r1.max - r2.min, s_p);
+      break;
+    case MIR_ADD:
+    case MIR_ADDS:
+      if (add_overflow_p (r1.min, r2.min, s_p) || add_overflow_p (r1.max, r2.max, s_p))
+        return CCP_VARYING;
+      set_range (res, r1.min + r2.min, r1.max + r2.max, s_p);
+      break;
+    case MIR_MUL:
+    case MIR_MULS: /* products of values with absolute values less 2^31 fit into int64_t: */
+      if (r1.min < -INT32_MAX || r1.max > INT32_MAX || r2.min < -INT32_MAX || r2.max > INT32_MAX)
+        return CCP_VARYING;
+      p[0] = r1.min * r2.min;
+      p[1] = r1.min * r2.max;
+      p[2] = r1.max * r2.min;
+      p[3] = r1.max * r2.max;
+      set_range (res, p[0], p[0], s_p);
+      for (int i = 1; i < 4; i++) {
+        if (res->min > p[i]) res->min = p[i];
+        if (res->max < p[i]) res->max = p[i];
+      }
+      if (res->min < lo || res->max > hi) return CCP_VARYING;
+      break;
+    case MIR_DIV:
+    case MIR_DIVS:
+      if (!const_range_p (&r2, &c) || c == 0 || c == -1) return CCP_VARYING;
+      if (c > 0)
+        set_range (res, r1.min / c, r1.max / c, s_p);
+      else
+        set_range (res, r1.max / c, r1.min / c, s_p);
+      break;
+    case MIR_MOD:
+    case MIR_MODS:
+      if (!const_range_p (&r2, &c) || c == 0 || c == lo) return CCP_VARYING;
+      if (c < 0) c = -c;
+      if (r1.min >= 0)
+        set_range (res, 0, r1.max < c - 1 ? r1.max : c - 1, s_p);
+      else if (r1.max <= 0)
+        set_range (res, r1.min > 1 - c ? r1.min : 1 - c, 0, s_p);
+      else
+        set_range (res, 1 - c, c - 1, s_p);
+      break;
+    case MIR_UDIV:
+    case MIR_UDIVS:
+      if (!const_range_p (&r2, &c)) return CCP_VARYING;
+      uc = s_p ? (uint32_t) c : (uint64_t) c;
+      if (uc == 0) return CCP_VARYING;
+      if (r1.min >= 0 && uc <= (uint64_t) hi)
+        set_range (res, r1.min / (int64_t) uc, r1.max / (int64_t) uc, s_p);
+      else if (uc >= 2)
+        set_range (res, 0, (int64_t) ((s_p ? UINT32_MAX : UINT64_MAX) / uc), s_p);
+      else
+        return CCP_VARYING;
+      break;
+    case MIR_UMOD:
+    case MIR_UMODS:
+      if (!const_range_p (&r2, &c)) return CCP_VARYING;
+      uc = s_p ? (uint32_t) c : (uint64_t) c;
+      if (uc == 0 || uc - 1 > (uint64_t) hi) return CCP_VARYING;
+      if (r1.min >= 0 && r1.max < (int64_t) uc)
+        *res = r1;
+      else
+        set_range (res, 0, uc - 1, s_p);
+      break;
+    case MIR_AND:
+    case MIR_ANDS:
+      if (r1.min >= 0) set_range (res, 0, r1.max, s_p);
+      if (r2.min >= 0 && (r1.min < 0 || r2.max < r1.max)) set_range (res, 0, r2.max, s_p);
+      res->zero_bits = r1.zero_bits | r2.zero_bits;
+      break;
+    case MIR_OR:
+    case MIR_ORS:
+      if (r1.min >= 0 && r2.min >= 0) res->min = r1.min > r2.min ? r1.min : r2.min;
+      res->zero_bits = r1.zero_bits & r2.zero_bits;
+      break;
+    case MIR_XOR:
+    case MIR_XORS: res->zero_bits = r1.zero_bits & r2.zero_bits; break;
+    case MIR_LSH:
+    case MIR_LSHS:
+      if (!const_range_p (&r2, &c) || c < 0 || c >= (s_p ? 32 : 64) || r1.min < (lo >> c)
+          || r1.max > (hi >> c))
+        return CCP_VARYING;
+      set_range (res, (int64_t) ((uint64_t) r1.min << c), (int64_t) ((uint64_t) r1.max << c), s_p);
+      res->zero_bits = (r1.zero_bits << c) | (((uint64_t) 1 << c) - 1);
+      break;
+    case MIR_RSH:
+    case MIR_RSHS:
+      if (!const_range_p (&r2, &c) || c < 0 || c >= (s_p ? 32 : 64)) return CCP_VARYING;
+      set_range (res, r1.min >> c, r1.max >> c, s_p);
+      res->zero_bits = (uint64_t) ((int64_t) r1.zero_bits >> c);
+      break;
+    case MIR_URSH:
+    case MIR_URSHS:
+      if (!const_range_p (&r2, &c) || c < 0 || c >= (s_p ? 32 : 64)) return CCP_VARYING;
+      if (r1.min >= 0) {
+        set_range (res, r1.min >> c, r1.max >> c, s_p);
+        res->zero_bits = (uint64_t) ((int64_t) r1.zero_bits >> c);
+      } else if (c != 0) {
+        set_range (res, 0, (int64_t) ((s_p ? UINT32_MAX : UINT64_MAX) >> c), s_p);
+        if (!s_p) res->zero_bits = (r1.zero_bits >> c) | ~(UINT64_MAX >> c);
+      } else {
+        *res = r1;
+      }
+      break;
+    default: gen_assert (FALSE);
+    }
+  }
+  normalize_range (res);
+  return full_range_p (res) ? CCP_VARYING : CCP_RANGE;
+}
+
+/* Try to calculate the result of branch INSN using ranges.  */
+static enum ccp_val_kind get_range_branch_res (gen_ctx_t gen_ctx, MIR_insn_t insn, int *res) {
+  MIR_insn_code_t code = insn->code;
+  enum ccp_cmp rel;
+  int s_p, uns_p, v;
+  ccp_range_t r1, r2;
+
+  if (code == MIR_BT || code == MIR_BTS || code == MIR_BF || code == MIR_BFS) {
+    if (get_op_range (gen_ctx, insn, 1, &r1) == CCP_UNKNOWN) return CCP_UNKNOWN;
+    s_p = code == MIR_BTS || code == MIR_BFS;
+    uns_p = FALSE;
+    rel = code == MIR_BT || code == MIR_BTS ? CCP_CMP_NE : CCP_CMP_EQ;
+    set_const_range (&r2, 0);
+  } else if (!get_cmp_params (code, &rel, &s_p, &uns_p)) {
+    return CCP_VARYING;
+  } else if (get_op_range (gen_ctx, insn, 1, &r1) == CCP_UNKNOWN
+             || get_op_range (gen_ctx, insn, 2, &r2) == CCP_UNKNOWN) {
+    return CCP_UNKNOWN;
+  }
+  if (s_p) {
+    to_low32_range (&r1);
+    to_low32_range (&r2);
+  } else {
+    to_full_range (&r1);
+    to_full_range (&r2);
+  }
+  if ((v = range_cmp (rel, uns_p, &r1, &r2)) < 0) return CCP_VARYING;
+  *res = v;
+  return CCP_CONST;
+}
+
+#if !MIR_NO_GEN_DEBUG
+static void print_ccp_range (FILE *f, ccp_range_t *r) {
+  fprintf (f, "[%" PRId64 ", %" PRId64 "]", r->min, r->max);
+  if (r->zero_bits != 0) fprintf (f, " zero bits %" PRIx64, r->zero_bits);
+  if (r->low32_p) fprintf (f, " (lower 32-bit)");
+}
+#endif
+
+#define EXT(tp)                                                                       \
+  do {                                                                                \
+    int64_t p;                                                                        \
+    if ((ccp_res = get_2iops (gen_ctx, insn, &p, TRUE)) != CCP_CONST) goto non_const; \
+    val.uns_p = FALSE;                                                                \
+    val.u.i = (tp) p;                                                                 \
+  } while (0)
+
+#define IOP2(op)                                                                      \
+  do {                                                                                \
+    int64_t p;                                                                        \
+    if ((ccp_res = get_2iops (gen_ctx, insn, &p, TRUE)) != CCP_CONST) goto non_const; \
+    val.uns_p = FALSE;                                                                \
+    val.u.i = op p;                                                                   \
+  } while (0)
+
+#define IOP2S(op)                                                                      \
+  do {                                                                                 \
+    int32_t p;                                                                         \
+    if ((ccp_res = get_2isops (gen_ctx, insn, &p, TRUE)) != CCP_CONST) goto non_const; \
+    val.uns_p = FALSE;                                                                 \
+    val.u.i = op p;                                                                    \
+  } while (0)
+
+#define UOP2S(op)                                                                      \
+  do {                                                                                 \
+    uint32_t p;                                                                        \
+    if ((ccp_res = get_2usops (gen_ctx, insn, &p, TRUE)) != CCP_CONST) goto non_const; \
+    val.uns_p = FALSE;                                                                 \
+    val.u.u = op p;                                                                    \
+  } while (0)
+
+#define IOP3(op)                                                                            \
+  do {                                                                                      \
+    int64_t p1, p2;                                                                         \
+    if ((ccp_res = get_3iops (gen_ctx, insn, &p1, &p2, TRUE)) != CCP_CONST) goto non_const; \
+    val.uns_p = FALSE;                                                                      \
+    val.u.i = p1 op p2;                                                                     \
+  } while (0)
+
+#define IOP3S(op)                                                                            \
+  do {                                                                                       \
+    int32_t p1, p2;                                                                          \
+    if ((ccp_res = get_3isops (gen_ctx, insn, &p1, &p2, TRUE)) != CCP_CONST) goto non_const; \
+    val.uns_p = FALSE;                                                                       \
+    val.u.i = p1 op p2;                                                                      \
+  } while (0)
+
+#define UOP3(op)                                                                            \
+  do {                                                                                      \
+    uint64_t p1, p2;                                                                        \
+    if ((ccp_res = get_3uops (gen_ctx, insn, &p1, &p2, TRUE)) != CCP_CONST) goto non_const; \
+    val.uns_p = TRUE;                                                                       \
+    val.u.u = p1 op p2;                                                                     \
+  } while (0)
+
+#define UOP3S(op)                                                                            \
+  do {                                                                                       \
+    uint32_t p1, p2;                                                                         \
+    if ((ccp_res = get_3usops (gen_ctx, insn, &p1, &p2, TRUE)) != CCP_CONST) goto non_const; \
+    val.uns_p = TRUE;                                                                        \
+    val.u.u = p1 op p2;                                                                      \
+  } while (0)
+
+#define IOP30(op)                                                                                  \
+  do {                                                                                             \
+    if ((ccp_res = get_op (gen_ctx, insn, 2, &val)) != CCP_CONST || val.u.i == 0) goto non_const0; \
+    IOP3 (op);                                                                                     \
   } while (0)
 
 #define IOP3S0(op)                                                                                 \
@@ -2777,6 +3969,7 @@ static int ccp_phi_insn_update (gen_ctx_t gen_ctx, bb_insn_t phi) {
   edge_t e;
   ssa_edge_t ssa_edge;
   ccp_val_t res_ccp_val, op_ccp_val;
+  ccp_range_t range;
   size_t nop;
   int change_p = FALSE;
 
@@ -2790,21 +3983,18 @@ static int ccp_phi_insn_update (gen_ctx_t gen_ctx, bb_insn_t phi) {
     ssa_edge = phi_insn->ops[nop].data;
     op_ccp_val = get_ccp_val (gen_ctx, ssa_edge->def);
     if (op_ccp_val->val_kind == CCP_UNKNOWN) continue;
-    if (res_ccp_val->val_kind == CCP_UNKNOWN || op_ccp_val->val_kind == CCP_VARYING) {
-      change_p = res_ccp_val->val_kind != op_ccp_val->val_kind;
-      res_ccp_val->val_kind = op_ccp_val->val_kind;
-      if (op_ccp_val->val_kind == CCP_VARYING) break;
-      if (op_ccp_val->val_kind == CCP_CONST) res_ccp_val->val = op_ccp_val->val;
-    } else {
-      gen_assert (res_ccp_val->val_kind == CCP_CONST && op_ccp_val->val_kind == CCP_CONST);
-      if (res_ccp_val->val.uns_p != op_ccp_val->val.uns_p
-          || (res_ccp_val->val.uns_p && res_ccp_val->val.u.u != op_ccp_val->val.u.u)
-          || (!res_ccp_val->val.uns_p && res_ccp_val->val.u.i != op_ccp_val->val.u.i)) {
-        res_ccp_val->val_kind = CCP_VARYING;
-        change_p = TRUE;
-        break;
-      }
+    if (op_ccp_val->val_kind == CCP_CONST) {
+      change_p |= update_ccp_val (res_ccp_val, CCP_CONST, &op_ccp_val->val, NULL, TRUE);
+    } else { /* the value coming through the edge can be narrowed by the edge condition: */
+      if (op_ccp_val->val_kind == CCP_VARYING)
+        set_full_range (&range, FALSE);
+      else
+        range = op_ccp_val->range;
+      refine_range (ssa_edge->def, e, &range);
+      change_p |= update_ccp_val (res_ccp_val, full_range_p (&range) ? CCP_VARYING : CCP_RANGE,
+                                  NULL, &range, TRUE);
     }
+    if (res_ccp_val->val_kind == CCP_VARYING) break;
   }
   return change_p;
 }
@@ -2816,7 +4006,7 @@ static int ccp_insn_update (gen_ctx_t gen_ctx, MIR_insn_t insn) {
   enum ccp_val_kind ccp_res;
   const_t val;
   ccp_val_t ccp_val;
-  enum ccp_val_kind val_kind;
+  ccp_range_t range;
 
   switch (insn->code) {
   case MIR_PHI: return ccp_phi_insn_update (gen_ctx, insn->data);
@@ -2896,17 +4086,12 @@ static int ccp_insn_update (gen_ctx_t gen_ctx, MIR_insn_t insn) {
     gen_assert (out_p);
   }
 #endif
-  ccp_val = get_ccp_val (gen_ctx, insn->data);
-  val_kind = ccp_val->val_kind;
-  gen_assert (val_kind == CCP_UNKNOWN || val_kind == CCP_CONST);
-  ccp_val->val_kind = CCP_CONST;
-  ccp_val->val = val;
-  return val_kind != CCP_CONST;
+  return update_ccp_val (get_ccp_val (gen_ctx, insn->data), CCP_CONST, &val, NULL, FALSE);
 non_const0:
   if (ccp_res == CCP_CONST && val.u.i == 0) ccp_res = CCP_VARYING;
 non_const:
   if (ccp_res == CCP_UNKNOWN) return FALSE;
-  gen_assert (ccp_res == CCP_VARYING);
+  gen_assert (ccp_res == CCP_VARYING || ccp_res == CCP_RANGE);
   change_p = FALSE;
   if (MIR_call_code_p (insn->code)) {
     ccp_val = get_ccp_val (gen_ctx, insn->data);
@@ -2914,10 +4099,9 @@ non_const:
     ccp_val->val_kind = CCP_VARYING;
   } else if (get_ccp_res_op (gen_ctx, insn, 0, &op)
              && (op.mode == MIR_OP_HARD_REG || op.mode == MIR_OP_REG)) {
-    ccp_val = get_ccp_val (gen_ctx, insn->data);
-    if (ccp_val->val_kind != CCP_VARYING) change_p = TRUE;
-    ccp_val->val_kind = CCP_VARYING;
     gen_assert (!get_ccp_res_op (gen_ctx, insn, 1, &op));
+    if ((ccp_res = get_range_res (gen_ctx, insn, &range)) == CCP_UNKNOWN) return FALSE;
+    change_p = update_ccp_val (get_ccp_val (gen_ctx, insn->data), ccp_res, NULL, &range, FALSE);
   }
   return change_p;
 }
@@ -2931,7 +4115,7 @@ static enum ccp_val_kind ccp_branch_update (gen_ctx_t gen_ctx, MIR_insn_t insn,
   case MIR_BTS:
   case MIR_BF:
   case MIR_BFS:
-    if ((ccp_res = get_op (gen_ctx, insn, 1, &val)) != CCP_CONST) return ccp_res;
+    if ((ccp_res = get_op (gen_ctx, insn, 1, &val)) != CCP_CONST) goto non_const;
     if (insn->code == MIR_BTS || insn->code == MIR_BFS)
       *res = val.uns_p ? (uint32_t) val.u.u != 0 : (int32_t) val.u.i != 0;
     else
@@ -2965,7 +4149,7 @@ static enum ccp_val_kind ccp_branch_update (gen_ctx_t gen_ctx, MIR_insn_t insn,
   *res = val.u.i;
   return CCP_CONST;
 non_const:
-  return ccp_res;
+  return ccp_res == CCP_UNKNOWN ? CCP_UNKNOWN : get_range_branch_res (gen_ctx, insn, res);
 }
 
 static void ccp_push_used_insns (gen_ctx_t gen_ctx, ssa_edge_t first_ssa_edge) {
@@ -2986,13 +4170,11 @@ static void ccp_push_used_insns (gen_ctx_t gen_ctx, ssa_edge_t first_ssa_edge) {
 }
 
 static void ccp_process_active_edge (gen_ctx_t gen_ctx, edge_t e) {
-  if (e->skipped_p && !e->dst->flag) {
+  if (e->skipped_p && add_bb_to_process_p (gen_ctx, e->dst)) { /* just activated edge */
     DEBUG (2, {
       fprintf (debug_file, "         Make edge bb%lu->bb%lu active\n",
                (unsigned long) e->src->index, (unsigned long) e->dst->index);
     });
-    e->dst->flag = TRUE; /* just activated edge whose dest is not in ccp_bbs */
-    VARR_PUSH (bb_t, ccp_bbs, e->dst);
   }
   e->skipped_p = FALSE;
 }
@@ -3011,6 +4193,9 @@ static void ccp_make_insn_update (gen_ctx_t gen_ctx, MIR_insn_t insn) {
           fprintf (debug_file, " -- make the result unknown");
         } else if (ccp_val->val_kind == CCP_VARYING) {
           fprintf (debug_file, " -- keep the result varying");
+        } else if (ccp_val->val_kind == CCP_RANGE) {
+          fprintf (debug_file, " -- keep the result range ");
+          print_ccp_range (debug_file, &ccp_val->range);
         } else {
           gen_assert (ccp_val->val_kind == CCP_CONST);
           fprintf (debug_file, " -- keep the result a constant ");
@@ -3037,6 +4222,10 @@ static void ccp_make_insn_update (gen_ctx_t gen_ctx, MIR_insn_t insn) {
         fprintf (debug_file, " -- make all results varying\n");
       } else if (ccp_val->val_kind == CCP_VARYING) {
         fprintf (debug_file, " -- make the result varying\n");
+      } else if (ccp_val->val_kind == CCP_RANGE) {
+        fprintf (debug_file, " -- make the result range ");
+        print_ccp_range (debug_file, &ccp_val->range);
+        fprintf (debug_file, "\n");
       } else {
         gen_assert (ccp_val->val_kind == CCP_CONST);
         fprintf (debug_file, " -- make the result a constant ");
@@ -3103,10 +4292,8 @@ static void ccp_process_bb (gen_ctx_t gen_ctx, bb_t bb) {
       || bb_insn->insn->code == MIR_SWITCH) {
     for (e = DLIST_HEAD (out_edge_t, bb->out_edges); e != NULL; e = DLIST_NEXT (out_edge_t, e)) {
       gen_assert (!e->skipped_p);
-      if (!bitmap_bit_p (bb_visited, e->dst->index) && !e->dst->flag) {
-        e->dst->flag = TRUE; /* first process of dest which is not in ccp_bbs */
-        VARR_PUSH (bb_t, ccp_bbs, e->dst);
-      }
+      if (!bitmap_bit_p (bb_visited, e->dst->index)) /* first process of dest */
+        add_bb_to_process_p (gen_ctx, e->dst);
       ccp_process_active_edge (gen_ctx, e);
     }
   }
@@ -3140,6 +4327,17 @@ static void ccp_remove_insn_ssa_edges (gen_ctx_t gen_ctx, MIR_insn_t insn) {
   }
 }
 
+/* Return TRUE if extension INSN of width W is a no-op for its operand range.  */
+static int ext_range_redundant_p (gen_ctx_t gen_ctx, MIR_insn_t insn, int w, int sign_p) {
+  ccp_range_t r;
+
+  if (!var_insn_op_p (insn, 1) || get_op_range (gen_ctx, insn, 1, &r) == CCP_UNKNOWN
+      || r.low32_p)
+    return FALSE;
+  if (sign_p) return r.min >= -((int64_t) 1 << (w - 1)) && r.max < ((int64_t) 1 << (w - 1));
+  return r.min >= 0 && r.max <= (int64_t) (((uint64_t) 1 << w) - 1);
+}
+
 static int ccp_modify (gen_ctx_t gen_ctx) {
   MIR_context_t ctx = gen_ctx->ctx;
   bb_t bb, next_bb;
@@ -3148,8 +4346,8 @@ static int ccp_modify (gen_ctx_t gen_ctx) {
   MIR_op_t op;
   MIR_insn_t insn, prev_insn, first_insn;
   ssa_edge_t se, next_se;
-  int res, change_p = FALSE;
-  long deleted_insns_num = 0, deleted_branches_num = 0;
+  int res, w, sign_p, change_p = FALSE;
+  long deleted_insns_num = 0, deleted_branches_num = 0, changed_exts_num = 0;
 
 #ifndef NDEBUG
   for (bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb))
@@ -3193,129 +4391,1072 @@ static int ccp_modify (gen_ctx_t gen_ctx) {
         {
           int out_p;
 
-          MIR_insn_op_mode (ctx, bb_insn->insn, 0, &out_p); /* result here is always 0-th op */
-          gen_assert (out_p);
-        }
-#endif
-        /* remove edges whose def and use is the insn, e.g. for case "5: phi a,a #index 5,5" */
-        for (se = bb_insn->insn->ops[0].data; se != NULL; se = next_se) {
-          next_se = se->next_use;
-          if (se->use == bb_insn) remove_ssa_edge (gen_ctx, se);
-        }
-        insn = MIR_new_insn (ctx, MIR_MOV, bb_insn->insn->ops[0], op); /* copy ops[0].data too! */
-        MIR_insert_insn_before (ctx, curr_func_item, bb_insn->insn, insn);
-        bb_insn->insn->ops[0].data = NULL;
-        ccp_remove_insn_ssa_edges (gen_ctx, bb_insn->insn);
-        MIR_remove_insn (ctx, curr_func_item, bb_insn->insn);
-        insn->data = bb_insn;
-        bb_insn->insn = insn;
-        DEBUG (2, {
-          fprintf (debug_file, "    on insn ");
-          MIR_output_insn (ctx, debug_file, insn, curr_func_item->u.func, TRUE);
-        });
-      }
+          MIR_insn_op_mode (ctx, bb_insn->insn, 0, &out_p); /* result here is always 0-th op */
+          gen_assert (out_p);
+        }
+#endif
+        /* remove edges whose def and use is the insn, e.g. for case "5: phi a,a #index 5,5" */
+        for (se = bb_insn->insn->ops[0].data; se != NULL; se = next_se) {
+          next_se = se->next_use;
+          if (se->use == bb_insn) remove_ssa_edge (gen_ctx, se);
+        }
+        insn = MIR_new_insn (ctx, MIR_MOV, bb_insn->insn->ops[0], op); /* copy ops[0].data too! */
+        MIR_insert_insn_before (ctx, curr_func_item, bb_insn->insn, insn);
+        bb_insn->insn->ops[0].data = NULL;
+        ccp_remove_insn_ssa_edges (gen_ctx, bb_insn->insn);
+        MIR_remove_insn (ctx, curr_func_item, bb_insn->insn);
+        insn->data = bb_insn;
+        bb_insn->insn = insn;
+        DEBUG (2, {
+          fprintf (debug_file, "    on insn ");
+          MIR_output_insn (ctx, debug_file, insn, curr_func_item->u.func, TRUE);
+        });
+      } else if ((w = get_ext_params (bb_insn->insn->code, &sign_p)) != 0
+                 && ext_range_redundant_p (gen_ctx, bb_insn->insn, w, sign_p)) {
+        change_p = TRUE;
+        DEBUG (2, {
+          fprintf (debug_file, "  changing redundant extension ");
+          MIR_output_insn (gen_ctx->ctx, debug_file, bb_insn->insn, curr_func_item->u.func, TRUE);
+        });
+        bb_insn->insn->code = MIR_MOV;
+        changed_exts_num++;
+      }
+    }
+    if ((bb_insn = DLIST_TAIL (bb_insn_t, bb->bb_insns)) == NULL) continue;
+    insn = bb_insn->insn;
+    first_insn = DLIST_HEAD (bb_insn_t, bb->bb_insns)->insn;
+    if (first_insn->code == MIR_LABEL && (prev_insn = DLIST_PREV (MIR_insn_t, first_insn)) != NULL
+        && prev_insn->code == MIR_JMP && prev_insn->ops[0].u.label == first_insn) {
+      DEBUG (2, {
+        fprintf (debug_file, "  removing useless jump insn ");
+        MIR_output_insn (ctx, debug_file, prev_insn, curr_func_item->u.func, TRUE);
+        fprintf (debug_file, "\n");
+      });
+      ccp_remove_insn_ssa_edges (gen_ctx, prev_insn);
+      gen_delete_insn (gen_ctx, prev_insn);
+      deleted_branches_num++;
+    }
+    if (!MIR_branch_code_p (insn->code) || insn->code == MIR_JMP || insn->code == MIR_SWITCH
+        || ccp_branch_update (gen_ctx, insn, &res) != CCP_CONST)
+      continue;
+    change_p = TRUE;
+    if (!res) {
+      edge_t e;
+
+      DEBUG (2, {
+        fprintf (debug_file, "  removing branch insn ");
+        MIR_output_insn (ctx, debug_file, insn, curr_func_item->u.func, TRUE);
+        fprintf (debug_file, "\n");
+      });
+      ccp_remove_insn_ssa_edges (gen_ctx, insn);
+      gen_delete_insn (gen_ctx, insn);
+      if ((e = DLIST_EL (out_edge_t, bb->out_edges, 1)) != NULL)
+        delete_edge (e); /* e can be arleady deleted by previous removing an unreachable BB */
+      deleted_branches_num++;
+    } else {
+      insn = MIR_new_insn (ctx, MIR_JMP, insn->ops[0]); /* label is always 0-th op */
+      DEBUG (2, {
+        fprintf (debug_file, "  changing branch insn ");
+        MIR_output_insn (ctx, debug_file, bb_insn->insn, curr_func_item->u.func, FALSE);
+        fprintf (debug_file, " onto jump insn ");
+        MIR_output_insn (ctx, debug_file, insn, curr_func_item->u.func, TRUE);
+        fprintf (debug_file, "\n");
+      });
+      MIR_insert_insn_before (ctx, curr_func_item, bb_insn->insn, insn);
+      ccp_remove_insn_ssa_edges (gen_ctx, bb_insn->insn);
+      MIR_remove_insn (ctx, curr_func_item, bb_insn->insn);
+      insn->data = bb_insn;
+      bb_insn->insn = insn;
+      delete_edge (DLIST_EL (out_edge_t, bb->out_edges, 0));
+    }
+  }
+  DEBUG (1, {
+    fprintf (debug_file,
+             "%5ld deleted CCP insns + %ld deleted branches + %ld changed extensions\n",
+             deleted_insns_num, deleted_branches_num, changed_exts_num);
+  });
+  return change_p;
+}
+
+static int ccp (gen_ctx_t gen_ctx) { /* conditional constant propagation */
+  size_t pos = 0, pass = 0;
+  bb_t bb;
+
+  DEBUG (2, { fprintf (debug_file, "  CCP analysis:\n"); });
+  curr_ccp_run++;
+  bb_visited = temp_bitmap;
+  initiate_ccp_info (gen_ctx);
+  for (;;) {
+    /* Process BBs in reverse post order to see more defs before their uses: */
+    while ((bb = extract_bb_to_process (gen_ctx, &pos, &pass)) != NULL)
+      ccp_process_bb (gen_ctx, bb);
+    if (VARR_LENGTH (bb_insn_t, ccp_insns) == 0) break;
+    while (VARR_LENGTH (bb_insn_t, ccp_insns) != 0) {
+      bb_insn_t bb_insn = VARR_POP (bb_insn_t, ccp_insns);
+
+      gen_assert (bb_insn->flag);
+      bb_insn->flag = FALSE;
+      ccp_process_insn (gen_ctx, bb_insn);
+    }
+  }
+  DEBUG (2, { fprintf (debug_file, "  CCP modification:\n"); });
+  return ccp_modify (gen_ctx);
+}
+
+static void init_ccp (gen_ctx_t gen_ctx) {
+  gen_ctx->ccp_ctx = gen_malloc (gen_ctx, sizeof (struct ccp_ctx));
+  curr_ccp_run = 0;
+  VARR_CREATE (bb_insn_t, ccp_insns, 256);
+  VARR_CREATE (ccp_val_t, ccp_vals, 256);
+}
+
+static void finish_ccp (gen_ctx_t gen_ctx) {
+  ccp_val_t ccp_val;
+
+  VARR_DESTROY (bb_insn_t, ccp_insns);
+  while (VARR_LENGTH (ccp_val_t, ccp_vals) != 0)
+    if ((ccp_val = VARR_POP (ccp_val_t, ccp_vals)) != NULL) free (ccp_val);
+  VARR_DESTROY (ccp_val_t, ccp_vals);
+  free (gen_ctx->ccp_ctx);
+  gen_ctx->ccp_ctx = NULL;
+}
+
+#undef live_in
+#undef live_out
+
+/* New Page */
+
+/* Algebraic simplification on SSA.  It applies identities (e.g. x + 0, x * 1, x & -1, x - x),
+   changes multiplication and unsigned division by power of 2 into shifts, reassociates
+   constants in chains of the same operation, and removes double negations, compares of
+   compares, and redundant extensions.  The pass is run before GVN until there are no changes.
+   Insns whose results become unused are removed by the subsequent dead code elimination. */
+
+typedef struct alg_op {
+  MIR_op_t op;
+  bb_insn_t def; /* NULL for non-register operand */
+  int def_op_num;
+} alg_op_t;
+
+static int alg_const_op_p (gen_ctx_t gen_ctx, MIR_insn_t insn, int nop, int64_t *val) {
+  MIR_op_t *op_ref = &insn->ops[nop];
+  ssa_edge_t se;
+  MIR_insn_t def_insn;
+
+  if (op_ref->mode == MIR_OP_INT || op_ref->mode == MIR_OP_UINT) {
+    *val = op_ref->u.i;
+    return TRUE;
+  }
+  if (op_ref->mode != MIR_OP_REG || (se = op_ref->data) == NULL || se->def->bb->index == 0)
+    return FALSE;
+  def_insn = se->def->insn;
+  if (def_insn->code != MIR_MOV
+      || (def_insn->ops[1].mode != MIR_OP_INT && def_insn->ops[1].mode != MIR_OP_UINT))
+    return FALSE;
+  *val = def_insn->ops[1].u.i;
+  return TRUE;
+}
+
+/* Return insn defining NOP-th operand of INSN or NULL: */
+static MIR_insn_t alg_op_def_insn (MIR_insn_t insn, int nop) {
+  ssa_edge_t se;
+
+  if (insn->ops[nop].mode != MIR_OP_REG || (se = insn->ops[nop].data) == NULL
+      || se->def->bb->index == 0)
+    return NULL;
+  return se->def->insn;
+}
+
+static int alg_same_val_p (MIR_insn_t insn) {
+  ssa_edge_t se1 = insn->ops[1].data, se2 = insn->ops[2].data;
+
+  return (insn->ops[1].mode == MIR_OP_REG && insn->ops[2].mode == MIR_OP_REG && se1 != NULL
+          && se2 != NULL && se1->def == se2->def && se1->def_op_num == se2->def_op_num);
+}
+
+/* Return operand NOP of INSN which will be used in a new insn.  If FORWARD_P, the new insn is
+   not INSN and we can not use phi regs there to keep conventional SSA. */
+static int alg_get_op (gen_ctx_t gen_ctx, MIR_insn_t insn, int nop, int forward_p,
+                       alg_op_t *res) {
+  ssa_edge_t se = insn->ops[nop].data;
+
+  res->op = insn->ops[nop];
+  res->def = NULL;
+  res->def_op_num = 0;
+  if (insn->ops[nop].mode != MIR_OP_REG) return insn->ops[nop].mode != MIR_OP_MEM;
+  if (se == NULL || (forward_p && bitmap_bit_p (temp_bitmap2, insn->ops[nop].u.reg)))
+    return FALSE;
+  res->def = se->def;
+  res->def_op_num = se->def_op_num;
+  return TRUE;
+}
+
+static alg_op_t alg_new_const (gen_ctx_t gen_ctx, bb_insn_t bb_insn, int64_t val) {
+  MIR_context_t ctx = gen_ctx->ctx;
+  MIR_reg_t temp_reg = gen_new_temp_reg (gen_ctx, MIR_T_I64, curr_func_item->u.func);
+  MIR_insn_t new_insn = MIR_new_insn (ctx, MIR_MOV, MIR_new_reg_op (ctx, temp_reg),
+                                      MIR_new_int_op (ctx, val));
+  alg_op_t res;
+
+  gen_add_insn_before (gen_ctx, bb_insn->insn, new_insn);
+  res.op = new_insn->ops[0];
+  res.def = new_insn->data;
+  res.def_op_num = 0;
+  return res;
+}
+
+/* Change insn of BB_INSN onto insn with CODE, the same output, and input operands OPS[1..NOPS-1]
+   keeping SSA edges: */
+static void alg_change_insn (gen_ctx_t gen_ctx, bb_insn_t bb_insn, MIR_insn_code_t code,
+                             size_t nops, alg_op_t *ops) {
+  MIR_context_t ctx = gen_ctx->ctx;
+  MIR_insn_t new_insn, insn = bb_insn->insn;
+  MIR_op_t new_ops[3];
+
+  gen_assert (nops <= 3);
+  DEBUG (2, {
+    fprintf (debug_file, "  changing insn ");
+    MIR_output_insn (ctx, debug_file, insn, curr_func_item->u.func, FALSE);
+  });
+  new_ops[0] = insn->ops[0];
+  for (size_t i = 1; i < nops; i++) new_ops[i] = ops[i].op;
+  new_insn = MIR_new_insn_arr (ctx, code, nops, new_ops); /* copy ops[0].data too! */
+  for (size_t i = 1; i < nops; i++) new_insn->ops[i].data = NULL;
+  MIR_insert_insn_before (ctx, curr_func_item, insn, new_insn);
+  insn->ops[0].data = NULL;
+  ccp_remove_insn_ssa_edges (gen_ctx, insn);
+  MIR_remove_insn (ctx, curr_func_item, insn);
+  new_insn->data = bb_insn;
+  bb_insn->insn = new_insn;
+  for (size_t i = 1; i < nops; i++)
+    if (ops[i].def != NULL) add_ssa_edge (gen_ctx, ops[i].def, ops[i].def_op_num, bb_insn, i);
+  DEBUG (2, {
+    fprintf (debug_file, "    onto insn ");
+    MIR_output_insn (ctx, debug_file, new_insn, curr_func_item->u.func, TRUE);
+  });
+}
+
+static void alg_change_to_move (gen_ctx_t gen_ctx, bb_insn_t bb_insn, alg_op_t op) {
+  alg_op_t ops[2];
+
+  ops[1] = op;
+  alg_change_insn (gen_ctx, bb_insn, MIR_MOV, 2, ops);
+}
+
+static void alg_change_to_const (gen_ctx_t gen_ctx, bb_insn_t bb_insn, int64_t val) {
+  alg_op_t op;
+
+  op.op = MIR_new_int_op (gen_ctx->ctx, val);
+  op.def = NULL;
+  alg_change_to_move (gen_ctx, bb_insn, op);
+}
+
+static int alg_cmp_code_p (MIR_insn_code_t code) { return MIR_EQ <= code && code <= MIR_LDGE; }
+
+/* Return TRUE if CODE is a compare whose whole result is 0 or 1: */
+static int alg_bool_code_p (MIR_insn_code_t code) {
+  return (alg_cmp_code_p (code) && code != MIR_EQS && code != MIR_NES && code != MIR_LTS
+          && code != MIR_ULTS && code != MIR_LES && code != MIR_ULES && code != MIR_GTS
+          && code != MIR_UGTS && code != MIR_GES && code != MIR_UGES);
+}
+
+static MIR_insn_code_t alg_reverse_int_cmp_code (MIR_insn_code_t code) {
+  switch (code) {
+  case MIR_EQ: return MIR_NE;
+  case MIR_EQS: return MIR_NES;
+  case MIR_NE: return MIR_EQ;
+  case MIR_NES: return MIR_EQS;
+  case MIR_LT: return MIR_GE;
+  case MIR_LTS: return MIR_GES;
+  case MIR_ULT: return MIR_UGE;
+  case MIR_ULTS: return MIR_UGES;
+  case MIR_LE: return MIR_GT;
+  case MIR_LES: return MIR_GTS;
+  case MIR_ULE: return MIR_UGT;
+  case MIR_ULES: return MIR_UGTS;
+  case MIR_GT: return MIR_LE;
+  case MIR_GTS: return MIR_LES;
+  case MIR_UGT: return MIR_ULE;
+  case MIR_UGTS: return MIR_ULES;
+  case MIR_GE: return MIR_LT;
+  case MIR_GES: return MIR_LTS;
+  case MIR_UGE: return MIR_ULT;
+  case MIR_UGES: return MIR_ULTS;
+  default: return MIR_INSN_BOUND;
+  }
+}
+
+/* Return TRUE if the value defined by DEF_INSN does not change after extension with width W and
+   sign SIGN_P. */
+static int alg_redundant_ext_p (MIR_insn_t def_insn, int w, int sign_p) {
+  int w2, sign2_p;
+  MIR_type_t type;
+  int64_t mask;
+
+  if (alg_bool_code_p (def_insn->code)) return TRUE; /* 0 or 1 */
+  if ((w2 = get_ext_params (def_insn->code, &sign2_p)) != 0)
+    return sign_p == sign2_p ? w2 <= w : !sign_p ? FALSE : w2 < w;
+  if (def_insn->code == MIR_AND && def_insn->ops[2].mode == MIR_OP_REG) {
+    MIR_insn_t mask_insn = alg_op_def_insn (def_insn, 2);
+
+    if (mask_insn == NULL || mask_insn->code != MIR_MOV
+        || (mask_insn->ops[1].mode != MIR_OP_INT && mask_insn->ops[1].mode != MIR_OP_UINT))
+      return FALSE;
+    mask = mask_insn->ops[1].u.i;
+    return mask >= 0 && (w == 64 || (uint64_t) mask < ((uint64_t) 1 << (sign_p ? w - 1 : w)));
+  }
+  if (def_insn->code == MIR_MOV && def_insn->ops[1].mode == MIR_OP_MEM) {
+    type = def_insn->ops[1].u.mem.type;
+    switch (type) {
+    case MIR_T_I8: return sign_p && w >= 8;
+    case MIR_T_U8: return sign_p ? w > 8 : w >= 8;
+    case MIR_T_I16: return sign_p && w >= 16;
+    case MIR_T_U16: return sign_p ? w > 16 : w >= 16;
+    case MIR_T_I32: return sign_p && w >= 32;
+    case MIR_T_U32: return sign_p ? w > 32 : w >= 32;
+    default: return FALSE;
+    }
+  }
+  return FALSE;
+}
+
+static int alg_pow2_p (uint64_t v, int *k) {
+  if (v == 0 || (v & (v - 1)) != 0) return FALSE;
+  for (*k = 0; (v >>= 1) != 0; (*k)++)
+    ;
+  return TRUE;
+}
+
+static int alg_simplify_insn (gen_ctx_t gen_ctx, bb_insn_t bb_insn) {
+  MIR_insn_t def_insn, insn = bb_insn->insn;
+  MIR_insn_code_t code = insn->code, new_code;
+  alg_op_t ops[3];
+  int64_t c, c1, c2;
+  int w, sign_p, k, s_p, commut_p, c1_p, c2_p, x_nop;
+
+  if (insn->nops < 2 || insn->ops[0].mode != MIR_OP_REG) return FALSE;
+  if ((w = get_ext_params (code, &sign_p)) != 0) {
+    if ((def_insn = alg_op_def_insn (insn, 1)) == NULL
+        || !alg_redundant_ext_p (def_insn, w, sign_p))
+      return FALSE;
+    alg_get_op (gen_ctx, insn, 1, FALSE, &ops[1]);
+    alg_change_to_move (gen_ctx, bb_insn, ops[1]);
+    return TRUE;
+  }
+  if (code == MIR_NEG || code == MIR_NEGS) { /* -(-x) => x: */
+    if ((def_insn = alg_op_def_insn (insn, 1)) == NULL || def_insn->code != code
+        || !alg_get_op (gen_ctx, def_insn, 1, TRUE, &ops[1]))
+      return FALSE;
+    alg_change_to_move (gen_ctx, bb_insn, ops[1]);
+    return TRUE;
+  }
+  if (insn->nops != 3) return FALSE;
+  switch (code) {
+  case MIR_ADDS:
+  case MIR_SUBS:
+  case MIR_MULS:
+  case MIR_DIVS:
+  case MIR_UDIVS:
+  case MIR_MODS:
+  case MIR_UMODS:
+  case MIR_ANDS:
+  case MIR_ORS:
+  case MIR_XORS:
+  case MIR_LSHS:
+  case MIR_RSHS:
+  case MIR_URSHS:
+  case MIR_EQS:
+  case MIR_NES: s_p = TRUE; break;
+  case MIR_ADD:
+  case MIR_SUB:
+  case MIR_MUL:
+  case MIR_DIV:
+  case MIR_UDIV:
+  case MIR_MOD:
+  case MIR_UMOD:
+  case MIR_AND:
+  case MIR_OR:
+  case MIR_XOR:
+  case MIR_LSH:
+  case MIR_RSH:
+  case MIR_URSH:
+  case MIR_EQ:
+  case MIR_NE: s_p = FALSE; break;
+  default:
+    if (alg_cmp_code_p (code) && alg_reverse_int_cmp_code (code) != MIR_INSN_BOUND
+        && alg_same_val_p (insn)) { /* x cmp x: */
+      alg_change_to_const (gen_ctx, bb_insn,
+                           code == MIR_LE || code == MIR_LES || code == MIR_ULE
+                             || code == MIR_ULES || code == MIR_GE || code == MIR_GES
+                             || code == MIR_UGE || code == MIR_UGES);
+      return TRUE;
+    }
+    return FALSE;
+  }
+  commut_p = (code == MIR_ADD || code == MIR_ADDS || code == MIR_MUL || code == MIR_MULS
+              || code == MIR_AND || code == MIR_ANDS || code == MIR_OR || code == MIR_ORS
+              || code == MIR_XOR || code == MIR_XORS || code == MIR_EQ || code == MIR_EQS
+              || code == MIR_NE || code == MIR_NES);
+  c1_p = alg_const_op_p (gen_ctx, insn, 1, &c1);
+  c2_p = alg_const_op_p (gen_ctx, insn, 2, &c2);
+  if (c1_p && c2_p) return FALSE; /* it is a job of CCP */
+  x_nop = 1;
+  if (c1_p && commut_p) {
+    x_nop = 2;
+    c2 = c1;
+    c2_p = TRUE;
+  }
+  if (s_p) c2 = (int32_t) c2;
+  if (alg_same_val_p (insn)) {
+    if (code == MIR_SUB || code == MIR_SUBS || code == MIR_XOR || code == MIR_XORS
+        || code == MIR_NE || code == MIR_NES) {
+      alg_change_to_const (gen_ctx, bb_insn, 0);
+    } else if (code == MIR_EQ || code == MIR_EQS) {
+      alg_change_to_const (gen_ctx, bb_insn, 1);
+    } else if (code == MIR_AND || code == MIR_ANDS || code == MIR_OR || code == MIR_ORS) {
+      alg_get_op (gen_ctx, insn, 1, FALSE, &ops[1]);
+      alg_change_to_move (gen_ctx, bb_insn, ops[1]);
+    } else {
+      return FALSE;
+    }
+    return TRUE;
+  }
+  if (!c2_p) return FALSE;
+  switch (code) {
+  case MIR_ADD:
+  case MIR_ADDS:
+  case MIR_SUB:
+  case MIR_SUBS:
+  case MIR_OR:
+  case MIR_ORS:
+  case MIR_XOR:
+  case MIR_XORS:
+  case MIR_LSH:
+  case MIR_LSHS:
+  case MIR_RSH:
+  case MIR_RSHS:
+  case MIR_URSH:
+  case MIR_URSHS:
+    if (c2 == 0) goto move_x; /* x op 0 => x */
+    if ((code == MIR_OR || code == MIR_ORS) && c2 == -1) goto const_res;
+    break;
+  case MIR_MUL:
+  case MIR_MULS:
+    if (c2 == 1) goto move_x;
+    if (c2 == 0) goto const_res;
+    if (alg_pow2_p ((uint64_t) c2, &k)) { /* x * 2^k => x << k: */
+      new_code = code == MIR_MUL ? MIR_LSH : MIR_LSHS;
+      c = k;
+      goto change_op;
+    }
+    break;
+  case MIR_DIV:
+  case MIR_DIVS:
+  case MIR_UDIV:
+  case MIR_UDIVS:
+    if (c2 == 1) goto move_x;
+    if ((code == MIR_UDIV || code == MIR_UDIVS)
+        && alg_pow2_p (code == MIR_UDIV ? (uint64_t) c2 : (uint32_t) c2, &k)) {
+      new_code = code == MIR_UDIV ? MIR_URSH : MIR_URSHS; /* x / 2^k => x >> k: */
+      c = k;
+      goto change_op;
+    }
+    break;
+  case MIR_MOD:
+  case MIR_MODS:
+  case MIR_UMOD:
+  case MIR_UMODS:
+    if (c2 == 1 || (c2 == -1 && (code == MIR_MOD || code == MIR_MODS))) {
+      c2 = 0;
+      goto const_res;
+    }
+    if ((code == MIR_UMOD || code == MIR_UMODS)
+        && alg_pow2_p (code == MIR_UMOD ? (uint64_t) c2 : (uint32_t) c2, &k)) {
+      new_code = code == MIR_UMOD ? MIR_AND : MIR_ANDS; /* x % 2^k => x & (2^k - 1): */
+      c = (int64_t) (((uint64_t) 1 << k) - 1);
+      goto change_op;
+    }
+    break;
+  case MIR_AND:
+  case MIR_ANDS:
+    if (c2 == -1) goto move_x;
+    if (c2 == 0) goto const_res;
+    break;
+  case MIR_EQ:
+  case MIR_EQS:
+  case MIR_NE:
+  case MIR_NES:
+    /* Compare of compare: (x cmp y) != 0 or (x cmp y) == 1 => x cmp y,
+       (x cmp y) == 0 => x reverse_cmp y for integer compares: */
+    if ((c2 != 0 && c2 != 1) || (def_insn = alg_op_def_insn (insn, x_nop)) == NULL
+        || !alg_bool_code_p (def_insn->code))
+      return FALSE;
+    if ((c2 == 0) == (code == MIR_NE || code == MIR_NES)) goto move_x;
+    if (c2 != 0 || (new_code = alg_reverse_int_cmp_code (def_insn->code)) == MIR_INSN_BOUND
+        || !alg_get_op (gen_ctx, def_insn, 1, TRUE, &ops[1])
+        || !alg_get_op (gen_ctx, def_insn, 2, TRUE, &ops[2]))
+      return FALSE;
+    alg_change_insn (gen_ctx, bb_insn, new_code, 3, ops);
+    return TRUE;
+  default: gen_assert (FALSE);
+  }
+  /* Reassociation: (y op c1) op c2 => y op (c1 op c2): */
+  if ((def_insn = alg_op_def_insn (insn, x_nop)) == NULL) return FALSE;
+  new_code = def_insn->code;
+  if ((code == MIR_ADD || code == MIR_SUB) && (new_code == MIR_ADD || new_code == MIR_SUB)) {
+    new_code = MIR_ADD;
+  } else if ((code == MIR_ADDS || code == MIR_SUBS)
+             && (new_code == MIR_ADDS || new_code == MIR_SUBS)) {
+    new_code = MIR_ADDS;
+  } else if (code != new_code
+             || (code != MIR_MUL && code != MIR_MULS && code != MIR_AND && code != MIR_ANDS
+                 && code != MIR_OR && code != MIR_ORS && code != MIR_XOR && code != MIR_XORS
+                 && code != MIR_LSH && code != MIR_URSH)) {
+    return FALSE;
+  }
+  if (alg_const_op_p (gen_ctx, def_insn, 2, &c1)) {
+    k = 1;
+  } else if ((new_code == MIR_LSH || new_code == MIR_URSH || def_insn->code == MIR_SUB
+              || def_insn->code == MIR_SUBS)
+             || !alg_const_op_p (gen_ctx, def_insn, 1, &c1)) {
+    return FALSE;
+  } else {
+    k = 2;
+  }
+  if (!alg_get_op (gen_ctx, def_insn, k, TRUE, &ops[1])) return FALSE;
+  if (def_insn->code == MIR_SUB || def_insn->code == MIR_SUBS) c1 = -(uint64_t) c1;
+  if (code == MIR_SUB || code == MIR_SUBS) c2 = -(uint64_t) c2;
+  switch (new_code) {
+  case MIR_ADD:
+  case MIR_ADDS: c = (uint64_t) c1 + (uint64_t) c2; break;
+  case MIR_MUL:
+  case MIR_MULS: c = (uint64_t) c1 * (uint64_t) c2; break;
+  case MIR_AND:
+  case MIR_ANDS: c = c1 & c2; break;
+  case MIR_OR:
+  case MIR_ORS: c = c1 | c2; break;
+  case MIR_XOR:
+  case MIR_XORS: c = c1 ^ c2; break;
+  case MIR_LSH:
+  case MIR_URSH:
+    if ((uint64_t) c1 >= 64 || (uint64_t) c2 >= 64) return FALSE;
+    if ((c = c1 + c2) >= 64) { /* all bits are shifted out: */
+      c2 = 0;
+      goto const_res;
+    }
+    break;
+  default: gen_assert (FALSE);
+  }
+  ops[2] = alg_new_const (gen_ctx, bb_insn, c);
+  alg_change_insn (gen_ctx, bb_insn, new_code, 3, ops);
+  return TRUE;
+move_x:
+  alg_get_op (gen_ctx, insn, x_nop, FALSE, &ops[1]);
+  alg_change_to_move (gen_ctx, bb_insn, ops[1]);
+  return TRUE;
+const_res:
+  alg_change_to_const (gen_ctx, bb_insn, c2);
+  return TRUE;
+change_op:
+  alg_get_op (gen_ctx, insn, x_nop, FALSE, &ops[1]);
+  ops[2] = alg_new_const (gen_ctx, bb_insn, c);
+  alg_change_insn (gen_ctx, bb_insn, new_code, 3, ops);
+  return TRUE;
+}
+
+static void algebraic_simplification (gen_ctx_t gen_ctx) {
+  bb_insn_t bb_insn;
+  int change_p;
+  long simplified_insns_num = 0;
+
+  bitmap_clear (temp_bitmap2); /* phi regs */
+  for (bb_t bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb))
+    for (bb_insn = DLIST_HEAD (bb_insn_t, bb->bb_insns); bb_insn != NULL;
+         bb_insn = DLIST_NEXT (bb_insn_t, bb_insn)) {
+      if (bb_insn->insn->code == MIR_LABEL) continue;
+      if (bb_insn->insn->code != MIR_PHI) break;
+      bitmap_set_bit_p (temp_bitmap2, bb_insn->insn->ops[0].u.reg);
+    }
+  do {
+    change_p = FALSE;
+    for (bb_t bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb))
+      for (bb_insn = DLIST_HEAD (bb_insn_t, bb->bb_insns); bb_insn != NULL;
+           bb_insn = DLIST_NEXT (bb_insn_t, bb_insn))
+        if (alg_simplify_insn (gen_ctx, bb_insn)) {
+          change_p = TRUE;
+          simplified_insns_num++;
+        }
+  } while (change_p);
+  DEBUG (1, {
+    fprintf (debug_file, "%5ld algebraically simplified insns\n", simplified_insns_num);
+  });
+}
+
+/* New Page */
+
+/* Extension elimination on SSA.  For each integer value we find how many low bits of the value
+   define it: sext_w (zext_w) is the minimal width W such that the value is equal to the sign
+   (zero) extension of its low W bits.  The widths are propagated forward through SSA edges
+   optimistically until the fixed point.  After that, extensions whose operand widths make them
+   no-ops are changed into moves.  Results of 32-bit (S) insns have undefined upper bits, so we
+   know nothing about them.  */
+
+typedef struct ext_info {
+  uint8_t sext_w, zext_w; /* 0 for not processed yet, 64 for unknown */
+} ext_info_t;
+
+DEF_VARR (ext_info_t);
+
+struct ext_ctx {
+  VARR (ext_info_t) * ext_infos;
+  VARR (bb_insn_t) * ext_worklist;
+  bitmap_t ext_insns_in_worklist;
+};
+
+#define ext_infos gen_ctx->ext_ctx->ext_infos
+#define ext_worklist gen_ctx->ext_ctx->ext_worklist
+#define ext_insns_in_worklist gen_ctx->ext_ctx->ext_insns_in_worklist
+
+static ext_info_t ext_unknown_info (void) {
+  ext_info_t info;
+
+  info.sext_w = info.zext_w = 64;
+  return info;
+}
+
+static ext_info_t ext_const_info (int64_t val) {
+  ext_info_t info;
+  int w;
+
+  for (w = 1; w < 64 && (uint64_t) val >= ((uint64_t) 1 << w); w++)
+    ;
+  info.zext_w = w;
+  for (w = 1; w < 64; w++)
+    if (val >= -((int64_t) 1 << (w - 1)) && val < ((int64_t) 1 << (w - 1))) break;
+  info.sext_w = w;
+  return info;
+}
+
+static ext_info_t ext_make_info (int sext_w, int zext_w) {
+  ext_info_t info;
+
+  if (zext_w < 64 && sext_w > zext_w + 1) sext_w = zext_w + 1;
+  info.sext_w = sext_w <= 1 ? 1 : sext_w >= 64 ? 64 : sext_w;
+  info.zext_w = zext_w <= 1 ? 1 : zext_w >= 64 ? 64 : zext_w;
+  return info;
+}
+
+static ext_info_t get_ext_info (gen_ctx_t gen_ctx, bb_insn_t bb_insn) {
+  while (VARR_LENGTH (ext_info_t, ext_infos) <= bb_insn->index) {
+    ext_info_t info = {0, 0};
+
+    VARR_PUSH (ext_info_t, ext_infos, info);
+  }
+  return VARR_GET (ext_info_t, ext_infos, bb_insn->index);
+}
+
+/* Return info of NOP-th input operand of INSN.  The result can be not processed yet. */
+static ext_info_t get_ext_op_info (gen_ctx_t gen_ctx, MIR_insn_t insn, int nop) {
+  MIR_op_t *op_ref = &insn->ops[nop];
+  ssa_edge_t se;
+
+  if (op_ref->mode == MIR_OP_INT || op_ref->mode == MIR_OP_UINT)
+    return ext_const_info (op_ref->u.i);
+  if (op_ref->mode != MIR_OP_REG || (se = op_ref->data) == NULL || se->def->bb->index == 0
+      || se->def_op_num != 0)
+    return ext_unknown_info ();
+  return get_ext_info (gen_ctx, se->def);
+}
+
+static int ext_max (int w1, int w2) { return w1 < w2 ? w2 : w1; }
+static int ext_min (int w1, int w2) { return w1 < w2 ? w1 : w2; }
+
+/* Return TRUE if extension with width W and sign SIGN_P of value with INFO is a no-op: */
+static int ext_redundant_p (ext_info_t info, int w, int sign_p) {
+  if (info.sext_w == 0) return FALSE;
+  return sign_p ? info.sext_w <= w || info.zext_w < w : info.zext_w <= w;
+}
+
+static ext_info_t ext_process_insn (gen_ctx_t gen_ctx, bb_insn_t bb_insn) {
+  MIR_insn_t insn = bb_insn->insn;
+  MIR_insn_code_t code = insn->code;
+  ext_info_t info, info1, info2;
+  int64_t c;
+  int w, sign_p;
+
+  if (code == MIR_PHI) {
+    info.sext_w = info.zext_w = 0;
+    for (size_t i = 1; i < insn->nops; i++) {
+      info1 = get_ext_op_info (gen_ctx, insn, i);
+      info.sext_w = ext_max (info.sext_w, info1.sext_w);
+      info.zext_w = ext_max (info.zext_w, info1.zext_w);
     }
-    if ((bb_insn = DLIST_TAIL (bb_insn_t, bb->bb_insns)) == NULL) continue;
-    insn = bb_insn->insn;
-    first_insn = DLIST_HEAD (bb_insn_t, bb->bb_insns)->insn;
-    if (first_insn->code == MIR_LABEL && (prev_insn = DLIST_PREV (MIR_insn_t, first_insn)) != NULL
-        && prev_insn->code == MIR_JMP && prev_insn->ops[0].u.label == first_insn) {
-      DEBUG (2, {
-        fprintf (debug_file, "  removing useless jump insn ");
-        MIR_output_insn (ctx, debug_file, prev_insn, curr_func_item->u.func, TRUE);
-        fprintf (debug_file, "\n");
-      });
-      ccp_remove_insn_ssa_edges (gen_ctx, prev_insn);
-      gen_delete_insn (gen_ctx, prev_insn);
-      deleted_branches_num++;
+    return info;
+  }
+  if (code == MIR_MOV) {
+    if (insn->ops[1].mode != MIR_OP_MEM) return get_ext_op_info (gen_ctx, insn, 1);
+    switch (insn->ops[1].u.mem.type) {
+    case MIR_T_I8: return ext_make_info (8, 64);
+    case MIR_T_U8: return ext_make_info (9, 8);
+    case MIR_T_I16: return ext_make_info (16, 64);
+    case MIR_T_U16: return ext_make_info (17, 16);
+    case MIR_T_I32: return ext_make_info (32, 64);
+    case MIR_T_U32: return ext_make_info (33, 32);
+    default: return ext_unknown_info ();
     }
-    if (!MIR_branch_code_p (insn->code) || insn->code == MIR_JMP || insn->code == MIR_SWITCH
-        || ccp_branch_update (gen_ctx, insn, &res) != CCP_CONST)
-      continue;
-    change_p = TRUE;
-    if (!res) {
-      edge_t e;
-
+  }
+  if (alg_bool_code_p (code)) return ext_make_info (2, 1);
+  if (insn->nops < 2) return ext_unknown_info ();
+  info1 = get_ext_op_info (gen_ctx, insn, 1);
+  if (info1.sext_w == 0) return info1;
+  if ((w = get_ext_params (code, &sign_p)) != 0) {
+    if (ext_redundant_p (info1, w, sign_p)) return info1;
+    return sign_p ? ext_make_info (w, 64) : ext_make_info (w + 1, w);
+  }
+  if (code == MIR_NEG) return ext_make_info (info1.sext_w + 1, 64);
+  if (insn->nops < 3) return ext_unknown_info ();
+  info2 = get_ext_op_info (gen_ctx, insn, 2);
+  if (info2.sext_w == 0) return info2;
+  switch (code) {
+  case MIR_AND:
+    return ext_make_info (ext_max (info1.sext_w, info2.sext_w),
+                          ext_min (info1.zext_w, info2.zext_w));
+  case MIR_OR:
+  case MIR_XOR:
+    return ext_make_info (ext_max (info1.sext_w, info2.sext_w),
+                          ext_max (info1.zext_w, info2.zext_w));
+  case MIR_ADD:
+    return ext_make_info (ext_max (info1.sext_w, info2.sext_w) + 1,
+                          ext_max (info1.zext_w, info2.zext_w) + 1);
+  case MIR_SUB: return ext_make_info (ext_max (info1.sext_w, info2.sext_w) + 1, 64);
+  case MIR_MUL:
+    return ext_make_info (info1.sext_w + info2.sext_w, info1.zext_w + info2.zext_w);
+  case MIR_UDIV: return ext_make_info (64, info1.zext_w);
+  case MIR_UMOD: return ext_make_info (64, ext_min (info1.zext_w, info2.zext_w));
+  case MIR_DIV:
+    return ext_make_info (info1.sext_w + 1,
+                          info1.zext_w < 64 && info2.zext_w < 64 ? info1.zext_w : 64);
+  case MIR_MOD:
+    return ext_make_info (ext_min (info1.sext_w, info2.sext_w),
+                          info1.zext_w < 64 ? ext_min (info1.zext_w, info2.zext_w) : 64);
+  case MIR_LSH:
+  case MIR_RSH:
+  case MIR_URSH:
+    if (!alg_const_op_p (gen_ctx, insn, 2, &c) || (uint64_t) c >= 64) return ext_unknown_info ();
+    if (c == 0) return info1;
+    if (code == MIR_LSH) return ext_make_info (info1.sext_w + c, info1.zext_w + c);
+    if (code == MIR_URSH) return ext_make_info (64, info1.zext_w - c);
+    return ext_make_info (info1.sext_w - c, info1.zext_w < 64 ? info1.zext_w - c : 64);
+  default: return ext_unknown_info ();
+  }
+}
+
+static void ext_add_to_worklist (gen_ctx_t gen_ctx, bb_insn_t bb_insn) {
+  if (!bitmap_set_bit_p (ext_insns_in_worklist, bb_insn->index)) return;
+  VARR_PUSH (bb_insn_t, ext_worklist, bb_insn);
+}
+
+static void ext_elimination (gen_ctx_t gen_ctx) {
+  MIR_context_t ctx = gen_ctx->ctx;
+  MIR_insn_t insn;
+  bb_insn_t bb_insn;
+  ssa_edge_t se;
+  ext_info_t info, old_info;
+  int w, sign_p;
+  long changed_insns_num = 0;
+
+  VARR_TRUNC (ext_info_t, ext_infos, 0);
+  VARR_TRUNC (bb_insn_t, ext_worklist, 0);
+  bitmap_clear (ext_insns_in_worklist);
+  /* Push insns in reverse order to process definitions mostly before their uses: */
+  for (bb_t bb = DLIST_TAIL (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_PREV (bb_t, bb))
+    for (bb_insn = DLIST_TAIL (bb_insn_t, bb->bb_insns); bb_insn != NULL;
+         bb_insn = DLIST_PREV (bb_insn_t, bb_insn)) {
+      insn = bb_insn->insn;
+      if (insn->nops > 0 && insn->ops[0].mode == MIR_OP_REG && !MIR_call_code_p (insn->code))
+        ext_add_to_worklist (gen_ctx, bb_insn);
+    }
+  while (VARR_LENGTH (bb_insn_t, ext_worklist) != 0) {
+    bb_insn = VARR_POP (bb_insn_t, ext_worklist);
+    bitmap_clear_bit_p (ext_insns_in_worklist, bb_insn->index);
+    info = ext_process_insn (gen_ctx, bb_insn);
+    old_info = get_ext_info (gen_ctx, bb_insn);
+    /* Keep the widths monotonic to guarantee the termination: */
+    info.sext_w = ext_max (info.sext_w, old_info.sext_w);
+    info.zext_w = ext_max (info.zext_w, old_info.zext_w);
+    if (info.sext_w == old_info.sext_w && info.zext_w == old_info.zext_w) continue;
+    VARR_SET (ext_info_t, ext_infos, bb_insn->index, info);
+    for (se = bb_insn->insn->ops[0].data; se != NULL; se = se->next_use)
+      if (se->use->insn->nops > 0 && se->use->insn->ops[0].mode == MIR_OP_REG
+          && !MIR_call_code_p (se->use->insn->code))
+        ext_add_to_worklist (gen_ctx, se->use);
+  }
+  for (bb_t bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb))
+    for (bb_insn = DLIST_HEAD (bb_insn_t, bb->bb_insns); bb_insn != NULL;
+         bb_insn = DLIST_NEXT (bb_insn_t, bb_insn)) {
+      insn = bb_insn->insn;
+      if ((w = get_ext_params (insn->code, &sign_p)) == 0 || insn->ops[1].mode != MIR_OP_REG
+          || !ext_redundant_p (get_ext_op_info (gen_ctx, insn, 1), w, sign_p))
+        continue;
       DEBUG (2, {
-        fprintf (debug_file, "  removing branch insn ");
-        MIR_output_insn (ctx, debug_file, insn, curr_func_item->u.func, TRUE);
-        fprintf (debug_file, "\n");
+        fprintf (debug_file, "  Change code of insn %lu: before", (unsigned long) bb_insn->index);
+        MIR_output_insn (ctx, debug_file, insn, curr_func_item->u.func, FALSE);
       });
-      ccp_remove_insn_ssa_edges (gen_ctx, insn);
-      gen_delete_insn (gen_ctx, insn);
-      if ((e = DLIST_EL (out_edge_t, bb->out_edges, 1)) != NULL)
-        delete_edge (e); /* e can be arleady deleted by previous removing an unreachable BB */
-      deleted_branches_num++;
-    } else {
-      insn = MIR_new_insn (ctx, MIR_JMP, insn->ops[0]); /* label is always 0-th op */
+      insn->code = MIR_MOV;
+      changed_insns_num++;
       DEBUG (2, {
-        fprintf (debug_file, "  changing branch insn ");
-        MIR_output_insn (ctx, debug_file, bb_insn->insn, curr_func_item->u.func, FALSE);
-        fprintf (debug_file, " onto jump insn ");
+        fprintf (debug_file, "    after");
         MIR_output_insn (ctx, debug_file, insn, curr_func_item->u.func, TRUE);
-        fprintf (debug_file, "\n");
       });
-      MIR_insert_insn_before (ctx, curr_func_item, bb_insn->insn, insn);
-      ccp_remove_insn_ssa_edges (gen_ctx, bb_insn->insn);
-      MIR_remove_insn (ctx, curr_func_item, bb_insn->insn);
-      insn->data = bb_insn;
-      bb_insn->insn = insn;
-      delete_edge (DLIST_EL (out_edge_t, bb->out_edges, 0));
     }
-  }
-  DEBUG (1, {
-    fprintf (debug_file, "%5ld deleted CCP insns + %ld deleted branches\n", deleted_insns_num,
-             deleted_branches_num);
-  });
-  return change_p;
+  DEBUG (1, { fprintf (debug_file, "%5ld removed extension insns\n", changed_insns_num); });
 }
 
-static int ccp (gen_ctx_t gen_ctx) { /* conditional constant propagation */
-  DEBUG (2, { fprintf (debug_file, "  CCP analysis:\n"); });
-  curr_ccp_run++;
-  bb_visited = temp_bitmap;
-  initiate_ccp_info (gen_ctx);
-  while (VARR_LENGTH (bb_t, ccp_bbs) != 0 || VARR_LENGTH (bb_insn_t, ccp_insns) != 0) {
-    while (VARR_LENGTH (bb_t, ccp_bbs) != 0) {
-      bb_t bb = VARR_POP (bb_t, ccp_bbs);
+static void init_ext (gen_ctx_t gen_ctx) {
+  gen_ctx->ext_ctx = gen_malloc (gen_ctx, sizeof (struct ext_ctx));
+  VARR_CREATE (ext_info_t, ext_infos, 256);
+  VARR_CREATE (bb_insn_t, ext_worklist, 256);
+  ext_insns_in_worklist = bitmap_create2 (256);
+}
 
-      bb->flag = FALSE;
-      ccp_process_bb (gen_ctx, bb);
-    }
-    while (VARR_LENGTH (bb_insn_t, ccp_insns) != 0) {
-      bb_insn_t bb_insn = VARR_POP (bb_insn_t, ccp_insns);
+static void finish_ext (gen_ctx_t gen_ctx) {
+  VARR_DESTROY (ext_info_t, ext_infos);
+  VARR_DESTROY (bb_insn_t, ext_worklist);
+  bitmap_destroy (ext_insns_in_worklist);
+  free (gen_ctx->ext_ctx);
+  gen_ctx->ext_ctx = NULL;
+}
 
-      gen_assert (bb_insn->flag);
-      bb_insn->flag = FALSE;
-      ccp_process_insn (gen_ctx, bb_insn);
+/* New Page */
+
+/* Strength reduction of integer division and modulo by constants (Granlund-Montgomery): the
+   division is changed by multiplication on a magic number and shifts.  The divisor constant is
+   found by looking for the divisor reg definition in the same BB.  We generate only generic MIR
+   insns.  There is no multiply-high insn in MIR, so for 64-bit operations the high part of the
+   product is calculated from 32-bit parts of the operands.  */
+
+static MIR_op_t new_div_temp_op (gen_ctx_t gen_ctx) {
+  MIR_reg_t reg = gen_new_temp_reg (gen_ctx, MIR_T_I64, curr_func_item->u.func);
+
+  return MIR_new_reg_op (gen_ctx->ctx, reg);
+}
+
+static MIR_op_t div_insn (gen_ctx_t gen_ctx, MIR_insn_t before, MIR_insn_code_t code, MIR_op_t op1,
+                          MIR_op_t op2) {
+  MIR_op_t res = new_div_temp_op (gen_ctx);
+
+  gen_add_insn_before (gen_ctx, before, MIR_new_insn (gen_ctx->ctx, code, res, op1, op2));
+  return res;
+}
+
+static MIR_op_t div_unary_insn (gen_ctx_t gen_ctx, MIR_insn_t before, MIR_insn_code_t code,
+                                MIR_op_t op) {
+  MIR_op_t res = new_div_temp_op (gen_ctx);
+
+  gen_add_insn_before (gen_ctx, before, MIR_new_insn (gen_ctx->ctx, code, res, op));
+  return res;
+}
+
+static MIR_op_t div_const (gen_ctx_t gen_ctx, MIR_insn_t before, int64_t val) {
+  return div_unary_insn (gen_ctx, before, MIR_MOV, MIR_new_int_op (gen_ctx->ctx, val));
+}
+
+static MIR_op_t div_const_insn (gen_ctx_t gen_ctx, MIR_insn_t before, MIR_insn_code_t code,
+                                MIR_op_t op, int64_t val) {
+  return div_insn (gen_ctx, before, code, op, div_const (gen_ctx, before, val));
+}
+
+/* Return high 64 bits of unsigned product OP * M: */
+static MIR_op_t div_umulh (gen_ctx_t gen_ctx, MIR_insn_t before, MIR_op_t op, uint64_t m) {
+  MIR_op_t op_lo, op_hi, m_lo, m_hi, t, w, w_lo, w_hi, x, res;
+
+  op_lo = div_unary_insn (gen_ctx, before, MIR_UEXT32, op);
+  op_hi = div_const_insn (gen_ctx, before, MIR_URSH, op, 32);
+  m_lo = div_const (gen_ctx, before, (int64_t) (m & 0xffffffff));
+  m_hi = div_const (gen_ctx, before, (int64_t) (m >> 32));
+  t = div_insn (gen_ctx, before, MIR_MUL, op_lo, m_lo);
+  t = div_const_insn (gen_ctx, before, MIR_URSH, t, 32);
+  w = div_insn (gen_ctx, before, MIR_MUL, op_hi, m_lo);
+  w = div_insn (gen_ctx, before, MIR_ADD, w, t);
+  w_lo = div_unary_insn (gen_ctx, before, MIR_UEXT32, w);
+  w_hi = div_const_insn (gen_ctx, before, MIR_URSH, w, 32);
+  x = div_insn (gen_ctx, before, MIR_MUL, op_lo, m_hi);
+  x = div_insn (gen_ctx, before, MIR_ADD, x, w_lo);
+  x = div_const_insn (gen_ctx, before, MIR_URSH, x, 32);
+  res = div_insn (gen_ctx, before, MIR_MUL, op_hi, m_hi);
+  res = div_insn (gen_ctx, before, MIR_ADD, res, w_hi);
+  return div_insn (gen_ctx, before, MIR_ADD, res, x);
+}
+
+/* Return high 64 bits of signed product OP * M: */
+static MIR_op_t div_mulh (gen_ctx_t gen_ctx, MIR_insn_t before, MIR_op_t op, int64_t m) {
+  MIR_op_t res = div_umulh (gen_ctx, before, op, (uint64_t) m), t;
+
+  t = div_const_insn (gen_ctx, before, MIR_RSH, op, 63);
+  t = div_const_insn (gen_ctx, before, MIR_AND, t, m);
+  res = div_insn (gen_ctx, before, MIR_SUB, res, t);
+  if (m < 0) res = div_insn (gen_ctx, before, MIR_SUB, res, op);
+  return res;
+}
+
+/* Return the quotient of (HI * 2^64) / D.  HI should be less than D. */
+static uint64_t div_128_by_64 (uint64_t hi, uint64_t d) {
+  uint64_t q = 0, r = hi;
+
+  gen_assert (hi < d);
+  for (int i = 0; i < 64; i++) {
+    int carry_p = (int64_t) r < 0;
+
+    r <<= 1;
+    q <<= 1;
+    if (carry_p || r >= d) {
+      r -= d;
+      q |= 1;
     }
   }
-  DEBUG (2, { fprintf (debug_file, "  CCP modification:\n"); });
-  return ccp_modify (gen_ctx);
+  return q;
 }
 
-static void init_ccp (gen_ctx_t gen_ctx) {
-  gen_ctx->ccp_ctx = gen_malloc (gen_ctx, sizeof (struct ccp_ctx));
-  curr_ccp_run = 0;
-  VARR_CREATE (bb_t, ccp_bbs, 256);
-  VARR_CREATE (bb_insn_t, ccp_insns, 256);
-  VARR_CREATE (ccp_val_t, ccp_vals, 256);
+static int ceil_log2 (uint64_t d) {
+  int l = 0;
+
+  while (l < 64 && ((uint64_t) 1 << l) < d) l++;
+  return l;
 }
 
-static void finish_ccp (gen_ctx_t gen_ctx) {
-  ccp_val_t ccp_val;
+/* Return quotient of unsigned division of OP by D.  OP should be zero extended for 32-bit
+   (N == 32) division. */
+static MIR_op_t udiv_by_const (gen_ctx_t gen_ctx, MIR_insn_t before, MIR_op_t op, uint64_t d,
+                               int n) {
+  int l = ceil_log2 (d);
+  uint64_t m;
+  MIR_op_t q, t;
 
-  VARR_DESTROY (bb_t, ccp_bbs);
-  VARR_DESTROY (bb_insn_t, ccp_insns);
-  while (VARR_LENGTH (ccp_val_t, ccp_vals) != 0)
-    if ((ccp_val = VARR_POP (ccp_val_t, ccp_vals)) != NULL) free (ccp_val);
-  VARR_DESTROY (ccp_val_t, ccp_vals);
-  free (gen_ctx->ccp_ctx);
-  gen_ctx->ccp_ctx = NULL;
+  gen_assert (d != 0 && (n == 64 || d <= UINT32_MAX));
+  if ((d & (d - 1)) == 0) return div_const_insn (gen_ctx, before, MIR_URSH, op, l);
+  /* m = 2^N * (2^l - d) / d + 1; q = (t + ((op - t) >> 1)) >> (l - 1) where t = mulhu (m, op): */
+  if (n == 64) {
+    m = div_128_by_64 ((l == 64 ? 0 : (uint64_t) 1 << l) - d, d) + 1;
+    t = div_umulh (gen_ctx, before, op, m);
+  } else {
+    m = ((((uint64_t) 1 << l) - d) << 32) / d + 1;
+    t = div_const_insn (gen_ctx, before, MIR_MUL, op, (int64_t) m);
+    t = div_const_insn (gen_ctx, before, MIR_URSH, t, 32);
+  }
+  q = div_insn (gen_ctx, before, MIR_SUB, op, t);
+  q = div_const_insn (gen_ctx, before, MIR_URSH, q, 1);
+  q = div_insn (gen_ctx, before, MIR_ADD, q, t);
+  return div_const_insn (gen_ctx, before, MIR_URSH, q, l - 1);
+}
+
+/* Return quotient of signed division of OP by D.  OP should be sign extended for 32-bit
+   (N == 32) division. */
+static MIR_op_t div_by_const (gen_ctx_t gen_ctx, MIR_insn_t before, MIR_op_t op, int64_t d,
+                              int n) {
+  uint64_t abs_d = d < 0 ? -(uint64_t) d : (uint64_t) d;
+  int l = ceil_log2 (abs_d);
+  int64_t m;
+  MIR_op_t q, t;
+
+  gen_assert (d != 0 && (n == 64 || (INT32_MIN <= d && d <= INT32_MAX)));
+  if (abs_d == 1) {
+    q = op;
+  } else if ((abs_d & (abs_d - 1)) == 0) { /* q = (op + ((op >> 63) >>> (64 - l))) >> l: */
+    t = div_const_insn (gen_ctx, before, MIR_RSH, op, 63);
+    t = div_const_insn (gen_ctx, before, MIR_URSH, t, 64 - l);
+    t = div_insn (gen_ctx, before, MIR_ADD, op, t);
+    q = div_const_insn (gen_ctx, before, MIR_RSH, t, l);
+  } else {
+    /* m = 2^(N + l - 1) / |d| + 1 - 2^N;
+       q = ((op + mulhs (m, op)) >> (l - 1)) - (op >> (N - 1)): */
+    if (n == 64) {
+      m = (int64_t) (div_128_by_64 ((uint64_t) 1 << (l - 1), abs_d) + 1);
+      t = div_mulh (gen_ctx, before, op, m);
+    } else {
+      m = (int64_t) (((uint64_t) 1 << (31 + l)) / abs_d + 1 - ((uint64_t) 1 << 32));
+      t = div_const_insn (gen_ctx, before, MIR_MUL, op, m);
+      t = div_const_insn (gen_ctx, before, MIR_RSH, t, 32);
+    }
+    t = div_insn (gen_ctx, before, MIR_ADD, op, t);
+    t = div_const_insn (gen_ctx, before, MIR_RSH, t, l - 1);
+    q = div_const_insn (gen_ctx, before, MIR_RSH, op, 63);
+    q = div_insn (gen_ctx, before, MIR_SUB, t, q);
+  }
+  if (d < 0) q = div_unary_insn (gen_ctx, before, MIR_NEG, q);
+  return q;
 }
 
-#undef live_in
-#undef live_out
+/* Return TRUE and the value in VAL if REG used in BB_INSN is defined by a constant move in the
+   same BB: */
+static int get_const_reg_def (gen_ctx_t gen_ctx, bb_insn_t bb_insn, MIR_reg_t reg, int64_t *val) {
+  MIR_context_t ctx = gen_ctx->ctx;
+  MIR_insn_t insn;
+  size_t i, nops;
+  int out_p;
+
+  while ((bb_insn = DLIST_PREV (bb_insn_t, bb_insn)) != NULL) {
+    insn = bb_insn->insn;
+    nops = MIR_insn_nops (ctx, insn);
+    for (i = 0; i < nops; i++) {
+      MIR_insn_op_mode (ctx, insn, i, &out_p);
+      if (out_p && insn->ops[i].mode == MIR_OP_REG && insn->ops[i].u.reg == reg) break;
+    }
+    if (i >= nops) continue;
+    if (insn->code != MIR_MOV
+        || (insn->ops[1].mode != MIR_OP_INT && insn->ops[1].mode != MIR_OP_UINT))
+      return FALSE;
+    *val = insn->ops[1].u.i;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static void reduce_div_by_const (gen_ctx_t gen_ctx) {
+  MIR_context_t ctx = gen_ctx->ctx;
+  MIR_insn_t insn;
+  MIR_insn_code_t code;
+  bb_insn_t bb_insn, next_bb_insn;
+  MIR_op_t op, q;
+  int64_t d;
+  int n, signed_p, mod_p;
+
+  for (bb_t bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb))
+    for (bb_insn = DLIST_HEAD (bb_insn_t, bb->bb_insns); bb_insn != NULL;
+         bb_insn = next_bb_insn) {
+      next_bb_insn = DLIST_NEXT (bb_insn_t, bb_insn);
+      insn = bb_insn->insn;
+      code = insn->code;
+      if (code != MIR_DIV && code != MIR_DIVS && code != MIR_UDIV && code != MIR_UDIVS
+          && code != MIR_MOD && code != MIR_MODS && code != MIR_UMOD && code != MIR_UMODS)
+        continue;
+      if (insn->ops[1].mode != MIR_OP_REG || insn->ops[2].mode != MIR_OP_REG
+          || !get_const_reg_def (gen_ctx, bb_insn, insn->ops[2].u.reg, &d))
+        continue;
+      n = code == MIR_DIVS || code == MIR_UDIVS || code == MIR_MODS || code == MIR_UMODS ? 32 : 64;
+      signed_p = code == MIR_DIV || code == MIR_DIVS || code == MIR_MOD || code == MIR_MODS;
+      mod_p = code == MIR_MOD || code == MIR_MODS || code == MIR_UMOD || code == MIR_UMODS;
+      if (n == 32) d = signed_p ? (int32_t) d : (int64_t) (uint32_t) d;
+      if (d == 0) continue;
+      DEBUG (2, {
+        fprintf (debug_file, "  changing division by constant %" PRId64 " in insn ", d);
+        print_bb_insn (gen_ctx, bb_insn, FALSE);
+      });
+      op = insn->ops[1];
+      if (n == 32) op = div_unary_insn (gen_ctx, insn, signed_p ? MIR_EXT32 : MIR_UEXT32, op);
+      if (signed_p)
+        q = div_by_const (gen_ctx, insn, op, d, n);
+      else if ((n == 32 && d > INT32_MAX) || d < 0) /* q = op >= d: */
+        q = div_const_insn (gen_ctx, insn, MIR_UGE, op, d);
+      else
+        q = udiv_by_const (gen_ctx, insn, op, (uint64_t) d, n);
+      if (mod_p) {
+        q = div_const_insn (gen_ctx, insn, MIR_MUL, q, d);
+        q = div_insn (gen_ctx, insn, MIR_SUB, op, q);
+      }
+      gen_add_insn_before (gen_ctx, insn, MIR_new_insn (ctx, MIR_MOV, insn->ops[0], q));
+      gen_delete_insn (gen_ctx, insn);
+    }
+}
 
 /* New Page */
 
@@ -3454,11 +5595,23 @@ static MIR_insn_t initiate_bb_live_info (gen_ctx_t gen_ctx, MIR_insn_t bb_tail_i
   return insn;
 }
 
+/* Use sparse bitmaps for the data indexed by vars in each BB when the dense ones could take
+   more bits in total.  It saves memory and time for huge functions whose BB live sets contain
+   a small part of all vars.  */
+#ifndef SPARSE_BB_VAR_BITS
+#define SPARSE_BB_VAR_BITS (1 << 26)
+#endif
+
+static int sparse_bb_var_bitmaps_p (gen_ctx_t gen_ctx) {
+  return (uint64_t) get_nvars (gen_ctx) * curr_bb_index > SPARSE_BB_VAR_BITS;
+}
+
 static void initiate_live_info (gen_ctx_t gen_ctx, int moves_p) {
   MIR_reg_t nregs, n;
   mv_t mv, next_mv;
   reg_info_t ri;
   uint32_t mvs_num = 0;
+  int sparse_p = sparse_bb_var_bitmaps_p (gen_ctx);
 
   for (mv = DLIST_HEAD (mv_t, curr_cfg->used_moves); mv != NULL; mv = next_mv) {
     next_mv = DLIST_NEXT (mv_t, mv);
@@ -3478,10 +5631,10 @@ static void initiate_live_info (gen_ctx_t gen_ctx, int moves_p) {
   for (bb_t bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb)) {
     gen_assert (bb != NULL && bb->live_in != NULL && bb->live_out != NULL && bb->live_gen != NULL
                 && bb->live_kill != NULL);
-    bitmap_clear (bb->live_in);
-    bitmap_clear (bb->live_out);
-    bitmap_clear (bb->live_gen);
-    bitmap_clear (bb->live_kill);
+    bitmap_make_sparse (bb->live_in, sparse_p);
+    bitmap_make_sparse (bb->live_out, sparse_p);
+    bitmap_make_sparse (bb->live_gen, sparse_p);
+    bitmap_make_sparse (bb->live_kill, sparse_p);
   }
   for (MIR_insn_t tail = DLIST_TAIL (MIR_insn_t, curr_func_item->u.func->insns); tail != NULL;)
     tail = initiate_bb_live_info (gen_ctx, tail, moves_p, &mvs_num);
@@ -3571,7 +5724,7 @@ struct lr_ctx {
 
 static live_range_t create_live_range (gen_ctx_t gen_ctx, int start, int finish,
                                        live_range_t next) {
-  live_range_t lr = gen_malloc (gen_ctx, sizeof (struct live_range));
+  live_range_t lr = gen_arena_alloc (gen_ctx, sizeof (struct live_range));
 
   gen_assert (finish < 0 || start <= finish);
   lr->start = start;
@@ -3580,15 +5733,6 @@ static live_range_t create_live_range (gen_ctx_t gen_ctx, int start, int finish,
   return lr;
 }
 
-static void destroy_live_range (live_range_t lr) {
-  live_range_t next_lr;
-
-  for (; lr != NULL; lr = next_lr) {
-    next_lr = lr->next;
-    free (lr);
-  }
-}
-
 static inline int make_var_dead (gen_ctx_t gen_ctx, MIR_reg_t var, int point) {
   live_range_t lr;
 
@@ -3686,7 +5830,6 @@ static void shrink_live_ranges (gen_ctx_t gen_ctx) {
       }
       prev_lr->start = lr->start;
       prev_lr->next = next_lr;
-      free (lr);
     }
   }
   DEBUG (2, {
@@ -3767,10 +5910,6 @@ static void build_live_ranges (gen_ctx_t gen_ctx) {
 }
 
 static void destroy_func_live_ranges (gen_ctx_t gen_ctx) {
-  size_t i;
-
-  for (i = 0; i < VARR_LENGTH (live_range_t, var_live_ranges); i++)
-    destroy_live_range (VARR_GET (live_range_t, var_live_ranges, i));
   VARR_TRUNC (live_range_t, var_live_ranges, 0);
 }
 
@@ -3817,9 +5956,11 @@ typedef struct breg_info {
 
 DEF_VARR (breg_info_t);
 DEF_VARR (bitmap_t);
+DEF_VARR (MIR_insn_t);
 
 struct ra_ctx {
   VARR (MIR_reg_t) * breg_renumber;
+  VARR (MIR_insn_t) * remat_insns; /* indexed by breg: the only def insn if it is rematerializable */
   VARR (breg_info_t) * sorted_bregs;
   VARR (bitmap_t) * used_locs; /* indexed by bb or point */
   VARR (bitmap_t) * var_bbs;
@@ -3831,6 +5972,7 @@ struct ra_ctx {
 };
 
 #define breg_renumber gen_ctx->ra_ctx->breg_renumber
+#define remat_insns gen_ctx->ra_ctx->remat_insns
 #define sorted_bregs gen_ctx->ra_ctx->sorted_bregs
 #define used_locs gen_ctx->ra_ctx->used_locs
 #define var_bbs gen_ctx->ra_ctx->var_bbs
@@ -3840,11 +5982,53 @@ struct ra_ctx {
 #define loc_profit_ages gen_ctx->ra_ctx->loc_profit_ages
 #define curr_age gen_ctx->ra_ctx->curr_age
 
+/* Rematerialization: a pseudo set up only by one cheap insn (moving an integer constant or a
+   reference, or getting an address in the frame) is not spilled when it gets no hard reg.  Instead
+   the insn is repeated with a temporary hard reg before each use of the pseudo.  */
+static int remat_insn_p (MIR_insn_t insn) {
+  if (insn->code == MIR_MOV)
+    return (insn->ops[0].mode == MIR_OP_REG
+            && (insn->ops[1].mode == MIR_OP_INT || insn->ops[1].mode == MIR_OP_UINT
+                || insn->ops[1].mode == MIR_OP_REF));
+  return (insn->code == MIR_ADD && insn->ops[0].mode == MIR_OP_REG
+          && insn->ops[1].mode == MIR_OP_HARD_REG && insn->ops[1].u.hard_reg == FP_HARD_REG
+          && insn->ops[2].mode == MIR_OP_INT);
+}
+
+static void find_remat_bregs (gen_ctx_t gen_ctx) {
+  MIR_context_t ctx = gen_ctx->ctx;
+  MIR_reg_t breg, nregs = get_nregs (gen_ctx);
+  MIR_insn_t *remat_insns_addr;
+  size_t i, nops;
+  int out_p;
+
+  VARR_TRUNC (MIR_insn_t, remat_insns, 0);
+  for (breg = 0; breg < nregs; breg++) VARR_PUSH (MIR_insn_t, remat_insns, NULL);
+  remat_insns_addr = VARR_ADDR (MIR_insn_t, remat_insns);
+  bitmap_clear (temp_bitmap); /* bregs which can not be rematerialized */
+  for (MIR_insn_t insn = DLIST_HEAD (MIR_insn_t, curr_func_item->u.func->insns); insn != NULL;
+       insn = DLIST_NEXT (MIR_insn_t, insn)) {
+    nops = MIR_insn_nops (ctx, insn);
+    for (i = 0; i < nops; i++) {
+      MIR_insn_op_mode (ctx, insn, i, &out_p);
+      if (!out_p || insn->ops[i].mode != MIR_OP_REG) continue;
+      breg = reg2breg (gen_ctx, insn->ops[i].u.reg);
+      if (bitmap_bit_p (temp_bitmap, breg)) continue;
+      if (remat_insns_addr[breg] == NULL && remat_insn_p (insn)) {
+        remat_insns_addr[breg] = insn;
+      } else {
+        remat_insns_addr[breg] = NULL;
+        bitmap_set_bit_p (temp_bitmap, breg);
+      }
+    }
+  }
+}
+
 static void fast_assign (gen_ctx_t gen_ctx) {
   MIR_reg_t loc, curr_loc, best_loc, i, reg, breg, var, nregs = get_nregs (gen_ctx);
   MIR_type_t type;
   int slots_num;
-  int k;
+  int k, sparse_p;
   bitmap_t bm;
   bitmap_t *used_locs_addr;
   size_t nel;
@@ -3852,10 +6036,12 @@ static void fast_assign (gen_ctx_t gen_ctx) {
 
   func_stack_slots_num = 0;
   if (nregs == 0) return;
+  sparse_p = sparse_bb_var_bitmaps_p (gen_ctx);
   for (size_t n = 0; n < nregs + MAX_HARD_REG + 1 && n < VARR_LENGTH (bitmap_t, var_bbs); n++)
-    bitmap_clear (VARR_GET (bitmap_t, var_bbs, n));
+    bitmap_make_sparse (VARR_GET (bitmap_t, var_bbs, n), sparse_p);
   while (VARR_LENGTH (bitmap_t, var_bbs) < nregs + MAX_HARD_REG + 1) {
     bm = bitmap_create2 (curr_bb_index);
+    bitmap_make_sparse (bm, sparse_p);
     VARR_PUSH (bitmap_t, var_bbs, bm);
   }
   for (bb_t bb = DLIST_HEAD (bb_t, curr_cfg->bbs); bb != NULL; bb = DLIST_NEXT (bb_t, bb)) {
@@ -3907,7 +6093,7 @@ static void fast_assign (gen_ctx_t gen_ctx) {
     }
     if (best_loc != MIR_NON_HARD_REG) {
       setup_used_hard_regs (gen_ctx, type, best_loc);
-    } else {
+    } else if (VARR_GET (MIR_insn_t, remat_insns, breg) == NULL) {
       for (loc = MAX_HARD_REG + 1; loc <= func_stack_slots_num + MAX_HARD_REG; loc++) {
         slots_num = target_locs_num (loc, type);
         if (target_nth_loc (loc, type, slots_num - 1) > func_stack_slots_num + MAX_HARD_REG) break;
@@ -3939,6 +6125,7 @@ static void fast_assign (gen_ctx_t gen_ctx) {
                breg, (unsigned long) best_loc);
     });
     VARR_SET (MIR_reg_t, breg_renumber, breg, best_loc);
+    if (best_loc == MIR_NON_HARD_REG) continue; /* rematerialized */
     slots_num = target_locs_num (best_loc, type);
     FOREACH_BITMAP_BIT (bi, VARR_GET (bitmap_t, var_bbs, var), nel) {
       for (k = 0; k < slots_num; k++)
@@ -4123,7 +6310,7 @@ static void quality_assign (gen_ctx_t gen_ctx) {
     }
     if (best_loc != MIR_NON_HARD_REG) {
       setup_used_hard_regs (gen_ctx, type, best_loc);
-    } else {
+    } else if (VARR_GET (MIR_insn_t, remat_insns, breg) == NULL) {
       for (loc = MAX_HARD_REG + 1; loc <= func_stack_slots_num + MAX_HARD_REG; loc++) {
         slots_num = target_locs_num (loc, type);
         if (target_nth_loc (loc, type, slots_num - 1) > func_stack_slots_num + MAX_HARD_REG) break;
@@ -4168,6 +6355,7 @@ static void quality_assign (gen_ctx_t gen_ctx) {
                curr_breg_infos[thread_breg].thread_freq, (unsigned long) best_loc);
     });
     VARR_SET (MIR_reg_t, breg_renumber, breg, best_loc);
+    if (best_loc == MIR_NON_HARD_REG) continue; /* rematerialized */
     slots_num = target_locs_num (best_loc, type);
     for (lr = VARR_GET (live_range_t, var_live_ranges, var); lr != NULL; lr = lr->next)
       for (j = lr->start; j <= lr->finish; j++)
@@ -4179,7 +6367,8 @@ static void quality_assign (gen_ctx_t gen_ctx) {
 static void assign (gen_ctx_t gen_ctx) {
   MIR_reg_t i, reg, nregs = get_nregs (gen_ctx);
 
-  if (optimize_level == 0)
+  find_remat_bregs (gen_ctx);
+  if (optimize_level == 0 || gen_ctx->budget_flags != 0)
     fast_assign (gen_ctx);
   else
     quality_assign (gen_ctx);
@@ -4198,7 +6387,7 @@ static void assign (gen_ctx_t gen_ctx) {
 static MIR_reg_t change_reg (gen_ctx_t gen_ctx, MIR_op_t *mem_op, MIR_reg_t reg,
                              MIR_op_mode_t data_mode, int first_p, MIR_insn_t insn, int out_p) {
   MIR_context_t ctx = gen_ctx->ctx;
-  MIR_reg_t loc = VARR_GET (MIR_reg_t, breg_renumber, reg2breg (gen_ctx, reg));
+  MIR_reg_t breg = reg2breg (gen_ctx, reg), loc = VARR_GET (MIR_reg_t, breg_renumber, breg);
   MIR_reg_t hard_reg;
   MIR_disp_t offset;
   MIR_insn_code_t code;
@@ -4208,7 +6397,16 @@ static MIR_reg_t change_reg (gen_ctx_t gen_ctx, MIR_op_t *mem_op, MIR_reg_t reg,
   MIR_op_t hard_reg_op;
   size_t n;
 
-  gen_assert (loc != MIR_NON_HARD_REG);
+  if (loc == MIR_NON_HARD_REG) { /* rematerialize the value instead of loading it */
+    gen_assert (VARR_GET (MIR_insn_t, remat_insns, breg) != NULL && !out_p
+                && data_mode == MIR_OP_INT);
+    hard_reg = get_temp_hard_reg (MIR_T_I64, first_p);
+    setup_used_hard_regs (gen_ctx, MIR_T_I64, hard_reg);
+    new_insns[0] = MIR_copy_insn (ctx, VARR_GET (MIR_insn_t, remat_insns, breg));
+    new_insns[0]->ops[0] = _MIR_new_hard_reg_op (ctx, hard_reg);
+    n = 1;
+    goto insert;
+  }
   if (loc <= MAX_HARD_REG) return loc;
   gen_assert (data_mode == MIR_OP_INT || data_mode == MIR_OP_FLOAT || data_mode == MIR_OP_DOUBLE
               || data_mode == MIR_OP_LDOUBLE);
@@ -4254,6 +6452,7 @@ static MIR_reg_t change_reg (gen_ctx_t gen_ctx, MIR_op_t *mem_op, MIR_reg_t reg,
       new_insns[j] = new_insn;
     }
   }
+insert:
   for (size_t i = 0; i < n; i++) {
     new_insn = new_insns[i];
     if (out_p)
@@ -4285,13 +6484,18 @@ static void rewrite (gen_ctx_t gen_ctx) {
 #endif
   MIR_mem_t mem;
   MIR_op_mode_t data_mode;
-  MIR_reg_t hard_reg;
+  MIR_reg_t hard_reg, breg, nregs = get_nregs (gen_ctx);
   int out_p, first_in_p;
-  size_t insns_num = 0, movs_num = 0, deleted_movs_num = 0;
+  size_t insns_num = 0, movs_num = 0, deleted_movs_num = 0, remats_num = 0;
 
   for (insn = DLIST_HEAD (MIR_insn_t, curr_func_item->u.func->insns); insn != NULL;
        insn = next_insn) {
     next_insn = DLIST_NEXT (MIR_insn_t, insn);
+    if (insn->nops != 0 && insn->ops[0].mode == MIR_OP_REG
+        && VARR_GET (MIR_insn_t, remat_insns, reg2breg (gen_ctx, insn->ops[0].u.reg)) == insn
+        && VARR_GET (MIR_reg_t, breg_renumber, reg2breg (gen_ctx, insn->ops[0].u.reg))
+             == MIR_NON_HARD_REG)
+      continue; /* it is removed below as its copies are used instead of its result */
     nops = MIR_insn_nops (ctx, insn);
     first_in_p = TRUE;
     for (i = 0; i < nops; i++) {
@@ -4312,6 +6516,8 @@ static void rewrite (gen_ctx_t gen_ctx) {
           bitmap_set_bit_p (func_used_hard_regs, op->u.hard_reg_mem.index);
         break;
       case MIR_OP_REG:
+        if (VARR_GET (MIR_reg_t, breg_renumber, reg2breg (gen_ctx, op->u.reg)) == MIR_NON_HARD_REG)
+          remats_num++;
         hard_reg
           = change_reg (gen_ctx, &mem_op, op->u.reg, data_mode, out_p || first_in_p, insn, out_p);
         if (!out_p) first_in_p = FALSE;
@@ -4328,6 +6534,9 @@ static void rewrite (gen_ctx_t gen_ctx) {
         if (op->u.mem.base == 0) {
           mem.base = MIR_NON_HARD_REG;
         } else {
+          if (VARR_GET (MIR_reg_t, breg_renumber, reg2breg (gen_ctx, op->u.mem.base))
+              == MIR_NON_HARD_REG)
+            remats_num++;
           mem.base = change_reg (gen_ctx, &mem_op, op->u.mem.base, MIR_OP_INT, FALSE, insn, FALSE);
           gen_assert (mem.base != MIR_NON_HARD_REG); /* we can always use GP regs */
         }
@@ -4356,6 +6565,9 @@ static void rewrite (gen_ctx_t gen_ctx) {
       }
     }
   }
+  for (breg = 0; breg < nregs; breg++)
+    if (VARR_GET (MIR_reg_t, breg_renumber, breg) == MIR_NON_HARD_REG)
+      gen_delete_insn (gen_ctx, VARR_GET (MIR_insn_t, remat_insns, breg));
   DEBUG (1, {
     fprintf (debug_file,
              "%5lu deleted RA noop moves out of %lu non-conflicting moves "
@@ -4367,12 +6579,15 @@ static void rewrite (gen_ctx_t gen_ctx) {
                : deleted_movs_num * 100.0 / curr_cfg->non_conflicting_moves,
              (unsigned long) movs_num, deleted_movs_num * 100.0 / movs_num,
              (unsigned long) insns_num, deleted_movs_num * 100.0 / insns_num);
+    if (remats_num != 0)
+      fprintf (debug_file, "%5lu rematerialized pseudo uses\n", (unsigned long) remats_num);
   });
 }
 
 static void init_ra (gen_ctx_t gen_ctx) {
   gen_ctx->ra_ctx = gen_malloc (gen_ctx, sizeof (struct ra_ctx));
   VARR_CREATE (MIR_reg_t, breg_renumber, 0);
+  VARR_CREATE (MIR_insn_t, remat_insns, 0);
   VARR_CREATE (breg_info_t, sorted_bregs, 0);
   VARR_CREATE (bitmap_t, used_locs, 0);
   VARR_CREATE (bitmap_t, var_bbs, 0);
@@ -4383,6 +6598,7 @@ static void init_ra (gen_ctx_t gen_ctx) {
 
 static void finish_ra (gen_ctx_t gen_ctx) {
   VARR_DESTROY (MIR_reg_t, breg_renumber);
+  VARR_DESTROY (MIR_insn_t, remat_insns);
   VARR_DESTROY (breg_info_t, sorted_bregs);
   while (VARR_LENGTH (bitmap_t, used_locs) != 0) bitmap_destroy (VARR_POP (bitmap_t, used_locs));
   VARR_DESTROY (bitmap_t, used_locs);
@@ -5229,6 +7445,7 @@ static void dead_code_elimination (gen_ctx_t gen_ctx) {
       if (dead_p && !MIR_call_code_p (insn->code) && insn->code != MIR_RET
           && insn->code != MIR_ALLOCA && insn->code != MIR_BSTART && insn->code != MIR_BEND
           && insn->code != MIR_VA_START && insn->code != MIR_VA_ARG && insn->code != MIR_VA_END
+          && !MIR_overflow_code_p (insn->code)
           && !(insn->ops[0].mode == MIR_OP_HARD_REG
                && (insn->ops[0].u.hard_reg == FP_HARD_REG
                    || insn->ops[0].u.hard_reg == SP_HARD_REG))) {
@@ -5274,7 +7491,7 @@ static int dead_insn_p (gen_ctx_t gen_ctx, bb_insn_t bb_insn) {
 
   /* check control insns with possible output: */
   if (MIR_call_code_p (insn->code) || insn->code == MIR_ALLOCA || insn->code == MIR_BSTART
-      || insn->code == MIR_VA_START || insn->code == MIR_VA_ARG
+      || insn->code == MIR_VA_START || insn->code == MIR_VA_ARG || MIR_overflow_code_p (insn->code)
       || (insn->nops > 0 && insn->ops[0].mode == MIR_OP_HARD_REG
           && (insn->ops[0].u.hard_reg == FP_HARD_REG || insn->ops[0].u.hard_reg == SP_HARD_REG)))
     return FALSE;
@@ -5342,12 +7559,24 @@ static void parallel_error (MIR_context_t ctx, const char *err_message) {
   MIR_get_error_func (ctx) (MIR_parallel_error, err_message);
 }
 
+/* Return TRUE if a budget of the current function is exceeded.  The size budgets are checked
+   before the generation and switch it to level 0.  The time budget is checked between the passes.
+   After exceeding it, the rest of the generation skips SSA optimizations and uses fast RA.  */
+static int over_budget_p (gen_ctx_t gen_ctx) {
+  if (gen_ctx->budget_flags == 0 && gen_ctx->budget.max_time != 0
+      && (real_usec_time () - gen_ctx->func_start_time) / 1000.0 > gen_ctx->budget.max_time)
+    gen_ctx->budget_flags |= MIR_GEN_TIME_BUDGET;
+  return gen_ctx->budget_flags != 0;
+}
+
 void *MIR_gen (MIR_context_t ctx, int gen_num, MIR_item_t func_item) {
   struct all_gen_ctx *all_gen_ctx = *all_gen_ctx_loc (ctx);
   gen_ctx_t gen_ctx;
   uint8_t *code;
   void *machine_code;
-  size_t code_len;
+  size_t code_len, insns_num, bbs_num;
+  unsigned saved_optimize_level;
+  int ssa_p = FALSE;
   double start_time = real_usec_time ();
 
 #if !MIR_PARALLEL_GEN
@@ -5373,14 +7602,39 @@ void *MIR_gen (MIR_context_t ctx, int gen_num, MIR_item_t func_item) {
     MIR_output_item (ctx, debug_file, func_item);
   });
   curr_func_item = func_item;
+  saved_optimize_level = optimize_level;
+  gen_ctx->func_start_time = start_time;
+  gen_ctx->budget_flags = 0;
+  insns_num = bbs_num = 0;
+  for (MIR_insn_t insn = DLIST_HEAD (MIR_insn_t, func_item->u.func->insns); insn != NULL;
+       insn = DLIST_NEXT (MIR_insn_t, insn)) {
+    insns_num++;
+    if (insn->code == MIR_LABEL || MIR_branch_code_p (insn->code)) bbs_num++; /* estimation */
+  }
+  if (gen_ctx->budget.max_insns != 0 && insns_num > gen_ctx->budget.max_insns)
+    gen_ctx->budget_flags |= MIR_GEN_INSNS_BUDGET;
+  if (gen_ctx->budget.max_bbs != 0 && bbs_num > gen_ctx->budget.max_bbs)
+    gen_ctx->budget_flags |= MIR_GEN_BBS_BUDGET;
+  if (gen_ctx->budget.max_regs != 0
+      && (VARR_LENGTH (MIR_var_t, func_item->u.func->vars) + func_item->u.func->last_temp_num
+          > gen_ctx->budget.max_regs))
+    gen_ctx->budget_flags |= MIR_GEN_REGS_BUDGET;
+  if (gen_ctx->budget_flags != 0) optimize_level = 0; /* the cheapest pipeline */
   _MIR_duplicate_func_insns (ctx, func_item);
-  curr_cfg = func_item->data = gen_malloc (gen_ctx, sizeof (struct func_cfg));
+#ifdef TARGET_OVERFLOW_INSNS
+  if (!overflow_flags_usable_p (gen_ctx))
+#endif
+    expand_overflow_insns (gen_ctx);
+  expand_block_insns (gen_ctx);
+  insert_fuel_checks (gen_ctx);
+  curr_cfg = func_item->data = gen_arena_alloc (gen_ctx, sizeof (struct func_cfg));
   build_func_cfg (gen_ctx);
   DEBUG (2, {
     fprintf (debug_file, "+++++++++++++MIR after building CFG:\n");
     print_CFG (gen_ctx, TRUE, FALSE, TRUE, FALSE, NULL);
   });
-  if (optimize_level >= 2) {
+  if (optimize_level >= 2 && !over_budget_p (gen_ctx)) {
+    ssa_p = TRUE;
     build_ssa (gen_ctx);
     DEBUG (2, {
       fprintf (debug_file, "+++++++++++++MIR after building SSA:\n");
@@ -5391,7 +7645,7 @@ void *MIR_gen (MIR_context_t ctx, int gen_num, MIR_item_t func_item) {
     });
   }
 #ifndef NO_COPY_PROP
-  if (optimize_level >= 2) {
+  if (ssa_p && !over_budget_p (gen_ctx)) {
     DEBUG (2, { fprintf (debug_file, "+++++++++++++Copy Propagation:\n"); });
     copy_prop (gen_ctx);
     DEBUG (2, {
@@ -5400,8 +7654,28 @@ void *MIR_gen (MIR_context_t ctx, int gen_num, MIR_item_t func_item) {
     });
   }
 #endif /* #ifndef NO_COPY_PROP */
+#ifndef NO_ALGEBRAIC_SIMPLIFICATION
+  if (ssa_p && !over_budget_p (gen_ctx)) {
+    DEBUG (2, { fprintf (debug_file, "+++++++++++++Algebraic simplification:\n"); });
+    algebraic_simplification (gen_ctx);
+    DEBUG (2, {
+      fprintf (debug_file, "+++++++++++++MIR after algebraic simplification:\n");
+      print_CFG (gen_ctx, TRUE, FALSE, TRUE, TRUE, NULL);
+    });
+  }
+#endif /* #ifndef NO_ALGEBRAIC_SIMPLIFICATION */
+#ifndef NO_EXT_ELIMINATION
+  if (ssa_p && !over_budget_p (gen_ctx)) {
+    DEBUG (2, { fprintf (debug_file, "+++++++++++++Extension elimination:\n"); });
+    ext_elimination (gen_ctx);
+    DEBUG (2, {
+      fprintf (debug_file, "+++++++++++++MIR after extension elimination:\n");
+      print_CFG (gen_ctx, TRUE, FALSE, TRUE, TRUE, NULL);
+    });
+  }
+#endif /* #ifndef NO_EXT_ELIMINATION */
 #ifndef NO_GVN
-  if (optimize_level >= 2) {
+  if (ssa_p && !over_budget_p (gen_ctx)) {
     DEBUG (2, { fprintf (debug_file, "+++++++++++++GVN:\n"); });
     gvn (gen_ctx);
     DEBUG (2, {
@@ -5412,7 +7686,7 @@ void *MIR_gen (MIR_context_t ctx, int gen_num, MIR_item_t func_item) {
   }
 #endif /* #ifndef NO_GVN */
 #ifndef NO_GVN
-  if (optimize_level >= 2) {
+  if (ssa_p && !over_budget_p (gen_ctx)) {
     ssa_dead_code_elimination (gen_ctx);
     DEBUG (2, {
       fprintf (debug_file, "+++++++++++++MIR after dead code elimination after GVN:\n");
@@ -5421,13 +7695,16 @@ void *MIR_gen (MIR_context_t ctx, int gen_num, MIR_item_t func_item) {
   }
 #endif /* #ifndef NO_GVN */
 #ifndef NO_CCP
-  if (optimize_level >= 2) {
+  if (ssa_p && !over_budget_p (gen_ctx)) {
     DEBUG (2, { fprintf (debug_file, "+++++++++++++CCP:\n"); });
     if (ccp (gen_ctx)) {
       DEBUG (2, {
         fprintf (debug_file, "+++++++++++++MIR after CCP:\n");
         print_CFG (gen_ctx, TRUE, FALSE, TRUE, TRUE, NULL);
       });
+#ifndef NO_ALGEBRAIC_SIMPLIFICATION
+      algebraic_simplification (gen_ctx);
+#endif
       ssa_dead_code_elimination (gen_ctx);
       DEBUG (2, {
         fprintf (debug_file, "+++++++++++++MIR after dead code elimination after CCP:\n");
@@ -5436,7 +7713,13 @@ void *MIR_gen (MIR_context_t ctx, int gen_num, MIR_item_t func_item) {
     }
   }
 #endif /* #ifndef NO_CCP */
-  if (optimize_level >= 2) undo_build_ssa (gen_ctx);
+  if (ssa_p) undo_build_ssa (gen_ctx);
+#ifndef NO_DIV_BY_CONST
+  if (optimize_level >= 1) {
+    DEBUG (2, { fprintf (debug_file, "+++++++++++++Division by constants:\n"); });
+    reduce_div_by_const (gen_ctx);
+  }
+#endif /* #ifndef NO_DIV_BY_CONST */
   make_io_dup_op_insns (gen_ctx);
   target_machinize (gen_ctx);
   DEBUG (2, {
@@ -5451,7 +7734,7 @@ void *MIR_gen (MIR_context_t ctx, int gen_num, MIR_item_t func_item) {
     print_loop_tree (gen_ctx, TRUE);
     print_CFG (gen_ctx, TRUE, TRUE, FALSE, FALSE, output_bb_live_info);
   });
-  if (optimize_level != 0) build_live_ranges (gen_ctx);
+  if (optimize_level != 0 && !over_budget_p (gen_ctx)) build_live_ranges (gen_ctx);
   assign (gen_ctx);
   rewrite (gen_ctx); /* After rewrite the BB live info is still valid */
   DEBUG (2, {
@@ -5496,7 +7779,15 @@ void *MIR_gen (MIR_context_t ctx, int gen_num, MIR_item_t func_item) {
   _MIR_redirect_thunk (ctx, func_item->addr, func_item->u.func->call_addr);
   destroy_func_live_ranges (gen_ctx);
   if (optimize_level != 0) destroy_loop_tree (gen_ctx, curr_cfg->root_loop_node);
+  gen_ctx->stats.funcs_num++;
+  gen_ctx->stats.insns_num += insns_num;
+  gen_ctx->stats.bbs_num += curr_bb_index;
+  if ((gen_ctx->stats.last_budget_flags = gen_ctx->budget_flags) != 0)
+    gen_ctx->stats.budget_funcs_num++;
   destroy_func_cfg (gen_ctx);
+  reset_arena (gen_ctx);
+  optimize_level = saved_optimize_level;
+  gen_ctx->stats.time += (real_usec_time () - start_time) / 1000.0;
   DEBUG (0, {
     fprintf (debug_file,
              "  Code generation for %s: %lu MIR insns (addr=%llx, len=%lu) -- time %.2f ms\n",
@@ -5504,6 +7795,12 @@ void *MIR_gen (MIR_context_t ctx, int gen_num, MIR_item_t func_item) {
              (long unsigned) DLIST_LENGTH (MIR_insn_t, func_item->u.func->insns),
              (unsigned long long) machine_code, (unsigned long) code_len,
              (real_usec_time () - start_time) / 1000.0);
+    if (gen_ctx->budget_flags != 0)
+      fprintf (debug_file, "  The cheaper pipeline was used because of exceeded%s%s%s%s budget\n",
+               gen_ctx->budget_flags & MIR_GEN_INSNS_BUDGET ? " insns" : "",
+               gen_ctx->budget_flags & MIR_GEN_BBS_BUDGET ? " BBs" : "",
+               gen_ctx->budget_flags & MIR_GEN_REGS_BUDGET ? " regs" : "",
+               gen_ctx->budget_flags & MIR_GEN_TIME_BUDGET ? " time" : "");
   });
   _MIR_restore_func_insns (ctx, func_item);
   /* ??? We should use atomic here but c2mir does not implement them yet.  */
@@ -5566,6 +7863,30 @@ void MIR_gen_set_optimize_level (MIR_context_t ctx, int gen_num, unsigned int le
   optimize_level = level;
 }
 
+void MIR_gen_set_budget (MIR_context_t ctx, int gen_num, const MIR_gen_budget_t *budget) {
+  struct all_gen_ctx *all_gen_ctx = *all_gen_ctx_loc (ctx);
+  gen_ctx_t gen_ctx;
+
+#if !MIR_PARALLEL_GEN
+  gen_num = 0;
+#endif
+  gen_assert (gen_num >= 0 && gen_num < all_gen_ctx->gens_num);
+  gen_ctx = &all_gen_ctx->gen_ctx[gen_num];
+  gen_ctx->budget = *budget;
+}
+
+void MIR_gen_get_stats (MIR_context_t ctx, int gen_num, MIR_gen_stats_t *stats) {
+  struct all_gen_ctx *all_gen_ctx = *all_gen_ctx_loc (ctx);
+  gen_ctx_t gen_ctx;
+
+#if !MIR_PARALLEL_GEN
+  gen_num = 0;
+#endif
+  gen_assert (gen_num >= 0 && gen_num < all_gen_ctx->gens_num);
+  gen_ctx = &all_gen_ctx->gen_ctx[gen_num];
+  *stats = gen_ctx->stats;
+}
+
 #if MIR_PARALLEL_GEN
 static void *gen (void *arg) {
   MIR_item_t func_item;
@@ -5664,10 +7985,13 @@ void MIR_gen_init (MIR_context_t ctx, int gens_num) {
 #endif
     gen_ctx->ctx = ctx;
     optimize_level = 2;
+    memset (&gen_ctx->budget, 0, sizeof (gen_ctx->budget));
+    memset (&gen_ctx->stats, 0, sizeof (gen_ctx->stats));
     gen_ctx->target_ctx = NULL;
     gen_ctx->data_flow_ctx = NULL;
     gen_ctx->gvn_ctx = NULL;
     gen_ctx->ccp_ctx = NULL;
+    gen_ctx->ext_ctx = NULL;
     gen_ctx->lr_ctx = NULL;
     gen_ctx->ra_ctx = NULL;
     gen_ctx->selection_ctx = NULL;
@@ -5680,10 +8004,12 @@ void MIR_gen_init (MIR_context_t ctx, int gens_num) {
     VARR_CREATE (loop_node_t, queue_nodes, 32);
     VARR_CREATE (loop_node_t, loop_entries, 16);
     init_dead_vars (gen_ctx);
+    init_arena (gen_ctx);
     init_data_flow (gen_ctx);
     init_ssa (gen_ctx);
     init_gvn (gen_ctx);
     init_ccp (gen_ctx);
+    init_ext (gen_ctx);
     temp_bitmap = bitmap_create2 (DEFAULT_INIT_BITMAP_BITS_NUM);
     temp_bitmap2 = bitmap_create2 (DEFAULT_INIT_BITMAP_BITS_NUM);
     init_live_ranges (gen_ctx);
@@ -5728,6 +8054,7 @@ void MIR_gen_finish (MIR_context_t ctx) {
     finish_ssa (gen_ctx);
     finish_gvn (gen_ctx);
     finish_ccp (gen_ctx);
+    finish_ext (gen_ctx);
     bitmap_destroy (temp_bitmap);
     bitmap_destroy (temp_bitmap2);
     finish_live_ranges (gen_ctx);
@@ -5738,7 +8065,7 @@ void MIR_gen_finish (MIR_context_t ctx) {
     bitmap_destroy (insn_to_consider);
     bitmap_destroy (func_used_hard_regs);
     target_finish (gen_ctx);
-    finish_dead_vars (gen_ctx);
+    finish_arena (gen_ctx);
     free (gen_ctx->data_flow_ctx);
     VARR_DESTROY (bb_insn_t, dead_bb_insns);
     VARR_DESTROY (loop_node_t, loop_nodes);
@@ -16,10 +16,34 @@
 extern "C" {
 #endif
 
+/* Per function limits for optimizing generation.  Zero value means no limit.  */
+typedef struct MIR_gen_budget {
+  size_t max_insns; /* MIR insns */
+  size_t max_bbs;   /* basic blocks (labels and branches) */
+  size_t max_regs;  /* function vars and temps */
+  double max_time;  /* generation time in ms */
+} MIR_gen_budget_t;
+
+/* Flags of the exceeded budgets: */
+#define MIR_GEN_INSNS_BUDGET 1
+#define MIR_GEN_BBS_BUDGET 2
+#define MIR_GEN_REGS_BUDGET 4
+#define MIR_GEN_TIME_BUDGET 8
+
+typedef struct MIR_gen_stats {
+  size_t funcs_num;           /* generated functions */
+  size_t budget_funcs_num;    /* functions generated by the cheaper pipeline */
+  size_t insns_num, bbs_num;  /* MIR insns and basic blocks of the generated functions */
+  double time;                /* generation time in ms */
+  unsigned last_budget_flags; /* MIR_GEN_*_BUDGET flags for the last generated function */
+} MIR_gen_stats_t;
+
 extern void MIR_gen_init (MIR_context_t ctx, int gens_num);
 extern void MIR_gen_set_debug_file (MIR_context_t ctx, int gen_num, FILE *f);
 extern void MIR_gen_set_debug_level (MIR_context_t ctx, int gen_num, int debug_level);
 extern void MIR_gen_set_optimize_level (MIR_context_t ctx, int gen_num, unsigned int level);
+extern void MIR_gen_set_budget (MIR_context_t ctx, int gen_num, const MIR_gen_budget_t *budget);
+extern void MIR_gen_get_stats (MIR_context_t ctx, int gen_num, MIR_gen_stats_t *stats);
 extern void *MIR_gen (MIR_context_t ctx, int gen_num, MIR_item_t func_item);
 extern void MIR_set_gen_interface (MIR_context_t ctx, MIR_item_t func_item);
 extern void MIR_set_parallel_gen_interface (MIR_context_t ctx, MIR_item_t func_item);
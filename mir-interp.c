@@ -8,12 +8,33 @@
 static void interp_init (MIR_context_t ctx) {}
 static void finish_func_interpretation (MIR_item_t func_item) {}
 static void interp_finish (MIR_context_t ctx) {}
+static void reset_interp_code (MIR_context_t ctx) {}
 void MIR_interp (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t *results, size_t nargs, ...) {}
 void MIR_interp_arr_varg (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t *results, size_t nargs,
                           MIR_val_t *vals, va_list va) {}
 void MIR_interp_arr (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t *results, size_t nargs,
                      MIR_val_t *vals) {}
 void MIR_set_interp_interface (MIR_context_t ctx, MIR_item_t func_item) {}
+void MIR_interp_set_profile (MIR_context_t ctx, int enable_p) {}
+uint64_t MIR_interp_get_func_profile (MIR_context_t ctx, MIR_item_t func_item, size_t *ninsns,
+                                      MIR_interp_insn_profile_t **insn_profiles) {
+  *ninsns = 0;
+  *insn_profiles = NULL;
+  return 0;
+}
+void MIR_interp_reset_profile (MIR_context_t ctx) {}
+void MIR_interp_output_profile (MIR_context_t ctx, FILE *f) {}
+MIR_interp_state_t MIR_interp_start (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t *results,
+                                     size_t nargs, MIR_val_t *vals) {
+  return NULL;
+}
+int MIR_interp_resume (MIR_context_t ctx, MIR_interp_state_t state) { return TRUE; }
+void MIR_interp_yield (MIR_context_t ctx, MIR_interp_state_t state) {}
+void MIR_interp_set_fuel (MIR_context_t ctx, MIR_interp_state_t state, int64_t fuel) {}
+int64_t MIR_interp_get_fuel (MIR_context_t ctx, MIR_interp_state_t state) { return 0; }
+void MIR_interp_set_fuel_handler (MIR_context_t ctx, MIR_interp_state_t state,
+                                  MIR_fuel_handler_t handler, void *data) {}
+void MIR_interp_free_state (MIR_context_t ctx, MIR_interp_state_t state) {}
 #else
 
 #ifndef MIR_INTERP_TRACE
@@ -36,12 +57,60 @@ void MIR_set_interp_interface (MIR_context_t ctx, MIR_item_t func_item) {}
 #define alloca _alloca
 #endif
 
-typedef MIR_val_t *code_t;
+#if defined(_WIN32)
+typedef DWORD interp_thread_t;
+#define interp_current_thread() GetCurrentThreadId ()
+#define interp_thread_eq_p(t1, t2) ((t1) == (t2))
+#else
+#include <pthread.h>
+typedef pthread_t interp_thread_t;
+#define interp_current_thread() pthread_self ()
+#define interp_thread_eq_p(t1, t2) pthread_equal (t1, t2)
+#endif
+
+/* Icode and ff interfaces are generated once under a lock and then
+   read by all threads interpreting the context without the lock: */
+#if MIR_PARALLEL_GEN && defined(__GNUC__)
+#define load_acquire(p) __atomic_load_n (p, __ATOMIC_ACQUIRE)
+#define store_release(p, v) __atomic_store_n (p, v, __ATOMIC_RELEASE)
+#else
+#define load_acquire(p) (*(p))
+#define store_release(p, v) (*(p) = (v))
+#endif
+
+/* Interpreter code consists of 32-bit words: insn codes (or offsets of
+   their dispatch labels), frame slot numbers, label locations, operand
+   numbers, and small immediates.  Other values (wide immediates,
+   addresses, and original insns for tracing) are kept out of line in
+   the function value pool and the code contains their pool indexes.  */
+typedef union {
+  int32_t i;
+  uint32_t u;
+  float f;
+} icode_t;
+
+typedef icode_t *code_t;
+
+/* Execution counts of a function interpreted in the profile mode.  The code counts executions
+   of basic blocks (the first one starts at the function entry) and the insn counts are derived
+   from them: */
+typedef struct {
+  size_t bb, fall_through_bb; /* the last one is SIZE_MAX if the insn is not a cond branch */
+} insn_bbs_t;
+
+typedef struct func_profile {
+  size_t ninsns, nbbs;
+  uint64_t *bb_counts;
+  insn_bbs_t *insn_bbs;
+  MIR_interp_insn_profile_t insns[1];
+} * func_profile_t;
 
 typedef struct func_desc {
   MIR_reg_t nregs;
   MIR_item_t func_item;
-  MIR_val_t code[1];
+  func_profile_t profile; /* NULL if the function is not profiled */
+  code_t code;            /* placed after the pool */
+  MIR_val_t pool[1];      /* values referred from the code */
 } * func_desc_t;
 
 static void update_max_nreg (MIR_reg_t reg, MIR_reg_t *max_nreg) {
@@ -63,11 +132,28 @@ typedef enum {
   REP3 (IC_EL, LDF, LDD, LDLD),
   REP7 (IC_EL, STI8, STU8, STI16, STU16, STI32, STU32, STI64),
   REP3 (IC_EL, STF, STD, STLD),
-  REP7 (IC_EL, MOVI, MOVP, MOVF, MOVD, MOVLD, IMM_CALL, INSN_BOUND),
+  REP2 (IC_EL, MEMCPYI, MEMSETI),
+  REP7 (IC_EL, MOVI, MOVP, MOVF, MOVD, MOVLD, IMM_CALL, IMM_ICALL),
+  /* Superinstructions: */
+  REP8 (IC_EL, BEQI, BNEI, BLTI, BLEI, BGTI, BGEI, UBLTI, UBLEI),
+  REP8 (IC_EL, UBGTI, UBGEI, BEQSI, BNESI, BLTSI, BLESI, BGTSI, BGESI),
+  REP4 (IC_EL, UBLTSI, UBLESI, UBGTSI, UBGESI),
+  REP8 (IC_EL, ADD_LDI8, ADD_LDU8, ADD_LDI16, ADD_LDU16, ADD_LDI32, ADD_LDU32, ADD_LDI64, ADD_LDF),
+  REP7 (IC_EL, ADD_LDD, ADD_ST8, ADD_ST16, ADD_ST32, ADD_ST64, ADD_STF, ADD_STD),
+  REP8 (IC_EL, ADD_BLT, ADD_BLE, ADD_BNE, ADDS_BLTS, ADDS_BLES, ADDS_BNES, MUL_ADD, MOV_MOV),
+  /* Insns with immediate operand: */
+  REP6 (IC_EL, ADDI, ADDSI, SUBI, SUBSI, ANDI, LSHI),
+  REP8 (IC_EL, ADDI_LDI8, ADDI_LDU8, ADDI_LDI16, ADDI_LDU16, ADDI_LDI32, ADDI_LDU32, ADDI_LDI64,
+        ADDI_LDF),
+  REP7 (IC_EL, ADDI_LDD, ADDI_ST8, ADDI_ST16, ADDI_ST32, ADDI_ST64, ADDI_STF, ADDI_STD),
+  IC_EL (PROF), /* counter increment in the profile mode */
+  IC_EL (FUEL), /* fuel counter decrement and check */
+  IC_INSN_BOUND
 } MIR_full_insn_code_t;
 #undef REP_SEP
 
 DEF_VARR (MIR_val_t);
+DEF_VARR (icode_t);
 
 struct ff_interface {
   size_t arg_vars_num, nres, nargs;
@@ -81,57 +167,136 @@ DEF_HTAB (ff_interface_t);
 
 DEF_VARR (_MIR_arg_desc_t);
 
+#ifndef MIR_INTERP_STACK_SEG_SIZE
+#define MIR_INTERP_STACK_SEG_SIZE 8192 /* in values */
+#endif
+
+#ifndef MIR_INTERP_MAX_STACK_SIZE
+#define MIR_INTERP_MAX_STACK_SIZE (1 << 22) /* in values */
+#endif
+
+#ifndef MIR_INTERP_MAX_CALL_DEPTH
+#define MIR_INTERP_MAX_CALL_DEPTH (1 << 18)
+#endif
+
+/* Interpreter frames are allocated on a value stack consisting of
+   segments.  The segments are never moved, so frame pointers stay
+   valid when the stack grows.  Segments are kept for reuse after
+   popping their frames.  */
+typedef struct stack_seg *stack_seg_t;
+
+struct stack_seg {
+  stack_seg_t prev, next;
+  MIR_val_t *top; /* first free value of the segment when the next segment is used */
+  size_t size;    /* # of values */
+  MIR_val_t vals[1];
+};
+
+typedef struct interp_stack *interp_stack_t;
+
+struct interp_stack {
+  interp_stack_t next;      /* all stacks of the context */
+  stack_seg_t seg;          /* the current segment */
+  MIR_val_t *top, *bound;   /* the first free value and the end of the current segment */
+  size_t size, depth;       /* # of values in all segments and the current call depth */
+  MIR_interp_state_t state; /* non-NULL for the stack of a suspendable interpretation */
+  int64_t *fuel_addr;       /* the counter decremented by the fuel checks */
+  /* The thread and C stack address of the interpreter entry using the stack, or NULL if the stack
+     is free or used by a suspendable interpretation: */
+  interp_thread_t thread;
+  void *entry_frame;
+};
+
+/* State of a suspendable interpretation started by MIR_interp_start.
+   Interpreted functions are evaluated without C recursion, so all
+   their frames are on the state stack and the interpretation can be
+   suspended and resumed later.  */
+struct MIR_interp_state {
+  interp_stack_t stack;   /* NULL after the interpretation finish */
+  MIR_val_t *frames;      /* the first frame on the stack */
+  MIR_val_t *results;     /* where to put the function results */
+  func_desc_t func_desc;  /* the function, frame, its results, and insn to continue: */
+  MIR_val_t *bp, *frame_results;
+  code_t pc;              /* NULL before the first resume */
+  int yield_p;            /* suspend at the next suspension point */
+  int suspended_p;        /* the last resume was finished by suspension */
+  int64_t fuel;           /* fuel of the interpretation and its handler: */
+  MIR_fuel_handler_t exhausted_handler;
+  void *exhausted_handler_data;
+};
+
+/* # of values saved for the caller in a frame of an interpreted
+   function called from interpreted code: func desc, frame, call insn
+   operands, and results of the caller.  */
+#define CALLER_STATE_SIZE 4
+
+/* # of values reserved right before the frame regs: the stack top
+   and the call insn of the last setjmp call in the frame, and va of
+   vararg function.  */
+#define FRAME_RESERVED_SIZE 3
+
+DEF_VARR (interp_stack_t);
+
 struct interp_ctx {
 #if DIRECT_THREADED_DISPATCH
-  void *dispatch_label_tab[IC_INSN_BOUND];
+  int32_t dispatch_label_tab[IC_INSN_BOUND]; /* label offsets from the first insn label */
+#endif
+#if MIR_PARALLEL_GEN
+  mir_mutex_t interp_mutex; /* for icode, ff interfaces, and icall func tab */
 #endif
-  VARR (MIR_val_t) * code_varr;
+  VARR (icode_t) * code_varr;
+  VARR (MIR_val_t) * pool_varr;
   VARR (MIR_insn_t) * branches;
-  VARR (MIR_val_t) * arg_vals_varr;
-  MIR_val_t *arg_vals;
 #if MIR_INTERP_TRACE
   int trace_insn_ident;
 #endif
-  void *(*bstart_builtin) (void);
-  void (*bend_builtin) (void *);
-  VARR (MIR_val_t) * call_res_args_varr;
-  MIR_val_t *call_res_args;
-  VARR (_MIR_arg_desc_t) * call_arg_descs_varr;
-  _MIR_arg_desc_t *call_arg_descs;
-  HTAB (ff_interface_t) * ff_interface_tab;
+  HTAB (MIR_item_t) * icall_func_tab; /* func items with interp interface keyed by addr */
+  interp_stack_t all_interp_stacks;
+  VARR (interp_stack_t) * free_interp_stacks;
+  int profile_p;            /* generate code counting insn executions */
+  int ff_interface_user_p; /* got ff interfaces from the process-wide table */
 };
 
 #define dispatch_label_tab interp_ctx->dispatch_label_tab
+#define interp_mutex interp_ctx->interp_mutex
 #define code_varr interp_ctx->code_varr
+#define pool_varr interp_ctx->pool_varr
 #define branches interp_ctx->branches
-#define arg_vals_varr interp_ctx->arg_vals_varr
-#define arg_vals interp_ctx->arg_vals
 #define trace_insn_ident interp_ctx->trace_insn_ident
 #define trace_ident interp_ctx->trace_ident
-#define bstart_builtin interp_ctx->bstart_builtin
-#define bend_builtin interp_ctx->bend_builtin
-#define call_res_args_varr interp_ctx->call_res_args_varr
-#define call_res_args interp_ctx->call_res_args
-#define call_arg_descs_varr interp_ctx->call_arg_descs_varr
-#define call_arg_descs interp_ctx->call_arg_descs
-#define ff_interface_tab interp_ctx->ff_interface_tab
-
-static void get_icode (struct interp_ctx *interp_ctx, MIR_val_t *v, int code) {
-#if DIRECT_THREADED_DISPATCH
-  v->a = dispatch_label_tab[code];
-#else
-  v->ic = code;
-#endif
+#define icall_func_tab interp_ctx->icall_func_tab
+#define all_interp_stacks interp_ctx->all_interp_stacks
+#define free_interp_stacks interp_ctx->free_interp_stacks
+#define profile_p interp_ctx->profile_p
+#define ff_interface_user_p interp_ctx->ff_interface_user_p
+
+static void push_word (struct interp_ctx *interp_ctx, int64_t w) {
+  icode_t v;
+
+  mir_assert (w == (int32_t) w);
+  v.i = (int32_t) w;
+  VARR_PUSH (icode_t, code_varr, v);
+}
+
+/* Put V into the function value pool and its index into the code.  */
+static void push_pool_val (struct interp_ctx *interp_ctx, MIR_val_t v) {
+  push_word (interp_ctx, VARR_LENGTH (MIR_val_t, pool_varr));
+  VARR_PUSH (MIR_val_t, pool_varr, v);
 }
 
 static void push_insn_start (struct interp_ctx *interp_ctx, int code, MIR_insn_t original_insn) {
+#if MIR_INTERP_TRACE
   MIR_val_t v;
+#endif
 
-  get_icode (interp_ctx, &v, code);
-  VARR_PUSH (MIR_val_t, code_varr, v);
+#if DIRECT_THREADED_DISPATCH
+  push_word (interp_ctx, dispatch_label_tab[code]);
+#else
+  push_word (interp_ctx, code);
+#endif
 #if MIR_INTERP_TRACE
   v.a = original_insn;
-  VARR_PUSH (MIR_val_t, code_varr, v);
+  push_pool_val (interp_ctx, v);
 #endif
 }
 
@@ -156,161 +321,474 @@ static MIR_full_insn_code_t get_int_mem_insn_code (int load_p, MIR_type_t t) {
 }
 
 static void push_mem (struct interp_ctx *interp_ctx, MIR_op_t op) {
-  MIR_val_t v;
-
   mir_assert (op.mode == MIR_OP_MEM && op.u.mem.disp == 0 && op.u.mem.index == 0);
-  v.i = op.u.mem.base;
-  VARR_PUSH (MIR_val_t, code_varr, v);
+  push_word (interp_ctx, op.u.mem.base);
 }
 
 static void redirect_interface_to_interp (MIR_context_t ctx, MIR_item_t func_item);
 
+static htab_hash_t icall_func_hash (MIR_item_t item, void *arg) {
+  return mir_hash_finish (mir_hash_step (mir_hash_init (0), (uint64_t) item->addr));
+}
+
+static int icall_func_eq (MIR_item_t item1, MIR_item_t item2, void *arg) {
+  return item1->addr == item2->addr;
+}
+
+/* Interpreted function can be called by a direct frame push in eval
+   when it does not need va_list and block arg copies made by ABI.  */
+static int icall_func_p (MIR_func_t func) {
+  MIR_var_t *arg_vars = VARR_ADDR (MIR_var_t, func->vars);
+
+  if (func->vararg_p) return FALSE;
+  for (size_t i = 0; i < func->nargs; i++)
+    if (MIR_blk_type_p (arg_vars[i].type)) return FALSE;
+  return TRUE;
+}
+
+static int icall_proto_p (MIR_func_t func, MIR_proto_t proto, size_t nops) {
+  return !proto->vararg_p && func->nres == proto->nres && func->nargs + proto->nres + 2 == nops;
+}
+
+/* Return func item with interp interface called by immediate call
+   INSN if the call can be done by a direct frame push in eval,
+   otherwise return NULL.  */
+static MIR_item_t get_icall_func_item (MIR_context_t ctx, MIR_insn_t insn) {
+  struct interp_ctx *interp_ctx = ctx->interp_ctx;
+  MIR_item_t tab_item, item = insn->ops[1].u.ref;
+
+  while (item != NULL
+         && (item->item_type == MIR_import_item || item->item_type == MIR_export_item
+             || item->item_type == MIR_forward_item))
+    item = item->ref_def;
+  if (item == NULL || item->item_type != MIR_func_item
+      || !HTAB_DO (MIR_item_t, icall_func_tab, item, HTAB_FIND, tab_item) || tab_item != item
+      || !icall_proto_p (item->u.func, insn->ops[0].u.ref->u.proto, MIR_insn_nops (ctx, insn)))
+    return NULL;
+  return item;
+}
+
+/* Superinstructions were chosen by counting the most frequently
+   executed pairs of icodes on c-benchmarks.  A superinstruction does
+   everything the original insns do, including setting the intermediate
+   result, so we need no liveness info to use it.  A label between the
+   insns prevents the fusion as the second insn is a branch target.  */
+
+static int get_branch_imm_icode (MIR_insn_code_t code) {
+  switch (code) {
+  case MIR_BEQ: return IC_BEQI;
+  case MIR_BNE: return IC_BNEI;
+  case MIR_BLT: return IC_BLTI;
+  case MIR_BLE: return IC_BLEI;
+  case MIR_BGT: return IC_BGTI;
+  case MIR_BGE: return IC_BGEI;
+  case MIR_UBLT: return IC_UBLTI;
+  case MIR_UBLE: return IC_UBLEI;
+  case MIR_UBGT: return IC_UBGTI;
+  case MIR_UBGE: return IC_UBGEI;
+  case MIR_BEQS: return IC_BEQSI;
+  case MIR_BNES: return IC_BNESI;
+  case MIR_BLTS: return IC_BLTSI;
+  case MIR_BLES: return IC_BLESI;
+  case MIR_BGTS: return IC_BGTSI;
+  case MIR_BGES: return IC_BGESI;
+  case MIR_UBLTS: return IC_UBLTSI;
+  case MIR_UBLES: return IC_UBLESI;
+  case MIR_UBGTS: return IC_UBGTSI;
+  case MIR_UBGES: return IC_UBGESI;
+  default: return -1;
+  }
+}
+
+static int get_add_branch_icode (MIR_insn_code_t add_code, MIR_insn_code_t code) {
+  if (add_code == MIR_ADD) return code == MIR_BLT ? IC_ADD_BLT : code == MIR_BLE ? IC_ADD_BLE
+                                                   : code == MIR_BNE ? IC_ADD_BNE
+                                                                     : -1;
+  mir_assert (add_code == MIR_ADDS);
+  return code == MIR_BLTS ? IC_ADDS_BLTS : code == MIR_BLES ? IC_ADDS_BLES
+                                         : code == MIR_BNES ? IC_ADDS_BNES
+                                                            : -1;
+}
+
+static int get_add_mem_icode (MIR_insn_t insn, MIR_reg_t addr_reg) {
+  MIR_op_t *ops = insn->ops;
+  int load_p;
+
+  if (insn->code != MIR_MOV && insn->code != MIR_FMOV && insn->code != MIR_DMOV) return -1;
+  if (ops[1].mode == MIR_OP_MEM && ops[0].mode == MIR_OP_REG) {
+    load_p = TRUE;
+  } else if (ops[0].mode == MIR_OP_MEM && ops[1].mode == MIR_OP_REG) {
+    load_p = FALSE;
+  } else {
+    return -1;
+  }
+  if (ops[load_p ? 1 : 0].u.mem.base != addr_reg) return -1;
+  if (insn->code == MIR_FMOV) return load_p ? IC_ADD_LDF : IC_ADD_STF;
+  if (insn->code == MIR_DMOV) return load_p ? IC_ADD_LDD : IC_ADD_STD;
+  switch (get_int_mem_insn_code (load_p, ops[load_p ? 1 : 0].u.mem.type)) {
+  case IC_LDI8: return IC_ADD_LDI8;
+  case IC_LDU8: return IC_ADD_LDU8;
+  case IC_LDI16: return IC_ADD_LDI16;
+  case IC_LDU16: return IC_ADD_LDU16;
+  case IC_LDI32: return IC_ADD_LDI32;
+  case IC_LDU32: return IC_ADD_LDU32;
+  case IC_LDI64: return IC_ADD_LDI64;
+  case IC_STI8:
+  case IC_STU8: return IC_ADD_ST8;
+  case IC_STI16:
+  case IC_STU16: return IC_ADD_ST16;
+  case IC_STI32:
+  case IC_STU32: return IC_ADD_ST32;
+  case IC_STI64: return IC_ADD_ST64;
+  default: return -1;
+  }
+}
+
+static int get_imm_op_icode (MIR_insn_code_t code) {
+  switch (code) {
+  case MIR_ADD: return IC_ADDI;
+  case MIR_ADDS: return IC_ADDSI;
+  case MIR_SUB: return IC_SUBI;
+  case MIR_SUBS: return IC_SUBSI;
+  case MIR_AND: return IC_ANDI;
+  case MIR_LSH: return IC_LSHI;
+  default: return -1;
+  }
+}
+
+static void push_reg (struct interp_ctx *interp_ctx, MIR_op_t op, MIR_reg_t *max_nreg) {
+  push_word (interp_ctx, get_reg (op, max_nreg));
+}
+
+/* Return TRUE if immediate OP can be put directly into the code.  */
+static int int32_imm_p (MIR_op_t op) {
+  mir_assert (op.mode == MIR_OP_INT || op.mode == MIR_OP_UINT);
+  return op.u.i == (int32_t) op.u.i;
+}
+
+static int int_reg_insn_p (MIR_insn_t insn, MIR_insn_code_t code, size_t nops) {
+  if (insn->code != code) return FALSE;
+  for (size_t i = 0; i < nops; i++)
+    if (insn->ops[i].mode != MIR_OP_REG) return FALSE;
+  return TRUE;
+}
+
+/* Generate a superinstruction for INSN and the next insn if it is
+   possible.  Return the last insn processed or NULL.  */
+static MIR_insn_t generate_superinsn (MIR_context_t ctx, MIR_insn_t insn, MIR_reg_t *max_nreg) {
+  struct interp_ctx *interp_ctx = ctx->interp_ctx;
+  MIR_insn_t next_insn = DLIST_NEXT (MIR_insn_t, insn);
+  MIR_op_t *ops = insn->ops, *next_ops;
+  int ic;
+
+  if (next_insn == NULL) return NULL;
+  next_ops = next_insn->ops;
+  if (insn->code == MIR_MOV && ops[0].mode == MIR_OP_REG
+      && (ops[1].mode == MIR_OP_INT || ops[1].mode == MIR_OP_UINT) && int32_imm_p (ops[1])
+      && (ic = get_imm_op_icode (next_insn->code)) >= 0
+      && int_reg_insn_p (next_insn, next_insn->code, 3)
+      && (next_ops[2].u.reg == ops[0].u.reg
+          || ((ic == IC_ADDI || ic == IC_ADDSI || ic == IC_ANDI)
+              && next_ops[1].u.reg == ops[0].u.reg))) {
+    /* mov t, imm; op r, a, t or a commutative op r, t, a: */
+    MIR_op_t a_op = next_ops[next_ops[2].u.reg == ops[0].u.reg ? 1 : 2];
+    MIR_insn_t mem_insn = DLIST_NEXT (MIR_insn_t, next_insn);
+    int mem_ic;
+
+    if (ic == IC_ADDI && mem_insn != NULL
+        && (mem_ic = get_add_mem_icode (mem_insn, next_ops[0].u.reg)) >= 0) {
+      /* displacement addressing: mov t, disp; add t2, a, t; mov r, (t2) or mov (t2), r: */
+      MIR_op_t *mem_ops = mem_insn->ops;
+
+      push_insn_start (interp_ctx, mem_ic - IC_ADD_LDI8 + IC_ADDI_LDI8, insn);
+      push_reg (interp_ctx, ops[0], max_nreg);
+      push_reg (interp_ctx, next_ops[0], max_nreg);
+      push_reg (interp_ctx, a_op, max_nreg);
+      push_word (interp_ctx, ops[1].u.i);
+      push_reg (interp_ctx, mem_ops[mem_ops[0].mode == MIR_OP_REG ? 0 : 1], max_nreg);
+      return mem_insn;
+    }
+    push_insn_start (interp_ctx, ic, insn);
+    push_reg (interp_ctx, next_ops[0], max_nreg);
+    push_reg (interp_ctx, a_op, max_nreg);
+    push_reg (interp_ctx, ops[0], max_nreg);
+    push_word (interp_ctx, ops[1].u.i);
+    return next_insn;
+  }
+  if (insn->code == MIR_MOV && ops[0].mode == MIR_OP_REG
+      && (ops[1].mode == MIR_OP_INT || ops[1].mode == MIR_OP_UINT) && int32_imm_p (ops[1])
+      && (ic = get_branch_imm_icode (next_insn->code)) >= 0 && next_ops[2].mode == MIR_OP_REG
+      && next_ops[2].u.reg == ops[0].u.reg) { /* mov t, imm; bcc L, a, t: */
+    next_insn->data = (void *) VARR_LENGTH (icode_t, code_varr);
+    push_insn_start (interp_ctx, ic, insn);
+    VARR_PUSH (MIR_insn_t, branches, next_insn);
+    push_word (interp_ctx, 0); /* label */
+    push_reg (interp_ctx, next_ops[1], max_nreg);
+    push_reg (interp_ctx, ops[0], max_nreg);
+    push_word (interp_ctx, ops[1].u.i);
+    return next_insn;
+  }
+  if ((int_reg_insn_p (insn, MIR_ADD, 3) || int_reg_insn_p (insn, MIR_ADDS, 3))
+      && (ic = get_add_branch_icode (insn->code, next_insn->code)) >= 0
+      && next_ops[1].mode == MIR_OP_REG && next_ops[1].u.reg == ops[0].u.reg
+      && next_ops[2].mode == MIR_OP_REG) { /* add r, a, b; bcc L, r, c: */
+    next_insn->data = (void *) VARR_LENGTH (icode_t, code_varr);
+    push_insn_start (interp_ctx, ic, insn);
+    VARR_PUSH (MIR_insn_t, branches, next_insn);
+    push_word (interp_ctx, 0); /* label */
+    for (size_t i = 0; i < 3; i++) push_reg (interp_ctx, ops[i], max_nreg);
+    push_reg (interp_ctx, next_ops[2], max_nreg);
+    return next_insn;
+  }
+  if (int_reg_insn_p (insn, MIR_ADD, 3) && (ic = get_add_mem_icode (next_insn, ops[0].u.reg)) >= 0) {
+    /* add t, a, b; mov r, (t) or mov (t), r: */
+    push_insn_start (interp_ctx, ic, insn);
+    for (size_t i = 0; i < 3; i++) push_reg (interp_ctx, ops[i], max_nreg);
+    push_reg (interp_ctx, next_ops[next_ops[0].mode == MIR_OP_REG ? 0 : 1], max_nreg);
+    return next_insn;
+  }
+  if (int_reg_insn_p (insn, MIR_MUL, 3) && int_reg_insn_p (next_insn, MIR_ADD, 3)
+      && (next_ops[1].u.reg == ops[0].u.reg || next_ops[2].u.reg == ops[0].u.reg)) {
+    /* mul t, a, b; add r, c, t: */
+    push_insn_start (interp_ctx, IC_MUL_ADD, insn);
+    for (size_t i = 0; i < 3; i++) push_reg (interp_ctx, ops[i], max_nreg);
+    push_reg (interp_ctx, next_ops[0], max_nreg);
+    push_reg (interp_ctx, next_ops[next_ops[1].u.reg == ops[0].u.reg ? 2 : 1], max_nreg);
+    return next_insn;
+  }
+  if (int_reg_insn_p (insn, MIR_MOV, 2) && int_reg_insn_p (next_insn, MIR_MOV, 2)) {
+    push_insn_start (interp_ctx, IC_MOV_MOV, insn);
+    for (size_t i = 0; i < 2; i++) push_reg (interp_ctx, ops[i], max_nreg);
+    for (size_t i = 0; i < 2; i++) push_reg (interp_ctx, next_ops[i], max_nreg);
+    return next_insn;
+  }
+  return NULL;
+}
+
+static void push_prof (struct interp_ctx *interp_ctx, uint64_t *counter, MIR_insn_t insn) {
+  MIR_val_t v;
+
+  push_insn_start (interp_ctx, IC_PROF, insn);
+  v.a = counter;
+  push_pool_val (interp_ctx, v);
+}
+
+static void push_fuel (struct interp_ctx *interp_ctx, MIR_insn_t insn) {
+  push_insn_start (interp_ctx, IC_FUEL, insn);
+}
+
+/* Return TRUE if a basic block starts right after INSN: */
+static int bb_end_insn_p (MIR_insn_t insn) {
+  return insn != NULL
+         && (MIR_branch_code_p (insn->code) || insn->code == MIR_SWITCH || insn->code == MIR_RET);
+}
+
+/* Create profile of FUNC with basic blocks starting at the function entry, labels, and after
+   bb_end_insn_p insns.  The icode generation should push the counters in the same order.  */
+static func_profile_t create_func_profile (MIR_context_t ctx, MIR_func_t func) {
+  size_t n = 0, ninsns = 0;
+  MIR_insn_t insn;
+  func_profile_t profile;
+
+  for (insn = DLIST_HEAD (MIR_insn_t, func->insns); insn != NULL;
+       insn = DLIST_NEXT (MIR_insn_t, insn), n++)
+    if (insn->code != MIR_LABEL) ninsns++;
+  /* Each insn starts at most one BB, insn profiles and their BBs are allocated with profile: */
+  profile = malloc (sizeof (struct func_profile) + ninsns * sizeof (MIR_interp_insn_profile_t)
+                    + (n + 1) * sizeof (uint64_t) + ninsns * sizeof (insn_bbs_t));
+  if (profile == NULL)
+    (*MIR_get_error_func (ctx)) (MIR_alloc_error, "no memory for interpreter profile");
+  profile->bb_counts = (uint64_t *) &profile->insns[ninsns];
+  profile->insn_bbs = (insn_bbs_t *) &profile->bb_counts[n + 1];
+  profile->ninsns = 0;
+  profile->nbbs = 1;
+  for (insn = DLIST_HEAD (MIR_insn_t, func->insns); insn != NULL;
+       insn = DLIST_NEXT (MIR_insn_t, insn)) {
+    if (bb_end_insn_p (DLIST_PREV (MIR_insn_t, insn))) {
+      if (DLIST_PREV (MIR_insn_t, insn)->code != MIR_JMP
+          && MIR_branch_code_p (DLIST_PREV (MIR_insn_t, insn)->code))
+        profile->insn_bbs[profile->ninsns - 1].fall_through_bb = profile->nbbs;
+      profile->nbbs++;
+    }
+    if (insn->code == MIR_LABEL) {
+      profile->nbbs++;
+      continue;
+    }
+    profile->insns[profile->ninsns].insn = insn;
+    profile->insn_bbs[profile->ninsns].bb = profile->nbbs - 1;
+    profile->insn_bbs[profile->ninsns].fall_through_bb = SIZE_MAX;
+    profile->ninsns++;
+  }
+  mir_assert (profile->nbbs <= n + 1);
+  memset (profile->bb_counts, 0, profile->nbbs * sizeof (uint64_t));
+  return profile;
+}
+
+static void push_bb_prof (struct interp_ctx *interp_ctx, func_profile_t profile, size_t *bb_num,
+                          MIR_insn_t insn) {
+  mir_assert (*bb_num < profile->nbbs);
+  push_prof (interp_ctx, &profile->bb_counts[(*bb_num)++], insn);
+}
+
 static void generate_icode (MIR_context_t ctx, MIR_item_t func_item) {
   struct interp_ctx *interp_ctx = ctx->interp_ctx;
-  int imm_call_p;
+  int imm_call_p, loop_label_p;
+  int fuel_p = _MIR_get_fuel_addr (ctx) != NULL;
   MIR_func_t func = func_item->u.func;
-  MIR_insn_t insn, label;
+  MIR_item_t icall_item;
+  MIR_insn_t insn, last_insn, label;
   MIR_val_t v;
-  size_t i;
+  icode_t w;
+  size_t i, bb_num = 0, npool;
   MIR_reg_t max_nreg = 0;
   func_desc_t func_desc;
+  func_profile_t profile = NULL;
 
+  if (mir_mutex_lock (&interp_mutex)) parallel_error (ctx, "error in mutex lock");
+  if (func_item->data != NULL) { /* icode was generated by another thread */
+    if (mir_mutex_unlock (&interp_mutex)) parallel_error (ctx, "error in mutex unlock");
+    return;
+  }
   VARR_TRUNC (MIR_insn_t, branches, 0);
-  VARR_TRUNC (MIR_val_t, code_varr, 0);
+  VARR_TRUNC (icode_t, code_varr, 0);
+  VARR_TRUNC (MIR_val_t, pool_varr, 0);
+  if (profile_p) {
+    profile = create_func_profile (ctx, func);
+    push_bb_prof (interp_ctx, profile, &bb_num, DLIST_HEAD (MIR_insn_t, func->insns));
+  }
+  if (fuel_p) { /* check fuel at the function start and loop headers: */
+    _MIR_mark_loop_labels (ctx, func_item);
+    push_fuel (interp_ctx, DLIST_HEAD (MIR_insn_t, func->insns));
+  }
   for (insn = DLIST_HEAD (MIR_insn_t, func->insns); insn != NULL;
        insn = DLIST_NEXT (MIR_insn_t, insn)) {
     MIR_insn_code_t code = insn->code;
     size_t nops = MIR_insn_nops (ctx, insn);
     MIR_op_t *ops = insn->ops;
 
-    insn->data = (void *) VARR_LENGTH (MIR_val_t, code_varr);
+    if (profile != NULL && bb_end_insn_p (DLIST_PREV (MIR_insn_t, insn)))
+      /* Reached only by fall through as a label counter is placed after this: */
+      push_bb_prof (interp_ctx, profile, &bb_num, insn);
+    loop_label_p = fuel_p && code == MIR_LABEL && insn->data != NULL;
+    insn->data = (void *) VARR_LENGTH (icode_t, code_varr);
+    if (profile != NULL && code == MIR_LABEL) push_bb_prof (interp_ctx, profile, &bb_num, insn);
+    if ((last_insn = generate_superinsn (ctx, insn, &max_nreg)) != NULL) {
+      insn = last_insn;
+      continue;
+    }
     switch (code) {
     case MIR_MOV: /* loads, imm moves */
       if (ops[0].mode == MIR_OP_MEM) {
         push_insn_start (interp_ctx, get_int_mem_insn_code (FALSE, ops[0].u.mem.type), insn);
-        v.i = get_reg (ops[1], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[1], &max_nreg));
         push_mem (interp_ctx, ops[0]);
       } else if (ops[1].mode == MIR_OP_MEM) {
         push_insn_start (interp_ctx, get_int_mem_insn_code (TRUE, ops[1].u.mem.type), insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
         push_mem (interp_ctx, ops[1]);
-      } else if (ops[1].mode == MIR_OP_INT || ops[1].mode == MIR_OP_UINT) {
+      } else if ((ops[1].mode == MIR_OP_INT || ops[1].mode == MIR_OP_UINT)
+                 && int32_imm_p (ops[1])) {
         push_insn_start (interp_ctx, IC_MOVI, insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
-        if (ops[1].mode == MIR_OP_INT)
-          v.i = ops[1].u.i;
-        else
-          v.u = ops[1].u.u;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
+        push_word (interp_ctx, ops[1].u.i);
+      } else if (ops[1].mode == MIR_OP_INT || ops[1].mode == MIR_OP_UINT) {
+        push_insn_start (interp_ctx, IC_MOVP, insn); /* wide immediate from the pool */
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
+        v.i = ops[1].u.i;
+        push_pool_val (interp_ctx, v);
       } else if (ops[1].mode == MIR_OP_REF) {
         MIR_item_t item = ops[1].u.ref;
 
         if (item->item_type == MIR_import_item && item->ref_def != NULL)
           item->addr = item->ref_def->addr;
         push_insn_start (interp_ctx, IC_MOVP, insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
         v.a = item->addr;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_pool_val (interp_ctx, v);
       } else {
         mir_assert (ops[1].mode == MIR_OP_REG);
         push_insn_start (interp_ctx, code, insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
-        v.i = ops[1].u.reg;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
+        push_word (interp_ctx, ops[1].u.reg);
       }
       break;
     case MIR_FMOV:
       if (ops[0].mode == MIR_OP_MEM) {
         push_insn_start (interp_ctx, IC_STF, insn);
-        v.i = get_reg (ops[1], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[1], &max_nreg));
         push_mem (interp_ctx, ops[0]);
       } else if (ops[1].mode == MIR_OP_MEM) {
         push_insn_start (interp_ctx, IC_LDF, insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
         push_mem (interp_ctx, ops[1]);
       } else if (ops[1].mode == MIR_OP_FLOAT) {
         push_insn_start (interp_ctx, IC_MOVF, insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
-        v.f = ops[1].u.f;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
+        w.f = ops[1].u.f;
+        VARR_PUSH (icode_t, code_varr, w);
       } else {
         mir_assert (ops[1].mode == MIR_OP_REG);
         push_insn_start (interp_ctx, code, insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
-        v.i = ops[1].u.reg;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
+        push_word (interp_ctx, ops[1].u.reg);
       }
       break;
     case MIR_DMOV:
       if (ops[0].mode == MIR_OP_MEM) {
         push_insn_start (interp_ctx, IC_STD, insn);
-        v.i = get_reg (ops[1], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[1], &max_nreg));
         push_mem (interp_ctx, ops[0]);
       } else if (ops[1].mode == MIR_OP_MEM) {
         push_insn_start (interp_ctx, IC_LDD, insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
         push_mem (interp_ctx, ops[1]);
       } else if (ops[1].mode == MIR_OP_DOUBLE) {
         push_insn_start (interp_ctx, IC_MOVD, insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
         v.d = ops[1].u.d;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_pool_val (interp_ctx, v);
       } else {
         mir_assert (ops[1].mode == MIR_OP_REG);
         push_insn_start (interp_ctx, code, insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
-        v.i = ops[1].u.reg;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
+        push_word (interp_ctx, ops[1].u.reg);
       }
       break;
     case MIR_LDMOV:
       if (ops[0].mode == MIR_OP_MEM) {
         push_insn_start (interp_ctx, IC_STLD, insn);
-        v.i = get_reg (ops[1], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[1], &max_nreg));
         push_mem (interp_ctx, ops[0]);
       } else if (ops[1].mode == MIR_OP_MEM) {
         push_insn_start (interp_ctx, IC_LDLD, insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
         push_mem (interp_ctx, ops[1]);
       } else if (ops[1].mode == MIR_OP_LDOUBLE) {
         push_insn_start (interp_ctx, IC_MOVLD, insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
         v.ld = ops[1].u.ld;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_pool_val (interp_ctx, v);
       } else {
         mir_assert (ops[1].mode == MIR_OP_REG);
         push_insn_start (interp_ctx, code, insn);
-        v.i = get_reg (ops[0], &max_nreg);
-        VARR_PUSH (MIR_val_t, code_varr, v);
-        v.i = ops[1].u.reg;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, get_reg (ops[0], &max_nreg));
+        push_word (interp_ctx, ops[1].u.reg);
       }
       break;
-    case MIR_LABEL: break;
+    case MIR_LABEL:
+      if (loop_label_p) push_fuel (interp_ctx, insn);
+      break;
     case MIR_INVALID_INSN:
       (*MIR_get_error_func (ctx)) (MIR_invalid_insn_error, "invalid insn for interpreter");
       break;
     case MIR_JMP:
+    case MIR_BO:
+    case MIR_UBO:
+    case MIR_BNO:
+    case MIR_UBNO:
       VARR_PUSH (MIR_insn_t, branches, insn);
       push_insn_start (interp_ctx, code, insn);
-      v.i = 0;
-      VARR_PUSH (MIR_val_t, code_varr, v);
+      push_word (interp_ctx, 0);
       break;
     case MIR_BT:
     case MIR_BTS:
@@ -318,10 +796,8 @@ static void generate_icode (MIR_context_t ctx, MIR_item_t func_item) {
     case MIR_BFS:
       VARR_PUSH (MIR_insn_t, branches, insn);
       push_insn_start (interp_ctx, code, insn);
-      v.i = 0;
-      VARR_PUSH (MIR_val_t, code_varr, v);
-      v.i = get_reg (ops[1], &max_nreg);
-      VARR_PUSH (MIR_val_t, code_varr, v);
+      push_word (interp_ctx, 0);
+      push_word (interp_ctx, get_reg (ops[1], &max_nreg));
       break;
     case MIR_BEQ:
     case MIR_BEQS:
@@ -363,69 +839,81 @@ static void generate_icode (MIR_context_t ctx, MIR_item_t func_item) {
     case MIR_LDBGE:
       VARR_PUSH (MIR_insn_t, branches, insn);
       push_insn_start (interp_ctx, code, insn);
-      v.i = 0;
-      VARR_PUSH (MIR_val_t, code_varr, v);
-      v.i = get_reg (ops[1], &max_nreg);
-      VARR_PUSH (MIR_val_t, code_varr, v);
-      v.i = get_reg (ops[2], &max_nreg);
-      VARR_PUSH (MIR_val_t, code_varr, v);
+      push_word (interp_ctx, 0);
+      push_word (interp_ctx, get_reg (ops[1], &max_nreg));
+      push_word (interp_ctx, get_reg (ops[2], &max_nreg));
+      break;
+    case MIR_MEMCPY:
+    case MIR_MEMSET:
+      if (ops[2].mode == MIR_OP_INT || ops[2].mode == MIR_OP_UINT) { /* constant size */
+        push_insn_start (interp_ctx, code == MIR_MEMCPY ? IC_MEMCPYI : IC_MEMSETI, insn);
+        v.u = ops[2].u.u;
+        push_pool_val (interp_ctx, v);
+      } else {
+        push_insn_start (interp_ctx, code, insn);
+        push_word (interp_ctx, get_reg (ops[2], &max_nreg));
+      }
+      push_word (interp_ctx, get_reg (ops[0], &max_nreg));
+      push_word (interp_ctx, get_reg (ops[1], &max_nreg));
       break;
     default:
       imm_call_p = FALSE;
+      icall_item = NULL;
       if (MIR_call_code_p (code))
         imm_call_p = (ops[1].mode == MIR_OP_REF
                       && (ops[1].u.ref->item_type == MIR_import_item
                           || ops[1].u.ref->item_type == MIR_export_item
                           || ops[1].u.ref->item_type == MIR_forward_item
                           || ops[1].u.ref->item_type == MIR_func_item));
+      if (imm_call_p) icall_item = get_icall_func_item (ctx, insn);
       push_insn_start (interp_ctx,
-                       imm_call_p           ? IC_IMM_CALL
+                       icall_item != NULL   ? IC_IMM_ICALL
+                       : imm_call_p         ? IC_IMM_CALL
                        : code == MIR_INLINE ? MIR_CALL
                                             : code,
                        insn);
       if (code == MIR_SWITCH) {
         VARR_PUSH (MIR_insn_t, branches, insn);
-        v.i = nops;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, nops);
       } else if (code == MIR_RET) {
-        v.i = nops;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, nops);
       } else if (MIR_call_code_p (code)) {
-        v.i = nops;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_word (interp_ctx, nops);
         v.a = insn;
-        VARR_PUSH (MIR_val_t, code_varr, v);
+        push_pool_val (interp_ctx, v);
         v.a = NULL;
-        VARR_PUSH (MIR_val_t, code_varr, v); /* for ffi interface */
+        push_pool_val (interp_ctx, v); /* for ffi interface */
       }
       for (i = 0; i < nops; i++) {
         if (i == 0 && MIR_call_code_p (code)) { /* prototype ??? */
           mir_assert (ops[i].mode == MIR_OP_REF && ops[i].u.ref->item_type == MIR_proto_item);
           v.a = ops[i].u.ref;
+          push_pool_val (interp_ctx, v);
         } else if (i == 1 && imm_call_p) {
           MIR_item_t item = ops[i].u.ref;
 
           mir_assert (item->item_type == MIR_import_item || item->item_type == MIR_export_item
                       || item->item_type == MIR_forward_item || item->item_type == MIR_func_item);
-          v.a = item->addr;
+          v.a = icall_item != NULL ? icall_item : item->addr;
+          push_pool_val (interp_ctx, v);
         } else if (code == MIR_VA_ARG && i == 2) { /* type */
           mir_assert (ops[i].mode == MIR_OP_MEM);
-          v.i = ops[i].u.mem.type;
+          push_word (interp_ctx, ops[i].u.mem.type);
         } else if (code == MIR_SWITCH && i > 0) {
           mir_assert (ops[i].mode == MIR_OP_LABEL);
-          v.i = 0;
+          push_word (interp_ctx, 0);
         } else if (MIR_call_code_p (code) && ops[i].mode == MIR_OP_MEM) {
           mir_assert (MIR_all_blk_type_p (ops[i].u.mem.type));
-          v.i = ops[i].u.mem.base;
-          update_max_nreg (v.i, &max_nreg);
+          update_max_nreg (ops[i].u.mem.base, &max_nreg);
+          push_word (interp_ctx, ops[i].u.mem.base);
         } else {
           mir_assert (ops[i].mode == MIR_OP_REG);
-          v.i = get_reg (ops[i], &max_nreg);
+          push_word (interp_ctx, get_reg (ops[i], &max_nreg));
         }
-        VARR_PUSH (MIR_val_t, code_varr, v);
       }
     }
   }
+  mir_assert (profile == NULL || bb_num == profile->nbbs);
   for (i = 0; i < VARR_LENGTH (MIR_insn_t, branches); i++) {
     size_t start_label_nop = 0, bound_label_nop = 1, start_label_loc = 1, n;
 
@@ -437,23 +925,38 @@ static void generate_icode (MIR_context_t ctx, MIR_item_t func_item) {
     }
     for (n = start_label_nop; n < bound_label_nop; n++) {
       label = insn->ops[n].u.label;
-      v.i = (size_t) label->data;
+      w.i = (int32_t) (size_t) label->data;
 #if MIR_INTERP_TRACE
-      VARR_SET (MIR_val_t, code_varr, (size_t) insn->data + n + start_label_loc + 1, v);
+      VARR_SET (icode_t, code_varr, (size_t) insn->data + n + start_label_loc + 1, w);
 #else
-      VARR_SET (MIR_val_t, code_varr, (size_t) insn->data + n + start_label_loc, v);
+      VARR_SET (icode_t, code_varr, (size_t) insn->data + n + start_label_loc, w);
 #endif
     }
   }
-  func_item->data = func_desc
-    = malloc (sizeof (struct func_desc) + VARR_LENGTH (MIR_val_t, code_varr) * sizeof (MIR_val_t));
+  npool = VARR_LENGTH (MIR_val_t, pool_varr);
+  func_desc = malloc (sizeof (struct func_desc) + npool * sizeof (MIR_val_t)
+                      + VARR_LENGTH (icode_t, code_varr) * sizeof (icode_t));
   if (func_desc == NULL)
     (*MIR_get_error_func (ctx)) (MIR_alloc_error, "no memory for interpreter code");
-  memmove (func_desc->code, VARR_ADDR (MIR_val_t, code_varr),
-           VARR_LENGTH (MIR_val_t, code_varr) * sizeof (MIR_val_t));
+  memcpy (func_desc->pool, VARR_ADDR (MIR_val_t, pool_varr), npool * sizeof (MIR_val_t));
+  func_desc->code = (code_t) &func_desc->pool[npool];
+  memcpy (func_desc->code, VARR_ADDR (icode_t, code_varr),
+          VARR_LENGTH (icode_t, code_varr) * sizeof (icode_t));
   mir_assert (max_nreg < MIR_MAX_REG_NUM);
   func_desc->nregs = max_nreg + 1;
   func_desc->func_item = func_item;
+  func_desc->profile = profile;
+  store_release (&func_item->data, (void *) func_desc);
+  if (mir_mutex_unlock (&interp_mutex)) parallel_error (ctx, "error in mutex unlock");
+}
+
+static inline func_desc_t get_func_desc (MIR_context_t ctx, MIR_item_t func_item) {
+  func_desc_t func_desc;
+
+  mir_assert (func_item->item_type == MIR_func_item);
+  if ((func_desc = load_acquire (&func_item->data)) != NULL) return func_desc;
+  generate_icode (ctx, func_item);
+  return func_item->data;
 }
 
 static void finish_func_interpretation (MIR_item_t func_item) {
@@ -462,15 +965,15 @@ static void finish_func_interpretation (MIR_item_t func_item) {
   for (MIR_insn_t insn = DLIST_HEAD (MIR_insn_t, func_item->u.func->insns); insn != NULL;
        insn = DLIST_NEXT (MIR_insn_t, insn))
     insn->data = NULL; /* it was used for interpretation preparation */
+  free (((func_desc_t) func_item->data)->profile);
   free (func_item->data);
   func_item->data = NULL;
 }
 
-static ALWAYS_INLINE void *get_a (MIR_val_t *v) { return v->a; }
-static ALWAYS_INLINE int64_t get_i (MIR_val_t *v) { return v->i; }
-static ALWAYS_INLINE float get_f (MIR_val_t *v) { return v->f; }
-static ALWAYS_INLINE double get_d (MIR_val_t *v) { return v->d; }
-static ALWAYS_INLINE long double get_ld (MIR_val_t *v) { return v->ld; }
+static ALWAYS_INLINE int64_t get_i (code_t c) { return c->i; }
+static ALWAYS_INLINE float get_f (code_t c) { return c->f; }
+static ALWAYS_INLINE MIR_val_t *get_pool_val (MIR_val_t *pool, code_t c) { return &pool[c->i]; }
+static ALWAYS_INLINE void *get_pool_a (MIR_val_t *pool, code_t c) { return pool[c->i].a; }
 
 static ALWAYS_INLINE void **get_aop (MIR_val_t *bp, code_t c) { return &bp[get_i (c)].a; }
 static ALWAYS_INLINE int64_t *get_iop (MIR_val_t *bp, code_t c) { return &bp[get_i (c)].i; }
@@ -761,6 +1264,71 @@ static ALWAYS_INLINE int64_t get_mem_addr (MIR_val_t *bp, code_t c) { return bp[
     *((mem_type *) a) = v;                  \
   } while (0)
 
+/* Superinstruction macros: */
+#define BICMPI(tp, op)                            \
+  do {                                            \
+    int64_t imm = get_i (ops + 3);                \
+    tp op1;                                       \
+    *get_iop (bp, ops + 2) = imm;                 \
+    op1 = *get_iop (bp, ops + 1);                 \
+    if (op1 op (tp) imm) pc = code + get_i (ops); \
+  } while (0)
+#define ADD_BICMP(tp, op)                                                  \
+  do {                                                                     \
+    int64_t *r = get_iop (bp, ops + 1);                                    \
+    *r = *get_iop (bp, ops + 2) + *get_iop (bp, ops + 3);                  \
+    if ((tp) * r op (tp) * get_iop (bp, ops + 4)) pc = code + get_i (ops); \
+  } while (0)
+#define ADDS_BICMPS(op)                                                              \
+  do {                                                                               \
+    int64_t *r = get_iop (bp, ops + 1);                                              \
+    int32_t p1 = *get_iop (bp, ops + 2), p2 = *get_iop (bp, ops + 3);                \
+    *r = p1 + p2;                                                                    \
+    if ((int32_t) * r op (int32_t) * get_iop (bp, ops + 4)) pc = code + get_i (ops); \
+  } while (0)
+#define ADD_LD(op, val_type, mem_type)                                                \
+  do {                                                                                \
+    int64_t a = *get_iop (bp, ops) = *get_iop (bp, ops + 1) + *get_iop (bp, ops + 2); \
+    *get_##op (bp, ops + 3) = *((mem_type *) a);                                      \
+  } while (0)
+#define ADD_ST(op, val_type, mem_type)                                                \
+  do {                                                                                \
+    int64_t a = *get_iop (bp, ops) = *get_iop (bp, ops + 1) + *get_iop (bp, ops + 2); \
+    val_type v = *get_##op (bp, ops + 3);                                             \
+    *((mem_type *) a) = v;                                                            \
+  } while (0)
+#define IOPI(op)                      \
+  do {                                \
+    int64_t p, imm = get_i (ops + 3); \
+    *get_iop (bp, ops + 2) = imm;     \
+    p = *get_iop (bp, ops + 1);       \
+    *get_iop (bp, ops) = p op imm;    \
+  } while (0)
+#define IOPSI(op)                            \
+  do {                                       \
+    int64_t imm = get_i (ops + 3);           \
+    int32_t p;                               \
+    *get_iop (bp, ops + 2) = imm;            \
+    p = *get_iop (bp, ops + 1);              \
+    *get_iop (bp, ops) = p op (int32_t) imm; \
+  } while (0)
+#define ADDI_LD(op, val_type, mem_type)                        \
+  do {                                                         \
+    int64_t a, imm = get_i (ops + 3);                          \
+    *get_iop (bp, ops) = imm;                                  \
+    a = *get_iop (bp, ops + 1) = *get_iop (bp, ops + 2) + imm; \
+    *get_##op (bp, ops + 4) = *((mem_type *) a);               \
+  } while (0)
+#define ADDI_ST(op, val_type, mem_type)                        \
+  do {                                                         \
+    int64_t a, imm = get_i (ops + 3);                          \
+    val_type v;                                                \
+    *get_iop (bp, ops) = imm;                                  \
+    a = *get_iop (bp, ops + 1) = *get_iop (bp, ops + 2) + imm; \
+    v = *get_##op (bp, ops + 4);                               \
+    *((mem_type *) a) = v;                                     \
+  } while (0)
+
 #if !MIR_INTERP_TRACE && defined(__GNUC__) && !defined(__clang__)
 #define OPTIMIZE \
   __attribute__ ((__optimize__ ("O2"))) __attribute__ ((__optimize__ ("-fno-ipa-cp-clone")))
@@ -768,21 +1336,22 @@ static ALWAYS_INLINE int64_t get_mem_addr (MIR_val_t *bp, code_t c) { return bp[
 #define OPTIMIZE
 #endif
 
-static void call (MIR_context_t ctx, MIR_val_t *bp, MIR_op_t *insn_arg_ops, code_t ffi_address_ptr,
-                  MIR_item_t proto_item, void *addr, code_t res_ops, size_t nargs);
+static void call (MIR_context_t ctx, MIR_val_t *bp, MIR_op_t *insn_arg_ops,
+                  MIR_val_t *ffi_address_ptr, MIR_item_t proto_item, void *addr, code_t res_ops,
+                  size_t nargs, MIR_val_t *arg_vals);
 
 #if MIR_INTERP_TRACE
 static void start_insn_trace (MIR_context_t ctx, const char *name, func_desc_t func_desc, code_t pc,
                               size_t nops) {
   struct interp_ctx *interp_ctx = ctx->interp_ctx;
-  MIR_insn_t insn = pc[1].a;
+  MIR_insn_t insn = func_desc->pool[pc[1].i].a;
   code_t ops = pc + 2;
 
   for (int i = 0; i < trace_insn_ident; i++) fprintf (stderr, " ");
   fprintf (stderr, "%s", name);
   for (size_t i = 0; i < nops; i++) {
     fprintf (stderr, i == 0 ? "\t" : ", ");
-    fprintf (stderr, "%" PRId64, ops[i].i);
+    fprintf (stderr, "%" PRId32, ops[i].i);
   }
   fprintf (stderr, "\t#");
   MIR_output_insn (ctx, stderr, insn, func_desc->func_item->u.func, FALSE);
@@ -819,8 +1388,35 @@ static void finish_insn_trace (MIR_context_t ctx, MIR_full_insn_code_t code, cod
   case IC_STF:
   case IC_STD:;
   case IC_STLD: break;
-  case IC_IMM_CALL: break;
+  case IC_IMM_CALL:
+  case IC_IMM_ICALL:
+  case IC_MEMCPYI:
+  case IC_MEMSETI: break;
+  case IC_ADD_LDI8:
+  case IC_ADD_LDU8:
+  case IC_ADD_LDI16:
+  case IC_ADD_LDU16:
+  case IC_ADD_LDI32:
+  case IC_ADD_LDU32:
+  case IC_ADD_LDI64:
+  case IC_ADD_LDF:
+  case IC_ADD_LDD:
+  case IC_ADD_ST8:
+  case IC_ADD_ST16:
+  case IC_ADD_ST32:
+  case IC_ADD_ST64:
+  case IC_ADD_STF:
+  case IC_ADD_STD:
+  case IC_MUL_ADD:
+  case IC_MOV_MOV:
+  case IC_ADDI:
+  case IC_ADDSI:
+  case IC_SUBI:
+  case IC_SUBSI:
+  case IC_ANDI:
+  case IC_LSHI: op_mode = MIR_OP_INT; break;
   default:
+    if (code >= IC_BEQI) break; /* superinstruction branches and addressing */
     op_mode = _MIR_insn_code_op_mode (ctx, (MIR_insn_code_t) code, 0, &out_p);
     if (op_mode == MIR_OP_BOUND || !out_p) op_mode = MIR_OP_UNDEF;
     break;
@@ -844,16 +1440,16 @@ static void finish_insn_trace (MIR_context_t ctx, MIR_full_insn_code_t code, cod
 }
 #endif
 
-static code_t call_insn_execute (MIR_context_t ctx, code_t pc, MIR_val_t *bp, code_t ops,
-                                 int imm_p) {
+static code_t call_insn_execute (MIR_context_t ctx, code_t pc, MIR_val_t *bp, MIR_val_t *pool,
+                                 code_t ops, void *func_addr) {
+#if MIR_INTERP_TRACE
   struct interp_ctx *interp_ctx = ctx->interp_ctx;
+#endif
   int64_t nops = get_i (ops); /* #args w/o nop, insn, and ff interface address */
-  MIR_insn_t insn = get_a (ops + 1);
-  MIR_item_t proto_item = get_a (ops + 3);
-  void *func_addr = imm_p ? get_a (ops + 4) : *get_aop (bp, ops + 4);
+  MIR_insn_t insn = get_pool_a (pool, ops + 1);
+  MIR_item_t proto_item = get_pool_a (pool, ops + 3);
   size_t start = proto_item->u.proto->nres + 5;
-
-  if (VARR_EXPAND (MIR_val_t, arg_vals_varr, nops)) arg_vals = VARR_ADDR (MIR_val_t, arg_vals_varr);
+  MIR_val_t *arg_vals = alloca ((nops - start + 3) * sizeof (MIR_val_t));
 
   for (size_t i = start; i < nops + 3; i++) arg_vals[i - start] = bp[get_i (ops + i)];
 
@@ -861,8 +1457,8 @@ static code_t call_insn_execute (MIR_context_t ctx, code_t pc, MIR_val_t *bp, co
   trace_insn_ident += 2;
 #endif
   call (ctx, bp, &insn->ops[proto_item->u.proto->nres + 2] /* arg ops */,
-        ops + 2 /* ffi address holder */, proto_item, func_addr, ops + 5 /* results start */,
-        nops - start + 3 /* arg # */);
+        get_pool_val (pool, ops + 2) /* ffi address holder */, proto_item, func_addr,
+        ops + 5 /* results start */, nops - start + 3 /* arg # */, arg_vals);
 #if MIR_INTERP_TRACE
   trace_insn_ident -= 2;
 #endif
@@ -870,10 +1466,264 @@ static code_t call_insn_execute (MIR_context_t ctx, code_t pc, MIR_val_t *bp, co
   return pc;
 }
 
-static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *bp,
-                           MIR_val_t *results) {
+static void stack_overflow_error (MIR_context_t ctx, const char *message) {
+  MIR_get_error_func (ctx) (MIR_stack_overflow_error, message);
+}
+
+/* Return a free interpreter stack.  Each entry to the interpreter from
+   C code uses its own stack.  The stack is marked by ENTRY_FRAME
+   (address on the C stack of the entry) if it is not NULL.
+
+   An error function or fuel handler can leave the interpretation by
+   longjmp without releasing the stack.  Such stack is reclaimed here:
+   a stack marked in the current thread by an entry not above the
+   current one on the C stack (which grows down) is not used anymore.  */
+static interp_stack_t get_interp_stack (MIR_context_t ctx, void *entry_frame) {
+  struct interp_ctx *interp_ctx = ctx->interp_ctx;
+  interp_stack_t stack = NULL;
+  interp_thread_t thread = interp_current_thread ();
+
+  if (mir_mutex_lock (&interp_mutex)) parallel_error (ctx, "error in mutex lock");
+  if (entry_frame != NULL)
+    for (stack = all_interp_stacks; stack != NULL; stack = stack->next)
+      if (stack->entry_frame != NULL && interp_thread_eq_p (stack->thread, thread)
+          && (uintptr_t) stack->entry_frame <= (uintptr_t) entry_frame) {
+        if (stack->seg != NULL) { /* pop all frames */
+          while (stack->seg->prev != NULL) stack->seg = stack->seg->prev;
+          stack->top = stack->seg->vals;
+          stack->bound = stack->seg->vals + stack->seg->size;
+        }
+        stack->entry_frame = NULL;
+        VARR_PUSH (interp_stack_t, free_interp_stacks, stack);
+      }
+  stack = NULL;
+  if (VARR_LENGTH (interp_stack_t, free_interp_stacks) != 0) {
+    stack = VARR_POP (interp_stack_t, free_interp_stacks);
+  } else if ((stack = malloc (sizeof (struct interp_stack))) != NULL) {
+    stack->next = all_interp_stacks;
+    all_interp_stacks = stack;
+    stack->seg = NULL;
+    stack->top = stack->bound = NULL;
+    stack->size = 0;
+  }
+  if (stack != NULL) {
+    stack->thread = thread;
+    stack->entry_frame = entry_frame;
+  }
+  if (mir_mutex_unlock (&interp_mutex)) parallel_error (ctx, "error in mutex unlock");
+  if (stack == NULL) MIR_get_error_func (ctx) (MIR_alloc_error, "no memory for interpreter stack");
+  stack->depth = 0;
+  stack->state = NULL;
+  stack->fuel_addr = _MIR_get_fuel_addr (ctx);
+  return stack;
+}
+
+static void release_interp_stack (MIR_context_t ctx, interp_stack_t stack) {
   struct interp_ctx *interp_ctx = ctx->interp_ctx;
+
+  if (mir_mutex_lock (&interp_mutex)) parallel_error (ctx, "error in mutex lock");
+  stack->entry_frame = NULL;
+  VARR_PUSH (interp_stack_t, free_interp_stacks, stack);
+  if (mir_mutex_unlock (&interp_mutex)) parallel_error (ctx, "error in mutex unlock");
+}
+
+static void free_interp_stack (interp_stack_t stack) {
+  stack_seg_t seg, next_seg;
+
+  if ((seg = stack->seg) != NULL) {
+    while (seg->prev != NULL) seg = seg->prev;
+    for (; seg != NULL; seg = next_seg) {
+      next_seg = seg->next;
+      free (seg);
+    }
+  }
+  free (stack);
+}
+
+static MIR_val_t *push_frame_in_new_seg (MIR_context_t ctx, interp_stack_t stack, size_t n) {
+  stack_seg_t next_seg, after_seg, seg = stack->seg;
+  size_t size;
+
+  if ((next_seg = seg == NULL ? NULL : seg->next) != NULL && next_seg->size < n) {
+    seg->next = NULL; /* the next segments are too small to reuse */
+    for (; next_seg != NULL; next_seg = after_seg) {
+      after_seg = next_seg->next;
+      stack->size -= next_seg->size;
+      free (next_seg);
+    }
+  }
+  if (next_seg == NULL) {
+    size = n < MIR_INTERP_STACK_SEG_SIZE ? MIR_INTERP_STACK_SEG_SIZE : n;
+    if (stack->size + size > MIR_INTERP_MAX_STACK_SIZE)
+      stack_overflow_error (ctx, "interpreter stack overflow");
+    if ((next_seg = malloc (offsetof (struct stack_seg, vals) + size * sizeof (MIR_val_t))) == NULL)
+      MIR_get_error_func (ctx) (MIR_alloc_error, "no memory for interpreter stack");
+    next_seg->prev = seg;
+    next_seg->next = NULL;
+    next_seg->size = size;
+    if (seg != NULL) seg->next = next_seg;
+    stack->size += size;
+  }
+  if (seg != NULL) seg->top = stack->top;
+  stack->seg = next_seg;
+  stack->top = next_seg->vals + n;
+  stack->bound = next_seg->vals + next_seg->size;
+  return next_seg->vals;
+}
+
+/* Allocate N values on top of STACK.  */
+static inline MIR_val_t *push_frame (MIR_context_t ctx, interp_stack_t stack, size_t n) {
+  MIR_val_t *frame = stack->top;
+
+  if ((size_t) (stack->bound - frame) < n) return push_frame_in_new_seg (ctx, stack, n);
+  stack->top = frame + n;
+  return frame;
+}
+
+static void pop_frames_in_prev_segs (interp_stack_t stack, MIR_val_t *top) {
+  stack_seg_t seg;
+
+  for (seg = stack->seg; seg->prev != NULL; seg = seg->prev) {
+    if (top == seg->vals) { /* all the segment is free */
+      seg = seg->prev;
+      top = seg->top;
+      break;
+    }
+    if (seg->vals < top && top <= seg->vals + seg->size) break;
+  }
+  stack->seg = seg;
+  stack->top = top;
+  stack->bound = seg->vals + seg->size;
+}
+
+/* Free all values of STACK starting with TOP.  */
+static inline void pop_frames (interp_stack_t stack, MIR_val_t *top) {
+  if (stack->seg->vals < top && top <= stack->bound)
+    stack->top = top;
+  else
+    pop_frames_in_prev_segs (stack, top);
+}
+
+/* Push a frame of interpreted function FUNC_DESC called by call insn
+   OPS of frame BP and pass the call args to it.  The frame starts with
+   NSAVED values for the caller, the callee results, and
+   FRAME_RESERVED_SIZE values.  Return the frame start.  */
+static MIR_val_t *push_call_frame (MIR_context_t ctx, interp_stack_t stack, MIR_val_t *bp,
+                                   MIR_val_t *pool, code_t ops, func_desc_t func_desc,
+                                   size_t nsaved) {
+  int64_t nops = get_i (ops); /* #args w/o nop, insn, and ff interface address */
+  MIR_item_t proto_item = get_pool_a (pool, ops + 3);
+  MIR_var_t *arg_vars = VARR_ADDR (MIR_var_t, func_desc->func_item->u.func->vars);
+  size_t i, nres = proto_item->u.proto->nres, start = nres + 5, nargs = nops - start + 3;
+  MIR_val_t *frame, *callee_bp, v;
+
+  if (++stack->depth > MIR_INTERP_MAX_CALL_DEPTH)
+    stack_overflow_error (ctx, "interpreter call depth overflow");
+  frame = push_frame (ctx, stack, nsaved + nres + FRAME_RESERVED_SIZE + func_desc->nregs);
+  callee_bp = frame + nsaved + nres + FRAME_RESERVED_SIZE;
+  callee_bp[-1].a = NULL;
+  callee_bp[0].i = 0;
+  if (func_desc->nregs < nargs + 1) nargs = func_desc->nregs - 1;
+  for (i = 0; i < nargs; i++) {
+    v = bp[get_i (ops + start + i)];
+    switch (arg_vars[i].type) {
+    case MIR_T_I8: v.i = (int8_t) v.i; break;
+    case MIR_T_U8: v.i = (uint8_t) v.i; break;
+    case MIR_T_I16: v.i = (int16_t) v.i; break;
+    case MIR_T_U16: v.i = (uint16_t) v.i; break;
+    case MIR_T_I32: v.i = (int32_t) v.i; break;
+    case MIR_T_U32: v.i = (uint32_t) v.i; break;
+    default: break;
+    }
+    callee_bp[i + 1] = v;
+  }
+  return frame;
+}
+
+/* Move RESULTS of the interpreted function called by call insn OPS to
+   the result regs of frame BP.  */
+static void copy_call_results (MIR_val_t *bp, MIR_val_t *pool, code_t ops, MIR_val_t *results) {
+  MIR_item_t proto_item = get_pool_a (pool, ops + 3);
+  MIR_proto_t proto = proto_item->u.proto;
+  MIR_val_t *res;
+
+  for (size_t i = 0; i < proto->nres; i++) {
+    res = &bp[get_i (ops + 5 + i)];
+    switch (proto->res_types[i]) {
+    case MIR_T_I8: res->i = (int8_t) (results[i].i); break;
+    case MIR_T_U8: res->u = (uint8_t) (results[i].u); break;
+    case MIR_T_I16: res->i = (int16_t) (results[i].i); break;
+    case MIR_T_U16: res->u = (uint16_t) (results[i].u); break;
+    case MIR_T_I32: res->i = (int32_t) (results[i].i); break;
+    case MIR_T_U32: res->u = (uint32_t) (results[i].u); break;
+    default: *res = results[i]; break;
+    }
+  }
+}
+
+/* Return func item with interp interface called indirectly through
+   ADDR if the call can be done by a direct frame push.  */
+static MIR_item_t find_icall_func_item (MIR_context_t ctx, void *addr, MIR_val_t *pool,
+                                        code_t ops) {
+  struct interp_ctx *interp_ctx = ctx->interp_ctx;
+  struct MIR_item item;
+  MIR_item_t tab_item, proto_item = get_pool_a (pool, ops + 3);
+
+  item.addr = addr;
+  if (!HTAB_DO (MIR_item_t, icall_func_tab, &item, HTAB_FIND, tab_item)
+      || tab_item->u.func->machine_code != NULL
+      || !icall_proto_p (tab_item->u.func, proto_item->u.proto, get_i (ops)))
+    return NULL;
+  return tab_item;
+}
+
+static void suspend_interp (MIR_interp_state_t state, func_desc_t func_desc, MIR_val_t *bp,
+                            MIR_val_t *results, code_t pc) {
+  state->func_desc = func_desc;
+  state->bp = bp;
+  state->frame_results = results;
+  state->pc = pc;
+  state->yield_p = FALSE;
+  state->suspended_p = TRUE;
+}
+
+/* Call the fuel handler of the suspendable interpretation or the
+   context when the fuel counter of STACK becomes negative: */
+static void interp_fuel_exhausted (MIR_context_t ctx, interp_stack_t stack) {
+  MIR_interp_state_t state = stack->state;
+
+  if (state == NULL) {
+    _MIR_fuel_exhausted (ctx);
+  } else if (state->exhausted_handler == NULL) {
+    MIR_get_error_func (ctx) (MIR_fuel_exhausted_error, "execution fuel is exhausted");
+  } else {
+    state->exhausted_handler (ctx, state->exhausted_handler_data);
+  }
+}
+
+static void resumable_setjmp_error (MIR_context_t ctx) {
+  MIR_get_error_func (ctx) (MIR_call_op_error,
+                            "setjmp can not be used in suspendable interpretation");
+}
+
+/* Evaluate code of FUNC_DESC with frame BP starting with insn START_PC
+   (or the first insn if it is NULL) and put the function results into
+   RESULTS.  Calls of interpreted functions are evaluated in the same
+   eval without C recursion.  Setjmp is called only in the first frame
+   of eval: to call it in a frame of a called function, the rest of the
+   function is evaluated by a new eval.  */
+static void OPTIMIZE eval (MIR_context_t ctx, interp_stack_t stack, func_desc_t func_desc,
+                           MIR_val_t *bp, MIR_val_t *results, code_t start_pc) {
+#if DIRECT_THREADED_DISPATCH
+  struct interp_ctx *interp_ctx = ctx->interp_ctx;
+#endif
   code_t pc, ops, code;
+  MIR_val_t *pool;
+  size_t depth;
+  int overflow_p = FALSE; /* set up by the last overflow insn */
+  /* Never changed, so they are valid after longjmp to setjmp called in the first frame: */
+  func_desc_t const first_func_desc = func_desc;
+  MIR_val_t *const first_bp = bp, *const first_results = results;
 
 #if MIR_INTERP_TRACE
   MIR_full_insn_code_t trace_insn_code;
@@ -893,9 +1743,10 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
 #endif
 
 #if DIRECT_THREADED_DISPATCH
-  void **ltab = dispatch_label_tab;
+  int32_t *ltab = dispatch_label_tab;
 
-#define LAB_EL(i) ltab[i] = &&L_##i
+  /* Labels are kept as 32-bit offsets from the first insn label: */
+#define LAB_EL(i) ltab[i] = (int32_t) ((char *) &&L_##i - (char *) &&L_MIR_MOV)
 #define REP_SEP ;
   if (bp == NULL) {
     REP4 (LAB_EL, MIR_MOV, MIR_FMOV, MIR_DMOV, MIR_LDMOV);
@@ -912,19 +1763,37 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
     REP8 (LAB_EL, MIR_ULT, MIR_ULTS, MIR_FLT, MIR_DLT, MIR_LDLT, MIR_LE, MIR_LES, MIR_ULE);
     REP8 (LAB_EL, MIR_ULES, MIR_FLE, MIR_DLE, MIR_LDLE, MIR_GT, MIR_GTS, MIR_UGT, MIR_UGTS);
     REP8 (LAB_EL, MIR_FGT, MIR_DGT, MIR_LDGT, MIR_GE, MIR_GES, MIR_UGE, MIR_UGES, MIR_FGE);
-    REP8 (LAB_EL, MIR_DGE, MIR_LDGE, MIR_JMP, MIR_BT, MIR_BTS, MIR_BF, MIR_BFS, MIR_BEQ);
+    REP8 (LAB_EL, MIR_DGE, MIR_LDGE, MIR_ADDO, MIR_ADDOS, MIR_SUBO, MIR_SUBOS, MIR_MULO, MIR_MULOS);
+    REP8 (LAB_EL, MIR_UMULO, MIR_UMULOS, MIR_JMP, MIR_BT, MIR_BTS, MIR_BF, MIR_BFS, MIR_BO);
+    REP4 (LAB_EL, MIR_UBO, MIR_BNO, MIR_UBNO, MIR_BEQ);
     REP8 (LAB_EL, MIR_BEQS, MIR_FBEQ, MIR_DBEQ, MIR_LDBEQ, MIR_BNE, MIR_BNES, MIR_FBNE, MIR_DBNE);
     REP8 (LAB_EL, MIR_LDBNE, MIR_BLT, MIR_BLTS, MIR_UBLT, MIR_UBLTS, MIR_FBLT, MIR_DBLT, MIR_LDBLT);
     REP8 (LAB_EL, MIR_BLE, MIR_BLES, MIR_UBLE, MIR_UBLES, MIR_FBLE, MIR_DBLE, MIR_LDBLE, MIR_BGT);
     REP8 (LAB_EL, MIR_BGTS, MIR_UBGT, MIR_UBGTS, MIR_FBGT, MIR_DBGT, MIR_LDBGT, MIR_BGE, MIR_BGES);
     REP5 (LAB_EL, MIR_UBGE, MIR_UBGES, MIR_FBGE, MIR_DBGE, MIR_LDBGE);
     REP4 (LAB_EL, MIR_CALL, MIR_INLINE, MIR_SWITCH, MIR_RET);
-    REP3 (LAB_EL, MIR_ALLOCA, MIR_BSTART, MIR_BEND);
+    REP5 (LAB_EL, MIR_ALLOCA, MIR_BSTART, MIR_BEND, MIR_MEMCPY, MIR_MEMSET);
     REP4 (LAB_EL, MIR_VA_ARG, MIR_VA_BLOCK_ARG, MIR_VA_START, MIR_VA_END);
     REP8 (LAB_EL, IC_LDI8, IC_LDU8, IC_LDI16, IC_LDU16, IC_LDI32, IC_LDU32, IC_LDI64, IC_LDF);
     REP8 (LAB_EL, IC_LDD, IC_LDLD, IC_STI8, IC_STU8, IC_STI16, IC_STU16, IC_STI32, IC_STU32);
     REP8 (LAB_EL, IC_STI64, IC_STF, IC_STD, IC_STLD, IC_MOVI, IC_MOVP, IC_MOVF, IC_MOVD);
-    REP2 (LAB_EL, IC_MOVLD, IC_IMM_CALL);
+    REP5 (LAB_EL, IC_MOVLD, IC_IMM_CALL, IC_IMM_ICALL, IC_MEMCPYI, IC_MEMSETI);
+    REP8 (LAB_EL, IC_BEQI, IC_BNEI, IC_BLTI, IC_BLEI, IC_BGTI, IC_BGEI, IC_UBLTI, IC_UBLEI);
+    REP8 (LAB_EL, IC_UBGTI, IC_UBGEI, IC_BEQSI, IC_BNESI, IC_BLTSI, IC_BLESI, IC_BGTSI, IC_BGESI);
+    REP4 (LAB_EL, IC_UBLTSI, IC_UBLESI, IC_UBGTSI, IC_UBGESI);
+    REP8 (LAB_EL, IC_ADD_LDI8, IC_ADD_LDU8, IC_ADD_LDI16, IC_ADD_LDU16, IC_ADD_LDI32, IC_ADD_LDU32,
+          IC_ADD_LDI64, IC_ADD_LDF);
+    REP7 (LAB_EL, IC_ADD_LDD, IC_ADD_ST8, IC_ADD_ST16, IC_ADD_ST32, IC_ADD_ST64, IC_ADD_STF,
+          IC_ADD_STD);
+    REP8 (LAB_EL, IC_ADD_BLT, IC_ADD_BLE, IC_ADD_BNE, IC_ADDS_BLTS, IC_ADDS_BLES, IC_ADDS_BNES,
+          IC_MUL_ADD, IC_MOV_MOV);
+    REP6 (LAB_EL, IC_ADDI, IC_ADDSI, IC_SUBI, IC_SUBSI, IC_ANDI, IC_LSHI);
+    REP8 (LAB_EL, IC_ADDI_LDI8, IC_ADDI_LDU8, IC_ADDI_LDI16, IC_ADDI_LDU16, IC_ADDI_LDI32,
+          IC_ADDI_LDU32, IC_ADDI_LDI64, IC_ADDI_LDF);
+    REP7 (LAB_EL, IC_ADDI_LDD, IC_ADDI_ST8, IC_ADDI_ST16, IC_ADDI_ST32, IC_ADDI_ST64, IC_ADDI_STF,
+          IC_ADDI_STD);
+    LAB_EL (IC_PROF);
+    LAB_EL (IC_FUEL);
     return;
   }
 #undef REP_SEP
@@ -933,9 +1802,9 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
 #if MIR_INTERP_TRACE
 #define END_INSN                                     \
   finish_insn_trace (ctx, trace_insn_code, ops, bp); \
-  goto * pc->a
+  goto * (void *) ((char *) &&L_MIR_MOV + pc->i)
 #else
-#define END_INSN goto * pc->a
+#define END_INSN goto * (void *) ((char *) &&L_MIR_MOV + pc->i)
 #endif
 
 #else
@@ -960,14 +1829,93 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
     END_INSN;                  \
   }
 
+/* Suspend the suspendable interpretation if it was requested.  It is
+   done only after insns which can execute C code: */
+#define CHECK_YIELD                                                   \
+  if (stack->state != NULL && stack->state->yield_p) {                \
+    suspend_interp (stack->state, func_desc, bp, results, pc);        \
+    return;                                                           \
+  }
+
+/* Call of interpreted function without C recursion: */
+#define INTERP_CALL(func_item)                                                                \
+  do {                                                                                        \
+    func_desc_t callee_desc = get_func_desc (ctx, func_item);                                 \
+    MIR_val_t *caller_state                                                                   \
+      = push_call_frame (ctx, stack, bp, pool, ops, callee_desc, CALLER_STATE_SIZE);          \
+                                                                                              \
+    caller_state[0].a = func_desc;                                                            \
+    caller_state[1].a = bp;                                                                   \
+    caller_state[2].a = ops;                                                                  \
+    caller_state[3].a = results;                                                              \
+    results = caller_state + CALLER_STATE_SIZE;                                               \
+    bp = results + ((MIR_item_t) get_pool_a (pool, ops + 3))->u.proto->nres                  \
+         + FRAME_RESERVED_SIZE;                                                               \
+    func_desc = callee_desc;                                                                  \
+    pool = func_desc->pool;                                                                   \
+    pc = code = func_desc->code;                                                              \
+  } while (0)
+
+/* Return from a called interpreted function whose results are already in RESULTS: */
+#define RETURN_TO_CALLER                                                    \
+  do {                                                                      \
+    MIR_val_t *caller_state = results - CALLER_STATE_SIZE;                  \
+                                                                            \
+    func_desc = caller_state[0].a;                                          \
+    bp = caller_state[1].a;                                                 \
+    ops = caller_state[2].a;                                                \
+    pool = func_desc->pool;                                                 \
+    code = func_desc->code;                                                 \
+    copy_call_results (bp, pool, ops, results);                             \
+    results = caller_state[3].a;                                            \
+    pop_frames (stack, caller_state);                                       \
+    stack->depth--;                                                         \
+    pc = ops + get_i (ops) + 3; /* nops, the call insn, ff interface addr */ \
+  } while (0)
+
+/* Call setjmp at FUNC_ADDR by call insn OPS in the first frame.  Otherwise make the current frame
+   the first one of a new eval: */
+#define SETJMP_CALL(func_addr)                                                                 \
+  do {                                                                                         \
+    int res;                                                                                   \
+    int64_t nops = get_i (ops); /* #args w/o nop, insn, and ff interface address */            \
+    MIR_item_t proto_item = get_pool_a (pool, ops + 3);                                        \
+    size_t start = proto_item->u.proto->nres + 5;                                              \
+                                                                                               \
+    if (stack->state != NULL) resumable_setjmp_error (ctx);                                    \
+    if (stack->depth != depth) {                                                               \
+      eval (ctx, stack, func_desc, bp, results, ops - (MIR_INTERP_TRACE ? 2 : 1));              \
+      RETURN_TO_CALLER;                                                                        \
+    } else {                                                                                   \
+      bp[-3].a = stack->top;                                                                   \
+      bp[-2].a = ops;                                                                          \
+      res = (*func_addr) (*get_aop (bp, ops + start));                                         \
+      /* Restore the first frame and pop frames of the called functions after longjmp: */      \
+      func_desc = first_func_desc;                                                             \
+      bp = first_bp;                                                                           \
+      results = first_results;                                                                 \
+      pool = func_desc->pool;                                                                  \
+      code = func_desc->code;                                                                  \
+      pop_frames (stack, bp[-3].a);                                                            \
+      stack->depth = depth;                                                                    \
+      ops = bp[-2].a;                                                                          \
+      nops = get_i (ops);                                                                      \
+      bp[get_i (ops + 5)].i = res;                                                             \
+      pc = ops + nops + 3; /* nops itself, the call insn, add ff interface address */          \
+    }                                                                                          \
+  } while (0)
+
+  pool = func_desc->pool;
   code = func_desc->code;
-  pc = code;
+  pc = start_pc != NULL ? start_pc : code;
+  depth = stack->depth;
+  if (stack->state != NULL) depth = 0; /* suspendable interpretation */
 
 #if DIRECT_THREADED_DISPATCH
-  goto * pc->a;
+  goto * (void *) ((char *) &&L_MIR_MOV + pc->i);
 #else
   for (;;) {
-    int insn_code = pc->ic;
+    int insn_code = pc->i;
     switch (insn_code) {
 #endif
 
@@ -1201,6 +2149,90 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
   SCASE (MIR_DGE, 3, DCMP (>=));
   SCASE (MIR_LDGE, 3, LDCMP (>=));
 
+  CASE (MIR_ADDO, 3) {
+    int64_t *r, p1, p2;
+    uint64_t res;
+
+    r = get_3iops (bp, ops, &p1, &p2);
+    res = (uint64_t) p1 + (uint64_t) p2;
+    overflow_p = ((res ^ p1) & (res ^ p2)) >> 63;
+    *r = res;
+    END_INSN;
+  }
+  CASE (MIR_ADDOS, 3) {
+    int64_t *r, res;
+    int32_t p1, p2;
+
+    r = get_3isops (bp, ops, &p1, &p2);
+    res = (int64_t) p1 + p2;
+    overflow_p = res != (int32_t) res;
+    *r = (int32_t) res;
+    END_INSN;
+  }
+  CASE (MIR_SUBO, 3) {
+    int64_t *r, p1, p2;
+    uint64_t res;
+
+    r = get_3iops (bp, ops, &p1, &p2);
+    res = (uint64_t) p1 - (uint64_t) p2;
+    overflow_p = ((p1 ^ p2) & (p1 ^ res)) >> 63;
+    *r = res;
+    END_INSN;
+  }
+  CASE (MIR_SUBOS, 3) {
+    int64_t *r, res;
+    int32_t p1, p2;
+
+    r = get_3isops (bp, ops, &p1, &p2);
+    res = (int64_t) p1 - p2;
+    overflow_p = res != (int32_t) res;
+    *r = (int32_t) res;
+    END_INSN;
+  }
+  CASE (MIR_MULO, 3) {
+    int64_t *r, p1, p2, res;
+
+    r = get_3iops (bp, ops, &p1, &p2);
+    res = (int64_t) ((uint64_t) p1 * (uint64_t) p2);
+    if (p1 == 0)
+      overflow_p = FALSE;
+    else if (p1 == -1)
+      overflow_p = p2 == INT64_MIN;
+    else
+      overflow_p = res / p1 != p2;
+    *r = res;
+    END_INSN;
+  }
+  CASE (MIR_MULOS, 3) {
+    int64_t *r, res;
+    int32_t p1, p2;
+
+    r = get_3isops (bp, ops, &p1, &p2);
+    res = (int64_t) p1 * p2;
+    overflow_p = res != (int32_t) res;
+    *r = (int32_t) res;
+    END_INSN;
+  }
+  CASE (MIR_UMULO, 3) {
+    uint64_t *r, p1, p2, res;
+
+    r = get_3uops (bp, ops, &p1, &p2);
+    res = p1 * p2;
+    overflow_p = p1 != 0 && res / p1 != p2;
+    *r = res;
+    END_INSN;
+  }
+  CASE (MIR_UMULOS, 3) {
+    uint64_t *r, res;
+    uint32_t p1, p2;
+
+    r = get_3usops (bp, ops, &p1, &p2);
+    res = (uint64_t) p1 * p2;
+    overflow_p = res > UINT32_MAX;
+    *r = (uint32_t) res;
+    END_INSN;
+  }
+
   SCASE (MIR_JMP, 1, pc = code + get_i (ops));
   CASE (MIR_BT, 2) {
     int64_t cond = *get_iop (bp, ops + 1);
@@ -1226,6 +2258,10 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
     if (!cond) pc = code + get_i (ops);
     END_INSN;
   }
+  SCASE (MIR_BO, 1, if (overflow_p) pc = code + get_i (ops));
+  SCASE (MIR_UBO, 1, if (overflow_p) pc = code + get_i (ops));
+  SCASE (MIR_BNO, 1, if (!overflow_p) pc = code + get_i (ops));
+  SCASE (MIR_UBNO, 1, if (!overflow_p) pc = code + get_i (ops));
   SCASE (MIR_BEQ, 3, BICMP (==));
   SCASE (MIR_BEQS, 3, BICMPS (==));
   SCASE (MIR_FBEQ, 3, BFCMP (==));
@@ -1267,43 +2303,43 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
 
   CASE (MIR_CALL, 0) {
     int (*func_addr) (void *buf) = *get_aop (bp, ops + 4);
+    MIR_item_t func_item;
 
     if (func_addr != setjmp_addr) {
-      pc = call_insn_execute (ctx, pc, bp, ops, FALSE);
+      if ((func_item = find_icall_func_item (ctx, func_addr, pool, ops)) == NULL)
+        pc = call_insn_execute (ctx, pc, bp, pool, ops, func_addr);
+      else
+        INTERP_CALL (func_item);
+      CHECK_YIELD;
     } else {
-      int res;
-      int64_t nops = get_i (ops); /* #args w/o nop, insn, and ff interface address */
-      MIR_item_t proto_item = get_a (ops + 3);
-      size_t start = proto_item->u.proto->nres + 5;
-      bp[-2].a = pc;
-      res = (*func_addr) (*get_aop (bp, ops + start));
-      ops = pc = bp[-2].a;
-      nops = get_i (ops);
-      bp[get_i (ops + 5)].i = res;
-      pc += nops + 3; /* nops itself, the call insn, add ff interface address */
+      SETJMP_CALL (func_addr);
     }
     END_INSN;
   }
   CASE (IC_IMM_CALL, 0) {
-    int (*func_addr) (void *buf) = get_a (ops + 4);
+    int (*func_addr) (void *buf) = get_pool_a (pool, ops + 4);
 
     if (func_addr != setjmp_addr) {
-      pc = call_insn_execute (ctx, pc, bp, ops, TRUE);
+      pc = call_insn_execute (ctx, pc, bp, pool, ops, func_addr);
+      CHECK_YIELD;
     } else {
-      int res;
-      int64_t nops = get_i (ops); /* #args w/o nop, insn, and ff interface address */
-      MIR_item_t proto_item = get_a (ops + 3);
-      size_t start = proto_item->u.proto->nres + 5;
-      bp[-2].a = pc;
-      res = (*func_addr) (*get_aop (bp, ops + start));
-      ops = pc = bp[-2].a;
-      nops = get_i (ops);
-      bp[get_i (ops + 5)].i = res;
-      pc += nops + 3; /* nops itself, the call insn, add ff interface address */
+      SETJMP_CALL (func_addr);
     }
     END_INSN;
   }
 
+  CASE (IC_IMM_ICALL, 0) {
+    MIR_item_t func_item = get_pool_a (pool, ops + 4);
+
+    /* The function can be redirected to generated machine code after icode generation: */
+    if (func_item->u.func->machine_code != NULL)
+      pc = call_insn_execute (ctx, pc, bp, pool, ops, func_item->addr);
+    else
+      INTERP_CALL (func_item);
+    CHECK_YIELD;
+    END_INSN;
+  }
+
   SCASE (MIR_INLINE, 0, mir_assert (FALSE));
 
   CASE (MIR_SWITCH, 0) {
@@ -1319,25 +2355,31 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
     int64_t nops = get_i (ops); /* #ops */
 
     for (int64_t i = 0; i < nops; i++) results[i] = bp[get_i (ops + i + 1)];
-    pc += nops + 1;
-    return;
+    if (stack->depth == depth) return;
+    RETURN_TO_CALLER;
     END_INSN;
   }
 
+  /* Memory is allocated on the interpreter stack as frames of called functions are there too: */
   CASE (MIR_ALLOCA, 2) {
     int64_t *r, s;
 
     r = get_2iops (bp, ops, &s);
-    *r = (uint64_t) alloca (s);
+    *r = (uint64_t) push_frame (ctx, stack, (s + sizeof (MIR_val_t) - 1) / sizeof (MIR_val_t));
     END_INSN;
   }
-  CASE (MIR_BSTART, 1) {
-    void **p = get_aop (bp, ops);
-
-    *p = bstart_builtin ();
-    END_INSN;
-  }
-  SCASE (MIR_BEND, 1, bend_builtin (*get_aop (bp, ops)));
+  SCASE (MIR_BSTART, 1, *get_aop (bp, ops) = stack->top);
+  SCASE (MIR_BEND, 1, pop_frames (stack, *get_aop (bp, ops)));
+  /* The block size is the first operand in the interpreter code: */
+  SCASE (MIR_MEMCPY, 3,
+         memcpy (*get_aop (bp, ops + 1), *get_aop (bp, ops + 2), *get_uop (bp, ops)));
+  SCASE (MIR_MEMSET, 3,
+         memset (*get_aop (bp, ops + 1), (int) *get_iop (bp, ops + 2), *get_uop (bp, ops)));
+  SCASE (IC_MEMCPYI, 3,
+         memcpy (*get_aop (bp, ops + 1), *get_aop (bp, ops + 2), get_pool_val (pool, ops)->u));
+  SCASE (IC_MEMSETI, 3,
+         memset (*get_aop (bp, ops + 1), (int) *get_iop (bp, ops + 2),
+                 get_pool_val (pool, ops)->u));
   CASE (MIR_VA_ARG, 3) {
     int64_t *r, va, tp;
 
@@ -1367,7 +2409,7 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
   SCASE (IC_LDD, 2, LD (dop, double, double));
   SCASE (IC_LDLD, 2, LD (ldop, long double, long double));
   CASE (IC_MOVP, 2) {
-    void **r = get_aop (bp, ops), *a = get_a (ops + 1);
+    void **r = get_aop (bp, ops), *a = get_pool_a (pool, ops + 1);
     *r = a;
     END_INSN;
   }
@@ -1392,15 +2434,104 @@ static void OPTIMIZE eval (MIR_context_t ctx, func_desc_t func_desc, MIR_val_t *
     END_INSN;
   }
   CASE (IC_MOVD, 2) {
-    double *r = get_dop (bp, ops), imm = get_d (ops + 1);
+    double *r = get_dop (bp, ops), imm = get_pool_val (pool, ops + 1)->d;
     *r = imm;
     END_INSN;
   }
   CASE (IC_MOVLD, 2) {
-    long double *r = get_ldop (bp, ops), imm = get_ld (ops + 1);
+    long double *r = get_ldop (bp, ops), imm = get_pool_val (pool, ops + 1)->ld;
     *r = imm;
     END_INSN;
   }
+
+  SCASE (IC_BEQI, 4, BICMPI (int64_t, ==));
+  SCASE (IC_BNEI, 4, BICMPI (int64_t, !=));
+  SCASE (IC_BLTI, 4, BICMPI (int64_t, <));
+  SCASE (IC_BLEI, 4, BICMPI (int64_t, <=));
+  SCASE (IC_BGTI, 4, BICMPI (int64_t, >));
+  SCASE (IC_BGEI, 4, BICMPI (int64_t, >=));
+  SCASE (IC_UBLTI, 4, BICMPI (uint64_t, <));
+  SCASE (IC_UBLEI, 4, BICMPI (uint64_t, <=));
+  SCASE (IC_UBGTI, 4, BICMPI (uint64_t, >));
+  SCASE (IC_UBGEI, 4, BICMPI (uint64_t, >=));
+  SCASE (IC_BEQSI, 4, BICMPI (int32_t, ==));
+  SCASE (IC_BNESI, 4, BICMPI (int32_t, !=));
+  SCASE (IC_BLTSI, 4, BICMPI (int32_t, <));
+  SCASE (IC_BLESI, 4, BICMPI (int32_t, <=));
+  SCASE (IC_BGTSI, 4, BICMPI (int32_t, >));
+  SCASE (IC_BGESI, 4, BICMPI (int32_t, >=));
+  SCASE (IC_UBLTSI, 4, BICMPI (uint32_t, <));
+  SCASE (IC_UBLESI, 4, BICMPI (uint32_t, <=));
+  SCASE (IC_UBGTSI, 4, BICMPI (uint32_t, >));
+  SCASE (IC_UBGESI, 4, BICMPI (uint32_t, >=));
+
+  SCASE (IC_ADD_LDI8, 4, ADD_LD (iop, int64_t, int8_t));
+  SCASE (IC_ADD_LDU8, 4, ADD_LD (uop, uint64_t, uint8_t));
+  SCASE (IC_ADD_LDI16, 4, ADD_LD (iop, int64_t, int16_t));
+  SCASE (IC_ADD_LDU16, 4, ADD_LD (uop, uint64_t, uint16_t));
+  SCASE (IC_ADD_LDI32, 4, ADD_LD (iop, int64_t, int32_t));
+  SCASE (IC_ADD_LDU32, 4, ADD_LD (uop, uint64_t, uint32_t));
+  SCASE (IC_ADD_LDI64, 4, ADD_LD (iop, int64_t, int64_t));
+  SCASE (IC_ADD_LDF, 4, ADD_LD (fop, float, float));
+  SCASE (IC_ADD_LDD, 4, ADD_LD (dop, double, double));
+  SCASE (IC_ADD_ST8, 4, ADD_ST (iop, int64_t, int8_t));
+  SCASE (IC_ADD_ST16, 4, ADD_ST (iop, int64_t, int16_t));
+  SCASE (IC_ADD_ST32, 4, ADD_ST (iop, int64_t, int32_t));
+  SCASE (IC_ADD_ST64, 4, ADD_ST (iop, int64_t, int64_t));
+  SCASE (IC_ADD_STF, 4, ADD_ST (fop, float, float));
+  SCASE (IC_ADD_STD, 4, ADD_ST (dop, double, double));
+
+  SCASE (IC_ADD_BLT, 5, ADD_BICMP (int64_t, <));
+  SCASE (IC_ADD_BLE, 5, ADD_BICMP (int64_t, <=));
+  SCASE (IC_ADD_BNE, 5, ADD_BICMP (int64_t, !=));
+  SCASE (IC_ADDS_BLTS, 5, ADDS_BICMPS (<));
+  SCASE (IC_ADDS_BLES, 5, ADDS_BICMPS (<=));
+  SCASE (IC_ADDS_BNES, 5, ADDS_BICMPS (!=));
+
+  CASE (IC_MUL_ADD, 5) {
+    int64_t t = *get_iop (bp, ops + 1) * *get_iop (bp, ops + 2);
+
+    *get_iop (bp, ops) = t;
+    *get_iop (bp, ops + 3) = *get_iop (bp, ops + 4) + t;
+    END_INSN;
+  }
+  CASE (IC_MOV_MOV, 4) {
+    *get_iop (bp, ops) = *get_iop (bp, ops + 1);
+    *get_iop (bp, ops + 2) = *get_iop (bp, ops + 3);
+    END_INSN;
+  }
+
+  SCASE (IC_ADDI, 4, IOPI (+));
+  SCASE (IC_ADDSI, 4, IOPSI (+));
+  SCASE (IC_SUBI, 4, IOPI (-));
+  SCASE (IC_SUBSI, 4, IOPSI (-));
+  SCASE (IC_ANDI, 4, IOPI (&));
+  SCASE (IC_LSHI, 4, IOPI (<<));
+
+  SCASE (IC_ADDI_LDI8, 5, ADDI_LD (iop, int64_t, int8_t));
+  SCASE (IC_ADDI_LDU8, 5, ADDI_LD (uop, uint64_t, uint8_t));
+  SCASE (IC_ADDI_LDI16, 5, ADDI_LD (iop, int64_t, int16_t));
+  SCASE (IC_ADDI_LDU16, 5, ADDI_LD (uop, uint64_t, uint16_t));
+  SCASE (IC_ADDI_LDI32, 5, ADDI_LD (iop, int64_t, int32_t));
+  SCASE (IC_ADDI_LDU32, 5, ADDI_LD (uop, uint64_t, uint32_t));
+  SCASE (IC_ADDI_LDI64, 5, ADDI_LD (iop, int64_t, int64_t));
+  SCASE (IC_ADDI_LDF, 5, ADDI_LD (fop, float, float));
+  SCASE (IC_ADDI_LDD, 5, ADDI_LD (dop, double, double));
+  SCASE (IC_ADDI_ST8, 5, ADDI_ST (iop, int64_t, int8_t));
+  SCASE (IC_ADDI_ST16, 5, ADDI_ST (iop, int64_t, int16_t));
+  SCASE (IC_ADDI_ST32, 5, ADDI_ST (iop, int64_t, int32_t));
+  SCASE (IC_ADDI_ST64, 5, ADDI_ST (iop, int64_t, int64_t));
+  SCASE (IC_ADDI_STF, 5, ADDI_ST (fop, float, float));
+  SCASE (IC_ADDI_STD, 5, ADDI_ST (dop, double, double));
+
+  SCASE (IC_PROF, 1, (*(uint64_t *) get_pool_a (pool, ops))++);
+  CASE (IC_FUEL, 0) {
+    if (--*stack->fuel_addr < 0) {
+      interp_fuel_exhausted (ctx, stack);
+      CHECK_YIELD;
+    }
+    END_INSN;
+  }
 #if !DIRECT_THREADED_DISPATCH
 default: mir_assert (FALSE);
 }
@@ -1408,11 +2539,6 @@ default: mir_assert (FALSE);
 #endif
 }
 
-static inline func_desc_t get_func_desc (MIR_item_t func_item) {
-  mir_assert (func_item->item_type == MIR_func_item);
-  return func_item->data;
-}
-
 static htab_hash_t ff_interface_hash (ff_interface_t i, void *arg) {
   htab_hash_t h = mir_hash_step (mir_hash_init (0), i->nres);
   h = mir_hash_step (h, i->nargs);
@@ -1438,7 +2564,48 @@ static int ff_interface_eq (ff_interface_t i1, ff_interface_t i2, void *arg) {
   return TRUE;
 }
 
-static void ff_interface_clear (ff_interface_t ffi, void *arg) { free (ffi); }
+/* FF interfaces depend only on the call signature.  They are shared
+   by all contexts of the process: the interface code is kept in a
+   hidden context and the interfaces are found through a process-wide
+   table.  The table and the context are created by the first
+   interface request and destroyed when the last context which got
+   interfaces from the table is finished.  Contexts can be used by
+   different threads even without MIR_PARALLEL_GEN, so the table is
+   always protected by its own statically initialized mutex.  The
+   interface generation allocates code memory, so the lock can be
+   held for a long time.  */
+static HTAB (ff_interface_t) * ff_interface_tab = NULL;
+static MIR_context_t ff_interface_ctx = NULL;
+static size_t ff_interface_users_num = 0; /* # of contexts using the table */
+
+#if defined(_WIN32)
+static SRWLOCK ff_interface_mutex = SRWLOCK_INIT;
+#define ff_interface_lock() AcquireSRWLockExclusive (&ff_interface_mutex)
+#define ff_interface_unlock() ReleaseSRWLockExclusive (&ff_interface_mutex)
+#else
+static pthread_mutex_t ff_interface_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define ff_interface_lock() pthread_mutex_lock (&ff_interface_mutex)
+#define ff_interface_unlock() pthread_mutex_unlock (&ff_interface_mutex)
+#endif
+
+static MIR_error_func_t ff_interface_error_func;
+
+/* Error function used for the interface generation: it releases the
+   lock as the original error function might not return.  */
+static void MIR_NO_RETURN ff_interface_error (MIR_error_type_t error_type, const char *format,
+                                              ...) {
+  char message[256];
+  va_list args;
+  MIR_error_func_t caller_error_func = ff_interface_error_func;
+
+  va_start (args, format);
+  vsnprintf (message, sizeof (message), format, args);
+  va_end (args);
+  ff_interface_unlock ();
+  caller_error_func (error_type, "%s", message);
+}
+
+static void ff_interface_free (ff_interface_t ffi, void *arg) { free (ffi); }
 
 static void *get_ff_interface (MIR_context_t ctx, size_t arg_vars_num, size_t nres,
                                MIR_type_t *res_types, size_t nargs, _MIR_arg_desc_t *arg_descs,
@@ -1446,6 +2613,7 @@ static void *get_ff_interface (MIR_context_t ctx, size_t arg_vars_num, size_t nr
   struct interp_ctx *interp_ctx = ctx->interp_ctx;
   struct ff_interface ffi_s;
   ff_interface_t tab_ffi, ffi;
+  void *interface_addr;
   int htab_res;
 
   ffi_s.arg_vars_num = arg_vars_num;
@@ -1453,10 +2621,28 @@ static void *get_ff_interface (MIR_context_t ctx, size_t arg_vars_num, size_t nr
   ffi_s.nargs = nargs;
   ffi_s.res_types = res_types;
   ffi_s.arg_descs = arg_descs;
-  if (HTAB_DO (ff_interface_t, ff_interface_tab, &ffi_s, HTAB_FIND, tab_ffi))
+  ff_interface_lock ();
+  if (ff_interface_tab == NULL) {
+    HTAB_CREATE_WITH_FREE_FUNC (ff_interface_t, ff_interface_tab, 1000, ff_interface_hash,
+                                ff_interface_eq, ff_interface_free, NULL);
+    ff_interface_ctx = MIR_init ();
+  }
+  if (!ff_interface_user_p) {
+    ff_interface_user_p = TRUE;
+    ff_interface_users_num++;
+  }
+  if (HTAB_DO (ff_interface_t, ff_interface_tab, &ffi_s, HTAB_FIND, tab_ffi)) {
+    ff_interface_unlock ();
     return tab_ffi->interface_addr;
+  }
+  ff_interface_error_func = MIR_get_error_func (ctx);
+  MIR_set_error_func (ff_interface_ctx, ff_interface_error);
+  interface_addr
+    = _MIR_get_ff_call (ff_interface_ctx, nres, res_types, nargs, arg_descs, arg_vars_num);
   ffi = malloc (sizeof (struct ff_interface) + sizeof (_MIR_arg_desc_t) * nargs
                 + sizeof (MIR_type_t) * nres);
+  if (ffi == NULL) ff_interface_error (MIR_alloc_error, "no memory for ff interface");
+  ffi->interface_addr = interface_addr;
   ffi->arg_vars_num = arg_vars_num;
   ffi->nres = nres;
   ffi->nargs = nargs;
@@ -1464,18 +2650,38 @@ static void *get_ff_interface (MIR_context_t ctx, size_t arg_vars_num, size_t nr
   ffi->res_types = (MIR_type_t *) ((char *) ffi->arg_descs + nargs * sizeof (_MIR_arg_desc_t));
   memcpy (ffi->res_types, res_types, sizeof (MIR_type_t) * nres);
   memcpy (ffi->arg_descs, arg_descs, sizeof (_MIR_arg_desc_t) * nargs);
-  ffi->interface_addr
-    = _MIR_get_ff_call (ctx, nres, res_types, nargs, call_arg_descs, arg_vars_num);
   htab_res = HTAB_DO (ff_interface_t, ff_interface_tab, ffi, HTAB_INSERT, tab_ffi);
   mir_assert (!htab_res && ffi == tab_ffi);
+  ff_interface_unlock ();
   return ffi->interface_addr;
 }
 
-static void call (MIR_context_t ctx, MIR_val_t *bp, MIR_op_t *insn_arg_ops, code_t ffi_address_ptr,
-                  MIR_item_t proto_item, void *addr, code_t res_ops, size_t nargs) {
-  struct interp_ctx *interp_ctx = ctx->interp_ctx;
+/* Destroy the ff interface table and its context after finishing the
+   last context using them: */
+static void finish_ff_interface_user (void) {
+  HTAB (ff_interface_t) * tab = NULL;
+  MIR_context_t interface_ctx = NULL;
+
+  ff_interface_lock ();
+  mir_assert (ff_interface_users_num != 0);
+  if (--ff_interface_users_num == 0) {
+    tab = ff_interface_tab;
+    interface_ctx = ff_interface_ctx;
+    ff_interface_tab = NULL;
+    ff_interface_ctx = NULL;
+  }
+  ff_interface_unlock ();
+  if (tab == NULL) return;
+  HTAB_DESTROY (ff_interface_t, tab);
+  MIR_finish (interface_ctx);
+}
+
+static void call (MIR_context_t ctx, MIR_val_t *bp, MIR_op_t *insn_arg_ops,
+                  MIR_val_t *ffi_address_ptr, MIR_item_t proto_item, void *addr, code_t res_ops,
+                  size_t nargs, MIR_val_t *arg_vals) {
   size_t i, arg_vars_num, nres;
-  MIR_val_t *res;
+  MIR_val_t *res, *call_res_args;
+  _MIR_arg_desc_t *call_arg_descs;
   MIR_type_t type;
   MIR_var_t *arg_vars = NULL;
   MIR_proto_t proto = proto_item->u.proto;
@@ -1492,12 +2698,9 @@ static void call (MIR_context_t ctx, MIR_val_t *bp, MIR_op_t *insn_arg_ops, code
     arg_vars_num = VARR_LENGTH (MIR_var_t, proto->args);
   }
   nres = proto->nres;
-  if (VARR_EXPAND (MIR_val_t, call_res_args_varr, nargs + nres)
-      || VARR_EXPAND (_MIR_arg_desc_t, call_arg_descs_varr, nargs)) {
-    call_res_args = VARR_ADDR (MIR_val_t, call_res_args_varr);
-    call_arg_descs = VARR_ADDR (_MIR_arg_desc_t, call_arg_descs_varr);
-  }
-  if ((ff_interface_addr = ffi_address_ptr->a) == NULL) {
+  call_res_args = alloca ((nargs + nres) * sizeof (MIR_val_t));
+  if ((ff_interface_addr = load_acquire (&ffi_address_ptr->a)) == NULL) {
+    call_arg_descs = alloca (nargs * sizeof (_MIR_arg_desc_t));
     for (i = 0; i < nargs; i++) {
       if (i < arg_vars_num) {
         call_arg_descs[i].type = arg_vars[i].type;
@@ -1520,9 +2723,9 @@ static void call (MIR_context_t ctx, MIR_val_t *bp, MIR_op_t *insn_arg_ops, code
                                                            : MIR_T_I64);
       }
     }
-    ff_interface_addr = ffi_address_ptr->a
-      = get_ff_interface (ctx, arg_vars_num, nres, proto->res_types, nargs, call_arg_descs,
-                          proto->vararg_p);
+    ff_interface_addr = get_ff_interface (ctx, arg_vars_num, nres, proto->res_types, nargs,
+                                          call_arg_descs, proto->vararg_p);
+    store_release (&ffi_address_ptr->a, ff_interface_addr);
   }
 
   for (i = 0; i < nargs; i++) {
@@ -1577,34 +2780,37 @@ static void interp_init (MIR_context_t ctx) {
   if ((interp_ctx = ctx->interp_ctx = malloc (sizeof (struct interp_ctx))) == NULL)
     MIR_get_error_func (ctx) (MIR_alloc_error, "Not enough memory for ctx");
 #if DIRECT_THREADED_DISPATCH
-  eval (ctx, NULL, NULL, NULL);
+  eval (ctx, NULL, NULL, NULL, NULL, NULL);
 #endif
+  if (mir_mutex_init (&interp_mutex, NULL)) parallel_error (ctx, "error in mutex init");
   VARR_CREATE (MIR_insn_t, branches, 0);
-  VARR_CREATE (MIR_val_t, code_varr, 0);
-  VARR_CREATE (MIR_val_t, arg_vals_varr, 0);
-  arg_vals = VARR_ADDR (MIR_val_t, arg_vals_varr);
-  VARR_CREATE (MIR_val_t, call_res_args_varr, 0);
-  VARR_CREATE (_MIR_arg_desc_t, call_arg_descs_varr, 0);
-  call_res_args = VARR_ADDR (MIR_val_t, call_res_args_varr);
-  call_arg_descs = VARR_ADDR (_MIR_arg_desc_t, call_arg_descs_varr);
-  HTAB_CREATE_WITH_FREE_FUNC (ff_interface_t, ff_interface_tab, 1000, ff_interface_hash,
-                              ff_interface_eq, ff_interface_clear, NULL);
+  VARR_CREATE (icode_t, code_varr, 0);
+  VARR_CREATE (MIR_val_t, pool_varr, 0);
+  HTAB_CREATE (MIR_item_t, icall_func_tab, 512, icall_func_hash, icall_func_eq, NULL);
+  all_interp_stacks = NULL;
+  VARR_CREATE (interp_stack_t, free_interp_stacks, 0);
+  profile_p = FALSE;
+  ff_interface_user_p = FALSE;
 #if MIR_INTERP_TRACE
   trace_insn_ident = 0;
 #endif
-  bstart_builtin = _MIR_get_bstart_builtin (ctx);
-  bend_builtin = _MIR_get_bend_builtin (ctx);
 }
 
 static void interp_finish (MIR_context_t ctx) {
   struct interp_ctx *interp_ctx = ctx->interp_ctx;
+  interp_stack_t stack, next_stack;
 
   VARR_DESTROY (MIR_insn_t, branches);
-  VARR_DESTROY (MIR_val_t, code_varr);
-  VARR_DESTROY (MIR_val_t, arg_vals_varr);
-  VARR_DESTROY (MIR_val_t, call_res_args_varr);
-  VARR_DESTROY (_MIR_arg_desc_t, call_arg_descs_varr);
-  HTAB_DESTROY (ff_interface_t, ff_interface_tab);
+  VARR_DESTROY (icode_t, code_varr);
+  VARR_DESTROY (MIR_val_t, pool_varr);
+  HTAB_DESTROY (MIR_item_t, icall_func_tab);
+  for (stack = all_interp_stacks; stack != NULL; stack = next_stack) {
+    next_stack = stack->next;
+    free_interp_stack (stack);
+  }
+  VARR_DESTROY (interp_stack_t, free_interp_stacks);
+  if (mir_mutex_destroy (&interp_mutex)) parallel_error (ctx, "error in mutex destroy");
+  if (ff_interface_user_p) finish_ff_interface_user ();
   /* Clear func descs???  */
   free (ctx->interp_ctx);
   ctx->interp_ctx = NULL;
@@ -1619,19 +2825,18 @@ typedef va_list va_t;
 static void interp_arr_varg (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t *results,
                              size_t nargs, MIR_val_t *vals, va_t va) {
   func_desc_t func_desc;
+  interp_stack_t stack = get_interp_stack (ctx, &func_desc);
   MIR_val_t *bp;
 
-  mir_assert (func_item->item_type == MIR_func_item);
-  if (func_item->data == NULL) generate_icode (ctx, func_item);
-  func_desc = get_func_desc (func_item);
-  bp = alloca ((func_desc->nregs + 2) * sizeof (MIR_val_t));
-  bp++; /* reserved for setjmp/longjmp */
-  bp[0].a = va;
-  bp++;
+  func_desc = get_func_desc (ctx, func_item);
+  bp = push_frame (ctx, stack, func_desc->nregs + FRAME_RESERVED_SIZE) + FRAME_RESERVED_SIZE;
+  bp[-1].a = va;
   if (func_desc->nregs < nargs + 1) nargs = func_desc->nregs - 1;
   bp[0].i = 0;
   memcpy (&bp[1], vals, sizeof (MIR_val_t) * nargs);
-  eval (ctx, func_desc, bp, results);
+  eval (ctx, stack, func_desc, bp, results, NULL);
+  pop_frames (stack, bp - FRAME_RESERVED_SIZE);
+  release_interp_stack (ctx, stack);
   if (va != NULL)
 #if VA_LIST_IS_ARRAY_P
     va_end (va);
@@ -1641,12 +2846,10 @@ static void interp_arr_varg (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t
 }
 
 void MIR_interp (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t *results, size_t nargs, ...) {
-  struct interp_ctx *interp_ctx = ctx->interp_ctx;
   va_list argp;
   size_t i;
+  MIR_val_t *arg_vals = alloca (nargs * sizeof (MIR_val_t));
 
-  if (VARR_EXPAND (MIR_val_t, arg_vals_varr, nargs))
-    arg_vals = VARR_ADDR (MIR_val_t, arg_vals_varr);
   va_start (argp, nargs);
   for (i = 0; i < nargs; i++) arg_vals[i] = va_arg (argp, MIR_val_t);
 #if VA_LIST_IS_ARRAY_P
@@ -1659,23 +2862,22 @@ void MIR_interp (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t *results, si
 void MIR_interp_arr_varg (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t *results, size_t nargs,
                           MIR_val_t *vals, va_list va) {
   func_desc_t func_desc;
+  interp_stack_t stack = get_interp_stack (ctx, &func_desc);
   MIR_val_t *bp;
 
-  mir_assert (func_item->item_type == MIR_func_item);
-  if (func_item->data == NULL) generate_icode (ctx, func_item);
-  func_desc = get_func_desc (func_item);
-  bp = alloca ((func_desc->nregs + 2) * sizeof (MIR_val_t));
-  bp++; /* reserved for setjmp/longjmp */
+  func_desc = get_func_desc (ctx, func_item);
+  bp = push_frame (ctx, stack, func_desc->nregs + FRAME_RESERVED_SIZE) + FRAME_RESERVED_SIZE;
 #if VA_LIST_IS_ARRAY_P
-  bp[0].a = va;
+  bp[-1].a = va;
 #else
-      bp[0].a = &va;
+      bp[-1].a = &va;
 #endif
-  bp++;
   if (func_desc->nregs < nargs + 1) nargs = func_desc->nregs - 1;
   bp[0].i = 0;
   memcpy (&bp[1], vals, sizeof (MIR_val_t) * nargs);
-  eval (ctx, func_desc, bp, results);
+  eval (ctx, stack, func_desc, bp, results, NULL);
+  pop_frames (stack, bp - FRAME_RESERVED_SIZE);
+  release_interp_stack (ctx, stack);
 }
 
 void MIR_interp_arr (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t *results, size_t nargs,
@@ -1683,19 +2885,90 @@ void MIR_interp_arr (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t *results
   interp_arr_varg (ctx, func_item, results, nargs, vals, NULL);
 }
 
+/* Suspendable interpretation: */
+
+MIR_interp_state_t MIR_interp_start (MIR_context_t ctx, MIR_item_t func_item, MIR_val_t *results,
+                                     size_t nargs, MIR_val_t *vals) {
+  MIR_interp_state_t state;
+  interp_stack_t stack;
+  func_desc_t func_desc;
+  MIR_val_t *bp;
+
+  if ((state = malloc (sizeof (struct MIR_interp_state))) == NULL)
+    MIR_get_error_func (ctx) (MIR_alloc_error, "no memory for interpreter state");
+  state->stack = stack = get_interp_stack (ctx, NULL);
+  stack->state = state;
+  func_desc = get_func_desc (ctx, func_item);
+  state->frames = bp = push_frame (ctx, stack, func_desc->nregs + FRAME_RESERVED_SIZE);
+  bp += FRAME_RESERVED_SIZE;
+  bp[-1].a = NULL; /* no va */
+  if (func_desc->nregs < nargs + 1) nargs = func_desc->nregs - 1;
+  bp[0].i = 0;
+  memcpy (&bp[1], vals, sizeof (MIR_val_t) * nargs);
+  state->results = state->frame_results = results;
+  state->func_desc = func_desc;
+  state->bp = bp;
+  state->pc = NULL;
+  state->yield_p = state->suspended_p = FALSE;
+  state->fuel = INT64_MAX;
+  state->exhausted_handler = NULL;
+  state->exhausted_handler_data = NULL;
+  stack->fuel_addr = &state->fuel;
+  return state;
+}
+
+static void release_interp_state_stack (MIR_context_t ctx, MIR_interp_state_t state) {
+  interp_stack_t stack = state->stack;
+
+  if (stack == NULL) return;
+  pop_frames (stack, state->frames);
+  stack->state = NULL;
+  release_interp_stack (ctx, stack);
+  state->stack = NULL;
+}
+
+int MIR_interp_resume (MIR_context_t ctx, MIR_interp_state_t state) {
+  if (state->stack == NULL) return TRUE; /* already finished */
+  state->suspended_p = FALSE;
+  eval (ctx, state->stack, state->func_desc, state->bp, state->frame_results, state->pc);
+  if (state->suspended_p) return FALSE;
+  release_interp_state_stack (ctx, state);
+  return TRUE;
+}
+
+void MIR_interp_yield (MIR_context_t ctx, MIR_interp_state_t state) { state->yield_p = TRUE; }
+
+/* The suspendable interpretation has its own fuel counter and handler
+   used by the fuel checks in the interpreted code: */
+void MIR_interp_set_fuel (MIR_context_t ctx, MIR_interp_state_t state, int64_t fuel) {
+  state->fuel = fuel;
+}
+
+int64_t MIR_interp_get_fuel (MIR_context_t ctx, MIR_interp_state_t state) { return state->fuel; }
+
+void MIR_interp_set_fuel_handler (MIR_context_t ctx, MIR_interp_state_t state,
+                                  MIR_fuel_handler_t handler, void *data) {
+  state->exhausted_handler = handler;
+  state->exhausted_handler_data = data;
+}
+
+void MIR_interp_free_state (MIR_context_t ctx, MIR_interp_state_t state) {
+  release_interp_state_stack (ctx, state);
+  free (state);
+}
+
 /* C call interface to interpreter.  It is based on knowledge of
    common vararg implementation.  For some targets it might not
    work.  */
 static void interp (MIR_context_t ctx, MIR_item_t func_item, va_list va, MIR_val_t *results) {
-  struct interp_ctx *interp_ctx = ctx->interp_ctx;
   size_t nargs;
   MIR_var_t *arg_vars;
+  MIR_val_t *arg_vals;
   MIR_func_t func = func_item->u.func;
 
   nargs = func->nargs;
   arg_vars = VARR_ADDR (MIR_var_t, func->vars);
-  if (VARR_EXPAND (MIR_val_t, arg_vals_varr, nargs))
-    arg_vals = VARR_ADDR (MIR_val_t, arg_vals_varr);
+  arg_vals = alloca (nargs * sizeof (MIR_val_t));
   for (size_t i = 0; i < nargs; i++) {
     MIR_type_t type = arg_vars[i].type;
     switch (type) {
@@ -1741,11 +3014,127 @@ static void interp (MIR_context_t ctx, MIR_item_t func_item, va_list va, MIR_val
 }
 
 static void redirect_interface_to_interp (MIR_context_t ctx, MIR_item_t func_item) {
+  struct interp_ctx *interp_ctx = ctx->interp_ctx;
+  MIR_item_t tab_item;
+
   _MIR_redirect_thunk (ctx, func_item->addr, _MIR_get_interp_shim (ctx, func_item, interp));
+  if (!icall_func_p (func_item->u.func)) return;
+  if (mir_mutex_lock (&interp_mutex)) parallel_error (ctx, "error in mutex lock");
+  HTAB_DO (MIR_item_t, icall_func_tab, func_item, HTAB_REPLACE, tab_item);
+  if (mir_mutex_unlock (&interp_mutex)) parallel_error (ctx, "error in mutex unlock");
 }
 
 void MIR_set_interp_interface (MIR_context_t ctx, MIR_item_t func_item) {
   if (func_item != NULL) redirect_interface_to_interp (ctx, func_item);
 }
 
+/* Discard the interpreter code of all functions.  The code is
+   regenerated for the new mode on the next call.  So no function
+   should be interpreted at the moment of the call.  */
+static void reset_interp_code (MIR_context_t ctx) {
+  for (MIR_module_t m = DLIST_HEAD (MIR_module_t, *MIR_get_module_list (ctx)); m != NULL;
+       m = DLIST_NEXT (MIR_module_t, m))
+    for (MIR_item_t item = DLIST_HEAD (MIR_item_t, m->items); item != NULL;
+         item = DLIST_NEXT (MIR_item_t, item))
+      if (item->item_type == MIR_func_item) finish_func_interpretation (item);
+}
+
+/* Profile mode: */
+
+void MIR_interp_set_profile (MIR_context_t ctx, int enable_p) {
+  struct interp_ctx *interp_ctx = ctx->interp_ctx;
+
+  if (profile_p == !!enable_p) return;
+  profile_p = !!enable_p;
+  reset_interp_code (ctx);
+}
+
+/* Return profile of FUNC_ITEM with the insn counts derived from the current BB counts: */
+static func_profile_t get_func_profile (MIR_item_t func_item) {
+  func_desc_t func_desc;
+  func_profile_t profile;
+  insn_bbs_t *insn_bbs;
+
+  if (func_item->item_type != MIR_func_item
+      || (func_desc = load_acquire (&func_item->data)) == NULL
+      || (profile = func_desc->profile) == NULL)
+    return NULL;
+  for (size_t i = 0; i < profile->ninsns; i++) {
+    insn_bbs = &profile->insn_bbs[i];
+    profile->insns[i].count = profile->bb_counts[insn_bbs->bb];
+    profile->insns[i].fall_through_count
+      = insn_bbs->fall_through_bb == SIZE_MAX ? 0 : profile->bb_counts[insn_bbs->fall_through_bb];
+  }
+  return profile;
+}
+
+/* Return the number of calls of FUNC_ITEM and its insn profiles
+   through INSN_PROFILES.  Labels have no profiles.  The profiles are updated
+   only by this call.  */
+uint64_t MIR_interp_get_func_profile (MIR_context_t ctx, MIR_item_t func_item, size_t *ninsns,
+                                      MIR_interp_insn_profile_t **insn_profiles) {
+  func_profile_t profile = get_func_profile (func_item);
+
+  if (profile == NULL) {
+    *ninsns = 0;
+    *insn_profiles = NULL;
+    return 0;
+  }
+  *ninsns = profile->ninsns;
+  *insn_profiles = profile->insns;
+  return profile->bb_counts[0];
+}
+
+void MIR_interp_reset_profile (MIR_context_t ctx) {
+  func_profile_t profile;
+
+  for (MIR_module_t m = DLIST_HEAD (MIR_module_t, *MIR_get_module_list (ctx)); m != NULL;
+       m = DLIST_NEXT (MIR_module_t, m))
+    for (MIR_item_t item = DLIST_HEAD (MIR_item_t, m->items); item != NULL;
+         item = DLIST_NEXT (MIR_item_t, item)) {
+      if ((profile = get_func_profile (item)) == NULL) continue;
+      memset (profile->bb_counts, 0, profile->nbbs * sizeof (uint64_t));
+      for (size_t i = 0; i < profile->ninsns; i++)
+        profile->insns[i].count = profile->insns[i].fall_through_count = 0;
+    }
+}
+
+/* Output executed insn numbers for each insn code and each function,
+   and counts of taken conditional branches.  */
+void MIR_interp_output_profile (MIR_context_t ctx, FILE *f) {
+  uint64_t code_counts[MIR_INSN_BOUND], count;
+  func_profile_t profile;
+  MIR_interp_insn_profile_t *insn_profile;
+  MIR_func_t func;
+
+  memset (code_counts, 0, sizeof (code_counts));
+  fprintf (f, "Interpreter profile:\n");
+  for (MIR_module_t m = DLIST_HEAD (MIR_module_t, *MIR_get_module_list (ctx)); m != NULL;
+       m = DLIST_NEXT (MIR_module_t, m))
+    for (MIR_item_t item = DLIST_HEAD (MIR_item_t, m->items); item != NULL;
+         item = DLIST_NEXT (MIR_item_t, item)) {
+      if ((profile = get_func_profile (item)) == NULL || profile->bb_counts[0] == 0) continue;
+      func = item->u.func;
+      count = 0;
+      for (size_t i = 0; i < profile->ninsns; i++) {
+        count += profile->insns[i].count;
+        code_counts[profile->insns[i].insn->code] += profile->insns[i].count;
+      }
+      fprintf (f, "  func %s: %" PRIu64 " calls, %" PRIu64 " insns\n", func->name, profile->bb_counts[0],
+               count);
+      for (size_t i = 0; i < profile->ninsns; i++) {
+        insn_profile = &profile->insns[i];
+        if (insn_profile->count == 0 || insn_profile->insn->code == MIR_JMP
+            || !MIR_branch_code_p (insn_profile->insn->code))
+          continue;
+        fprintf (f, "    taken %" PRIu64 " of %" PRIu64 ":",
+                 insn_profile->count - insn_profile->fall_through_count, insn_profile->count);
+        MIR_output_insn (ctx, f, insn_profile->insn, func, TRUE);
+      }
+    }
+  for (size_t i = 0; i < MIR_INSN_BOUND; i++)
+    if (code_counts[i] != 0)
+      fprintf (f, "  %-8s %" PRIu64 "\n", MIR_insn_name (ctx, (MIR_insn_code_t) i), code_counts[i]);
+}
+
 #endif /* #ifdef MIR_NO_INTERP */
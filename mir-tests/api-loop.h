@@ -29,3 +29,16 @@ MIR_item_t create_mir_func_with_loop (MIR_context_t ctx, MIR_module_t *m) {
   if (m != NULL) MIR_finish_module (ctx);
   return func;
 }
+
+/* Create the loop function, load, and link it through SET_INTERFACE.  Switch on the fuel metering
+   before linking if FUEL_P: */
+MIR_item_t link_mir_func_with_loop (MIR_context_t ctx, int fuel_p,
+                                    void (*set_interface) (MIR_context_t ctx, MIR_item_t item)) {
+  MIR_module_t m;
+  MIR_item_t func = create_mir_func_with_loop (ctx, &m);
+
+  MIR_load_module (ctx, m);
+  if (fuel_p) MIR_set_fuel_metering (ctx, TRUE);
+  MIR_link (ctx, set_interface, NULL);
+  return func;
+}
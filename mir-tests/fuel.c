@@ -0,0 +1,82 @@
+#include "../mir.h"
+#include "../mir-gen.h"
+#include "api-loop.h"
+#include "test-check.h"
+
+#include <inttypes.h>
+#include <setjmp.h>
+
+typedef int64_t (*loop_func_t) (int64_t);
+
+static int handler_calls;
+static jmp_buf exhausted_jmp_buf;
+static MIR_error_type_t exhausted_error_type;
+
+static void refill (MIR_context_t ctx, void *data) {
+  handler_calls++;
+  MIR_set_fuel (ctx, *(int64_t *) data);
+}
+
+static void MIR_NO_RETURN exhausted_error (MIR_error_type_t error_type, const char *format, ...) {
+  exhausted_error_type = error_type;
+  longjmp (exhausted_jmp_buf, 1);
+}
+
+static int64_t run_loop (MIR_context_t ctx, MIR_item_t func, int gen_p, int64_t n) {
+  MIR_val_t val;
+
+  if (gen_p) return ((loop_func_t) func->addr) (n);
+  val.i = n;
+  MIR_interp (ctx, func, &val, 1, val);
+  return val.i;
+}
+
+static void test_fuel (int gen_p) {
+  MIR_item_t func;
+  int64_t portion = 100;
+  MIR_context_t ctx = MIR_init ();
+
+  if (gen_p) MIR_gen_init (ctx, 1);
+  func = link_mir_func_with_loop (ctx, TRUE,
+                                  gen_p ? MIR_set_gen_interface : MIR_set_interp_interface);
+  /* The fuel is spent at the function entry and each loop iteration: */
+  MIR_set_fuel (ctx, 10000);
+  check (run_loop (ctx, func, gen_p, 1000) == 1000, "loop result");
+  check (MIR_get_fuel (ctx) == 10000 - 1001, "spent fuel");
+  /* The handler is called each time when the fuel runs out: */
+  MIR_set_fuel_handler (ctx, refill, &portion);
+  MIR_set_fuel (ctx, 0);
+  check (run_loop (ctx, func, gen_p, 1000) == 1000, "loop result with refill");
+  check (handler_calls == 10 && MIR_get_fuel (ctx) == 9, "refill");
+  /* Without the handler, the code is left through the error function: */
+  MIR_set_fuel_handler (ctx, NULL, NULL);
+  MIR_set_error_func (ctx, exhausted_error);
+  MIR_set_fuel (ctx, 500);
+  if (setjmp (exhausted_jmp_buf) == 0) {
+    run_loop (ctx, func, gen_p, 1000);
+    check (FALSE, "no unwinding");
+  }
+  check (exhausted_error_type == MIR_fuel_exhausted_error && MIR_get_fuel (ctx) == -1,
+         "unwinding");
+  /* Interpreter stacks left by unwinding are reused by the next runs: */
+  for (int i = 0; !gen_p && i < 10000; i++) {
+    MIR_set_fuel (ctx, 500);
+    if (setjmp (exhausted_jmp_buf) == 0) {
+      run_loop (ctx, func, gen_p, 1000);
+      check (FALSE, "no repeated unwinding");
+    }
+    check (exhausted_error_type == MIR_fuel_exhausted_error, "repeated unwinding");
+  }
+  MIR_set_fuel (ctx, 10000);
+  check (run_loop (ctx, func, gen_p, 1000) == 1000, "loop result after unwinding");
+  if (gen_p) MIR_gen_finish (ctx);
+  MIR_finish (ctx);
+  handler_calls = 0;
+}
+
+int main (void) {
+  test_fuel (FALSE);
+  test_fuel (TRUE);
+  fprintf (stderr, "fuel metering is ok\n");
+  return 0;
+}
@@ -0,0 +1,90 @@
+#include "../mir.h"
+#include "../mir-gen.h"
+#include "test-check.h"
+
+#include <inttypes.h>
+
+typedef int64_t (*sum_func_t) (int64_t);
+
+/* The function has loops and redundant expressions to keep all optimizations busy: */
+static const char *sum_module_str
+  = "\n\
+m_sum:   module\n\
+sum:     func i64, i64:n\n\
+         local i64:s, i64:i, i64:j, i64:t, i64:u\n\
+         mov s, 0; mov i, 0\n\
+loop:    bge fin, i, n\n\
+         mul t, i, i; add u, i, 7; mul u, u, 3\n\
+         mov j, 0\n\
+loop2:   bge fin2, j, 4\n\
+         add s, s, t; add s, s, j; mul t, i, i\n\
+         add j, j, 1\n\
+         jmp loop2\n\
+fin2:    and u, u, 15; add s, s, u\n\
+         add i, i, 1\n\
+         jmp loop\n\
+fin:     ret s\n\
+         endfunc\n\
+         endmodule\n\
+";
+
+static int64_t sum (int64_t n) {
+  int64_t s = 0;
+
+  for (int64_t i = 0; i < n; i++) {
+    for (int64_t j = 0; j < 4; j++) s += i * i + j;
+    s += ((i + 7) * 3) & 15;
+  }
+  return s;
+}
+
+/* Generate a new copy of the sum function on optimization LEVEL with time budget MAX_TIME, check
+   the code, and return the exceeded budget flags.  Add the generation time to *TIME if it is not
+   NULL.  */
+static unsigned gen_sum (MIR_context_t ctx, unsigned level, double max_time, double *time) {
+  MIR_gen_budget_t budget = {0};
+  MIR_gen_stats_t stats;
+  MIR_module_t m;
+  MIR_item_t func;
+  double start_time;
+
+  MIR_scan_string (ctx, sum_module_str);
+  m = DLIST_TAIL (MIR_module_t, *MIR_get_module_list (ctx));
+  func = DLIST_TAIL (MIR_item_t, m->items);
+  MIR_load_module (ctx, m);
+  MIR_gen_set_optimize_level (ctx, 0, level);
+  budget.max_time = max_time;
+  MIR_gen_set_budget (ctx, 0, &budget);
+  MIR_gen_get_stats (ctx, 0, &stats);
+  start_time = stats.time;
+  MIR_link (ctx, MIR_set_gen_interface, NULL);
+  MIR_gen_get_stats (ctx, 0, &stats);
+  if (time != NULL) *time += stats.time - start_time;
+  check (((sum_func_t) func->addr) (1000) == sum (1000), "sum result");
+  return stats.last_budget_flags;
+}
+
+int main (void) {
+  MIR_context_t ctx = MIR_init ();
+  double time = 0;
+
+  MIR_gen_init (ctx, 1);
+  /* A tiny time budget is exceeded at the first check: before building SSA on levels 2 and 3 and
+     before building live ranges on level 1.  Level 0 does not check the time: */
+  for (unsigned level = 0; level <= 3; level++)
+    check (gen_sum (ctx, level, 1e-9, NULL) == (level == 0 ? 0 : MIR_GEN_TIME_BUDGET),
+           "time budget flags");
+  /* Budgets of a part of the full generation time are exceeded between other passes: */
+  for (int i = 0; i < 8; i++) check (gen_sum (ctx, 3, 0, &time) == 0, "no budget flags");
+  time /= 8;
+  for (unsigned level = 2; level <= 3; level++)
+    for (int k = 1; k <= 32; k++) {
+      unsigned flags = gen_sum (ctx, level, time * k / 32, NULL);
+
+      check (flags == 0 || flags == MIR_GEN_TIME_BUDGET, "partial time budget flags");
+    }
+  MIR_gen_finish (ctx);
+  MIR_finish (ctx);
+  fprintf (stderr, "generator time budget is ok\n");
+  return 0;
+}
@@ -0,0 +1,146 @@
+#include "../mir.h"
+#include "api-loop.h"
+#include "test-check.h"
+
+#include <inttypes.h>
+
+static MIR_context_t await_ctx;
+static MIR_interp_state_t current_state;
+static int awaits;
+
+static int64_t await_point (int64_t v) {
+  awaits++;
+  MIR_interp_yield (await_ctx, current_state);
+  return v;
+}
+
+/* Recursive interpreted function suspended at each await point.  Its
+   alloca memory should survive the suspensions: */
+static const char *mir_code
+  = "m_co: module\n\
+import await_point\n\
+p_await: proto i64, i64:v\n\
+p_sum: proto i64, i64:n\n\
+export sum\n\
+sum: func i64, i64:n\n\
+local i64:r, i64:t, i64:a, i64:m\n\
+beq L0, n, 0\n\
+alloca m, 16\n\
+mov i64:8(m), n\n\
+call p_await, await_point, t, n\n\
+sub a, n, 1\n\
+call p_sum, sum, r, a\n\
+add r, r, t\n\
+mov t, i64:8(m)\n\
+add r, r, t\n\
+ret r\n\
+L0: ret 0\n\
+endfunc\n\
+endmodule\n";
+
+static int resume (MIR_context_t ctx, MIR_interp_state_t state) {
+  current_state = state;
+  return MIR_interp_resume (ctx, state);
+}
+
+static void test_await (void) {
+  MIR_context_t ctx = await_ctx = MIR_init ();
+  MIR_module_t m;
+  MIR_item_t item, func = NULL;
+  MIR_val_t arg, res1, res2, res3;
+  MIR_interp_state_t state1, state2, state3;
+  int finished1 = FALSE, finished2 = FALSE, nresumes = 0;
+
+  MIR_load_external (ctx, "await_point", await_point);
+  MIR_scan_string (ctx, mir_code);
+  m = DLIST_TAIL (MIR_module_t, *MIR_get_module_list (ctx));
+  MIR_load_module (ctx, m);
+  MIR_link (ctx, MIR_set_interp_interface, NULL);
+  for (item = DLIST_HEAD (MIR_item_t, m->items); item != NULL;
+       item = DLIST_NEXT (MIR_item_t, item))
+    if (item->item_type == MIR_func_item) func = item;
+  /* Two interleaved interpretations: */
+  arg.i = 5;
+  state1 = MIR_interp_start (ctx, func, &res1, 1, &arg);
+  arg.i = 3;
+  state2 = MIR_interp_start (ctx, func, &res2, 1, &arg);
+  while (!finished1 || !finished2) {
+    if (!finished1) finished1 = resume (ctx, state1);
+    if (!finished2) finished2 = resume (ctx, state2);
+    nresumes++;
+  }
+  check (res1.i == 30 && res2.i == 12, "results");
+  check (awaits == 8 && nresumes == 6, "suspensions");
+  check (MIR_interp_resume (ctx, state1), "resume of finished interpretation");
+  MIR_interp_free_state (ctx, state1);
+  MIR_interp_free_state (ctx, state2);
+  /* Abandoning a suspended interpretation: */
+  arg.i = 10;
+  state3 = MIR_interp_start (ctx, func, &res3, 1, &arg);
+  check (!resume (ctx, state3) && !resume (ctx, state3), "suspended interpretation");
+  MIR_interp_free_state (ctx, state3);
+  MIR_finish (ctx);
+}
+
+/* A script with its own fuel portion and interpretation state: */
+struct script {
+  MIR_interp_state_t state;
+  MIR_val_t res;
+  int64_t portion;
+  int exhaustions;
+};
+
+static void refill_and_yield (MIR_context_t ctx, void *data) {
+  struct script *script = data;
+
+  script->exhaustions++;
+  MIR_interp_set_fuel (ctx, script->state, script->portion);
+  MIR_interp_yield (ctx, script->state);
+}
+
+static void start_script (MIR_context_t ctx, MIR_item_t func, struct script *script,
+                          int64_t portion) {
+  MIR_val_t arg;
+
+  arg.i = 1000;
+  script->state = MIR_interp_start (ctx, func, &script->res, 1, &arg);
+  script->portion = portion;
+  script->exhaustions = 0;
+  MIR_interp_set_fuel (ctx, script->state, 0);
+  MIR_interp_set_fuel_handler (ctx, script->state, refill_and_yield, script);
+}
+
+static void test_fuel (void) {
+  MIR_context_t ctx = MIR_init ();
+  MIR_item_t func;
+  struct script script1, script2;
+  int finished1 = FALSE, finished2 = FALSE, nresumes = 0;
+
+  func = link_mir_func_with_loop (ctx, TRUE, MIR_set_interp_interface);
+  MIR_set_fuel (ctx, 7);
+  /* Two interleaved interpretations with different fuel portions spend their own fuel: */
+  start_script (ctx, func, &script1, 100);
+  start_script (ctx, func, &script2, 300);
+  while (!finished1 || !finished2) {
+    if (!finished1) finished1 = MIR_interp_resume (ctx, script1.state);
+    if (!finished2) finished2 = MIR_interp_resume (ctx, script2.state);
+    nresumes++;
+  }
+  /* 1001 fuel checks with 100 and 300 fuel portions: */
+  check (script1.res.i == 1000 && script2.res.i == 1000, "results of scripts");
+  check (script1.exhaustions == 10 && MIR_interp_get_fuel (ctx, script1.state) == 9,
+         "fuel of the first script");
+  check (script2.exhaustions == 4 && MIR_interp_get_fuel (ctx, script2.state) == 203,
+         "fuel of the second script");
+  check (nresumes == 11 && MIR_get_fuel (ctx) == 7, "fuel of the context");
+  MIR_interp_free_state (ctx, script1.state);
+  MIR_interp_free_state (ctx, script2.state);
+  MIR_finish (ctx);
+}
+
+int main (void) {
+  test_await ();
+  test_fuel ();
+  fprintf (stderr, "suspendable interpretation is ok\n");
+  return 0;
+}
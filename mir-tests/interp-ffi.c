@@ -0,0 +1,90 @@
+#include "../mir.h"
+#include "test-check.h"
+
+#include <inttypes.h>
+
+#if defined(__GNUC__)
+#define RETURN_ADDRESS() __builtin_return_address (0)
+#else
+#define RETURN_ADDRESS() NULL
+#endif
+
+/* The return address is inside the ff interface calling the function: */
+static void *add3_return_address;
+
+static int64_t add3 (int64_t a, int64_t b, int64_t c) {
+  add3_return_address = RETURN_ADDRESS ();
+  return a + b + c;
+}
+
+static double dmul (double a, double b) { return a * b; }
+
+static const char *mir_code
+  = "m_ffi: module\n\
+import add3, dmul\n\
+p_add3: proto i64, i64:a, i64:b, i64:c\n\
+p_dmul: proto d, d:a, d:b\n\
+export calls\n\
+calls: func i64, i64:n\n\
+local i64:r, i64:t, d:d\n\
+call p_add3, add3, r, n, 2, 3\n\
+dmov d, 1.5\n\
+call p_dmul, dmul, d, d, 4.0\n\
+d2i t, d\n\
+add r, r, t\n\
+ret r\n\
+endfunc\n\
+endmodule\n";
+
+static MIR_context_t create_ctx (MIR_item_t *func) {
+  MIR_context_t ctx = MIR_init ();
+  MIR_module_t m;
+  MIR_item_t item;
+
+  MIR_load_external (ctx, "add3", add3);
+  MIR_load_external (ctx, "dmul", dmul);
+  MIR_scan_string (ctx, mir_code);
+  m = DLIST_TAIL (MIR_module_t, *MIR_get_module_list (ctx));
+  MIR_load_module (ctx, m);
+  MIR_link (ctx, MIR_set_interp_interface, NULL);
+  for (item = DLIST_HEAD (MIR_item_t, m->items); item != NULL;
+       item = DLIST_NEXT (MIR_item_t, item))
+    if (item->item_type == MIR_func_item) *func = item;
+  return ctx;
+}
+
+static int64_t run (MIR_context_t ctx, MIR_item_t func, int64_t n) {
+  MIR_val_t val;
+
+  val.i = n;
+  MIR_interp (ctx, func, &val, 1, val);
+  return val.i;
+}
+
+int main (void) {
+  MIR_item_t func1, func2;
+  MIR_context_t ctx1, ctx2;
+  void *interface_address;
+
+  /* FF interfaces are shared by simultaneously living contexts: */
+  ctx1 = create_ctx (&func1);
+  check (run (ctx1, func1, 1) == 12, "first context");
+  interface_address = add3_return_address;
+  ctx2 = create_ctx (&func2);
+  check (run (ctx2, func2, 2) == 13, "simultaneously living contexts");
+  check (add3_return_address == interface_address, "the same interface in different contexts");
+  /* The interfaces survive finishing a context while other contexts use them: */
+  MIR_finish (ctx1);
+  check (run (ctx2, func2, 3) == 14, "context living after finishing another one");
+  ctx1 = create_ctx (&func1);
+  check (run (ctx1, func1, 4) == 15, "context created after finishing another one");
+  check (add3_return_address == interface_address, "the interface after finishing a context");
+  MIR_finish (ctx2);
+  MIR_finish (ctx1);
+  /* The interfaces are freed with the last context using them and generated again later: */
+  ctx1 = create_ctx (&func1);
+  check (run (ctx1, func1, 5) == 16, "context created after finishing all contexts");
+  MIR_finish (ctx1);
+  fprintf (stderr, "shared ff interfaces are ok\n");
+  return 0;
+}
@@ -0,0 +1,52 @@
+#include "../mir.h"
+#include "api-loop.h"
+#include "test-check.h"
+
+#include <inttypes.h>
+
+static MIR_interp_insn_profile_t *find_insn_profile (MIR_interp_insn_profile_t *insn_profiles,
+                                                     size_t ninsns, MIR_insn_code_t code) {
+  for (size_t i = 0; i < ninsns; i++)
+    if (insn_profiles[i].insn->code == code) return &insn_profiles[i];
+  return NULL;
+}
+
+int main (void) {
+  MIR_item_t func;
+  MIR_val_t val;
+  MIR_interp_insn_profile_t *insn_profiles, *bge, *blt, *add;
+  size_t ninsns;
+  uint64_t calls;
+  MIR_context_t ctx = MIR_init ();
+
+  func = link_mir_func_with_loop (ctx, FALSE, MIR_set_interp_interface);
+  MIR_interp_set_profile (ctx, TRUE);
+  for (int i = 0; i < 2; i++) {
+    val.i = 1000;
+    MIR_interp (ctx, func, &val, 1, val);
+    check (val.i == 1000, "loop result");
+  }
+  calls = MIR_interp_get_func_profile (ctx, func, &ninsns, &insn_profiles);
+  check (calls == 2, "number of calls");
+  bge = find_insn_profile (insn_profiles, ninsns, MIR_BGE);
+  blt = find_insn_profile (insn_profiles, ninsns, MIR_BLT);
+  check (bge != NULL && blt != NULL, "branch profiles");
+  check (bge->count == 2 && bge->fall_through_count == 2, "not taken branch");
+  check (blt->count == 2000 && blt->fall_through_count == 2, "loop branch");
+  /* Counts of other insns are derived from the counts of their basic blocks: */
+  add = find_insn_profile (insn_profiles, ninsns, MIR_ADD);
+  check (add != NULL && add->count == 2000 && add->fall_through_count == 0, "loop body");
+  MIR_interp_output_profile (ctx, stderr);
+  MIR_interp_reset_profile (ctx);
+  calls = MIR_interp_get_func_profile (ctx, func, &ninsns, &insn_profiles);
+  check (calls == 0 && blt->count == 0 && blt->fall_through_count == 0, "profile reset");
+  MIR_interp_set_profile (ctx, FALSE);
+  val.i = 10;
+  MIR_interp (ctx, func, &val, 1, val);
+  check (val.i == 10, "loop result without profile");
+  calls = MIR_interp_get_func_profile (ctx, func, &ninsns, &insn_profiles);
+  check (calls == 0 && ninsns == 0, "no profile");
+  fprintf (stderr, "interpreter profile is ok\n");
+  MIR_finish (ctx);
+  return 0;
+}
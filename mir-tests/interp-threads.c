@@ -0,0 +1,116 @@
+#include "../mir.h"
+#include "test-check.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include <pthread.h>
+
+#define THREADS_NUM 8
+#define ITERATIONS_NUM 200
+
+static int64_t add3 (int64_t a, int64_t b, int64_t c) { return a + b + c; }
+
+static double dmul (double a, double b) { return a * b; }
+
+/* Recursive calls, calls of C functions through different ff interfaces, and calls of functions
+   with the interpreter interface from C code: */
+static const char *mir_code
+  = "m_threads: module\n\
+import add3, dmul\n\
+p_add3: proto i64, i64:a, i64:b, i64:c\n\
+p_dmul: proto d, d:a, d:b\n\
+p_fib: proto i64, i64:n\n\
+export fib, calls\n\
+fib: func i64, i64:n\n\
+local i64:r, i64:r2, i64:a\n\
+blt L0, n, 2\n\
+sub a, n, 1\n\
+call p_fib, fib, r, a\n\
+sub a, n, 2\n\
+call p_fib, fib, r2, a\n\
+add r, r, r2\n\
+ret r\n\
+L0: ret n\n\
+endfunc\n\
+calls: func i64, i64:n\n\
+local i64:r, i64:t, d:d\n\
+call p_add3, add3, r, n, 2, 3\n\
+i2d d, n\n\
+call p_dmul, dmul, d, d, 2.0\n\
+d2i t, d\n\
+add r, r, t\n\
+ret r\n\
+endfunc\n\
+endmodule\n";
+
+static MIR_context_t ctx;
+static MIR_item_t fib_func, calls_func;
+
+/* Start all threads at once to interpret functions which are not called yet: */
+static pthread_mutex_t start_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int start_p = FALSE;
+
+static int64_t fib (int64_t n) { return n < 2 ? n : fib (n - 1) + fib (n - 2); }
+
+static int64_t interp (MIR_item_t func, int64_t n) {
+  MIR_val_t val;
+
+  val.i = n;
+  MIR_interp (ctx, func, &val, 1, val);
+  return val.i;
+}
+
+static void *run (void *arg) {
+  intptr_t thread_num = (intptr_t) arg;
+  int64_t (*calls) (int64_t) = calls_func->addr;
+  int ok_p = TRUE;
+
+  pthread_mutex_lock (&start_mutex);
+  while (!start_p) pthread_cond_wait (&start_cond, &start_mutex);
+  pthread_mutex_unlock (&start_mutex);
+  for (int i = 0; i < ITERATIONS_NUM; i++) {
+    int64_t n = thread_num + i % 10;
+
+    if (interp (fib_func, n) != fib (n)) ok_p = FALSE;
+    if (interp (calls_func, n) != 3 * n + 5) ok_p = FALSE;
+    if (calls (n + 1) != 3 * n + 8) ok_p = FALSE;
+  }
+  return ok_p ? arg : NULL;
+}
+
+int main (void) {
+  pthread_t threads[THREADS_NUM];
+  MIR_module_t m;
+  MIR_item_t item;
+  void *res;
+
+  ctx = MIR_init ();
+  MIR_load_external (ctx, "add3", add3);
+  MIR_load_external (ctx, "dmul", dmul);
+  MIR_scan_string (ctx, mir_code);
+  m = DLIST_TAIL (MIR_module_t, *MIR_get_module_list (ctx));
+  MIR_load_module (ctx, m);
+  MIR_link (ctx, MIR_set_interp_interface, NULL);
+  for (item = DLIST_HEAD (MIR_item_t, m->items); item != NULL;
+       item = DLIST_NEXT (MIR_item_t, item))
+    if (item->item_type != MIR_func_item)
+      ;
+    else if (strcmp (MIR_item_name (ctx, item), "fib") == 0)
+      fib_func = item;
+    else
+      calls_func = item;
+  for (intptr_t i = 0; i < THREADS_NUM; i++)
+    check (pthread_create (&threads[i], NULL, run, (void *) (i + 1)) == 0, "thread creation");
+  pthread_mutex_lock (&start_mutex);
+  start_p = TRUE;
+  pthread_cond_broadcast (&start_cond);
+  pthread_mutex_unlock (&start_mutex);
+  for (intptr_t i = 0; i < THREADS_NUM; i++) {
+    check (pthread_join (threads[i], &res) == 0, "thread join");
+    check (res == (void *) (i + 1), "results in a thread");
+  }
+  MIR_finish (ctx);
+  fprintf (stderr, "interpretation by several threads is ok\n");
+  return 0;
+}
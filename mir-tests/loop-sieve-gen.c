@@ -65,12 +65,29 @@ int main (void) {
     MIR_gen_init (ctx, 1);
     fprintf (stderr, "MIR_init_gen end -- %.0f usec\n", real_usec_time () - start_time);
     MIR_gen_set_optimize_level (ctx, 0, level);
+#if defined(TEST_GEN_BUDGET)
+    MIR_gen_budget_t budget = {0};
+    budget.max_insns = 4; /* force the cheaper pipeline */
+    MIR_gen_set_budget (ctx, 0, &budget);
+#endif
 #if TEST_GEN_DEBUG
     MIR_gen_set_debug_file (ctx, 0, stderr);
 #endif
     MIR_link (ctx, MIR_set_gen_interface, NULL);
     for (int i = 0; i < N; i++) fun = MIR_gen (ctx, 0, funcs[i]);
     fprintf (stderr, "MIR_gen end (%d funcs) -- %.0f usec\n", N, real_usec_time () - start_time);
+#if defined(TEST_GEN_BUDGET)
+    MIR_gen_stats_t stats;
+    MIR_gen_get_stats (ctx, 0, &stats);
+    fprintf (stderr, "MIR_gen stats: %lu funcs (%lu over budget), %lu insns, %lu BBs -- %.2f ms\n",
+             (unsigned long) stats.funcs_num, (unsigned long) stats.budget_funcs_num,
+             (unsigned long) stats.insns_num, (unsigned long) stats.bbs_num, stats.time);
+    if (stats.funcs_num == 0 || stats.budget_funcs_num != stats.funcs_num
+        || stats.last_budget_flags != MIR_GEN_INSNS_BUDGET) {
+      fprintf (stderr, "wrong generator budget stats\n");
+      return 1;
+    }
+#endif
 #if defined(TEST_GENERATION_ONLY)
     return 0;
 #endif
@@ -78,6 +95,9 @@ int main (void) {
 #if defined(TEST_GEN_LOOP)
     res = fun (arg);
     fprintf (stderr, "fun (%ld) -> %ld", (long) arg, (long) res);
+#if defined(TEST_GEN_BUDGET)
+    if (res != arg) return 1;
+#endif
 #else
     res = fun ();
     fprintf (stderr, "sieve () -> %ld", (long) res);
@@ -0,0 +1,9 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Report failure of a test condition and exit: */
+static void check (int cond, const char *message) {
+  if (cond) return;
+  fprintf (stderr, "FAIL: %s\n", message);
+  exit (1);
+}
@@ -52,6 +52,10 @@ struct MIR_context {
   struct scan_ctx *scan_ctx;
   struct interp_ctx *interp_ctx;
   void *setjmp_addr; /* used in interpreter to call setjmp directly not from a shim and FFI */
+  int fuel_metering_p;
+  int64_t fuel_count; /* decremented at function entries and loop headers */
+  MIR_fuel_handler_t fuel_handler;
+  void *fuel_handler_data;
 };
 
 #define ctx_mutex ctx->ctx_mutex
@@ -68,6 +72,10 @@ struct MIR_context {
 #define all_modules ctx->all_modules
 #define modules_to_link ctx->modules_to_link
 #define setjmp_addr ctx->setjmp_addr
+#define fuel_metering_p ctx->fuel_metering_p
+#define fuel_count ctx->fuel_count
+#define fuel_handler ctx->fuel_handler
+#define fuel_handler_data ctx->fuel_handler_data
 
 static void util_error (MIR_context_t ctx, const char *message);
 #define MIR_VARR_ERROR util_error
@@ -86,6 +94,7 @@ static void util_error (MIR_context_t ctx, const char *message);
 static void interp_init (MIR_context_t ctx);
 static void finish_func_interpretation (MIR_item_t func_item);
 static void interp_finish (MIR_context_t ctx);
+static void reset_interp_code (MIR_context_t ctx);
 
 static void MIR_NO_RETURN default_error (enum MIR_error_type error_type, const char *format, ...) {
   va_list ap;
@@ -242,11 +251,23 @@ static const struct insn_desc insn_descs[] = {
   {MIR_FGE, "fge", {MIR_OP_INT | OUT_FLAG, MIR_OP_FLOAT, MIR_OP_FLOAT, MIR_OP_BOUND}},
   {MIR_DGE, "dge", {MIR_OP_INT | OUT_FLAG, MIR_OP_DOUBLE, MIR_OP_DOUBLE, MIR_OP_BOUND}},
   {MIR_LDGE, "ldge", {MIR_OP_INT | OUT_FLAG, MIR_OP_LDOUBLE, MIR_OP_LDOUBLE, MIR_OP_BOUND}},
+  {MIR_ADDO, "addo", {MIR_OP_INT | OUT_FLAG, MIR_OP_INT, MIR_OP_INT, MIR_OP_BOUND}},
+  {MIR_ADDOS, "addos", {MIR_OP_INT | OUT_FLAG, MIR_OP_INT, MIR_OP_INT, MIR_OP_BOUND}},
+  {MIR_SUBO, "subo", {MIR_OP_INT | OUT_FLAG, MIR_OP_INT, MIR_OP_INT, MIR_OP_BOUND}},
+  {MIR_SUBOS, "subos", {MIR_OP_INT | OUT_FLAG, MIR_OP_INT, MIR_OP_INT, MIR_OP_BOUND}},
+  {MIR_MULO, "mulo", {MIR_OP_INT | OUT_FLAG, MIR_OP_INT, MIR_OP_INT, MIR_OP_BOUND}},
+  {MIR_MULOS, "mulos", {MIR_OP_INT | OUT_FLAG, MIR_OP_INT, MIR_OP_INT, MIR_OP_BOUND}},
+  {MIR_UMULO, "umulo", {MIR_OP_INT | OUT_FLAG, MIR_OP_INT, MIR_OP_INT, MIR_OP_BOUND}},
+  {MIR_UMULOS, "umulos", {MIR_OP_INT | OUT_FLAG, MIR_OP_INT, MIR_OP_INT, MIR_OP_BOUND}},
   {MIR_JMP, "jmp", {MIR_OP_LABEL, MIR_OP_BOUND}},
   {MIR_BT, "bt", {MIR_OP_LABEL, MIR_OP_INT, MIR_OP_BOUND}},
   {MIR_BTS, "bts", {MIR_OP_LABEL, MIR_OP_INT, MIR_OP_BOUND}},
   {MIR_BF, "bf", {MIR_OP_LABEL, MIR_OP_INT, MIR_OP_BOUND}},
   {MIR_BFS, "bfs", {MIR_OP_LABEL, MIR_OP_INT, MIR_OP_BOUND}},
+  {MIR_BO, "bo", {MIR_OP_LABEL, MIR_OP_BOUND}},
+  {MIR_UBO, "ubo", {MIR_OP_LABEL, MIR_OP_BOUND}},
+  {MIR_BNO, "bno", {MIR_OP_LABEL, MIR_OP_BOUND}},
+  {MIR_UBNO, "ubno", {MIR_OP_LABEL, MIR_OP_BOUND}},
   {MIR_BEQ, "beq", {MIR_OP_LABEL, MIR_OP_INT, MIR_OP_INT, MIR_OP_BOUND}},
   {MIR_BEQS, "beqs", {MIR_OP_LABEL, MIR_OP_INT, MIR_OP_INT, MIR_OP_BOUND}},
   {MIR_FBEQ, "fbeq", {MIR_OP_LABEL, MIR_OP_FLOAT, MIR_OP_FLOAT, MIR_OP_BOUND}},
@@ -292,6 +313,8 @@ static const struct insn_desc insn_descs[] = {
   {MIR_ALLOCA, "alloca", {MIR_OP_INT | OUT_FLAG, MIR_OP_INT, MIR_OP_BOUND}},
   {MIR_BSTART, "bstart", {MIR_OP_INT | OUT_FLAG, MIR_OP_BOUND}},
   {MIR_BEND, "bend", {MIR_OP_INT, MIR_OP_BOUND}},
+  {MIR_MEMCPY, "memcpy", {MIR_OP_INT, MIR_OP_INT, MIR_OP_INT, MIR_OP_BOUND}},
+  {MIR_MEMSET, "memset", {MIR_OP_INT, MIR_OP_INT, MIR_OP_INT, MIR_OP_BOUND}},
   {MIR_VA_ARG, "va_arg", {MIR_OP_INT | OUT_FLAG, MIR_OP_INT, MIR_OP_UNDEF, MIR_OP_BOUND}},
   {MIR_VA_BLOCK_ARG,
    "va_block_arg",
@@ -549,6 +572,39 @@ void MIR_set_error_func (MIR_context_t ctx, MIR_error_func_t func) {  // ?? atom
   error_func = func;
 }
 
+/* Fuel checks are added to the code generated by the interpreter or
+   the generator after switching the metering on.  The interpreter
+   code is regenerated on the next call.  So no function should be
+   interpreted at the moment of the call.  */
+void MIR_set_fuel_metering (MIR_context_t ctx, int enable_p) {
+  if (fuel_metering_p == !!enable_p) return;
+  fuel_metering_p = !!enable_p;
+  reset_interp_code (ctx);
+}
+
+void MIR_set_fuel (MIR_context_t ctx, int64_t fuel) { fuel_count = fuel; }
+
+int64_t MIR_get_fuel (MIR_context_t ctx) { return fuel_count; }
+
+void MIR_set_fuel_handler (MIR_context_t ctx, MIR_fuel_handler_t handler, void *data) {
+  fuel_handler = handler;
+  fuel_handler_data = data;
+}
+
+/* Return the fuel counter address for the code being generated or
+   NULL if the metering is off.  */
+int64_t *_MIR_get_fuel_addr (MIR_context_t ctx) { return fuel_metering_p ? &fuel_count : NULL; }
+
+/* Called from the interpreted or generated code when the fuel counter
+   becomes negative.  The handler can add fuel and return or leave the
+   code by longjmp.  Without the handler, the error function is
+   called.  */
+void _MIR_fuel_exhausted (MIR_context_t ctx) {
+  if (fuel_handler == NULL)
+    MIR_get_error_func (ctx) (MIR_fuel_exhausted_error, "execution fuel is exhausted");
+  fuel_handler (ctx, fuel_handler_data);
+}
+
 static htab_hash_t item_hash (MIR_item_t it, void *arg) {
   return mir_hash_finish (
     mir_hash_step (mir_hash_step (mir_hash_init (28), (uint64_t) MIR_item_name (NULL, it)),
@@ -638,17 +694,32 @@ MIR_context_t _MIR_init (void) {
   init_module (ctx, &environment_module, ".environment");
   HTAB_CREATE (MIR_item_t, module_item_tab, 512, item_hash, item_eq, NULL);
   setjmp_addr = NULL;
+  fuel_metering_p = FALSE;
+  fuel_count = INT64_MAX;
+  fuel_handler = NULL;
+  fuel_handler_data = NULL;
   code_init (ctx);
   interp_init (ctx);
   return ctx;
 }
 
+static int insn_in_func_block_p (MIR_func_t func, MIR_insn_t insn) {
+  return (func->insns_block != NULL && (uintptr_t) insn >= (uintptr_t) func->insns_block
+          && (uintptr_t) insn < (uintptr_t) func->insns_block + func->insns_block_size);
+}
+
+static void free_func_insns_block (MIR_func_t func) {
+  free (func->insns_block);
+  func->insns_block = NULL;
+  func->insns_block_size = 0;
+}
+
 void MIR_remove_insn (MIR_context_t ctx, MIR_item_t func_item, MIR_insn_t insn) {
   mir_assert (func_item != NULL);
   if (func_item->item_type != MIR_func_item)
     MIR_get_error_func (ctx) (MIR_wrong_param_value_error, "MIR_remove_insn: wrong func item");
   DLIST_REMOVE (MIR_insn_t, func_item->u.func->insns, insn);
-  free (insn);
+  if (!insn_in_func_block_p (func_item->u.func, insn)) free (insn);
 }
 
 static void remove_func_insns (MIR_context_t ctx, MIR_item_t func_item,
@@ -666,6 +737,7 @@ static void remove_item (MIR_context_t ctx, MIR_item_t item) {
   case MIR_func_item:
     remove_func_insns (ctx, item, &item->u.func->insns);
     remove_func_insns (ctx, item, &item->u.func->original_insns);
+    free_func_insns_block (item->u.func);
     VARR_DESTROY (MIR_var_t, item->u.func->vars);
     func_regs_finish (ctx, item->u.func);
     free (item->u.func);
@@ -1207,6 +1279,8 @@ static MIR_item_t new_func_arr (MIR_context_t ctx, const char *name, size_t nres
   mir_assert (tab_item == func_item);
   DLIST_INIT (MIR_insn_t, func->insns);
   DLIST_INIT (MIR_insn_t, func->original_insns);
+  func->insns_block = NULL;
+  func->insns_block_size = 0;
   VARR_CREATE (MIR_var_t, func->vars, nargs + 8);
   func->nargs = nargs;
   func->last_temp_num = 0;
@@ -1991,10 +2065,14 @@ void _MIR_register_unspec_insn (MIR_context_t ctx, uint64_t code, const char *na
   }
 }
 
+static size_t insn_size (MIR_insn_t insn) {
+  return sizeof (struct MIR_insn) + sizeof (MIR_op_t) * (insn->nops == 0 ? 0 : insn->nops - 1);
+}
+
 MIR_insn_t MIR_copy_insn (MIR_context_t ctx, MIR_insn_t insn) {
   size_t size;
   mir_assert (insn != NULL);
-  size = sizeof (struct MIR_insn) + sizeof (MIR_op_t) * (insn->nops == 0 ? 0 : insn->nops - 1);
+  size = insn_size (insn);
   MIR_insn_t new_insn = malloc (size);
 
   if (new_insn == NULL)
@@ -2341,22 +2419,48 @@ static void redirect_duplicated_labels (MIR_context_t ctx, VARR (MIR_insn_t) * l
   }
 }
 
+struct insn_align {
+  char c;
+  struct MIR_insn insn;
+};
+
+static size_t aligned_insn_size (MIR_insn_t insn) {
+  size_t align = offsetof (struct insn_align, insn);
+
+  return (insn_size (insn) + align - 1) / align * align;
+}
+
+/* All duplicated insns are placed in one block to avoid a malloc/free pair per insn for each
+   generation.  Insns added later by the generator are still allocated individually.  */
 void _MIR_duplicate_func_insns (MIR_context_t ctx, MIR_item_t func_item) {
   MIR_func_t func;
   MIR_insn_t insn, new_insn;
+  size_t block_size = 0;
+  char *block;
   VARR (MIR_insn_t) * labels, *branch_insns;
 
   mir_assert (func_item != NULL && func_item->item_type == MIR_func_item);
   func = func_item->u.func;
-  mir_assert (DLIST_HEAD (MIR_insn_t, func->original_insns) == NULL);
+  mir_assert (DLIST_HEAD (MIR_insn_t, func->original_insns) == NULL && func->insns_block == NULL);
   func->original_vars_num = VARR_LENGTH (MIR_var_t, func->vars);
   func->original_insns = func->insns;
   DLIST_INIT (MIR_insn_t, func->insns);
+  for (insn = DLIST_HEAD (MIR_insn_t, func->original_insns); insn != NULL;
+       insn = DLIST_NEXT (MIR_insn_t, insn))
+    block_size += aligned_insn_size (insn);
+  if (block_size == 0) return;
+  if ((block = malloc (block_size)) == NULL)
+    MIR_get_error_func (ctx) (MIR_alloc_error, "Not enough memory to duplicate insns of %s",
+                              func->name);
+  func->insns_block = block;
+  func->insns_block_size = block_size;
   VARR_CREATE (MIR_insn_t, labels, 0);
   VARR_CREATE (MIR_insn_t, branch_insns, 0);
   for (insn = DLIST_HEAD (MIR_insn_t, func->original_insns); insn != NULL;
        insn = DLIST_NEXT (MIR_insn_t, insn)) { /* copy insns and collect label info */
-    new_insn = MIR_copy_insn (ctx, insn);
+    new_insn = (MIR_insn_t) block;
+    memcpy (new_insn, insn, insn_size (insn));
+    block += aligned_insn_size (insn);
     DLIST_APPEND (MIR_insn_t, func->insns, new_insn);
     store_labels_for_duplication (ctx, labels, branch_insns, insn, new_insn);
   }
@@ -2387,10 +2491,40 @@ void _MIR_restore_func_insns (MIR_context_t ctx, MIR_item_t func_item) {
   }
   while ((insn = DLIST_HEAD (MIR_insn_t, func->insns)) != NULL)
     MIR_remove_insn (ctx, func_item, insn);
+  free_func_insns_block (func);
   func->insns = func->original_insns;
   DLIST_INIT (MIR_insn_t, func->original_insns);
 }
 
+/* Set up data of FUNC_ITEM labels to a non-null value if the label is
+   a target of a backward branch and to NULL otherwise.  Any cycle in
+   the function CFG contains such label.  */
+void _MIR_mark_loop_labels (MIR_context_t ctx, MIR_item_t func_item) {
+  MIR_insn_t insn, label;
+  size_t i, nops;
+
+  mir_assert (func_item != NULL && func_item->item_type == MIR_func_item);
+  for (insn = DLIST_HEAD (MIR_insn_t, func_item->u.func->insns); insn != NULL;
+       insn = DLIST_NEXT (MIR_insn_t, insn))
+    if (insn->code == MIR_LABEL) insn->data = NULL;
+  for (insn = DLIST_HEAD (MIR_insn_t, func_item->u.func->insns); insn != NULL;
+       insn = DLIST_NEXT (MIR_insn_t, insn)) {
+    if (insn->code == MIR_LABEL) {
+      if (insn->data == NULL) insn->data = (void *) 1; /* processed */
+      continue;
+    }
+    nops = MIR_insn_nops (ctx, insn);
+    for (i = 0; i < nops; i++) {
+      if (insn->ops[i].mode != MIR_OP_LABEL) continue;
+      label = insn->ops[i].u.label;
+      if (label->data != NULL) label->data = (void *) 2;
+    }
+  }
+  for (insn = DLIST_HEAD (MIR_insn_t, func_item->u.func->insns); insn != NULL;
+       insn = DLIST_NEXT (MIR_insn_t, insn))
+    if (insn->code == MIR_LABEL && insn->data != (void *) 2) insn->data = NULL;
+}
+
 static void set_item_name (MIR_item_t item, const char *name) {
   mir_assert (item != NULL);
   switch (item->item_type) {
@@ -2834,6 +2968,9 @@ static void simplify_op (MIR_context_t ctx, MIR_item_t func_item, MIR_insn_t ins
       return; /* do nothing: it is an immediate operand */
   }
   if (code == MIR_VA_ARG && nop == 2) return; /* do nothing: this operand is used as a type */
+  if ((code == MIR_MEMCPY || code == MIR_MEMSET) && nop == 2
+      && (op->mode == MIR_OP_INT || op->mode == MIR_OP_UINT))
+    return; /* do nothing: keep constant block size */
   switch (op->mode) {
   case MIR_OP_REF:
     if (keep_ref_p) break;
@@ -3113,6 +3250,10 @@ MIR_insn_code_t MIR_reverse_branch_code (MIR_insn_code_t code) {
   case MIR_BTS: return MIR_BFS;
   case MIR_BF: return MIR_BT;
   case MIR_BFS: return MIR_BTS;
+  case MIR_BO: return MIR_BNO;
+  case MIR_UBO: return MIR_UBNO;
+  case MIR_BNO: return MIR_BO;
+  case MIR_UBNO: return MIR_UBO;
   case MIR_BEQ: return MIR_BNE;
   case MIR_BEQS: return MIR_BNES;
   case MIR_BNE: return MIR_BEQ;
@@ -4042,7 +4183,9 @@ typedef enum {
    o EOI, EOF - tokens for end of insn (optional for most insns) and end of file
 */
 
-static const int CURR_BIN_VERSION = 1;
+/* Version 2: insn codes of overflow insns and branches, memcpy, and memset are inserted before
+   the following insn codes: */
+static const int CURR_BIN_VERSION = 2;
 
 DEF_VARR (MIR_str_t);
 DEF_VARR (uint64_t);
@@ -4894,9 +5037,9 @@ void MIR_read_with_func (MIR_context_t ctx, int (*const reader) (MIR_context_t))
                               "can not alloc data for MIR binary decompression");
 #endif
   version = read_uint (ctx, "wrong header");
-  if (version > CURR_BIN_VERSION)
+  if (version != CURR_BIN_VERSION) /* insn codes are renumbered in different versions */
     MIR_get_error_func (ctx) (MIR_binary_io_error,
-                              "can not read version %d MIR binary: expected %d or less", version,
+                              "can not read version %d MIR binary: expected %d", version,
                               CURR_BIN_VERSION);
   nstr = read_uint (ctx, "wrong header");
   read_all_strings (ctx, nstr);
@@ -72,7 +72,8 @@ typedef enum MIR_error_type {
   REP4 (ERR_EL, func, vararg_func, nested_func, wrong_param_value),
   REP5 (ERR_EL, reserved_name, import_export, undeclared_func_reg, repeated_decl, reg_type),
   REP6 (ERR_EL, wrong_type, unique_reg, undeclared_op_ref, ops_num, call_op, unspec_op),
-  REP6 (ERR_EL, ret, op_mode, out_op, invalid_insn, ctx_change, parallel)
+  REP8 (ERR_EL, ret, op_mode, out_op, invalid_insn, ctx_change, parallel, stack_overflow,
+        fuel_exhausted)
 } MIR_error_type_t;
 
 #ifdef __GNUC__
@@ -145,9 +146,15 @@ typedef enum {
   REP7 (INSN_EL, LE, LES, ULE, ULES, FLE, DLE, LDLE),        /* Less or equal */
   REP7 (INSN_EL, GT, GTS, UGT, UGTS, FGT, DGT, LDGT),        /* Greater then */
   REP7 (INSN_EL, GE, GES, UGE, UGES, FGE, DGE, LDGE),        /* Greater or equal */
+  /* Addition, subtraction, and multiplication which also set up
+     signed (U - unsigned) overflow flag checked by the branches below: */
+  REP8 (INSN_EL, ADDO, ADDOS, SUBO, SUBOS, MULO, MULOS, UMULO, UMULOS),
   /* Unconditional (1 operand) and conditional (2 operands) branch
      insns.  The first operand is a label.  */
   REP5 (INSN_EL, JMP, BT, BTS, BF, BFS),
+  /* Branch (1 operand) on signed/unsigned overflow or no overflow of
+     the previous overflow insn.  The first operand is a label.  */
+  REP4 (INSN_EL, BO, UBO, BNO, UBNO),
   /* Compare and branch (3 operand) insns.  The first operand is the
      label. */
   REP5 (INSN_EL, BEQ, BEQS, FBEQ, DBEQ, LDBEQ),
@@ -168,6 +175,9 @@ typedef enum {
   INSN_EL (RET),
   INSN_EL (ALLOCA),             /* 2 operands: result address and size  */
   REP2 (INSN_EL, BSTART, BEND), /* block start: result addr; block end: addr from block start */
+  /* Block copy: dest addr, src addr, size; block fill: dest addr, byte value, size.  The
+     size can be an immediate.  Copied blocks should not overlap: */
+  REP2 (INSN_EL, MEMCPY, MEMSET),
   /* Special insns: */
   INSN_EL (VA_ARG),       /* result is arg address, operands: va_list addr and memory */
   INSN_EL (VA_BLOCK_ARG), /* result is arg address, operands: va_list addr and integer (size) */
@@ -321,6 +331,8 @@ typedef struct MIR_func {
   MIR_item_t func_item;
   size_t original_vars_num;
   DLIST (MIR_insn_t) insns, original_insns;
+  char *insns_block; /* one allocation for all duplicated insns or NULL */
+  size_t insns_block_size;
   uint32_t nres, nargs, last_temp_num, n_inlines;
   MIR_type_t *res_types;
   char vararg_p;           /* flag of variable number of arguments */
@@ -453,7 +465,13 @@ static inline int MIR_int_branch_code_p (MIR_insn_code_t code) {
           || code == MIR_BLTS || code == MIR_UBLT || code == MIR_UBLTS || code == MIR_BLE
           || code == MIR_BLES || code == MIR_UBLE || code == MIR_UBLES || code == MIR_BGT
           || code == MIR_BGTS || code == MIR_UBGT || code == MIR_UBGTS || code == MIR_BGE
-          || code == MIR_BGES || code == MIR_UBGE || code == MIR_UBGES);
+          || code == MIR_BGES || code == MIR_UBGE || code == MIR_UBGES || code == MIR_BO
+          || code == MIR_UBO || code == MIR_BNO || code == MIR_UBNO);
+}
+
+static inline int MIR_overflow_code_p (MIR_insn_code_t code) {
+  return (code == MIR_ADDO || code == MIR_ADDOS || code == MIR_SUBO || code == MIR_SUBOS
+          || code == MIR_MULO || code == MIR_MULOS || code == MIR_UMULO || code == MIR_UMULOS);
 }
 
 static inline int MIR_branch_code_p (MIR_insn_code_t code) {
@@ -517,6 +535,14 @@ extern void MIR_finish_module (MIR_context_t ctx);
 extern MIR_error_func_t MIR_get_error_func (MIR_context_t ctx);
 extern void MIR_set_error_func (MIR_context_t ctx, MIR_error_func_t func);
 
+/* Fuel metering: */
+typedef void (*MIR_fuel_handler_t) (MIR_context_t ctx, void *data);
+
+extern void MIR_set_fuel_metering (MIR_context_t ctx, int enable_p);
+extern void MIR_set_fuel (MIR_context_t ctx, int64_t fuel);
+extern int64_t MIR_get_fuel (MIR_context_t ctx);
+extern void MIR_set_fuel_handler (MIR_context_t ctx, MIR_fuel_handler_t handler, void *data);
+
 extern MIR_insn_t MIR_new_insn_arr (MIR_context_t ctx, MIR_insn_code_t code, size_t nops,
                                     MIR_op_t *ops);
 extern MIR_insn_t MIR_new_insn (MIR_context_t ctx, MIR_insn_code_t code, ...);
@@ -610,6 +636,33 @@ extern void MIR_interp_arr_varg (MIR_context_t ctx, MIR_item_t func_item, MIR_va
                                  size_t nargs, MIR_val_t *vals, va_list va);
 extern void MIR_set_interp_interface (MIR_context_t ctx, MIR_item_t func_item);
 
+/* Interpreter profile mode: */
+typedef struct {
+  MIR_insn_t insn;
+  uint64_t count;              /* # of the insn executions */
+  uint64_t fall_through_count; /* # of not taken conditional branches */
+} MIR_interp_insn_profile_t;
+
+extern void MIR_interp_set_profile (MIR_context_t ctx, int enable_p);
+extern uint64_t MIR_interp_get_func_profile (MIR_context_t ctx, MIR_item_t func_item,
+                                             size_t *ninsns,
+                                             MIR_interp_insn_profile_t **insn_profiles);
+extern void MIR_interp_reset_profile (MIR_context_t ctx);
+extern void MIR_interp_output_profile (MIR_context_t ctx, FILE *f);
+
+/* Suspendable interpretation: */
+typedef struct MIR_interp_state *MIR_interp_state_t;
+
+extern MIR_interp_state_t MIR_interp_start (MIR_context_t ctx, MIR_item_t func_item,
+                                            MIR_val_t *results, size_t nargs, MIR_val_t *vals);
+extern int MIR_interp_resume (MIR_context_t ctx, MIR_interp_state_t state);
+extern void MIR_interp_yield (MIR_context_t ctx, MIR_interp_state_t state);
+extern void MIR_interp_set_fuel (MIR_context_t ctx, MIR_interp_state_t state, int64_t fuel);
+extern int64_t MIR_interp_get_fuel (MIR_context_t ctx, MIR_interp_state_t state);
+extern void MIR_interp_set_fuel_handler (MIR_context_t ctx, MIR_interp_state_t state,
+                                         MIR_fuel_handler_t handler, void *data);
+extern void MIR_interp_free_state (MIR_context_t ctx, MIR_interp_state_t state);
+
 /* Private: */
 extern double _MIR_get_api_version (void);
 extern MIR_context_t _MIR_init (void);
@@ -627,6 +680,9 @@ extern void _MIR_register_unspec_insn (MIR_context_t ctx, uint64_t code, const c
                                        int vararg_p, MIR_var_t *args);
 extern void _MIR_duplicate_func_insns (MIR_context_t ctx, MIR_item_t func_item);
 extern void _MIR_restore_func_insns (MIR_context_t ctx, MIR_item_t func_item);
+extern int64_t *_MIR_get_fuel_addr (MIR_context_t ctx);
+extern void _MIR_fuel_exhausted (MIR_context_t ctx);
+extern void _MIR_mark_loop_labels (MIR_context_t ctx, MIR_item_t func_item);
 
 extern void _MIR_output_data_item_els (MIR_context_t ctx, FILE *f, MIR_item_t item, int c_p);
 extern void _MIR_get_temp_item_name (MIR_context_t ctx, MIR_module_t module, char *buff,
@@ -117,6 +117,18 @@ static void out_usop3 (MIR_context_t ctx, FILE *f, MIR_op_t *ops, const char *st
   fprintf (f, ";\n");
 }
 
+/* Overflow insns set up the function local overflow flag ov__: */
+static void out_oop3 (MIR_context_t ctx, FILE *f, MIR_op_t *ops, const char *str,
+                      const char *type) {
+  fprintf (f, "{\n    %s res__;\n    ov__ = __builtin_%s_overflow ((%s) ", type, str, type);
+  out_op (ctx, f, ops[1]);
+  fprintf (f, ", (%s) ", type);
+  out_op (ctx, f, ops[2]);
+  fprintf (f, ", &res__);\n    ");
+  out_op (ctx, f, ops[0]);
+  fprintf (f, " = res__;\n  }\n");
+}
+
 static void out_jmp (MIR_context_t ctx, FILE *f, MIR_op_t label_op) {
   mir_assert (label_op.mode == MIR_OP_LABEL);
   fprintf (f, "goto ");
@@ -288,7 +300,25 @@ static void out_insn (MIR_context_t ctx, FILE *f, MIR_insn_t insn) {
   case MIR_FGE:
   case MIR_DGE:
   case MIR_LDGE: out_fop3 (ctx, f, ops, ">="); break;
+  case MIR_ADDO: out_oop3 (ctx, f, ops, "add", "int64_t"); break;
+  case MIR_ADDOS: out_oop3 (ctx, f, ops, "add", "int32_t"); break;
+  case MIR_SUBO: out_oop3 (ctx, f, ops, "sub", "int64_t"); break;
+  case MIR_SUBOS: out_oop3 (ctx, f, ops, "sub", "int32_t"); break;
+  case MIR_MULO: out_oop3 (ctx, f, ops, "mul", "int64_t"); break;
+  case MIR_MULOS: out_oop3 (ctx, f, ops, "mul", "int32_t"); break;
+  case MIR_UMULO: out_oop3 (ctx, f, ops, "mul", "uint64_t"); break;
+  case MIR_UMULOS: out_oop3 (ctx, f, ops, "mul", "uint32_t"); break;
   case MIR_JMP: out_jmp (ctx, f, ops[0]); break;
+  case MIR_BO:
+  case MIR_UBO:
+    fprintf (f, "if (ov__) ");
+    out_jmp (ctx, f, ops[0]);
+    break;
+  case MIR_BNO:
+  case MIR_UBNO:
+    fprintf (f, "if (! ov__) ");
+    out_jmp (ctx, f, ops[0]);
+    break;
   case MIR_BT:
     fprintf (f, "if ((int64_t) ");
     out_op (ctx, f, ops[1]);
@@ -346,6 +376,16 @@ static void out_insn (MIR_context_t ctx, FILE *f, MIR_insn_t insn) {
     out_op (ctx, f, ops[1]);
     fprintf (f, ");\n");
     break;
+  case MIR_MEMCPY:
+  case MIR_MEMSET:
+    fprintf (f, "__builtin_%s ((void *) ", insn->code == MIR_MEMCPY ? "memcpy" : "memset");
+    out_op (ctx, f, ops[0]);
+    fprintf (f, insn->code == MIR_MEMCPY ? ", (void *) " : ", (int) ");
+    out_op (ctx, f, ops[1]);
+    fprintf (f, ", ");
+    out_op (ctx, f, ops[2]);
+    fprintf (f, ");\n");
+    break;
   case MIR_CALL:
   case MIR_INLINE: {
     MIR_proto_t proto;
@@ -572,6 +612,12 @@ static void out_item (MIR_context_t ctx, FILE *f, MIR_item_t item) {
     out_type (f, var.type);
     fprintf (f, " %s;\n", var.name);
   }
+  for (MIR_insn_t insn = DLIST_HEAD (MIR_insn_t, curr_func->insns); insn != NULL;
+       insn = DLIST_NEXT (MIR_insn_t, insn))
+    if (MIR_overflow_code_p (insn->code)) {
+      fprintf (f, "  int ov__ = 0;\n");
+      break;
+    }
   for (MIR_insn_t insn = DLIST_HEAD (MIR_insn_t, curr_func->insns); insn != NULL;
        insn = DLIST_NEXT (MIR_insn_t, insn))
     out_insn (ctx, f, insn);